@@ -0,0 +1,260 @@
+#include "CudaMeshBackend.h"
+
+//Members share their names with the kernel wrappers, so the wrappers are called through the global scope
+
+bool CudaMeshBackend::isAvailable()
+{
+	int deviceCount = 0;
+	if(cudaGetDeviceCount(&deviceCount) != cudaSuccess)
+		return false;
+	return deviceCount > 0;
+}
+
+#pragma region Memory
+void* CudaMeshBackend::allocate(size_t bytes)
+{
+	void* ptr = NULL;
+	cudaMalloc(&ptr, bytes);
+	return ptr;
+}
+
+void CudaMeshBackend::release(void* ptr)
+{
+	cudaFree(ptr);
+}
+
+void* CudaMeshBackend::allocateHost(size_t bytes)
+{
+	void* ptr = NULL;
+	cudaMallocHost(&ptr, bytes);
+	return ptr;
+}
+
+void CudaMeshBackend::releaseHost(void* ptr)
+{
+	cudaFreeHost(ptr);
+}
+
+void CudaMeshBackend::copyToDevice(void* dest, const void* src, size_t bytes)
+{
+	cudaMemcpy(dest, src, bytes, cudaMemcpyHostToDevice);
+}
+
+void CudaMeshBackend::copyToHost(void* dest, const void* src, size_t bytes)
+{
+	cudaMemcpy(dest, src, bytes, cudaMemcpyDeviceToHost);
+}
+
+void CudaMeshBackend::synchronize()
+{
+	cudaDeviceSynchronize();
+}
+#pragma endregion
+
+#pragma region Preprocessing
+void CudaMeshBackend::rgbAOSToSOA(rgbd::framework::ColorPixel* colorPixels, Float3SOAPyramid rgbSOA, int xRes, int yRes)
+{
+	::rgbAOSToSOACUDA(colorPixels, rgbSOA, xRes, yRes);
+}
+
+void CudaMeshBackend::flipDepthImageXAxis(rgbd::framework::DPixel* depthBuffer, int xRes, int yRes)
+{
+	::flipDepthImageXAxis(depthBuffer, xRes, yRes);
+}
+
+void CudaMeshBackend::buildVMapNoFilter(rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+										rgbd::framework::Intrinsics intr, float maxDepth)
+{
+	::buildVMapNoFilterCUDA(depthBuffer, vmapSOA, xRes, yRes, intr, maxDepth);
+}
+
+void CudaMeshBackend::setGaussianSpatialKernel(float sigma)
+{
+	::setGaussianSpatialKernel(sigma);
+}
+
+void CudaMeshBackend::buildVMapGaussianFilter(rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+											  rgbd::framework::Intrinsics intr, float maxDepth)
+{
+	::buildVMapGaussianFilterCUDA(depthBuffer, vmapSOA, xRes, yRes, intr, maxDepth);
+}
+
+void CudaMeshBackend::buildVMapBilateralFilter(rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+											   rgbd::framework::Intrinsics intr, float maxDepth, float sigma_t)
+{
+	::buildVMapBilateralFilterCUDA(depthBuffer, vmapSOA, xRes, yRes, intr, maxDepth, sigma_t);
+}
+
+void CudaMeshBackend::subsamplePyramid(Float3SOAPyramid mapSOA, int xRes, int yRes, int numLevels)
+{
+	::subsamplePyramidCUDA(mapSOA, xRes, yRes, numLevels);
+}
+#pragma endregion
+
+#pragma region Normals
+void CudaMeshBackend::simpleNormals(Float3SOAPyramid vmap, Float3SOAPyramid nmap, int numLevels, int xRes, int yRes)
+{
+	::simpleNormals(vmap, nmap, numLevels, xRes, yRes);
+}
+
+void CudaMeshBackend::horizontalGradient(float* image_in, float* gradient_out, int width, int height)
+{
+	::horizontalGradient(image_in, gradient_out, width, height);
+}
+
+void CudaMeshBackend::verticalGradient(float* image_in, float* gradient_out, int width, int height)
+{
+	::verticalGradient(image_in, gradient_out, width, height);
+}
+
+void CudaMeshBackend::setSeperableKernelGaussian(float sigma)
+{
+	::setSeperableKernelGaussian(sigma);
+}
+
+void CudaMeshBackend::seperableFilter(float* x, float* y, float* z, float* x_out, float* y_out, float* z_out, int xRes, int yRes)
+{
+	::seperableFilter(x, y, z, x_out, y_out, z_out, xRes, yRes);
+}
+
+void CudaMeshBackend::computeAverageGradientNormals(Float3SOAPyramid horizontalGradient, Float3SOAPyramid vertGradient,
+													Float3SOAPyramid vmap, Float3SOAPyramid nmap, int xRes, int yRes)
+{
+	::computeAverageGradientNormals(horizontalGradient, vertGradient, vmap, nmap, xRes, yRes);
+}
+#pragma endregion
+
+#pragma region Segmentation
+void CudaMeshBackend::clearHistogram(int* histogram, int xBins, int yBins)
+{
+	::clearHistogram(histogram, xBins, yBins);
+}
+
+void CudaMeshBackend::computeNormalHistogram(float* normX, float* normY, float* normZ, int* finalSegmentsBuffer, int* histogram,
+											 int xRes, int yRes, int xBins, int yBins, bool excludePreviousSegments)
+{
+	::computeNormalHistogram(normX, normY, normZ, finalSegmentsBuffer, histogram, xRes, yRes, xBins, yBins, excludePreviousSegments);
+}
+
+void CudaMeshBackend::normalHistogramPrimaryPeakDetection(int* histogram, int xBins, int yBins, Float3SOA peaks, int maxPeaks,
+														  int exclusionRadius, int minPeakHeight, float previousPeaksClearRadius)
+{
+	::normalHistogramPrimaryPeakDetection(histogram, xBins, yBins, peaks, maxPeaks, exclusionRadius, minPeakHeight, previousPeaksClearRadius);
+}
+
+void CudaMeshBackend::segmentNormals2D(Float3SOA rawNormals, Float3SOA rawPositions,
+									   int* normalSegments, float* projectedDistance, int imageWidth, int imageHeight,
+									   int* histogram, int xBins, int yBins, Float3SOA peaks, int maxPeaks, float maxAngleRange)
+{
+	::segmentNormals2D(rawNormals, rawPositions, normalSegments, projectedDistance, imageWidth, imageHeight,
+		histogram, xBins, yBins, peaks, maxPeaks, maxAngleRange);
+}
+
+void CudaMeshBackend::generateDistanceHistograms(int* normalSegments, float* planeProjectedDistanceMap, int xRes, int yRes,
+												 int** distanceHistograms, int numMaxNormalSegments, int histcount, float histMinDist, float histMaxDist)
+{
+	::generateDistanceHistograms(normalSegments, planeProjectedDistanceMap, xRes, yRes,
+		distanceHistograms, numMaxNormalSegments, histcount, histMinDist, histMaxDist);
+}
+
+void CudaMeshBackend::distanceHistogramPrimaryPeakDetection(int* histogram, int length, int numHistograms, float* distPeaks, int maxDistPeaks,
+															int exclusionRadius, int minPeakHeight, float minHistDist, float maxHistDist)
+{
+	::distanceHistogramPrimaryPeakDetection(histogram, length, numHistograms, distPeaks, maxDistPeaks,
+		exclusionRadius, minPeakHeight, minHistDist, maxHistDist);
+}
+
+void CudaMeshBackend::fineDistanceSegmentation(float* distPeaks, int numNormalPeaks, int maxDistPeaks,
+											   Float3SOA positions, PlaneStats* planeStats, int* normalSegments, float* planeProjectedDistanceMap,
+											   int xRes, int yRes, float maxDistTolerance, int iteration)
+{
+	::fineDistanceSegmentation(distPeaks, numNormalPeaks, maxDistPeaks, positions, planeStats,
+		normalSegments, planeProjectedDistanceMap, xRes, yRes, maxDistTolerance, iteration);
+}
+
+void CudaMeshBackend::clearPlaneStats(PlaneStats* planeStats, int numNormalPeaks, int numDistPeaks, int maxRounds, int iteration)
+{
+	::clearPlaneStats(planeStats, numNormalPeaks, numDistPeaks, maxRounds, iteration);
+}
+
+void CudaMeshBackend::finalizePlanes(PlaneStats* planeStats, int numNormalPeaks, int numDistPeaks,
+									 float mergeAngleThresh, float mergeDistThresh, int iteration)
+{
+	::finalizePlanes(planeStats, numNormalPeaks, numDistPeaks, mergeAngleThresh, mergeDistThresh, iteration);
+}
+
+void CudaMeshBackend::fitFinalPlanes(PlaneStats* planeStats, int numPlanes,
+									 Float3SOA norms, Float3SOA positions, int* finalSegmentsBuffer, float* distToPlaneBuffer, int xRes, int yRes,
+									 float fitAngleThresh, float fitDistThresh, int iteration)
+{
+	::fitFinalPlanes(planeStats, numPlanes, norms, positions, finalSegmentsBuffer, distToPlaneBuffer, xRes, yRes,
+		fitAngleThresh, fitDistThresh, iteration);
+}
+
+void CudaMeshBackend::realignPeaks(PlaneStats* planeStats, Float3SOA normalPeaks, int numNormPeaks, int numDistPeaks,
+								   int xBins, int yBins, int iteration)
+{
+	::realignPeaks(planeStats, normalPeaks, numNormPeaks, numDistPeaks, xBins, yBins, iteration);
+}
+
+void CudaMeshBackend::mergePlanes(PlaneStats* planeStats, int numPlanes, float mergeAngleThresh, float mergeDistThresh)
+{
+	::mergePlanes(planeStats, numPlanes, mergeAngleThresh, mergeDistThresh);
+}
+
+void CudaMeshBackend::generatePlaneCompressionMap(PlaneStats* planeStats, int numPlanes, int* planeIdMap, int* planeInvIdMap, int* planeCountOut)
+{
+	::generatePlaneCompressionMap(planeStats, numPlanes, planeIdMap, planeInvIdMap, planeCountOut);
+}
+
+void CudaMeshBackend::compactPlaneStats(PlaneStats* planeStats, int numPlanes, int* planeIdMap, int* planeCount)
+{
+	::compactPlaneStats(planeStats, numPlanes, planeIdMap, planeCount);
+}
+
+void CudaMeshBackend::computePlaneTangents(PlaneStats* planeStats, int numPlanes, int* planeCount)
+{
+	::computePlaneTangents(planeStats, numPlanes, planeCount);
+}
+#pragma endregion
+
+#pragma region Texture projection and quadtree meshing
+void CudaMeshBackend::computeAABBs(PlaneStats* planeStats, int* planeInvIdMap, glm::vec4* aabbsBlockResults,
+								   int* planeCount, int maxPlanes, Float3SOA positions, float* segmentProjectedSx, float* segmentProjectedSy,
+								   int* finalSegmentsBuffer, int xRes, int yRes)
+{
+	::computeAABBs(planeStats, planeInvIdMap, aabbsBlockResults, planeCount, maxPlanes,
+		positions, segmentProjectedSx, segmentProjectedSy, finalSegmentsBuffer, xRes, yRes);
+}
+
+void CudaMeshBackend::calculateProjectionData(rgbd::framework::Intrinsics intr, PlaneStats* planeStats,
+											  int* planeCount, int maxTextureSize, int maxPlanes, int xRes, int yRes)
+{
+	::calculateProjectionData(intr, planeStats, planeCount, maxTextureSize, maxPlanes, xRes, yRes);
+}
+
+void CudaMeshBackend::projectTexture(int segmentId, PlaneStats* host_planeStats, PlaneStats* dev_planeStats,
+									 Float4SOA destTexture, int destTextureSize, RGBMapSOA rgbMap, int* finalSegmentsBuffer, float* finalDistanceToPlaneBuffer,
+									 int imageXRes, int imageYRes)
+{
+	::projectTexture(segmentId, host_planeStats, dev_planeStats, destTexture, destTextureSize,
+		rgbMap, finalSegmentsBuffer, finalDistanceToPlaneBuffer, imageXRes, imageYRes);
+}
+
+void CudaMeshBackend::quadtreeDecimation(int actualWidth, int actualHeight, Float4SOA planarTexture, int* quadTreeAssemblyBuffer,
+										 int textureBufferSize)
+{
+	::quadtreeDecimation(actualWidth, actualHeight, planarTexture, quadTreeAssemblyBuffer, textureBufferSize);
+}
+
+void CudaMeshBackend::quadtreeMeshGeneration(glm::vec4 aabbMeters, int actualWidth, int actualHeight, int* quadTreeAssemblyBuffer,
+											 int* quadTreeScanResults, int textureBufferSize, int* blockResults, int blockResultsBufferSize,
+											 int* indexBuffer, float4* vertexBuffer, int* compactCount, int* host_compactCount, int outputBufferSize,
+											 int finalTextureWidth, int finalTextureHeight, Float4SOA planarTexture, float4* finalTexture)
+{
+	::quadtreeMeshGeneration(aabbMeters, actualWidth, actualHeight, quadTreeAssemblyBuffer,
+		quadTreeScanResults, textureBufferSize, blockResults, blockResultsBufferSize,
+		indexBuffer, vertexBuffer, compactCount, host_compactCount, outputBufferSize,
+		finalTextureWidth, finalTextureHeight, planarTexture, finalTexture);
+}
+#pragma endregion
@@ -0,0 +1,92 @@
+#pragma once
+#include "MeshComputeBackend.h"
+#include "preprocessing.h"
+#include "normal_estimates.h"
+#include "gradient.h"
+#include "seperable_filter.h"
+#include "plane_segmentation.h"
+#include "quadtree.h"
+
+/*
+*	Class CudaMeshBackend
+*	Runs every stage on the GPU through the __host__ kernel wrappers. Buffers are cudaMalloc device memory,
+*	results are copied back into page locked host memory.
+*/
+class CudaMeshBackend : public MeshComputeBackend
+{
+public:
+	MeshBackendType getType() override {return MESH_BACKEND_CUDA;}
+
+	//True if a CUDA capable device is present
+	static bool isAvailable();
+
+	void* allocate(size_t bytes) override;
+	void release(void* ptr) override;
+	void* allocateHost(size_t bytes) override;
+	void releaseHost(void* ptr) override;
+	void copyToDevice(void* dest, const void* src, size_t bytes) override;
+	void copyToHost(void* dest, const void* src, size_t bytes) override;
+	void synchronize() override;
+
+	void rgbAOSToSOA(rgbd::framework::ColorPixel* colorPixels, Float3SOAPyramid rgbSOA, int xRes, int yRes) override;
+	void flipDepthImageXAxis(rgbd::framework::DPixel* depthBuffer, int xRes, int yRes) override;
+	void buildVMapNoFilter(rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+		rgbd::framework::Intrinsics intr, float maxDepth) override;
+	void setGaussianSpatialKernel(float sigma) override;
+	void buildVMapGaussianFilter(rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+		rgbd::framework::Intrinsics intr, float maxDepth) override;
+	void buildVMapBilateralFilter(rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+		rgbd::framework::Intrinsics intr, float maxDepth, float sigma_t) override;
+	void subsamplePyramid(Float3SOAPyramid mapSOA, int xRes, int yRes, int numLevels) override;
+
+	void simpleNormals(Float3SOAPyramid vmap, Float3SOAPyramid nmap, int numLevels, int xRes, int yRes) override;
+	void horizontalGradient(float* image_in, float* gradient_out, int width, int height) override;
+	void verticalGradient(float* image_in, float* gradient_out, int width, int height) override;
+	void setSeperableKernelGaussian(float sigma) override;
+	void seperableFilter(float* x, float* y, float* z, float* x_out, float* y_out, float* z_out, int xRes, int yRes) override;
+	void computeAverageGradientNormals(Float3SOAPyramid horizontalGradient, Float3SOAPyramid vertGradient,
+		Float3SOAPyramid vmap, Float3SOAPyramid nmap, int xRes, int yRes) override;
+
+	void clearHistogram(int* histogram, int xBins, int yBins) override;
+	void computeNormalHistogram(float* normX, float* normY, float* normZ, int* finalSegmentsBuffer, int* histogram,
+		int xRes, int yRes, int xBins, int yBins, bool excludePreviousSegments) override;
+	void normalHistogramPrimaryPeakDetection(int* histogram, int xBins, int yBins, Float3SOA peaks, int maxPeaks,
+		int exclusionRadius, int minPeakHeight, float previousPeaksClearRadius) override;
+	void segmentNormals2D(Float3SOA rawNormals, Float3SOA rawPositions,
+		int* normalSegments, float* projectedDistance, int imageWidth, int imageHeight,
+		int* histogram, int xBins, int yBins, Float3SOA peaks, int maxPeaks, float maxAngleRange) override;
+	void generateDistanceHistograms(int* normalSegments, float* planeProjectedDistanceMap, int xRes, int yRes,
+		int** distanceHistograms, int numMaxNormalSegments, int histcount, float histMinDist, float histMaxDist) override;
+	void distanceHistogramPrimaryPeakDetection(int* histogram, int length, int numHistograms, float* distPeaks, int maxDistPeaks,
+		int exclusionRadius, int minPeakHeight, float minHistDist, float maxHistDist) override;
+	void fineDistanceSegmentation(float* distPeaks, int numNormalPeaks, int maxDistPeaks,
+		Float3SOA positions, PlaneStats* planeStats, int* normalSegments, float* planeProjectedDistanceMap,
+		int xRes, int yRes, float maxDistTolerance, int iteration) override;
+	void clearPlaneStats(PlaneStats* planeStats, int numNormalPeaks, int numDistPeaks, int maxRounds, int iteration) override;
+	void finalizePlanes(PlaneStats* planeStats, int numNormalPeaks, int numDistPeaks,
+		float mergeAngleThresh, float mergeDistThresh, int iteration) override;
+	void fitFinalPlanes(PlaneStats* planeStats, int numPlanes,
+		Float3SOA norms, Float3SOA positions, int* finalSegmentsBuffer, float* distToPlaneBuffer, int xRes, int yRes,
+		float fitAngleThresh, float fitDistThresh, int iteration) override;
+	void realignPeaks(PlaneStats* planeStats, Float3SOA normalPeaks, int numNormPeaks, int numDistPeaks,
+		int xBins, int yBins, int iteration) override;
+	void mergePlanes(PlaneStats* planeStats, int numPlanes, float mergeAngleThresh, float mergeDistThresh) override;
+	void generatePlaneCompressionMap(PlaneStats* planeStats, int numPlanes, int* planeIdMap, int* planeInvIdMap, int* planeCountOut) override;
+	void compactPlaneStats(PlaneStats* planeStats, int numPlanes, int* planeIdMap, int* planeCount) override;
+	void computePlaneTangents(PlaneStats* planeStats, int numPlanes, int* planeCount) override;
+
+	void computeAABBs(PlaneStats* planeStats, int* planeInvIdMap, glm::vec4* aabbsBlockResults,
+		int* planeCount, int maxPlanes, Float3SOA positions, float* segmentProjectedSx, float* segmentProjectedSy,
+		int* finalSegmentsBuffer, int xRes, int yRes) override;
+	void calculateProjectionData(rgbd::framework::Intrinsics intr, PlaneStats* planeStats,
+		int* planeCount, int maxTextureSize, int maxPlanes, int xRes, int yRes) override;
+	void projectTexture(int segmentId, PlaneStats* host_planeStats, PlaneStats* dev_planeStats,
+		Float4SOA destTexture, int destTextureSize, RGBMapSOA rgbMap, int* finalSegmentsBuffer, float* finalDistanceToPlaneBuffer,
+		int imageXRes, int imageYRes) override;
+	void quadtreeDecimation(int actualWidth, int actualHeight, Float4SOA planarTexture, int* quadTreeAssemblyBuffer,
+		int textureBufferSize) override;
+	void quadtreeMeshGeneration(glm::vec4 aabbMeters, int actualWidth, int actualHeight, int* quadTreeAssemblyBuffer,
+		int* quadTreeScanResults, int textureBufferSize, int* blockResults, int blockResultsBufferSize,
+		int* indexBuffer, float4* vertexBuffer, int* compactCount, int* host_compactCount, int outputBufferSize,
+		int finalTextureWidth, int finalTextureHeight, Float4SOA planarTexture, float4* finalTexture) override;
+};
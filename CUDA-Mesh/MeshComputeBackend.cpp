@@ -0,0 +1,21 @@
+#include "MeshComputeBackend.h"
+#include "CudaMeshBackend.h"
+#include "cpu/CpuMeshBackend.h"
+
+shared_ptr<MeshComputeBackend> createMeshComputeBackend(MeshBackendType type)
+{
+	switch(type)
+	{
+	case MESH_BACKEND_CUDA:
+		if(!CudaMeshBackend::isAvailable())
+			return shared_ptr<MeshComputeBackend>();
+		return shared_ptr<MeshComputeBackend>(new CudaMeshBackend());
+	case MESH_BACKEND_CPU:
+		return shared_ptr<MeshComputeBackend>(new CpuMeshBackend());
+	case MESH_BACKEND_AUTO:
+	default:
+		if(CudaMeshBackend::isAvailable())
+			return shared_ptr<MeshComputeBackend>(new CudaMeshBackend());
+		return shared_ptr<MeshComputeBackend>(new CpuMeshBackend());
+	}
+}
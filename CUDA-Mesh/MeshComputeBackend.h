@@ -0,0 +1,119 @@
+#pragma once
+#include "device_structs.h"
+#include "cuda_runtime.h"
+#include "RGBDFrame.h"
+#include "Calibration.h"
+#include <memory>
+
+using namespace std;
+
+enum MeshBackendType
+{
+	MESH_BACKEND_CUDA,
+	MESH_BACKEND_CPU,
+	//CUDA if a device is present, CPU otherwise
+	MESH_BACKEND_AUTO
+};
+
+/*
+*	Class MeshComputeBackend
+*	Runs the MeshTracker pipeline stages. MeshTracker owns the buffers and the order of the stages, a backend
+*	owns where the buffers live and how each stage is computed.
+*	Methods mirror the CUDA __host__ wrappers one to one, so both backends take the same buffers and arguments and
+*	produce the same results. Pointers passed to stages are "device" memory from allocate.
+*	Calls come from one thread at a time.
+*/
+class MeshComputeBackend
+{
+public:
+	virtual ~MeshComputeBackend(){}
+
+	virtual MeshBackendType getType() = 0;
+
+#pragma region Memory
+	//Buffer the stages can read and write
+	virtual void* allocate(size_t bytes) = 0;
+	virtual void release(void* ptr) = 0;
+	//Host side memory results are copied back into. Page locked where the backend supports it
+	virtual void* allocateHost(size_t bytes) = 0;
+	virtual void releaseHost(void* ptr) = 0;
+	virtual void copyToDevice(void* dest, const void* src, size_t bytes) = 0;
+	virtual void copyToHost(void* dest, const void* src, size_t bytes) = 0;
+	//Returns when all queued work is done
+	virtual void synchronize() = 0;
+#pragma endregion
+
+#pragma region Preprocessing
+	virtual void rgbAOSToSOA(rgbd::framework::ColorPixel* colorPixels, Float3SOAPyramid rgbSOA, int xRes, int yRes) = 0;
+	virtual void flipDepthImageXAxis(rgbd::framework::DPixel* depthBuffer, int xRes, int yRes) = 0;
+	virtual void buildVMapNoFilter(rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+		rgbd::framework::Intrinsics intr, float maxDepth) = 0;
+	virtual void setGaussianSpatialKernel(float sigma) = 0;
+	virtual void buildVMapGaussianFilter(rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+		rgbd::framework::Intrinsics intr, float maxDepth) = 0;
+	virtual void buildVMapBilateralFilter(rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+		rgbd::framework::Intrinsics intr, float maxDepth, float sigma_t) = 0;
+	virtual void subsamplePyramid(Float3SOAPyramid mapSOA, int xRes, int yRes, int numLevels) = 0;
+#pragma endregion
+
+#pragma region Normals
+	virtual void simpleNormals(Float3SOAPyramid vmap, Float3SOAPyramid nmap, int numLevels, int xRes, int yRes) = 0;
+	virtual void horizontalGradient(float* image_in, float* gradient_out, int width, int height) = 0;
+	virtual void verticalGradient(float* image_in, float* gradient_out, int width, int height) = 0;
+	virtual void setSeperableKernelGaussian(float sigma) = 0;
+	virtual void seperableFilter(float* x, float* y, float* z, float* x_out, float* y_out, float* z_out, int xRes, int yRes) = 0;
+	virtual void computeAverageGradientNormals(Float3SOAPyramid horizontalGradient, Float3SOAPyramid vertGradient,
+		Float3SOAPyramid vmap, Float3SOAPyramid nmap, int xRes, int yRes) = 0;
+#pragma endregion
+
+#pragma region Segmentation
+	virtual void clearHistogram(int* histogram, int xBins, int yBins) = 0;
+	virtual void computeNormalHistogram(float* normX, float* normY, float* normZ, int* finalSegmentsBuffer, int* histogram,
+		int xRes, int yRes, int xBins, int yBins, bool excludePreviousSegments) = 0;
+	virtual void normalHistogramPrimaryPeakDetection(int* histogram, int xBins, int yBins, Float3SOA peaks, int maxPeaks,
+		int exclusionRadius, int minPeakHeight, float previousPeaksClearRadius) = 0;
+	virtual void segmentNormals2D(Float3SOA rawNormals, Float3SOA rawPositions,
+		int* normalSegments, float* projectedDistance, int imageWidth, int imageHeight,
+		int* histogram, int xBins, int yBins, Float3SOA peaks, int maxPeaks, float maxAngleRange) = 0;
+	virtual void generateDistanceHistograms(int* normalSegments, float* planeProjectedDistanceMap, int xRes, int yRes,
+		int** distanceHistograms, int numMaxNormalSegments, int histcount, float histMinDist, float histMaxDist) = 0;
+	virtual void distanceHistogramPrimaryPeakDetection(int* histogram, int length, int numHistograms, float* distPeaks, int maxDistPeaks,
+		int exclusionRadius, int minPeakHeight, float minHistDist, float maxHistDist) = 0;
+	virtual void fineDistanceSegmentation(float* distPeaks, int numNormalPeaks, int maxDistPeaks,
+		Float3SOA positions, PlaneStats* planeStats, int* normalSegments, float* planeProjectedDistanceMap,
+		int xRes, int yRes, float maxDistTolerance, int iteration) = 0;
+	virtual void clearPlaneStats(PlaneStats* planeStats, int numNormalPeaks, int numDistPeaks, int maxRounds, int iteration) = 0;
+	virtual void finalizePlanes(PlaneStats* planeStats, int numNormalPeaks, int numDistPeaks,
+		float mergeAngleThresh, float mergeDistThresh, int iteration) = 0;
+	virtual void fitFinalPlanes(PlaneStats* planeStats, int numPlanes,
+		Float3SOA norms, Float3SOA positions, int* finalSegmentsBuffer, float* distToPlaneBuffer, int xRes, int yRes,
+		float fitAngleThresh, float fitDistThresh, int iteration) = 0;
+	virtual void realignPeaks(PlaneStats* planeStats, Float3SOA normalPeaks, int numNormPeaks, int numDistPeaks,
+		int xBins, int yBins, int iteration) = 0;
+	virtual void mergePlanes(PlaneStats* planeStats, int numPlanes, float mergeAngleThresh, float mergeDistThresh) = 0;
+	virtual void generatePlaneCompressionMap(PlaneStats* planeStats, int numPlanes, int* planeIdMap, int* planeInvIdMap, int* planeCountOut) = 0;
+	virtual void compactPlaneStats(PlaneStats* planeStats, int numPlanes, int* planeIdMap, int* planeCount) = 0;
+	virtual void computePlaneTangents(PlaneStats* planeStats, int numPlanes, int* planeCount) = 0;
+#pragma endregion
+
+#pragma region Texture projection and quadtree meshing
+	virtual void computeAABBs(PlaneStats* planeStats, int* planeInvIdMap, glm::vec4* aabbsBlockResults,
+		int* planeCount, int maxPlanes, Float3SOA positions, float* segmentProjectedSx, float* segmentProjectedSy,
+		int* finalSegmentsBuffer, int xRes, int yRes) = 0;
+	virtual void calculateProjectionData(rgbd::framework::Intrinsics intr, PlaneStats* planeStats,
+		int* planeCount, int maxTextureSize, int maxPlanes, int xRes, int yRes) = 0;
+	//host_planeStats and dev_planeStats are the same plane, preoffset to it
+	virtual void projectTexture(int segmentId, PlaneStats* host_planeStats, PlaneStats* dev_planeStats,
+		Float4SOA destTexture, int destTextureSize, RGBMapSOA rgbMap, int* finalSegmentsBuffer, float* finalDistanceToPlaneBuffer,
+		int imageXRes, int imageYRes) = 0;
+	virtual void quadtreeDecimation(int actualWidth, int actualHeight, Float4SOA planarTexture, int* quadTreeAssemblyBuffer,
+		int textureBufferSize) = 0;
+	virtual void quadtreeMeshGeneration(glm::vec4 aabbMeters, int actualWidth, int actualHeight, int* quadTreeAssemblyBuffer,
+		int* quadTreeScanResults, int textureBufferSize, int* blockResults, int blockResultsBufferSize,
+		int* indexBuffer, float4* vertexBuffer, int* compactCount, int* host_compactCount, int outputBufferSize,
+		int finalTextureWidth, int finalTextureHeight, Float4SOA planarTexture, float4* finalTexture) = 0;
+#pragma endregion
+};
+
+//Returns NULL if type is MESH_BACKEND_CUDA and no CUDA device is present
+shared_ptr<MeshComputeBackend> createMeshComputeBackend(MeshBackendType type);
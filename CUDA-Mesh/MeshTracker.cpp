@@ -1,9 +1,13 @@
 #include "MeshTracker.h"
+#include "CudaMeshBackend.h"
 
 #pragma region Ctor/Dtor
 
-MeshTracker::MeshTracker(int xResolution, int yResolution, Intrinsics intr)
+MeshTracker::MeshTracker(int xResolution, int yResolution, Intrinsics intr, shared_ptr<MeshComputeBackend> backend)
 {
+	//Default to the GPU pipeline
+	mBackend = (backend != NULL) ? backend : shared_ptr<MeshComputeBackend>(new CudaMeshBackend());
+
 	mXRes = xResolution;
 	mYRes = yResolution;
 	mIntr = intr;
@@ -40,8 +44,8 @@ MeshTracker::~MeshTracker(void)
 void MeshTracker::initBuffers(int xRes, int yRes)
 {
 	int pixCount = xRes*yRes;
-	cudaMalloc((void**) &dev_colorImageBuffer,				sizeof(ColorPixel)*pixCount);
-	cudaMalloc((void**) &dev_depthImageBuffer,				sizeof(DPixel)*pixCount);
+	backendMalloc(&dev_colorImageBuffer,				sizeof(ColorPixel)*pixCount);
+	backendMalloc(&dev_depthImageBuffer,				sizeof(DPixel)*pixCount);
 
 
 	//Setup SOA buffers, ensuring contiguous memory for pyramids 
@@ -55,55 +59,55 @@ void MeshTracker::initBuffers(int xRes, int yRes)
 	createFloat3SOAPyramid(dev_nmapSOA, xRes, yRes);
 
 	//2D Normal Histogram
-	cudaMalloc((void**) &dev_normalVoxels,	NUM_NORMAL_X_SUBDIVISIONS*NUM_NORMAL_Y_SUBDIVISIONS*sizeof(int));
+	backendMalloc(&dev_normalVoxels,	NUM_NORMAL_X_SUBDIVISIONS*NUM_NORMAL_Y_SUBDIVISIONS*sizeof(int));
 
 	//Normal Segmentation Results
-	cudaMalloc((void**) &dev_normalSegments, xRes*yRes*sizeof(int));
-	cudaMalloc((void**) &dev_planeProjectedDistanceMap, xRes*yRes*sizeof(float));
+	backendMalloc(&dev_normalSegments, xRes*yRes*sizeof(int));
+	backendMalloc(&dev_planeProjectedDistanceMap, xRes*yRes*sizeof(float));
 
 	createFloat3SOA(dev_normalPeaks, MAX_2D_PEAKS_PER_ROUND);
 
 	//Projected distance histograms
-	cudaMalloc((void**) &(dev_distanceHistograms[0]), MAX_2D_PEAKS_PER_ROUND*DISTANCE_HIST_COUNT*sizeof(int));
+	backendMalloc(&(dev_distanceHistograms[0]), MAX_2D_PEAKS_PER_ROUND*DISTANCE_HIST_COUNT*sizeof(int));
 	for(int i = 1; i < MAX_2D_PEAKS_PER_ROUND; i++)//Update other pointers
 		dev_distanceHistograms[i] = dev_distanceHistograms[i-1] + DISTANCE_HIST_COUNT;
 
-	cudaMalloc((void**) &(dev_distPeaks[0]), MAX_2D_PEAKS_PER_ROUND*DISTANCE_HIST_MAX_PEAKS*sizeof(float));
+	backendMalloc(&(dev_distPeaks[0]), MAX_2D_PEAKS_PER_ROUND*DISTANCE_HIST_MAX_PEAKS*sizeof(float));
 	for(int i = 1; i < MAX_2D_PEAKS_PER_ROUND; i++)//Update other pointers
 		dev_distPeaks[i] = dev_distPeaks[i-1] + DISTANCE_HIST_COUNT;
 
 
 
 	//Plane stats buffers
-	cudaMalloc((void**) &dev_planeStats, MAX_PLANES_TOTAL*sizeof(PlaneStats));
+	backendMalloc(&dev_planeStats, MAX_PLANES_TOTAL*sizeof(PlaneStats));
 	host_planeStats = new PlaneStats[MAX_PLANES_TOTAL];
 
-	cudaMalloc((void**) &dev_finalSegmentsBuffer, xRes*yRes*sizeof(int));
-	cudaMalloc((void**) &dev_finalDistanceToPlaneBuffer, xRes*yRes*sizeof(float));
+	backendMalloc(&dev_finalSegmentsBuffer, xRes*yRes*sizeof(int));
+	backendMalloc(&dev_finalDistanceToPlaneBuffer, xRes*yRes*sizeof(float));
 
-	cudaMalloc((void**) &dev_planeIdMap,  MAX_PLANES_TOTAL*sizeof(int));
-	cudaMalloc((void**) &dev_planeInvIdMap,  MAX_PLANES_TOTAL*sizeof(int));
-	cudaMalloc((void**) &dev_detectedPlaneCount,  sizeof(int));
+	backendMalloc(&dev_planeIdMap,  MAX_PLANES_TOTAL*sizeof(int));
+	backendMalloc(&dev_planeInvIdMap,  MAX_PLANES_TOTAL*sizeof(int));
+	backendMalloc(&dev_detectedPlaneCount,  sizeof(int));
 
 	int numBlocks = ceil(xRes/float(AABB_COMPUTE_BLOCKWIDTH))*ceil(yRes/float(AABB_COMPUTE_BLOCKHEIGHT));
-	cudaMalloc((void**) &dev_aabbIntermediateBuffer, 
+	backendMalloc(&dev_aabbIntermediateBuffer, 
 		numBlocks*MAX_PLANES_TOTAL*sizeof(glm::vec4));
 
 
-	cudaMalloc((void**) &dev_segmentProjectedSx, xRes*yRes*sizeof(float));
-	cudaMalloc((void**) &dev_segmentProjectedSy, xRes*yRes*sizeof(float));
+	backendMalloc(&dev_segmentProjectedSx, xRes*yRes*sizeof(float));
+	backendMalloc(&dev_segmentProjectedSy, xRes*yRes*sizeof(float));
 
 	createFloat4SOA(dev_PlaneTexture, MAX_TEXTURE_BUFFER_SIZE*MAX_TEXTURE_BUFFER_SIZE);
-	cudaMalloc((void**) &dev_finalTextureBuffer, MAX_TEXTURE_BUFFER_SIZE*MAX_TEXTURE_BUFFER_SIZE*sizeof(float4));
+	backendMalloc(&dev_finalTextureBuffer, MAX_TEXTURE_BUFFER_SIZE*MAX_TEXTURE_BUFFER_SIZE*sizeof(float4));
 
-	cudaMalloc((void**) &dev_quadTreeAssembly, MAX_TEXTURE_BUFFER_SIZE*MAX_TEXTURE_BUFFER_SIZE*sizeof(int));
-	cudaMalloc((void**) &dev_quadTreeScanResults, MAX_TEXTURE_BUFFER_SIZE*MAX_TEXTURE_BUFFER_SIZE*sizeof(int));
-	cudaMalloc((void**) &dev_quadTreeBlockResults, MAX_TEXTURE_BUFFER_SIZE*sizeof(int));
+	backendMalloc(&dev_quadTreeAssembly, MAX_TEXTURE_BUFFER_SIZE*MAX_TEXTURE_BUFFER_SIZE*sizeof(int));
+	backendMalloc(&dev_quadTreeScanResults, MAX_TEXTURE_BUFFER_SIZE*MAX_TEXTURE_BUFFER_SIZE*sizeof(int));
+	backendMalloc(&dev_quadTreeBlockResults, MAX_TEXTURE_BUFFER_SIZE*sizeof(int));
 
 
-	cudaMalloc((void**) &dev_quadTreeIndexBuffer, QUADTREE_BUFFER_SIZE*6*sizeof(int));//Triangles
-	cudaMalloc((void**) &dev_quadTreeVertexBuffer, QUADTREE_BUFFER_SIZE*sizeof(float4));//verticies
-	cudaMalloc((void**) &dev_compactCount, sizeof(int));//Number of triangles
+	backendMalloc(&dev_quadTreeIndexBuffer, QUADTREE_BUFFER_SIZE*6*sizeof(int));//Triangles
+	backendMalloc(&dev_quadTreeVertexBuffer, QUADTREE_BUFFER_SIZE*sizeof(float4));//verticies
+	backendMalloc(&dev_compactCount, sizeof(int));//Number of triangles
 
 
 	for(int i = 0; i < NUM_FLOAT1_PYRAMID_BUFFERS; ++i)
@@ -119,7 +123,7 @@ void MeshTracker::initBuffers(int xRes, int yRes)
 
 	for(int i = 0; i < NUM_FLOAT1_IMAGE_SIZE_BUFFERS; ++i)
 	{
-		cudaMalloc((void**) &dev_floatImageBuffers[i], xRes*yRes*sizeof(float));
+		backendMalloc(&dev_floatImageBuffers[i], xRes*yRes*sizeof(float));
 	}
 
 	//Initialize gaussian spatial kernel
@@ -128,45 +132,45 @@ void MeshTracker::initBuffers(int xRes, int yRes)
 
 void MeshTracker::cleanupBuffers()
 {
-	cudaFree(dev_colorImageBuffer);
-	cudaFree(dev_depthImageBuffer);
+	mBackend->release(dev_colorImageBuffer);
+	mBackend->release(dev_depthImageBuffer);
 	freeFloat3SOAPyramid(dev_rgbSOA);
 	freeFloat3SOAPyramid(dev_vmapSOA);
 	freeFloat3SOAPyramid(dev_nmapSOA);
 
-	cudaFree(dev_normalVoxels);
+	mBackend->release(dev_normalVoxels);
 
-	cudaFree(dev_normalSegments);
-	cudaFree(dev_planeProjectedDistanceMap);
+	mBackend->release(dev_normalSegments);
+	mBackend->release(dev_planeProjectedDistanceMap);
 
 	freeFloat3SOA(dev_normalPeaks);
 
-	cudaFree(dev_distanceHistograms[0]);
-	cudaFree(dev_distPeaks[0]);
+	mBackend->release(dev_distanceHistograms[0]);
+	mBackend->release(dev_distPeaks[0]);
 
 
-	cudaFree(dev_planeStats);
+	mBackend->release(dev_planeStats);
 
-	cudaFree(dev_finalSegmentsBuffer);
-	cudaFree(dev_finalDistanceToPlaneBuffer);
+	mBackend->release(dev_finalSegmentsBuffer);
+	mBackend->release(dev_finalDistanceToPlaneBuffer);
 
-	cudaFree(dev_planeIdMap);
-	cudaFree(dev_planeInvIdMap);
-	cudaFree(dev_detectedPlaneCount);
-	cudaFree(dev_aabbIntermediateBuffer);
+	mBackend->release(dev_planeIdMap);
+	mBackend->release(dev_planeInvIdMap);
+	mBackend->release(dev_detectedPlaneCount);
+	mBackend->release(dev_aabbIntermediateBuffer);
 
-	cudaFree(dev_segmentProjectedSx);
-	cudaFree(dev_segmentProjectedSy);
+	mBackend->release(dev_segmentProjectedSx);
+	mBackend->release(dev_segmentProjectedSy);
 
 	freeFloat4SOA(dev_PlaneTexture);
-	cudaFree(dev_finalTextureBuffer);
-	cudaFree(dev_quadTreeAssembly);
-	cudaFree(dev_quadTreeScanResults);
-	cudaFree(dev_quadTreeBlockResults);
+	mBackend->release(dev_finalTextureBuffer);
+	mBackend->release(dev_quadTreeAssembly);
+	mBackend->release(dev_quadTreeScanResults);
+	mBackend->release(dev_quadTreeBlockResults);
 
-	cudaFree(dev_quadTreeIndexBuffer);
-	cudaFree(dev_quadTreeVertexBuffer);
-	cudaFree(dev_compactCount);
+	mBackend->release(dev_quadTreeIndexBuffer);
+	mBackend->release(dev_quadTreeVertexBuffer);
+	mBackend->release(dev_compactCount);
 
 	for(int i = 0; i < NUM_FLOAT1_PYRAMID_BUFFERS; ++i)
 	{
@@ -180,7 +184,7 @@ void MeshTracker::cleanupBuffers()
 
 	for(int i = 0; i < NUM_FLOAT1_IMAGE_SIZE_BUFFERS; ++i)
 	{
-		cudaFree(dev_floatImageBuffers[i]);
+		mBackend->release(dev_floatImageBuffers[i]);
 	}
 
 
@@ -197,7 +201,7 @@ void MeshTracker::createFloat1SOAPyramid(Float1SOAPyramid& dev_pyramid, int xRes
 		pyramidCount += (pixCount >> (i*2));
 	}
 
-	cudaMalloc((void**) &dev_pyramid.x[0], sizeof(float)*(pyramidCount));
+	backendMalloc(&dev_pyramid.x[0], sizeof(float)*(pyramidCount));
 	//Get convenience pointer offsets
 	for(int i = 0; i < NUM_PYRAMID_LEVELS-1; ++i)
 	{
@@ -209,39 +213,39 @@ void MeshTracker::createFloat1SOAPyramid(Float1SOAPyramid& dev_pyramid, int xRes
 
 void MeshTracker::freeFloat1SOAPyramid(Float1SOAPyramid dev_pyramid)
 {
-	cudaFree(dev_pyramid.x[0]);
+	mBackend->release(dev_pyramid.x[0]);
 }
 
 void MeshTracker::createInt3SOA(Int3SOA& dev_soa, int length)
 {
-	cudaMalloc((void**) &dev_soa.x, sizeof(int)*3*length);
+	backendMalloc(&dev_soa.x, sizeof(int)*3*length);
 	dev_soa.y = dev_soa.x + length;
 	dev_soa.z = dev_soa.y + length;
 }
 
 void MeshTracker::freeInt3SOA(Int3SOA dev_soa)
 {
-	cudaFree(dev_soa.x);
+	mBackend->release(dev_soa.x);
 }
 
 
 void MeshTracker::createFloat3SOA(Float3SOA& dev_soa, int length)
 {
-	cudaMalloc((void**) &dev_soa.x, sizeof(float)*3*length);
+	backendMalloc(&dev_soa.x, sizeof(float)*3*length);
 	dev_soa.y = dev_soa.x + length;
 	dev_soa.z = dev_soa.y + length;
 }
 
 void MeshTracker::freeFloat3SOA(Float3SOA dev_soa)
 {
-	cudaFree(dev_soa.x);
+	mBackend->release(dev_soa.x);
 }
 
 
 
 void MeshTracker::createFloat4SOA(Float4SOA& dev_soa, int length)
 {
-	cudaMalloc((void**) &dev_soa.x, sizeof(float)*4*length);
+	backendMalloc(&dev_soa.x, sizeof(float)*4*length);
 	dev_soa.y = dev_soa.x + length;
 	dev_soa.z = dev_soa.y + length;
 	dev_soa.w = dev_soa.z + length;
@@ -249,7 +253,7 @@ void MeshTracker::createFloat4SOA(Float4SOA& dev_soa, int length)
 
 void MeshTracker::freeFloat4SOA(Float4SOA dev_soa)
 {
-	cudaFree(dev_soa.x);
+	mBackend->release(dev_soa.x);
 }
 
 void MeshTracker::createFloat3SOAPyramid(Float3SOAPyramid& dev_pyramid, int xRes, int yRes)
@@ -262,7 +266,7 @@ void MeshTracker::createFloat3SOAPyramid(Float3SOAPyramid& dev_pyramid, int xRes
 		pyramidCount += (pixCount >> (i*2));
 	}
 
-	cudaMalloc((void**) &dev_pyramid.x[0], sizeof(float)*3*(pyramidCount));
+	backendMalloc(&dev_pyramid.x[0], sizeof(float)*3*(pyramidCount));
 	//Get convenience pointer offsets
 	for(int i = 0; i < NUM_PYRAMID_LEVELS-1; ++i)
 	{
@@ -286,7 +290,7 @@ void MeshTracker::createFloat3SOAPyramid(Float3SOAPyramid& dev_pyramid, int xRes
 
 void MeshTracker::freeFloat3SOAPyramid(Float3SOAPyramid dev_pyramid)
 {
-	cudaFree(dev_pyramid.x[0]);
+	mBackend->release(dev_pyramid.x[0]);
 }
 
 
@@ -310,8 +314,8 @@ void MeshTracker::pushRGBDFrameToDevice(ColorPixelArray colorArray, DPixelArray
 	lastFrameTime = currentFrameTime;
 	currentFrameTime = time;
 
-	cudaMemcpy((void*)dev_depthImageBuffer, depthArray.get(), sizeof(DPixel)*mXRes*mYRes, cudaMemcpyHostToDevice);
-	cudaMemcpy((void*)dev_colorImageBuffer, colorArray.get(), sizeof(ColorPixel)*mXRes*mYRes, cudaMemcpyHostToDevice);
+	mBackend->copyToDevice((void*)dev_depthImageBuffer, depthArray.get(), sizeof(DPixel)*mXRes*mYRes);
+	mBackend->copyToDevice((void*)dev_colorImageBuffer, colorArray.get(), sizeof(ColorPixel)*mXRes*mYRes);
 
 }
 
@@ -319,27 +323,27 @@ void MeshTracker::pushRGBDFrameToDevice(ColorPixelArray colorArray, DPixelArray
 
 void MeshTracker::buildRGBSOA()
 {
-	rgbAOSToSOACUDA(dev_colorImageBuffer, dev_rgbSOA, mXRes, mYRes);
+	mBackend->rgbAOSToSOA(dev_colorImageBuffer, dev_rgbSOA, mXRes, mYRes);
 }
 
 void MeshTracker::buildVMapNoFilter(float maxDepth)
 {
-	buildVMapNoFilterCUDA(dev_depthImageBuffer, dev_vmapSOA, mXRes, mYRes, mIntr, maxDepth);
+	mBackend->buildVMapNoFilter(dev_depthImageBuffer, dev_vmapSOA, mXRes, mYRes, mIntr, maxDepth);
 
 }
 
 void MeshTracker::buildVMapGaussianFilter(float maxDepth)
 {
-	flipDepthImageXAxis(dev_depthImageBuffer, mXRes, mYRes);
-	buildVMapGaussianFilterCUDA(dev_depthImageBuffer, dev_vmapSOA, mXRes, mYRes, mIntr, maxDepth);
+	mBackend->flipDepthImageXAxis(dev_depthImageBuffer, mXRes, mYRes);
+	mBackend->buildVMapGaussianFilter(dev_depthImageBuffer, dev_vmapSOA, mXRes, mYRes, mIntr, maxDepth);
 
 }
 
 void MeshTracker::buildVMapBilateralFilter(float maxDepth, float sigma_t)
 {
 
-	flipDepthImageXAxis(dev_depthImageBuffer, mXRes, mYRes);
-	buildVMapBilateralFilterCUDA(dev_depthImageBuffer, dev_vmapSOA, mXRes, mYRes, 
+	mBackend->flipDepthImageXAxis(dev_depthImageBuffer, mXRes, mYRes);
+	mBackend->buildVMapBilateralFilter(dev_depthImageBuffer, dev_vmapSOA, mXRes, mYRes, 
 		mIntr, maxDepth, sigma_t);
 
 
@@ -348,14 +352,14 @@ void MeshTracker::buildVMapBilateralFilter(float maxDepth, float sigma_t)
 
 void MeshTracker::setGaussianSpatialSigma(float sigma)
 {
-	setGaussianSpatialKernel(sigma);
+	mBackend->setGaussianSpatialKernel(sigma);
 }
 
 
 void MeshTracker::buildNMapSimple()
 {
 
-	simpleNormals(dev_vmapSOA, dev_nmapSOA, NUM_PYRAMID_LEVELS, mXRes, mYRes);
+	mBackend->simpleNormals(dev_vmapSOA, dev_nmapSOA, NUM_PYRAMID_LEVELS, mXRes, mYRes);
 
 }
 
@@ -365,27 +369,27 @@ void MeshTracker::buildNMapAverageGradient()
 	//Assemble gradient images.
 
 	//For each first level of pyramid
-	horizontalGradient(dev_vmapSOA.x[0], dev_float3PyramidBuffers[0].x[0], mXRes, mYRes);
-	verticalGradient(  dev_vmapSOA.x[0], dev_float3PyramidBuffers[1].x[0], mXRes, mYRes);
+	mBackend->horizontalGradient(dev_vmapSOA.x[0], dev_float3PyramidBuffers[0].x[0], mXRes, mYRes);
+	mBackend->verticalGradient(  dev_vmapSOA.x[0], dev_float3PyramidBuffers[1].x[0], mXRes, mYRes);
 
-	horizontalGradient(dev_vmapSOA.y[0], dev_float3PyramidBuffers[0].y[0], mXRes, mYRes);
-	verticalGradient(  dev_vmapSOA.y[0], dev_float3PyramidBuffers[1].y[0], mXRes, mYRes);
+	mBackend->horizontalGradient(dev_vmapSOA.y[0], dev_float3PyramidBuffers[0].y[0], mXRes, mYRes);
+	mBackend->verticalGradient(  dev_vmapSOA.y[0], dev_float3PyramidBuffers[1].y[0], mXRes, mYRes);
 
-	horizontalGradient(dev_vmapSOA.z[0], dev_float3PyramidBuffers[0].z[0], mXRes, mYRes);
-	verticalGradient(  dev_vmapSOA.z[0], dev_float3PyramidBuffers[1].z[0], mXRes, mYRes);
+	mBackend->horizontalGradient(dev_vmapSOA.z[0], dev_float3PyramidBuffers[0].z[0], mXRes, mYRes);
+	mBackend->verticalGradient(  dev_vmapSOA.z[0], dev_float3PyramidBuffers[1].z[0], mXRes, mYRes);
 
 	//Apply filters to float3
-	setSeperableKernelGaussian(10.0);
+	mBackend->setSeperableKernelGaussian(10.0);
 
-	seperableFilter(dev_float3PyramidBuffers[0].x[0], dev_float3PyramidBuffers[0].y[0], dev_float3PyramidBuffers[0].z[0],
+	mBackend->seperableFilter(dev_float3PyramidBuffers[0].x[0], dev_float3PyramidBuffers[0].y[0], dev_float3PyramidBuffers[0].z[0],
 		dev_float3PyramidBuffers[0].x[0], dev_float3PyramidBuffers[0].y[0], dev_float3PyramidBuffers[0].z[0],
 		mXRes, mYRes);
 
-	seperableFilter(dev_float3PyramidBuffers[1].x[0], dev_float3PyramidBuffers[1].y[0], dev_float3PyramidBuffers[1].z[0],
+	mBackend->seperableFilter(dev_float3PyramidBuffers[1].x[0], dev_float3PyramidBuffers[1].y[0], dev_float3PyramidBuffers[1].z[0],
 		dev_float3PyramidBuffers[1].x[0], dev_float3PyramidBuffers[1].y[0], dev_float3PyramidBuffers[1].z[0],
 		mXRes, mYRes);
 
-	computeAverageGradientNormals(dev_float3PyramidBuffers[0], dev_float3PyramidBuffers[1], dev_vmapSOA, dev_nmapSOA, mXRes, mYRes);
+	mBackend->computeAverageGradientNormals(dev_float3PyramidBuffers[0], dev_float3PyramidBuffers[1], dev_vmapSOA, dev_nmapSOA, mXRes, mYRes);
 
 }
 
@@ -404,30 +408,30 @@ void MeshTracker::segmentationInnerLoop(int resolutionLevel, int iteration)
 
 
 	//Tight tolerance angle segmentation
-	segmentNormals2D(normals, positions, dev_normalSegments, dev_planeProjectedDistanceMap, mXRes>>resolutionLevel, mYRes>>resolutionLevel, 
+	mBackend->segmentNormals2D(normals, positions, dev_normalSegments, dev_planeProjectedDistanceMap, mXRes>>resolutionLevel, mYRes>>resolutionLevel, 
 		dev_normalVoxels, NUM_NORMAL_X_SUBDIVISIONS, NUM_NORMAL_Y_SUBDIVISIONS, 
 		dev_normalPeaks, MAX_2D_PEAKS_PER_ROUND, m2DSegmentationMaxAngleFromPeak*PI_F/180.0f);
 
 	//Distance histogram generation
-	clearHistogram(dev_distanceHistograms[0], DISTANCE_HIST_COUNT, MAX_2D_PEAKS_PER_ROUND);
-	generateDistanceHistograms(dev_normalSegments, dev_planeProjectedDistanceMap, 
+	mBackend->clearHistogram(dev_distanceHistograms[0], DISTANCE_HIST_COUNT, MAX_2D_PEAKS_PER_ROUND);
+	mBackend->generateDistanceHistograms(dev_normalSegments, dev_planeProjectedDistanceMap, 
 		mXRes>>resolutionLevel, mYRes>>resolutionLevel, dev_distanceHistograms,
 		MAX_2D_PEAKS_PER_ROUND, DISTANCE_HIST_COUNT, DISTANCE_HIST_MIN, DISTANCE_HIST_MAX);
 
-	distanceHistogramPrimaryPeakDetection(dev_distanceHistograms[0], DISTANCE_HIST_COUNT, MAX_2D_PEAKS_PER_ROUND, dev_distPeaks[0], 
+	mBackend->distanceHistogramPrimaryPeakDetection(dev_distanceHistograms[0], DISTANCE_HIST_COUNT, MAX_2D_PEAKS_PER_ROUND, dev_distPeaks[0], 
 		DISTANCE_HIST_MAX_PEAKS, int(2.0f*mDistPeakThresholdTight/DISTANCE_HIST_RESOLUTION), 
 		mMinDistPeakCount*countScale, DISTANCE_HIST_MIN, DISTANCE_HIST_MAX);
 
 	//Segment by distance and assemble plane stats for segments
-	clearPlaneStats(dev_planeStats, MAX_2D_PEAKS_PER_ROUND, DISTANCE_HIST_MAX_PEAKS, MAX_SEGMENTATION_ROUNDS, iteration);
+	mBackend->clearPlaneStats(dev_planeStats, MAX_2D_PEAKS_PER_ROUND, DISTANCE_HIST_MAX_PEAKS, MAX_SEGMENTATION_ROUNDS, iteration);
 
-	fineDistanceSegmentation(dev_distPeaks[0], MAX_2D_PEAKS_PER_ROUND, DISTANCE_HIST_MAX_PEAKS, 
+	mBackend->fineDistanceSegmentation(dev_distPeaks[0], MAX_2D_PEAKS_PER_ROUND, DISTANCE_HIST_MAX_PEAKS, 
 		positions, dev_planeStats, dev_normalSegments, dev_planeProjectedDistanceMap, 
 		mXRes>>resolutionLevel, mYRes>>resolutionLevel, mDistPeakThresholdTight, iteration);
 
 
 	//Process stats and calculate merges
-	finalizePlanes(dev_planeStats, MAX_2D_PEAKS_PER_ROUND, DISTANCE_HIST_MAX_PEAKS, 
+	mBackend->finalizePlanes(dev_planeStats, MAX_2D_PEAKS_PER_ROUND, DISTANCE_HIST_MAX_PEAKS, 
 		mPlaneMergeAngleThresh*PI_F/180.0f, mPlaneMergeDistThresh, iteration);
 
 }
@@ -435,15 +439,15 @@ void MeshTracker::segmentationInnerLoop(int resolutionLevel, int iteration)
 
 void MeshTracker::normalHistogramGeneration(int normalHistLevel, int iteration)
 {
-	clearHistogram(dev_normalVoxels, NUM_NORMAL_X_SUBDIVISIONS, NUM_NORMAL_Y_SUBDIVISIONS);
+	mBackend->clearHistogram(dev_normalVoxels, NUM_NORMAL_X_SUBDIVISIONS, NUM_NORMAL_Y_SUBDIVISIONS);
 
-	computeNormalHistogram(dev_nmapSOA.x[normalHistLevel], dev_nmapSOA.y[normalHistLevel], dev_nmapSOA.z[normalHistLevel], 
+	mBackend->computeNormalHistogram(dev_nmapSOA.x[normalHistLevel], dev_nmapSOA.y[normalHistLevel], dev_nmapSOA.z[normalHistLevel], 
 		dev_finalSegmentsBuffer,
 		dev_normalVoxels, mXRes>>normalHistLevel, mYRes>>normalHistLevel, 
 		NUM_NORMAL_X_SUBDIVISIONS, NUM_NORMAL_Y_SUBDIVISIONS, (iteration>0));
 
 	//Detect peaks
-	normalHistogramPrimaryPeakDetection(dev_normalVoxels, NUM_NORMAL_X_SUBDIVISIONS, NUM_NORMAL_Y_SUBDIVISIONS, 
+	mBackend->normalHistogramPrimaryPeakDetection(dev_normalVoxels, NUM_NORMAL_X_SUBDIVISIONS, NUM_NORMAL_Y_SUBDIVISIONS, 
 		dev_normalPeaks, MAX_2D_PEAKS_PER_ROUND,  PEAK_2D_EXCLUSION_RADIUS, mMinNormalPeakCout/float(1 << normalHistLevel*2),
 		(iteration>0)?PEAK_2D_EXCLUSION_RADIUS/2:0);
 }
@@ -451,7 +455,7 @@ void MeshTracker::normalHistogramGeneration(int normalHistLevel, int iteration)
 void MeshTracker::GPUSimpleSegmentation()
 {
 	//Clear buffers
-	clearPlaneStats(dev_planeStats, MAX_2D_PEAKS_PER_ROUND, DISTANCE_HIST_MAX_PEAKS, MAX_SEGMENTATION_ROUNDS, -1);
+	mBackend->clearPlaneStats(dev_planeStats, MAX_2D_PEAKS_PER_ROUND, DISTANCE_HIST_MAX_PEAKS, MAX_SEGMENTATION_ROUNDS, -1);
 
 	//Future LOOP Start
 	for(int iter = 0; iter < MAX_SEGMENTATION_ROUNDS; ++iter)
@@ -462,7 +466,7 @@ void MeshTracker::GPUSimpleSegmentation()
 		segmentationInnerLoop(2, iter);
 
 		//Use plane stats from first pass to better align peaks, then re-segment
-		realignPeaks(dev_planeStats, dev_normalPeaks, MAX_2D_PEAKS_PER_ROUND, DISTANCE_HIST_MAX_PEAKS, 
+		mBackend->realignPeaks(dev_planeStats, dev_normalPeaks, MAX_2D_PEAKS_PER_ROUND, DISTANCE_HIST_MAX_PEAKS, 
 			NUM_NORMAL_X_SUBDIVISIONS, NUM_NORMAL_Y_SUBDIVISIONS, iter);
 
 		segmentationInnerLoop(2, iter);
@@ -480,21 +484,21 @@ void MeshTracker::GPUSimpleSegmentation()
 
 		int numPlanes = MAX_2D_PEAKS_PER_ROUND*DISTANCE_HIST_MAX_PEAKS*(iter+1);
 
-		mergePlanes(dev_planeStats, numPlanes,mPlaneMergeAngleThresh*PI_F/180.0f, mPlaneMergeDistThresh);
+		mBackend->mergePlanes(dev_planeStats, numPlanes,mPlaneMergeAngleThresh*PI_F/180.0f, mPlaneMergeDistThresh);
 
-		fitFinalPlanes(dev_planeStats, numPlanes, 
+		mBackend->fitFinalPlanes(dev_planeStats, numPlanes, 
 			normals, positions,  dev_finalSegmentsBuffer, dev_finalDistanceToPlaneBuffer, mXRes, mYRes,
 			mPlaneFinalAngleThresh*PI_F/180.0f, mPlaneFinalDistThresh, 0);
 
 	}
 
-	generatePlaneCompressionMap(dev_planeStats, MAX_PLANES_TOTAL, 
+	mBackend->generatePlaneCompressionMap(dev_planeStats, MAX_PLANES_TOTAL, 
 		dev_planeIdMap, dev_planeInvIdMap, dev_detectedPlaneCount);
 
-	compactPlaneStats(dev_planeStats,  MAX_PLANES_TOTAL, 
+	mBackend->compactPlaneStats(dev_planeStats,  MAX_PLANES_TOTAL, 
 		dev_planeIdMap, dev_detectedPlaneCount);
 
-	computePlaneTangents(dev_planeStats, MAX_PLANES_TOTAL, dev_detectedPlaneCount);
+	mBackend->computePlaneTangents(dev_planeStats, MAX_PLANES_TOTAL, dev_detectedPlaneCount);
 }
 
 int roundnextpow2up (int x)
@@ -519,16 +523,15 @@ void MeshTracker::ReprojectPlaneTextures()
 	positions.z = dev_vmapSOA.z[0];
 
 	//Compute bounding boxes and do some other work in the meantime like remapping segments to correct ids and generating plane projected 
-	computeAABBs(dev_planeStats, dev_planeInvIdMap, dev_aabbIntermediateBuffer, dev_detectedPlaneCount,  
+	mBackend->computeAABBs(dev_planeStats, dev_planeInvIdMap, dev_aabbIntermediateBuffer, dev_detectedPlaneCount,  
 		MAX_PLANES_TOTAL, 
 		positions, dev_segmentProjectedSx, dev_segmentProjectedSy, dev_finalSegmentsBuffer, mXRes, mYRes);
 
-	calculateProjectionData(mIntr, dev_planeStats, dev_detectedPlaneCount, 
+	mBackend->calculateProjectionData(mIntr, dev_planeStats, dev_detectedPlaneCount, 
 		MAX_TEXTURE_BUFFER_SIZE, MAX_PLANES_TOTAL, mXRes, mYRes);
 
-	cudaMemcpy(host_planeStats, dev_planeStats, 
-		MAX_PLANES_TOTAL*sizeof(PlaneStats), 
-		cudaMemcpyDeviceToHost);
+	mBackend->copyToHost(host_planeStats, dev_planeStats, 
+		MAX_PLANES_TOTAL*sizeof(PlaneStats));
 
 	//Plane projection parameters now on host side. Use to dispatch kernels more efficiently
 	RGBMapSOA rgbMap;
@@ -543,20 +546,20 @@ void MeshTracker::ReprojectPlaneTextures()
 		{
 			host_detectedPlaneCount++;
 			//Offset projections to correct index
-			projectTexture(i, (host_planeStats + i), (dev_planeStats + i), 
+			mBackend->projectTexture(i, (host_planeStats + i), (dev_planeStats + i), 
 				dev_PlaneTexture, MAX_TEXTURE_BUFFER_SIZE, 
 				rgbMap, dev_finalSegmentsBuffer, dev_finalDistanceToPlaneBuffer,
 				mXRes, mYRes);
 
 			//Quadtree decimation
-			quadtreeDecimation((host_planeStats + i)->projParams.destWidth, (host_planeStats + i)->projParams.destHeight,
+			mBackend->quadtreeDecimation((host_planeStats + i)->projParams.destWidth, (host_planeStats + i)->projParams.destHeight,
 				dev_PlaneTexture, dev_quadTreeAssembly, MAX_TEXTURE_BUFFER_SIZE);
 
 			//Quadtree compression, mesh generation
 			int finalTextureWidth = roundnextpow2up((host_planeStats + i)->projParams.destWidth);
 			int finalTextureHeight = roundnextpow2up((host_planeStats + i)->projParams.destHeight);
 
-			quadtreeMeshGeneration((host_planeStats + i)->projParams.aabbMeters, 
+			mBackend->quadtreeMeshGeneration((host_planeStats + i)->projParams.aabbMeters, 
 				(host_planeStats + i)->projParams.destWidth, (host_planeStats + i)->projParams.destHeight,
 				dev_quadTreeAssembly, dev_quadTreeScanResults, MAX_TEXTURE_BUFFER_SIZE, 
 				dev_quadTreeBlockResults, MAX_TEXTURE_BUFFER_SIZE,
@@ -575,16 +578,16 @@ void MeshTracker::ReprojectPlaneTextures()
 				glm::vec4(0.0f,0.0f,0.0f, 1.0f));
 
 
-			QuadTreeMesh resultMesh(finalTextureWidth, finalTextureHeight, host_quadtreeVertexCount, host_planeStats[i], Ttrans*Trot);
+			QuadTreeMesh resultMesh(mBackend, finalTextureWidth, finalTextureHeight, host_quadtreeVertexCount, host_planeStats[i], Ttrans*Trot);
 			//Pull data
-			cudaMemcpy(resultMesh.rgbhTexture.get(), dev_finalTextureBuffer, 
-				finalTextureWidth*finalTextureHeight*sizeof(float4), cudaMemcpyDeviceToHost);
+			mBackend->copyToHost(resultMesh.rgbhTexture.get(), dev_finalTextureBuffer, 
+				finalTextureWidth*finalTextureHeight*sizeof(float4));
 			
-			cudaMemcpy(resultMesh.vertices.get(), dev_quadTreeVertexBuffer, 
-				host_quadtreeVertexCount*sizeof(float4), cudaMemcpyDeviceToHost);
+			mBackend->copyToHost(resultMesh.vertices.get(), dev_quadTreeVertexBuffer, 
+				host_quadtreeVertexCount*sizeof(float4));
 			
-			cudaMemcpy(resultMesh.triangleIndices.get(), dev_quadTreeIndexBuffer, 
-				host_quadtreeVertexCount*6*sizeof(int), cudaMemcpyDeviceToHost);
+			mBackend->copyToHost(resultMesh.triangleIndices.get(), dev_quadTreeIndexBuffer, 
+				host_quadtreeVertexCount*6*sizeof(int));
 
 			host_quadtrees.push_back(resultMesh);
 		}else
@@ -604,9 +607,9 @@ void MeshTracker::deleteQuadTreeMeshes()
 
 void MeshTracker::subsamplePyramids()
 {
-	subsamplePyramidCUDA(dev_vmapSOA, mXRes, mYRes, NUM_PYRAMID_LEVELS);
-	subsamplePyramidCUDA(dev_nmapSOA, mXRes, mYRes, NUM_PYRAMID_LEVELS);
-	subsamplePyramidCUDA(dev_rgbSOA,  mXRes, mYRes, NUM_PYRAMID_LEVELS);
+	mBackend->subsamplePyramid(dev_vmapSOA, mXRes, mYRes, NUM_PYRAMID_LEVELS);
+	mBackend->subsamplePyramid(dev_nmapSOA, mXRes, mYRes, NUM_PYRAMID_LEVELS);
+	mBackend->subsamplePyramid(dev_rgbSOA,  mXRes, mYRes, NUM_PYRAMID_LEVELS);
 }
 
 
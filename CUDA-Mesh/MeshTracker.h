@@ -11,6 +11,7 @@
 #include "CudaUtils.h"
 #include "plane_segmentation.h"
 #include "quadtree.h"
+#include "MeshComputeBackend.h"
 
 // glm::translate, glm::rotate, glm::scale
 #include "glm/gtc/matrix_transform.hpp"
@@ -64,20 +65,18 @@ struct QuadTreeMesh
 	int mHeight;
 	int numVerts;
 
-	QuadTreeMesh(int textureWidth, int textureHeight, int numVertices, PlaneStats planeStats, glm::mat4 transform)
+	//Host memory comes from the backend that produced the mesh and is returned to it when the last copy goes
+	QuadTreeMesh(shared_ptr<MeshComputeBackend> backend, int textureWidth, int textureHeight, int numVertices, PlaneStats planeStats, glm::mat4 transform)
 	{
-		float4* textureMem;
-		cudaMallocHost((void**) &textureMem, textureWidth*textureHeight*sizeof(float4));
-		rgbhTexture = shared_ptr<float4>(textureMem, [](float4* p){cudaFreeHost(p);});
+		float4* textureMem = (float4*) backend->allocateHost(textureWidth*textureHeight*sizeof(float4));
+		rgbhTexture = shared_ptr<float4>(textureMem, [backend](float4* p){backend->releaseHost(p);});
 
 
-		float4* vertMem;
-		cudaMallocHost((void**) &vertMem, numVertices*sizeof(float4));
-		vertices = shared_ptr<float4>(vertMem, [](float4* p){cudaFreeHost(p);});
+		float4* vertMem = (float4*) backend->allocateHost(numVertices*sizeof(float4));
+		vertices = shared_ptr<float4>(vertMem, [backend](float4* p){backend->releaseHost(p);});
 
-		int* triangleMem;
-		cudaMallocHost((void**) &triangleMem, numVertices*6*sizeof(int));
-		triangleIndices = shared_ptr<int>(triangleMem, [](int* p){cudaFreeHost(p);});
+		int* triangleMem = (int*) backend->allocateHost(numVertices*6*sizeof(int));
+		triangleIndices = shared_ptr<int>(triangleMem, [backend](int* p){backend->releaseHost(p);});
 
 
 		TplaneTocam = transform;
@@ -113,6 +112,9 @@ private:
 	int mMaxPlanesOutput;
 #pragma region
 
+	//Where the buffers below live and how the stages run
+	shared_ptr<MeshComputeBackend> mBackend;
+
 #pragma region Pipeline Buffer Device Pointers
 	//PIPELINE BUFFERS
 	ColorPixel* dev_colorImageBuffer;
@@ -171,6 +173,10 @@ private:
 
 
 #pragma region Private Methods
+	//cudaMalloc style allocation through the backend
+	template<typename T>
+	inline void backendMalloc(T** ptr, size_t bytes){ *ptr = (T*) mBackend->allocate(bytes);}
+
 	void createFloat1SOAPyramid(Float1SOAPyramid& dev_pyramid, int xRes, int yRes);
 	void freeFloat1SOAPyramid(Float1SOAPyramid dev_pyramid);
 
@@ -197,7 +203,8 @@ private:
 public:
 
 #pragma region Ctor/Dtor
-	MeshTracker(int xResolution, int yResolution, Intrinsics intr);
+	//NULL backend runs the pipeline on the GPU
+	MeshTracker(int xResolution, int yResolution, Intrinsics intr, shared_ptr<MeshComputeBackend> backend = shared_ptr<MeshComputeBackend>());
 	~MeshTracker(void);
 #pragma endregion
 
@@ -244,6 +251,8 @@ public:
 	inline int getHostNumDetectedPlanes(){return host_detectedPlaneCount;}
 	inline int* getQuadtreeBuffer(int planeNum){return dev_quadTreeAssembly;}
 	inline vector<QuadTreeMesh>* getQuadTreeMeshes(){return &host_quadtrees;}
+	inline MeshBackendType getBackendType(){return mBackend->getType();}
+	inline shared_ptr<MeshComputeBackend> getBackend(){return mBackend;}
 #pragma endregion
 
 #pragma region Property Getters
@@ -190,7 +190,7 @@ DeviceStatus MeshViewer::init(int argc, char **argv)
 	}
 
 	//Register frame listener
-	mDevice->addNewRGBDFrameListener(this);
+	mDevice->addNewRGBDFrameListener(this, DISPATCH_LATEST);
 
 	//Create mesh tracker and set default values
 	mMeshTracker = new MeshTracker(mXRes, mYRes, mDevice->getColorIntrinsics());
@@ -1011,20 +1011,8 @@ void MeshViewer::resetCamera()
 #pragma region Event Handlers
 void MeshViewer::onNewRGBDFrame(RGBDFramePtr frame)
 {
-	mLatestFrame = frame;
-	if(mLatestFrame != NULL)
-	{
-		if(mLatestFrame->hasColor())
-		{
-			mColorArray = mLatestFrame->getColorArray();
-		}
-
-		if(mLatestFrame->hasDepth())
-		{
-			mDepthArray = mLatestFrame->getDepthArray();
-			mLatestTime = mLatestFrame->getDepthTimestamp();
-		}
-	}
+	//Runs on the dispatch thread. display() picks the frame up
+	mFrameMailbox.publish(frame);
 }
 
 #pragma endregion
@@ -1048,6 +1036,23 @@ void MeshViewer::display()
 
 
 
+	//Pick up the newest frame. The mailbox fills in streams an unsynced device left out, but frames from before the
+	//first of each stream still lack one, so only replace the arrays a frame has
+	RGBDFramePtr latestFrame = mFrameMailbox.consume();
+	if(latestFrame != NULL)
+	{
+		if(latestFrame->hasColor())
+		{
+			mColorArray = latestFrame->getColorArray();
+		}
+
+		if(latestFrame->hasDepth())
+		{
+			mDepthArray = latestFrame->getDepthArray();
+			mLatestTime = latestFrame->getDepthTimestamp();
+		}
+	}
+
 	//=====Tracker Pipeline=====
 	//Check if log playback has restarted (special edge case)
 	if(mLastSubmittedTime > mLatestTime){
@@ -24,6 +24,7 @@
 #include "RGBDDevice.h"
 #include "RGBDFrame.h"
 #include "RGBDFrameFactory.h"
+#include "LatestFrameMailbox.h"
 #include "MeshTracker.h"
 #include "debug_rendering.h"
 
@@ -104,7 +105,8 @@ private:
 
 	//======STATE VARIABLES=======
 #pragma region State Variables
-	RGBDFramePtr mLatestFrame;
+	//Frames from the device. Everything below is only touched by the render thread
+	LatestFrameMailbox mFrameMailbox;
 	ColorPixelArray mColorArray;
 	DPixelArray mDepthArray;
 	timestamp mLatestTime;
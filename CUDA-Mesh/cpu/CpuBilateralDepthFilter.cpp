@@ -0,0 +1,676 @@
+#include "CpuBilateralDepthFilter.h"
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstring>
+
+#ifdef RGBD_USE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef RGBD_USE_AVX2
+#include <immintrin.h>
+#endif
+
+//Valid samples are above 1mm. Zeros, NaNs and anything padded in fail the test
+#define FILTER_MIN_DEPTH	0.001f
+
+//Range weights below e^-87 are under FLT_MIN and flushed to 0, as __expf does with flush to zero
+#define BILATERAL_EXP_MIN_ARG	-87.0f
+
+//Empty cells around the bilateral grid, so neither the blurs nor slicing reach outside it
+#define BILATERAL_GRID_PADDING	2
+
+//Smallest grid cell in pixels. Below this the grid grows with 1/sigma and costs more than the windowed filter it replaces,
+//so smaller spatial sigmas keep this cell and blur less than one cell instead
+#define BILATERAL_GRID_MIN_CELL	2.0f
+
+//Most cells along the range axis. Bounds the grid when sigma_t is tiny against the frame's depth range
+#define BILATERAL_GRID_MAX_RANGE_CELLS	256
+
+#pragma region Range Weights
+//Cephes style exp: x = n*ln2 + r with |r| <= ln2/2, a degree 7 polynomial for e^r and n added to the exponent.
+//Within 2 ulp of expf for the arguments the filter sees, which are never positive
+#define EXP_LOG2E	1.44269504088896341f
+#define EXP_LN2_HI	0.693359375f
+#define EXP_LN2_LO	-2.12194440e-4f
+#define EXP_P0	1.9875691500e-4f
+#define EXP_P1	1.3981999507e-3f
+#define EXP_P2	8.3334519073e-3f
+#define EXP_P3	4.1665795894e-2f
+#define EXP_P4	1.6666665459e-1f
+#define EXP_P5	5.0000001201e-1f
+
+//e^x for x <= 0. NaN gives 0
+static inline float expNegative(float x)
+{
+	if(!(x > BILATERAL_EXP_MIN_ARG))
+		return 0.0f;
+	float fn = floorf(x*EXP_LOG2E + 0.5f);
+	float r = x - fn*EXP_LN2_HI - fn*EXP_LN2_LO;
+	float p = ((((EXP_P0*r + EXP_P1)*r + EXP_P2)*r + EXP_P3)*r + EXP_P4)*r + EXP_P5;
+	p = p*r*r + r + 1.0f;
+	int bits = ((int) fn + 127) << 23;
+	float scale;
+	memcpy(&scale, &bits, sizeof(float));
+	return p*scale;
+}
+
+#ifdef RGBD_USE_AVX2
+static inline RGBD_AVX2_TARGET __m256 expNegative8(__m256 x)
+{
+	const __m256 minArg = _mm256_set1_ps(BILATERAL_EXP_MIN_ARG);
+	__m256 inRange = _mm256_cmp_ps(x, minArg, _CMP_GT_OQ);
+	//NaN lanes become minArg and are masked off below
+	x = _mm256_max_ps(x, minArg);
+	__m256 fn = _mm256_round_ps(_mm256_mul_ps(x, _mm256_set1_ps(EXP_LOG2E)), _MM_FROUND_TO_NEAREST_INT | _MM_FROUND_NO_EXC);
+	__m256 r = _mm256_sub_ps(x, _mm256_mul_ps(fn, _mm256_set1_ps(EXP_LN2_HI)));
+	r = _mm256_sub_ps(r, _mm256_mul_ps(fn, _mm256_set1_ps(EXP_LN2_LO)));
+	__m256 p = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(EXP_P0), r), _mm256_set1_ps(EXP_P1));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(EXP_P2));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(EXP_P3));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(EXP_P4));
+	p = _mm256_add_ps(_mm256_mul_ps(p, r), _mm256_set1_ps(EXP_P5));
+	p = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(p, _mm256_mul_ps(r, r)), r), _mm256_set1_ps(1.0f));
+	__m256i n = _mm256_cvtps_epi32(fn);
+	__m256 scale = _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(n, _mm256_set1_epi32(127)), 23));
+	return _mm256_and_ps(inRange, _mm256_mul_ps(p, scale));
+}
+#endif
+#ifdef RGBD_USE_SSE2
+static inline __m128 expNegative4(__m128 x)
+{
+	const __m128 minArg = _mm_set1_ps(BILATERAL_EXP_MIN_ARG);
+	__m128 inRange = _mm_cmpgt_ps(x, minArg);
+	//NaN lanes become minArg and are masked off below
+	x = _mm_max_ps(x, minArg);
+	__m128i n = _mm_cvtps_epi32(_mm_mul_ps(x, _mm_set1_ps(EXP_LOG2E)));
+	__m128 fn = _mm_cvtepi32_ps(n);
+	__m128 r = _mm_sub_ps(x, _mm_mul_ps(fn, _mm_set1_ps(EXP_LN2_HI)));
+	r = _mm_sub_ps(r, _mm_mul_ps(fn, _mm_set1_ps(EXP_LN2_LO)));
+	__m128 p = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(EXP_P0), r), _mm_set1_ps(EXP_P1));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(EXP_P2));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(EXP_P3));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(EXP_P4));
+	p = _mm_add_ps(_mm_mul_ps(p, r), _mm_set1_ps(EXP_P5));
+	p = _mm_add_ps(_mm_add_ps(_mm_mul_ps(p, _mm_mul_ps(r, r)), r), _mm_set1_ps(1.0f));
+	__m128 scale = _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(n, _mm_set1_epi32(127)), 23));
+	return _mm_and_ps(inRange, _mm_mul_ps(p, scale));
+}
+#endif
+
+#ifdef RGBD_USE_AVX2
+//bilateralTaps 8 columns at a time. Returns the number of columns written
+static RGBD_AVX2_TARGET int bilateralTapsAVX2(const float* const* taps, const float* weights, int numTaps, const float* center, float inv2sig_t,
+	float* out, int count)
+{
+	int u = 0;
+	const __m256 minDepth8 = _mm256_set1_ps(FILTER_MIN_DEPTH);
+	const __m256 negInv8 = _mm256_set1_ps(-inv2sig_t);
+	for(; u + 8 <= count; u += 8)
+	{
+		__m256 c = _mm256_loadu_ps(center + u);
+		__m256 sum = _mm256_setzero_ps();
+		__m256 weightAccum = _mm256_setzero_ps();
+		for(int i = 0; i < numTaps; i++)
+		{
+			__m256 d = _mm256_loadu_ps(taps[i] + u);
+			__m256 diff = _mm256_sub_ps(c, d);
+			__m256 w = _mm256_mul_ps(expNegative8(_mm256_mul_ps(_mm256_mul_ps(diff, diff), negInv8)), _mm256_set1_ps(weights[i]));
+			//Invalid taps can be NaN, so mask the product and not just the weight
+			__m256 valid = _mm256_cmp_ps(d, minDepth8, _CMP_GT_OQ);
+			sum = _mm256_add_ps(sum, _mm256_and_ps(valid, _mm256_mul_ps(w, d)));
+			weightAccum = _mm256_add_ps(weightAccum, _mm256_and_ps(valid, w));
+		}
+		_mm256_storeu_ps(out + u, _mm256_div_ps(sum, weightAccum));
+	}
+	_mm256_zeroupper();
+	return u;
+}
+#endif
+
+//out[u] = sum(w*taps[i][u]) / sum(w) over the taps that are valid at u, with w = weights[i]*e^(-(center[u]-taps[i][u])^2*inv2sig_t).
+//No valid taps, or a NaN center, gives 0/0 = NaN like the kernels
+static void bilateralTaps(const float* const* taps, const float* weights, int numTaps, const float* center, float inv2sig_t,
+						  float* out, int count)
+{
+	int u = 0;
+#ifdef RGBD_USE_AVX2
+	if(rgbd::framework::cpuHasAVX2())
+		u = bilateralTapsAVX2(taps, weights, numTaps, center, inv2sig_t, out, count);
+#endif
+#ifdef RGBD_USE_SSE2
+	const __m128 minDepth4 = _mm_set1_ps(FILTER_MIN_DEPTH);
+	const __m128 negInv4 = _mm_set1_ps(-inv2sig_t);
+	for(; u + 4 <= count; u += 4)
+	{
+		__m128 c = _mm_loadu_ps(center + u);
+		__m128 sum = _mm_setzero_ps();
+		__m128 weightAccum = _mm_setzero_ps();
+		for(int i = 0; i < numTaps; i++)
+		{
+			__m128 d = _mm_loadu_ps(taps[i] + u);
+			__m128 diff = _mm_sub_ps(c, d);
+			__m128 w = _mm_mul_ps(expNegative4(_mm_mul_ps(_mm_mul_ps(diff, diff), negInv4)), _mm_set1_ps(weights[i]));
+			//Invalid taps can be NaN, so mask the product and not just the weight
+			__m128 valid = _mm_cmpgt_ps(d, minDepth4);
+			sum = _mm_add_ps(sum, _mm_and_ps(valid, _mm_mul_ps(w, d)));
+			weightAccum = _mm_add_ps(weightAccum, _mm_and_ps(valid, w));
+		}
+		_mm_storeu_ps(out + u, _mm_div_ps(sum, weightAccum));
+	}
+#endif
+	for(; u < count; u++)
+	{
+		float c = center[u];
+		float sum = 0.0f;
+		float weightAccum = 0.0f;
+		for(int i = 0; i < numTaps; i++)
+		{
+			float d = taps[i][u];
+			float w = expNegative(-(c-d)*(c-d)*inv2sig_t) * weights[i];
+			bool valid = d > FILTER_MIN_DEPTH;
+			sum += valid ? w*d : 0.0f;
+			weightAccum += valid ? w : 0.0f;
+		}
+		out[u] = sum/weightAccum;
+	}
+}
+#pragma endregion
+
+CpuBilateralDepthFilter::CpuBilateralDepthFilter(size_t cacheBytes) : mMode(CPU_BILATERAL_SEPARABLE), mSpatialSigma(1.0f),
+	mCacheBytes(cacheBytes)
+{
+	fill(mKernel, mKernel + GAUSSIAN_SPATIAL_KERNEL_SIZE, 0.0f);
+}
+
+void CpuBilateralDepthFilter::setKernel(const float* kernel, float sigma)
+{
+	copy(kernel, kernel + GAUSSIAN_SPATIAL_KERNEL_SIZE, mKernel);
+	mSpatialSigma = sigma;
+}
+
+void CpuBilateralDepthFilter::filter(const rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+									 float maxDepth, float sigma_t, CpuVertexMapBuilder& builder, CpuThreadPool& pool)
+{
+	if(mMode == CPU_BILATERAL_GRID)
+	{
+		filterGrid(depthBuffer, vmapSOA, xRes, yRes, maxDepth, sigma_t, builder, pool);
+		return;
+	}
+
+	float inv2sig_t = 1.0f/(2.0f*sigma_t);
+	bool windowed = (mMode == CPU_BILATERAL_WINDOWED);
+	//The windowed mode buffers padded input rows, the separable mode unpadded row results
+	int stripHeight = depthFilterStripHeight(mCacheBytes,
+		(windowed ? xRes + 2*GAUSSIAN_SPATIAL_FILTER_RADIUS : xRes)*sizeof(float));
+	int numStrips = (yRes + stripHeight - 1)/stripHeight;
+	pool.parallelFor(numStrips, 1, [&](int begin, int end){
+		vector<float> scratch;
+		for(int strip = begin; strip < end; strip++)
+		{
+			int first = strip*stripHeight;
+			int last = min(first + stripHeight, yRes);
+			if(windowed)
+				filterWindowedStrip(depthBuffer, vmapSOA, xRes, yRes, first, last, maxDepth, inv2sig_t, builder, scratch);
+			else
+				filterStrip(depthBuffer, vmapSOA, xRes, yRes, first, last, maxDepth, inv2sig_t, builder, scratch);
+		}
+	});
+}
+
+#pragma region Strip Filters
+void CpuBilateralDepthFilter::filterStrip(const rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+										  int begin, int end, float maxDepth, float inv2sig_t, CpuVertexMapBuilder& builder,
+										  vector<float>& scratch)
+{
+	const int R = GAUSSIAN_SPATIAL_FILTER_RADIUS;
+
+	//Rows the column pass reads. Rows outside the image are 0 and add nothing, so they are left out
+	int firstRow = max(begin - R, 0);
+	int lastRow = min(end + R, yRes);
+
+	size_t paddedSize = xRes + 2*R;
+	size_t stripSize = (lastRow - firstRow)*xRes;
+	if(scratch.size() < paddedSize + stripSize + xRes)
+		scratch.resize(paddedSize + stripSize + xRes);
+	float* padded = &scratch[0];
+	float* strip = padded + paddedSize;
+	float* depthOut = strip + stripSize;
+
+	//Samples outside the image are 0
+	fill(padded, padded + R, 0.0f);
+	fill(padded + R + xRes, padded + paddedSize, 0.0f);
+
+	//Row pass into the strip buffer, range weighted against the thresholded center depth
+	const float* taps[GAUSSIAN_SPATIAL_KERNEL_SIZE];
+	float weights[GAUSSIAN_SPATIAL_KERNEL_SIZE];
+	for(int i = 0; i < GAUSSIAN_SPATIAL_KERNEL_SIZE; i++)
+	{
+		taps[i] = padded + i;
+		weights[i] = mKernel[2*R - i];
+	}
+	for(int v = firstRow; v < lastRow; v++)
+	{
+		loadThresholdedDepthRow(&depthBuffer[v*xRes].depth, padded + R, xRes, maxDepth);
+		bilateralTaps(taps, weights, GAUSSIAN_SPATIAL_KERNEL_SIZE, padded + R, inv2sig_t, strip + (v - firstRow)*xRes, xRes);
+	}
+
+	//Column pass straight from the strip buffer, range weighted against the row result
+	for(int v = begin; v < end; v++)
+	{
+		int numTaps = 0;
+		for(int j = -R; j <= R; j++)
+		{
+			if(v+j < 0 || v+j >= yRes)
+				continue;
+			taps[numTaps] = strip + (v + j - firstRow)*xRes;
+			weights[numTaps] = mKernel[R - j];
+			numTaps++;
+		}
+		bilateralTaps(taps, weights, numTaps, strip + (v - firstRow)*xRes, inv2sig_t, depthOut, xRes);
+		builder.buildRowFromDepth(depthOut, vmapSOA, v);
+	}
+}
+
+void CpuBilateralDepthFilter::filterWindowedStrip(const rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+												  int begin, int end, float maxDepth, float inv2sig_t, CpuVertexMapBuilder& builder,
+												  vector<float>& scratch)
+{
+	const int R = GAUSSIAN_SPATIAL_FILTER_RADIUS;
+
+	int firstRow = max(begin - R, 0);
+	int lastRow = min(end + R, yRes);
+
+	//Thresholded input rows with R zeros on either side
+	size_t paddedWidth = xRes + 2*R;
+	size_t stripSize = (lastRow - firstRow)*paddedWidth;
+	if(scratch.size() < stripSize + xRes)
+		scratch.resize(stripSize + xRes);
+	float* strip = &scratch[0];
+	float* depthOut = strip + stripSize;
+
+	for(int v = firstRow; v < lastRow; v++)
+	{
+		float* row = strip + (v - firstRow)*paddedWidth;
+		fill(row, row + R, 0.0f);
+		fill(row + R + xRes, row + paddedWidth, 0.0f);
+		loadThresholdedDepthRow(&depthBuffer[v*xRes].depth, row + R, xRes, maxDepth);
+	}
+
+	const float* taps[GAUSSIAN_SPATIAL_KERNEL_SIZE*GAUSSIAN_SPATIAL_KERNEL_SIZE];
+	float weights[GAUSSIAN_SPATIAL_KERNEL_SIZE*GAUSSIAN_SPATIAL_KERNEL_SIZE];
+	for(int v = begin; v < end; v++)
+	{
+		//Rows outside the image are left out
+		int numTaps = 0;
+		for(int j = -R; j <= R; j++)
+		{
+			if(v+j < 0 || v+j >= yRes)
+				continue;
+			const float* row = strip + (v + j - firstRow)*paddedWidth + R;
+			for(int i = -R; i <= R; i++)
+			{
+				taps[numTaps] = row + i;
+				weights[numTaps] = mKernel[R - j]*mKernel[R - i];
+				numTaps++;
+			}
+		}
+		bilateralTaps(taps, weights, numTaps, strip + (v - firstRow)*paddedWidth + R, inv2sig_t, depthOut, xRes);
+		builder.buildRowFromDepth(depthOut, vmapSOA, v);
+	}
+}
+#pragma endregion
+
+#pragma region Bilateral Grid
+//Geometry of one frame's bilateral grid. Cells are (depth sum, weight) pairs, z fastest, then x. One grid row of cells is a slab
+struct BilateralGridShape
+{
+	int gridX;
+	int gridY;
+	int gridZ;
+	int cellWidth;
+	size_t slabSize;
+	float invCellSize;
+	float invRangeCellSize;
+	float minDepth;
+	//Outer, inner and center weights of the 5 tap blur along x and y, and along z
+	float spatialTaps[3];
+	float rangeTaps[3];
+};
+
+//Weights of a 5 tap blur with the given variance in cells, from 0 (no blur) to 1 (the [1 4 6 4 1]/16 binomial).
+//It is [w, 1-2w, w] applied twice with w = variance/4
+static void gridBlurTaps(float variance, float* taps)
+{
+	//NaNs blur fully
+	if(!(variance <= 1.0f))
+		variance = 1.0f;
+	float w = max(variance, 0.0f)*0.25f;
+	taps[0] = w*w;
+	taps[1] = 2.0f*w*(1.0f - 2.0f*w);
+	taps[2] = (1.0f - 2.0f*w)*(1.0f - 2.0f*w) + 2.0f*w*w;
+}
+
+#ifdef RGBD_USE_AVX2
+//blurGridTaps 8 floats at a time. Returns the number of floats written
+static RGBD_AVX2_TARGET size_t blurGridTapsAVX2(const float* const* taps, const float* weights, float* dest, size_t count)
+{
+	size_t k = 0;
+	const __m256 outerWeight = _mm256_set1_ps(weights[0]);
+	const __m256 innerWeight = _mm256_set1_ps(weights[1]);
+	const __m256 centerWeight = _mm256_set1_ps(weights[2]);
+	for(; k + 8 <= count; k += 8)
+	{
+		__m256 outer = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(taps[0] + k), _mm256_loadu_ps(taps[4] + k)), outerWeight);
+		__m256 inner = _mm256_mul_ps(_mm256_add_ps(_mm256_loadu_ps(taps[1] + k), _mm256_loadu_ps(taps[3] + k)), innerWeight);
+		__m256 center = _mm256_mul_ps(_mm256_loadu_ps(taps[2] + k), centerWeight);
+		_mm256_storeu_ps(dest + k, _mm256_add_ps(_mm256_add_ps(outer, inner), center));
+	}
+	_mm256_zeroupper();
+	return k;
+}
+#endif
+
+//dest[k] = w0*(taps[0][k] + taps[4][k]) + w1*(taps[1][k] + taps[3][k]) + w2*taps[2][k] for count floats,
+//with the weights from gridBlurTaps
+static void blurGridTaps(const float* const* taps, const float* weights, float* dest, size_t count)
+{
+	size_t k = 0;
+#ifdef RGBD_USE_AVX2
+	if(rgbd::framework::cpuHasAVX2())
+		k = blurGridTapsAVX2(taps, weights, dest, count);
+#endif
+#ifdef RGBD_USE_SSE2
+	const __m128 outerWeight = _mm_set1_ps(weights[0]);
+	const __m128 innerWeight = _mm_set1_ps(weights[1]);
+	const __m128 centerWeight = _mm_set1_ps(weights[2]);
+	for(; k + 4 <= count; k += 4)
+	{
+		__m128 outer = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(taps[0] + k), _mm_loadu_ps(taps[4] + k)), outerWeight);
+		__m128 inner = _mm_mul_ps(_mm_add_ps(_mm_loadu_ps(taps[1] + k), _mm_loadu_ps(taps[3] + k)), innerWeight);
+		__m128 center = _mm_mul_ps(_mm_loadu_ps(taps[2] + k), centerWeight);
+		_mm_storeu_ps(dest + k, _mm_add_ps(_mm_add_ps(outer, inner), center));
+	}
+#endif
+	for(; k < count; k++)
+		dest[k] = (weights[0]*(taps[0][k] + taps[4][k]) + weights[1]*(taps[1][k] + taps[3][k])) + weights[2]*taps[2][k];
+}
+
+//One grid row of cells. Cells [zBegin, zEnd) of each column may be nonzero, the rest are zero.
+//Rows of a scene only cover part of its depth range, so every pass only touches the occupied cells
+struct BilateralGridSlab
+{
+	float* cells;
+	int zBegin;
+	int zEnd;
+};
+
+//Zeroes the occupied cells of slab
+static void clearGridSlab(const BilateralGridShape& grid, BilateralGridSlab& slab)
+{
+	if(slab.zBegin < slab.zEnd)
+	{
+		for(int gx = 0; gx < grid.gridX; gx++)
+		{
+			float* cells = slab.cells + gx*grid.cellWidth;
+			fill(cells + 2*slab.zBegin, cells + 2*slab.zEnd, 0.0f);
+		}
+	}
+	slab.zBegin = slab.zEnd = 0;
+}
+
+//Splats image rows [begin, end) into slab and blurs it along z and x. row holds xRes floats, line one slab plus four cells
+static void splatGridSlab(const BilateralGridShape& grid, const rgbd::framework::DPixel* depthBuffer, int xRes, int begin, int end,
+						  float maxDepth, BilateralGridSlab& slab, float* row, float* line)
+{
+	const int pad = BILATERAL_GRID_PADDING;
+	clearGridSlab(grid, slab);
+
+	int zLo = grid.gridZ;
+	int zHi = -1;
+	for(int v = begin; v < end; v++)
+	{
+		loadThresholdedDepthRow(&depthBuffer[v*xRes].depth, row, xRes, maxDepth);
+		for(int u = 0; u < xRes; u++)
+		{
+			float d = row[u];
+			if(!(d > FILTER_MIN_DEPTH))
+				continue;
+			int gx = int(u*grid.invCellSize + 0.5f) + pad;
+			int gz = int((d - grid.minDepth)*grid.invRangeCellSize + 0.5f) + pad;
+			float* cell = slab.cells + gx*grid.cellWidth + 2*gz;
+			cell[0] += d;
+			cell[1] += 1.0f;
+			zLo = min(zLo, gz);
+			zHi = max(zHi, gz);
+		}
+	}
+	if(zHi < zLo)
+		return;
+
+	//The blurs spread the occupied cells two further either way. The padding keeps that inside the grid
+	slab.zBegin = zLo - 2;
+	slab.zEnd = zHi + 3;
+	const int width = 2*(slab.zEnd - slab.zBegin);
+	const float* taps[5];
+
+	//Along z, through a copy of each column with two zero cells either side
+	fill(line, line + width + 8, 0.0f);
+	for(int gx = 0; gx < grid.gridX; gx++)
+	{
+		float* cells = slab.cells + gx*grid.cellWidth + 2*slab.zBegin;
+		copy(cells, cells + width, line + 4);
+		for(int i = 0; i < 5; i++)
+			taps[i] = line + 2*i;
+		blurGridTaps(taps, grid.rangeTaps, cells, width);
+	}
+
+	//Along x, through a packed copy of the occupied cells with two zero columns either side
+	fill(line, line + 2*width, 0.0f);
+	fill(line + (grid.gridX + 2)*width, line + (grid.gridX + 4)*width, 0.0f);
+	for(int gx = 0; gx < grid.gridX; gx++)
+	{
+		const float* cells = slab.cells + gx*grid.cellWidth + 2*slab.zBegin;
+		copy(cells, cells + width, line + (gx + 2)*width);
+	}
+	for(int gx = 0; gx < grid.gridX; gx++)
+	{
+		for(int i = 0; i < 5; i++)
+			taps[i] = line + (gx + i)*width;
+		blurGridTaps(taps, grid.spatialTaps, slab.cells + gx*grid.cellWidth + 2*slab.zBegin, width);
+	}
+}
+
+//Blurs five consecutive z/x blurred slabs along y into dest
+static void blurGridSlabs(const BilateralGridShape& grid, const BilateralGridSlab* const* src, BilateralGridSlab& dest)
+{
+	clearGridSlab(grid, dest);
+
+	int zBegin = grid.gridZ;
+	int zEnd = 0;
+	for(int i = 0; i < 5; i++)
+	{
+		if(src[i]->zBegin < src[i]->zEnd)
+		{
+			zBegin = min(zBegin, src[i]->zBegin);
+			zEnd = max(zEnd, src[i]->zEnd);
+		}
+	}
+	if(zEnd <= zBegin)
+		return;
+
+	dest.zBegin = zBegin;
+	dest.zEnd = zEnd;
+	const float* taps[5];
+	for(int gx = 0; gx < grid.gridX; gx++)
+	{
+		size_t offset = gx*grid.cellWidth + 2*zBegin;
+		for(int i = 0; i < 5; i++)
+			taps[i] = src[i]->cells + offset;
+		blurGridTaps(taps, grid.spatialTaps, dest.cells + offset, 2*(zEnd - zBegin));
+	}
+}
+
+//Trilinear lookup of every valid pixel of row v in the blurred slabs either side of it. Pixels without depth get 0
+static void sliceGridRow(const BilateralGridShape& grid, const float* slab0, const float* slab1, int v, float* row, int xRes)
+{
+	const int pad = BILATERAL_GRID_PADDING;
+	float fy = v*grid.invCellSize + pad;
+	float ty = fy - int(fy);
+	const float* slabs[2] = {slab0, slab1};
+	for(int u = 0; u < xRes; u++)
+	{
+		float d = row[u];
+		if(!(d > FILTER_MIN_DEPTH))
+		{
+			row[u] = 0.0f;
+			continue;
+		}
+		float fx = u*grid.invCellSize + pad;
+		float fz = (d - grid.minDepth)*grid.invRangeCellSize + pad;
+		int x0 = int(fx);
+		int z0 = int(fz);
+		float tx = fx - x0;
+		float tz = fz - z0;
+
+		float sum = 0.0f;
+		float weightAccum = 0.0f;
+		for(int j = 0; j < 2; j++)
+		{
+			float wy = j ? ty : 1.0f - ty;
+			for(int i = 0; i < 2; i++)
+			{
+				float wxy = wy*(i ? tx : 1.0f - tx);
+				const float* cell = slabs[j] + (x0 + i)*grid.cellWidth + 2*z0;
+				sum += wxy*((1.0f - tz)*cell[0] + tz*cell[2]);
+				weightAccum += wxy*((1.0f - tz)*cell[1] + tz*cell[3]);
+			}
+		}
+		row[u] = sum/weightAccum;
+	}
+}
+
+void CpuBilateralDepthFilter::filterGrid(const rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+										 float maxDepth, float sigma_t, CpuVertexMapBuilder& builder, CpuThreadPool& pool)
+{
+	const int pad = BILATERAL_GRID_PADDING;
+	BilateralGridShape grid;
+
+	//Depth range of the frame, so the range axis only covers depths that occur
+	vector<float> rowMin(yRes);
+	vector<float> rowMax(yRes);
+	pool.parallelFor(yRes, pool.grainFor(yRes), [&](int begin, int end){
+		vector<float> row(xRes);
+		for(int v = begin; v < end; v++)
+		{
+			loadThresholdedDepthRow(&depthBuffer[v*xRes].depth, &row[0], xRes, maxDepth);
+			float lo = FLT_MAX;
+			float hi = -FLT_MAX;
+			for(int u = 0; u < xRes; u++)
+			{
+				float d = row[u];
+				bool valid = d > FILTER_MIN_DEPTH;
+				lo = valid ? min(lo, d) : lo;
+				hi = valid ? max(hi, d) : hi;
+			}
+			rowMin[v] = lo;
+			rowMax[v] = hi;
+		}
+	});
+	grid.minDepth = *min_element(rowMin.begin(), rowMin.end());
+	float maxValidDepth = *max_element(rowMax.begin(), rowMax.end());
+	//No valid depth. Every vertex ends up NaN
+	if(maxValidDepth < grid.minDepth)
+		grid.minDepth = maxValidDepth = 0.0f;
+
+	//Cells are one standard deviation wide where they can be, so the binomial blur applies the same gaussians as the kernel
+	//and the range weight. Cells are kept to at least BILATERAL_GRID_MIN_CELL pixels, range cells to at least the 1mm depth
+	//resolution and at most BILATERAL_GRID_MAX_RANGE_CELLS per frame, and the blurs shrink below a cell to make up for it.
+	//Written so that sigmas of 0, below 0, NaN or infinity still give a finite grid
+	float cellSize = sqrtf(mSpatialSigma);
+	if(!(cellSize >= BILATERAL_GRID_MIN_CELL))
+		cellSize = BILATERAL_GRID_MIN_CELL;
+	float rangeCellSize = sqrtf(sigma_t);
+	float minRangeCellSize = max((maxValidDepth - grid.minDepth)/(BILATERAL_GRID_MAX_RANGE_CELLS - 1), 0.001f);
+	if(!(rangeCellSize >= minRangeCellSize))
+		rangeCellSize = minRangeCellSize;
+	grid.invCellSize = 1.0f/cellSize;
+	grid.invRangeCellSize = 1.0f/rangeCellSize;
+	gridBlurTaps(mSpatialSigma/(cellSize*cellSize), grid.spatialTaps);
+	gridBlurTaps(sigma_t/(rangeCellSize*rangeCellSize), grid.rangeTaps);
+
+	//Splatting rounds to the nearest cell, slicing reads the cell after the one below, padding covers both
+	grid.gridX = int((xRes - 1)*grid.invCellSize + 0.5f) + 1 + 2*pad;
+	grid.gridY = int((yRes - 1)*grid.invCellSize + 0.5f) + 1 + 2*pad;
+	grid.gridZ = int((maxValidDepth - grid.minDepth)*grid.invRangeCellSize + 0.5f) + 1 + 2*pad;
+	grid.cellWidth = 2*grid.gridZ;
+	grid.slabSize = size_t(grid.gridX)*grid.cellWidth;
+	const int gridY = grid.gridY;
+	const size_t slabSize = grid.slabSize;
+
+	//First image row splatted into each slab, and first image row sliced between each slab and the next
+	vector<int> splatStart(gridY + 1, yRes);
+	vector<int> sliceStart(gridY + 1, yRes);
+	for(int v = yRes - 1; v >= 0; v--)
+	{
+		splatStart[int(v*grid.invCellSize + 0.5f) + pad] = v;
+		sliceStart[int(v*grid.invCellSize) + pad] = v;
+	}
+	for(int gy = gridY - 1; gy >= 0; gy--)
+	{
+		splatStart[gy] = min(splatStart[gy], splatStart[gy+1]);
+		sliceStart[gy] = min(sliceStart[gy], sliceStart[gy+1]);
+	}
+
+	//The grid is never built whole. Each chunk of slabs streams through a ring of the five z/x blurred slabs that the y blur
+	//of one slab reads, and the two y blurred slabs that slicing reads, so the working set stays a few slabs per thread.
+	//Chunks rebuild the two slabs either side of them
+	const int grain = pool.grainFor(gridY, 1);
+	if(mGridBuffers.size() < size_t((gridY + grain - 1)/grain))
+		mGridBuffers.resize((gridY + grain - 1)/grain);
+	pool.parallelFor(gridY, grain, [&](int begin, int end){
+		//Eight slabs, a line of one slab plus four cells and an image row, kept between frames
+		vector<float>& buffer = mGridBuffers[begin/grain];
+		size_t lineSize = (grid.gridX + 4)*grid.cellWidth;
+		if(buffer.size() < 8*slabSize + lineSize + xRes)
+			buffer.resize(8*slabSize + lineSize + xRes);
+		fill(buffer.begin(), buffer.begin() + 8*slabSize, 0.0f);
+		float* line = &buffer[8*slabSize];
+		float* row = line + lineSize;
+		BilateralGridSlab slabs[8];
+		for(int i = 0; i < 8; i++)
+		{
+			slabs[i].cells = &buffer[i*slabSize];
+			slabs[i].zBegin = slabs[i].zEnd = 0;
+		}
+		//Ring of z/x blurred slabs, the y blurred slabs, and a slab that stays zero for rows outside the grid
+		BilateralGridSlab* ring = slabs;
+		BilateralGridSlab* blurred = slabs + 5;
+		const BilateralGridSlab* zeroSlab = slabs + 7;
+
+		for(int gy = max(begin - 2, 0); gy < min(begin + 2, gridY); gy++)
+			splatGridSlab(grid, depthBuffer, xRes, splatStart[gy], splatStart[gy+1], maxDepth, ring[gy%5], row, line);
+
+		int last = min(end, gridY - 1);
+		for(int gy = begin; gy <= last; gy++)
+		{
+			if(gy + 2 < gridY)
+				splatGridSlab(grid, depthBuffer, xRes, splatStart[gy+2], splatStart[gy+3], maxDepth, ring[(gy+2)%5], row, line);
+
+			const BilateralGridSlab* src[5];
+			for(int j = -2; j <= 2; j++)
+				src[j+2] = (gy+j < 0 || gy+j >= gridY) ? zeroSlab : &ring[(gy+j)%5];
+			blurGridSlabs(grid, src, blurred[gy%2]);
+
+			if(gy == begin)
+				continue;
+			for(int v = sliceStart[gy-1]; v < sliceStart[gy]; v++)
+			{
+				loadThresholdedDepthRow(&depthBuffer[v*xRes].depth, row, xRes, maxDepth);
+				sliceGridRow(grid, blurred[(gy-1)%2].cells, blurred[gy%2].cells, v, row, xRes);
+				builder.buildRowFromDepth(row, vmapSOA, v);
+			}
+		}
+	});
+}
+#pragma endregion
@@ -0,0 +1,73 @@
+#pragma once
+#include "device_structs.h"
+#include "RGBDFrame.h"
+#include "preprocessing.h"
+#include "CpuVertexMapBuilder.h"
+#include "CpuGaussianDepthFilter.h"
+#include "CpuThreadPool.h"
+#include <vector>
+
+using namespace std;
+
+enum CpuBilateralMode
+{
+	//Row pass then column pass, each range weighted against its own center, like bilateralFilterKernelRows/Cols.
+	//Depths within 2.4e-6m of the kernels
+	CPU_BILATERAL_SEPARABLE,
+	//Full (2R+1)^2 window around each pixel, range weighted against the center depth: the filter the kernels approximate.
+	//About 3x the cost of the separable mode
+	CPU_BILATERAL_WINDOWED,
+	//Bilateral grid with cells one spatial and one range standard deviation wide, but never under 2 pixels or over 256 range
+	//cells a frame. Cost stays flat up to a spatial sigma of 4 and goes down above it, below the windowed mode throughout,
+	//and the spatial gaussian is not cut off at GAUSSIAN_SPATIAL_FILTER_RADIUS. Coarser than the other modes at small sigmas.
+	//Unlike the kernels it never fills pixels without depth
+	CPU_BILATERAL_GRID
+};
+
+/*
+*	Class CpuBilateralDepthFilter
+*	Host bilateral depth filter behind CpuMeshBackend::buildVMapBilateralFilter, with a selectable algorithm (see CpuBilateralMode).
+*	Takes the same parameters as buildVMapBilateralFilterCUDA: the spatial kernel from setGaussianSpatialKernel, maxDepth, and
+*	sigma_t, with range weights exp(-(dz*dz)/(2*sigma_t)). Depths beyond maxDepth are dropped and 1mm or less get no weight.
+*	The separable and windowed modes work on L2 sized row strips like CpuGaussianDepthFilter and are vectorized across columns
+*	with AVX2 or SSE2. Their range weights use a polynomial exp that flushes weights below FLT_MIN to 0 like __expf.
+*	The grid is streamed a few grid rows at a time per thread, through buffers kept between frames, and only over the depths
+*	each grid row holds.
+*	Against the kernels at the viewer's defaults (spatial sigma 2, sigma_t 0.005) on a noisy 640x480 scene, the windowed mode
+*	is within 0.5mm on half the pixels, 6.5mm on 95% and 15mm on 99%, the grid within 2.5mm, 12mm and 22mm.
+*/
+class CpuBilateralDepthFilter
+{
+private:
+	//Make this class non construction-copyable
+	CpuBilateralDepthFilter( const CpuBilateralDepthFilter& other );
+	CpuBilateralDepthFilter& operator=( const CpuBilateralDepthFilter& );
+protected:
+	CpuBilateralMode mMode;
+	float mKernel[GAUSSIAN_SPATIAL_KERNEL_SIZE];
+	//Spatial sigma as given to setGaussianSpatialKernel, which uses it as a variance
+	float mSpatialSigma;
+	size_t mCacheBytes;
+	//Bilateral grid slabs and scratch rows of each parallelFor chunk, kept between frames
+	vector<vector<float> > mGridBuffers;
+
+	void filterStrip(const rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+		int begin, int end, float maxDepth, float inv2sig_t, CpuVertexMapBuilder& builder, vector<float>& scratch);
+	void filterWindowedStrip(const rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+		int begin, int end, float maxDepth, float inv2sig_t, CpuVertexMapBuilder& builder, vector<float>& scratch);
+	void filterGrid(const rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+		float maxDepth, float sigma_t, CpuVertexMapBuilder& builder, CpuThreadPool& pool);
+public:
+	CpuBilateralDepthFilter(size_t cacheBytes = CPU_FILTER_L2_BYTES);
+
+	inline void setMode(CpuBilateralMode mode){mMode = mode;}
+	inline CpuBilateralMode getMode(){return mMode;}
+
+	//Copies GAUSSIAN_SPATIAL_KERNEL_SIZE weights built from sigma
+	void setKernel(const float* kernel, float sigma);
+
+	//Filters the whole depth image into the level 0 vertex map through builder, which must be set up for the camera.
+	//depthBuffer is already mirrored
+	void filter(const rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+		float maxDepth, float sigma_t, CpuVertexMapBuilder& builder, CpuThreadPool& pool);
+};
@@ -0,0 +1,174 @@
+#include "CpuGaussianDepthFilter.h"
+#include <algorithm>
+
+#ifdef RGBD_USE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef RGBD_USE_AVX2
+#include <immintrin.h>
+#endif
+
+//Valid samples are above 1mm. Zeros, NaNs and anything padded in fail the test
+#define FILTER_MIN_DEPTH	0.001f
+
+#ifdef RGBD_USE_AVX2
+//convolveValidTaps 8 columns at a time. Returns the number of columns written
+static RGBD_AVX2_TARGET int convolveValidTapsAVX2(const float* const* taps, const float* weights, int numTaps, float* out, int count)
+{
+	int u = 0;
+	const __m256 minDepth8 = _mm256_set1_ps(FILTER_MIN_DEPTH);
+	for(; u + 8 <= count; u += 8)
+	{
+		__m256 sum = _mm256_setzero_ps();
+		__m256 weightAccum = _mm256_setzero_ps();
+		for(int i = 0; i < numTaps; i++)
+		{
+			__m256 d = _mm256_loadu_ps(taps[i] + u);
+			__m256 w = _mm256_set1_ps(weights[i]);
+			__m256 valid = _mm256_cmp_ps(d, minDepth8, _CMP_GT_OQ);
+			sum = _mm256_add_ps(sum, _mm256_and_ps(valid, _mm256_mul_ps(w, d)));
+			weightAccum = _mm256_add_ps(weightAccum, _mm256_and_ps(valid, w));
+		}
+		_mm256_storeu_ps(out + u, _mm256_div_ps(sum, weightAccum));
+	}
+	_mm256_zeroupper();
+	return u;
+}
+#endif
+
+//out[u] = sum(w[i]*taps[i][u]) / sum(w[i]) over the taps that are valid at u, added in tap order.
+//No valid taps gives 0/0 = NaN like the kernels
+static void convolveValidTaps(const float* const* taps, const float* weights, int numTaps, float* out, int count)
+{
+	int u = 0;
+#ifdef RGBD_USE_AVX2
+	if(rgbd::framework::cpuHasAVX2())
+		u = convolveValidTapsAVX2(taps, weights, numTaps, out, count);
+#endif
+#ifdef RGBD_USE_SSE2
+	const __m128 minDepth4 = _mm_set1_ps(FILTER_MIN_DEPTH);
+	for(; u + 4 <= count; u += 4)
+	{
+		__m128 sum = _mm_setzero_ps();
+		__m128 weightAccum = _mm_setzero_ps();
+		for(int i = 0; i < numTaps; i++)
+		{
+			__m128 d = _mm_loadu_ps(taps[i] + u);
+			__m128 w = _mm_set1_ps(weights[i]);
+			__m128 valid = _mm_cmpgt_ps(d, minDepth4);
+			sum = _mm_add_ps(sum, _mm_and_ps(valid, _mm_mul_ps(w, d)));
+			weightAccum = _mm_add_ps(weightAccum, _mm_and_ps(valid, w));
+		}
+		_mm_storeu_ps(out + u, _mm_div_ps(sum, weightAccum));
+	}
+#endif
+	for(; u < count; u++)
+	{
+		float sum = 0.0f;
+		float weightAccum = 0.0f;
+		for(int i = 0; i < numTaps; i++)
+		{
+			float d = taps[i][u];
+			bool valid = d > FILTER_MIN_DEPTH;
+			sum += valid ? weights[i]*d : 0.0f;
+			weightAccum += valid ? weights[i] : 0.0f;
+		}
+		out[u] = sum/weightAccum;
+	}
+}
+
+void loadThresholdedDepthRow(const uint16_t* src, float* dest, int count, float maxDepth)
+{
+	int u = 0;
+#if defined(RGBD_USE_SSE2)
+	const __m128 scale = _mm_set1_ps(0.001f);
+	const __m128 maxDepth4 = _mm_set1_ps(maxDepth);
+	const __m128i zero = _mm_setzero_si128();
+	for(; u + 8 <= count; u += 8)
+	{
+		__m128i raw = _mm_loadu_si128((const __m128i*) (src + u));
+		__m128 lo = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(raw, zero)), scale);
+		__m128 hi = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(raw, zero)), scale);
+		_mm_storeu_ps(dest + u, _mm_and_ps(_mm_cmple_ps(lo, maxDepth4), lo));
+		_mm_storeu_ps(dest + u + 4, _mm_and_ps(_mm_cmple_ps(hi, maxDepth4), hi));
+	}
+#endif
+	for(; u < count; u++)
+	{
+		float d = src[u] * 0.001f;
+		dest[u] = (d > maxDepth) ? 0.0f : d;
+	}
+}
+
+CpuGaussianDepthFilter::CpuGaussianDepthFilter(size_t cacheBytes) : mCacheBytes(cacheBytes)
+{
+	fill(mKernel, mKernel + GAUSSIAN_SPATIAL_KERNEL_SIZE, 0.0f);
+}
+
+void CpuGaussianDepthFilter::setKernel(const float* kernel)
+{
+	copy(kernel, kernel + GAUSSIAN_SPATIAL_KERNEL_SIZE, mKernel);
+}
+
+int depthFilterStripHeight(size_t cacheBytes, size_t bufferRowBytes)
+{
+	int bufferRows = int(cacheBytes/2/bufferRowBytes);
+	return max(bufferRows - 2*GAUSSIAN_SPATIAL_FILTER_RADIUS, GAUSSIAN_SPATIAL_FILTER_RADIUS);
+}
+
+int CpuGaussianDepthFilter::getStripHeight(int xRes)
+{
+	return depthFilterStripHeight(mCacheBytes, xRes*sizeof(float));
+}
+
+void CpuGaussianDepthFilter::filterStrip(const rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+										 int begin, int end, float maxDepth, CpuVertexMapBuilder& builder, vector<float>& scratch)
+{
+	const int R = GAUSSIAN_SPATIAL_FILTER_RADIUS;
+
+	//Rows the column pass reads. Rows outside the image are 0 and add nothing, so they are left out
+	int firstRow = max(begin - R, 0);
+	int lastRow = min(end + R, yRes);
+
+	size_t paddedSize = xRes + 2*R;
+	size_t stripSize = (lastRow - firstRow)*xRes;
+	if(scratch.size() < paddedSize + stripSize + xRes)
+		scratch.resize(paddedSize + stripSize + xRes);
+	float* padded = &scratch[0];
+	float* strip = padded + paddedSize;
+	float* depthOut = strip + stripSize;
+
+	//Samples outside the image are 0
+	fill(padded, padded + R, 0.0f);
+	fill(padded + R + xRes, padded + paddedSize, 0.0f);
+
+	//Row pass into the strip buffer. Tap j of the kernels reads u+j with weight kernel[R-j]
+	const float* taps[GAUSSIAN_SPATIAL_KERNEL_SIZE];
+	float weights[GAUSSIAN_SPATIAL_KERNEL_SIZE];
+	for(int i = 0; i < GAUSSIAN_SPATIAL_KERNEL_SIZE; i++)
+	{
+		taps[i] = padded + i;
+		weights[i] = mKernel[2*R - i];
+	}
+	for(int v = firstRow; v < lastRow; v++)
+	{
+		loadThresholdedDepthRow(&depthBuffer[v*xRes].depth, padded + R, xRes, maxDepth);
+		convolveValidTaps(taps, weights, GAUSSIAN_SPATIAL_KERNEL_SIZE, strip + (v - firstRow)*xRes, xRes);
+	}
+
+	//Column pass straight from the strip buffer
+	for(int v = begin; v < end; v++)
+	{
+		int numTaps = 0;
+		for(int j = -R; j <= R; j++)
+		{
+			if(v+j < 0 || v+j >= yRes)
+				continue;
+			taps[numTaps] = strip + (v + j - firstRow)*xRes;
+			weights[numTaps] = mKernel[R - j];
+			numTaps++;
+		}
+		convolveValidTaps(taps, weights, numTaps, depthOut, xRes);
+		builder.buildRowFromDepth(depthOut, vmapSOA, v);
+	}
+}
@@ -0,0 +1,53 @@
+#pragma once
+#include "device_structs.h"
+#include "RGBDFrame.h"
+#include "preprocessing.h"
+#include "CpuVertexMapBuilder.h"
+#include <vector>
+
+using namespace std;
+
+//Per core L2 size the strips are fitted to. Smaller than most current parts so a strip stays resident next to other data
+#define CPU_FILTER_L2_BYTES	(256*1024)
+
+//Output rows per strip so that a strip buffer of rows bufferRowBytes wide, plus GAUSSIAN_SPATIAL_FILTER_RADIUS rows of apron
+//above and below, takes half of cacheBytes. The rest holds input, output and whatever else is live
+int depthFilterStripHeight(size_t cacheBytes, size_t bufferRowBytes);
+
+//Metric depth from raw depth with everything beyond maxDepth set to 0, as the depth filter kernels load it
+void loadThresholdedDepthRow(const uint16_t* src, float* dest, int count, float maxDepth);
+
+/*
+*	Class CpuGaussianDepthFilter
+*	Host version of the gaussianKernelRows/gaussianKernelCols pair behind buildVMapGaussianFilterCUDA.
+*	The image is cut into strips of rows. For each strip the row pass fills a strip buffer (with GAUSSIAN_SPATIAL_FILTER_RADIUS
+*	rows of apron above and below) and the column pass reads it straight back, so the row results never leave the cache and
+*	no full size intermediate image is written. Strip height is picked so the strip buffer takes half of CPU_FILTER_L2_BYTES.
+*	Both passes are vectorized across columns with AVX2 or SSE2 and add taps in the kernels' order, so results match the
+*	unstripped filter bit for bit.
+*	Invalid depths are handled like the kernels: depths beyond maxDepth become 0, and 0, NaN or 1mm and less get no weight.
+*/
+class CpuGaussianDepthFilter
+{
+private:
+	//Make this class non construction-copyable
+	CpuGaussianDepthFilter( const CpuGaussianDepthFilter& other );
+	CpuGaussianDepthFilter& operator=( const CpuGaussianDepthFilter& );
+protected:
+	float mKernel[GAUSSIAN_SPATIAL_KERNEL_SIZE];
+	size_t mCacheBytes;
+public:
+	CpuGaussianDepthFilter(size_t cacheBytes = CPU_FILTER_L2_BYTES);
+
+	//Copies GAUSSIAN_SPATIAL_KERNEL_SIZE weights
+	void setKernel(const float* kernel);
+
+	//Output rows per strip for an image xRes wide
+	int getStripHeight(int xRes);
+
+	//Filters output rows [begin, end) and writes them to the level 0 vertex map through builder, which must be set up
+	//for the camera. depthBuffer is already mirrored. scratch is grown as needed; use one per thread.
+	//Safe to call from several threads for disjoint strips
+	void filterStrip(const rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+		int begin, int end, float maxDepth, CpuVertexMapBuilder& builder, vector<float>& scratch);
+};
@@ -0,0 +1,77 @@
+#include "CpuMeshBackend.h"
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+
+//Cache line alignment so rows start on a vector boundary
+#define CPU_BUFFER_ALIGNMENT	64
+
+CpuMeshBackend::CpuMeshBackend(int threadCount) : mPool(threadCount)
+{
+	setGaussianSpatialKernel(2.0f);
+	setSeperableKernelGaussian(10.0f);
+}
+
+CpuMeshBackend::~CpuMeshBackend(void)
+{
+}
+
+int CpuMeshBackend::getThreadCount()
+{
+	return mPool.getThreadCount();
+}
+
+float* CpuMeshBackend::getScratch(int index, size_t count)
+{
+	if(mScratch[index].size() < count)
+		mScratch[index].resize(count);
+	return &mScratch[index][0];
+}
+
+#pragma region Memory
+void* CpuMeshBackend::allocate(size_t bytes)
+{
+#ifdef _WIN32
+	return _aligned_malloc(bytes, CPU_BUFFER_ALIGNMENT);
+#else
+	void* ptr = NULL;
+	if(posix_memalign(&ptr, CPU_BUFFER_ALIGNMENT, bytes) != 0)
+		return NULL;
+	return ptr;
+#endif
+}
+
+void CpuMeshBackend::release(void* ptr)
+{
+#ifdef _WIN32
+	_aligned_free(ptr);
+#else
+	free(ptr);
+#endif
+}
+
+void* CpuMeshBackend::allocateHost(size_t bytes)
+{
+	return allocate(bytes);
+}
+
+void CpuMeshBackend::releaseHost(void* ptr)
+{
+	release(ptr);
+}
+
+void CpuMeshBackend::copyToDevice(void* dest, const void* src, size_t bytes)
+{
+	memcpy(dest, src, bytes);
+}
+
+void CpuMeshBackend::copyToHost(void* dest, const void* src, size_t bytes)
+{
+	memcpy(dest, src, bytes);
+}
+
+void CpuMeshBackend::synchronize()
+{
+	//Stages finish before they return
+}
+#pragma endregion
@@ -0,0 +1,111 @@
+#include "CpuThreadPool.h"
+#include <algorithm>
+
+CpuThreadPool::CpuThreadPool(int threadCount)
+{
+	mIsStopping = false;
+	mBody = NULL;
+	mCount = 0;
+	mGrain = 1;
+	mChunkCount = 0;
+	mNextChunk = 0;
+	mFinishedChunks = 0;
+	mGeneration = 0;
+
+	if(threadCount <= 0)
+		threadCount = max((int) boost::thread::hardware_concurrency(), 1);
+
+	//The thread calling parallelFor does its share, so one fewer worker
+	for(int i = 1; i < threadCount; i++)
+		mWorkers.push_back(boost::shared_ptr<boost::thread>(new boost::thread(&CpuThreadPool::run, this)));
+}
+
+CpuThreadPool::~CpuThreadPool(void)
+{
+	{
+		boost::mutex::scoped_lock lock(mGuard);
+		mIsStopping = true;
+		mWorkCond.notify_all();
+	}
+	for(size_t i = 0; i < mWorkers.size(); i++)
+		mWorkers[i]->join();
+}
+
+int CpuThreadPool::getThreadCount()
+{
+	return (int) mWorkers.size() + 1;
+}
+
+int CpuThreadPool::grainFor(int count, int chunksPerThread)
+{
+	int chunks = max(getThreadCount()*chunksPerThread, 1);
+	return max((count + chunks - 1)/chunks, 1);
+}
+
+void CpuThreadPool::runChunks(boost::unique_lock<boost::mutex>& lock)
+{
+	while(mNextChunk < mChunkCount)
+	{
+		int chunk = mNextChunk++;
+		const boost::function<void (int, int)>* body = mBody;
+		int begin = chunk*mGrain;
+		int end = min(begin + mGrain, mCount);
+
+		lock.unlock();
+		(*body)(begin, end);
+		lock.lock();
+
+		mFinishedChunks++;
+		if(mFinishedChunks == mChunkCount)
+			mDoneCond.notify_all();
+	}
+}
+
+void CpuThreadPool::run()
+{
+	boost::unique_lock<boost::mutex> lock(mGuard);
+	int seenGeneration = mGeneration;
+	while(!mIsStopping)
+	{
+		if(seenGeneration == mGeneration || mNextChunk >= mChunkCount)
+		{
+			seenGeneration = mGeneration;
+			mWorkCond.wait(lock);
+			continue;
+		}
+
+		seenGeneration = mGeneration;
+		runChunks(lock);
+	}
+}
+
+void CpuThreadPool::parallelFor(int count, int grain, const boost::function<void (int begin, int end)>& body)
+{
+	if(count <= 0)
+		return;
+	grain = max(grain, 1);
+
+	//Not worth waking anyone for
+	if(count <= grain || mWorkers.empty())
+	{
+		for(int begin = 0; begin < count; begin += grain)
+			body(begin, min(begin + grain, count));
+		return;
+	}
+
+	boost::unique_lock<boost::mutex> lock(mGuard);
+	mBody = &body;
+	mCount = count;
+	mGrain = grain;
+	mChunkCount = (count + grain - 1)/grain;
+	mNextChunk = 0;
+	mFinishedChunks = 0;
+	mGeneration++;
+	mWorkCond.notify_all();
+
+	runChunks(lock);
+	while(mFinishedChunks < mChunkCount)
+		mDoneCond.wait(lock);
+
+	mBody = NULL;
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include <vector>
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+#include <boost/shared_ptr.hpp>
+
+using namespace std;
+
+/*
+*	Class CpuThreadPool
+*	Fixed set of worker threads that run data parallel loops for the CPU mesh backend.
+*	parallelFor splits a range into chunks, hands them to the workers and the calling thread, and returns when all are done.
+*	Chunk boundaries only depend on the range and grain, never on the thread count, so a reduction that keeps one partial
+*	result per chunk and combines them in chunk order gives the same result on any machine.
+*/
+class CpuThreadPool
+{
+private:
+	//Make this class non construction-copyable
+	CpuThreadPool( const CpuThreadPool& other );
+	CpuThreadPool& operator=( const CpuThreadPool& );
+protected:
+	boost::mutex mGuard;
+	boost::condition_variable mWorkCond;
+	boost::condition_variable mDoneCond;
+	vector<boost::shared_ptr<boost::thread> > mWorkers;
+	bool mIsStopping;
+
+	//Current loop. Workers take chunks while mNextChunk < mChunkCount
+	const boost::function<void (int, int)>* mBody;
+	int mCount;
+	int mGrain;
+	int mChunkCount;
+	int mNextChunk;
+	int mFinishedChunks;
+	//Incremented for every loop, so a worker never mistakes an old loop for a new one
+	int mGeneration;
+
+	void run();
+	//Runs chunks of the current loop until none are left. Caller must hold lock
+	void runChunks(boost::unique_lock<boost::mutex>& lock);
+public:
+	//0 threads uses one per hardware thread. The calling thread counts as one of them
+	CpuThreadPool(int threadCount = 0);
+	~CpuThreadPool(void);
+
+	int getThreadCount();
+
+	//Calls body(begin, end) for consecutive chunks of at most grain elements covering [0, count).
+	//Chunk i starts at i*grain. Not reentrant: body must not call parallelFor
+	void parallelFor(int count, int grain, const boost::function<void (int begin, int end)>& body);
+
+	//Grain that splits count into about chunksPerThread chunks per thread
+	int grainFor(int count, int chunksPerThread = 4);
+};
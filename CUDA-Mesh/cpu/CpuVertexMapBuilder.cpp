@@ -0,0 +1,184 @@
+#include "CpuVertexMapBuilder.h"
+#include <limits>
+
+#ifdef RGBD_USE_SSE2
+#include <emmintrin.h>
+#endif
+#ifdef RGBD_USE_AVX2
+#include <immintrin.h>
+#endif
+
+#define VMAP_NAN_F	(std::numeric_limits<float>::quiet_NaN())
+
+CpuVertexMapBuilder::CpuVertexMapBuilder(void) : mIntr(0.0f, 0.0f, 0.0f, 0.0f), mXRes(0), mYRes(0)
+{
+}
+
+void CpuVertexMapBuilder::setCamera(rgbd::framework::Intrinsics intr, int xRes, int yRes)
+{
+	if(xRes == mXRes && yRes == mYRes && intr.fx == mIntr.fx && intr.fy == mIntr.fy
+		&& intr.cx == mIntr.cx && intr.cy == mIntr.cy)
+		return;
+
+	mIntr = intr;
+	mXRes = xRes;
+	mYRes = yRes;
+	mRayX.resize(xRes);
+	mRayY.resize(yRes);
+	for(int u = 0; u < xRes; u++)
+		mRayX[u] = (u - intr.cx) / intr.fx;
+	for(int v = 0; v < yRes; v++)
+		mRayY[v] = (v - intr.cy) / intr.fy;
+}
+
+#ifdef RGBD_USE_SSE2
+//Reverses the 8 depths in a register, so a row read backwards can be loaded 8 pixels at a time
+static inline __m128i reverseDepths(__m128i d)
+{
+	d = _mm_shuffle_epi32(d, _MM_SHUFFLE(1,0,3,2));
+	d = _mm_shufflelo_epi16(d, _MM_SHUFFLE(0,1,2,3));
+	return _mm_shufflehi_epi16(d, _MM_SHUFFLE(0,1,2,3));
+}
+#endif
+
+#ifdef RGBD_USE_AVX2
+//One row of buildMirroredRows 8 pixels at a time. Returns the number of pixels written
+static RGBD_AVX2_TARGET int buildMirroredRowAVX2(const uint16_t* src, const float* rayX, float rayY, float maxDepth, int xRes,
+	float* x, float* y, float* z)
+{
+	int u = 0;
+	const __m256 scale = _mm256_set1_ps(0.001f);
+	const __m256 minDepth8 = _mm256_set1_ps(0.001f);
+	const __m256 maxDepth8 = _mm256_set1_ps(maxDepth);
+	const __m256 nan8 = _mm256_set1_ps(VMAP_NAN_F);
+	const __m256 rayY8 = _mm256_set1_ps(rayY);
+	for(; u + 8 <= xRes; u += 8)
+	{
+		//Pixels u..u+7 come from xRes-1-u back to xRes-8-u
+		__m128i raw = reverseDepths(_mm_loadu_si128((const __m128i*) (src + xRes - 8 - u)));
+		__m256 d = _mm256_mul_ps(_mm256_cvtepi32_ps(_mm256_cvtepu16_epi32(raw)), scale);
+		__m256 valid = _mm256_and_ps(_mm256_cmp_ps(d, minDepth8, _CMP_GT_OQ), _mm256_cmp_ps(d, maxDepth8, _CMP_LT_OQ));
+		_mm256_storeu_ps(x + u, _mm256_blendv_ps(nan8, _mm256_mul_ps(_mm256_loadu_ps(rayX + u), d), valid));
+		_mm256_storeu_ps(y + u, _mm256_blendv_ps(nan8, _mm256_mul_ps(rayY8, d), valid));
+		_mm256_storeu_ps(z + u, _mm256_blendv_ps(nan8, d, valid));
+	}
+	_mm256_zeroupper();
+	return u;
+}
+
+//buildRowFromDepth 8 pixels at a time. Returns the number of pixels written
+static RGBD_AVX2_TARGET int buildRowFromDepthAVX2(const float* depthRow, const float* rayX, float rayY, int xRes, float* x, float* y, float* z)
+{
+	int u = 0;
+	const __m256 minDepth8 = _mm256_set1_ps(0.001f);
+	const __m256 nan8 = _mm256_set1_ps(VMAP_NAN_F);
+	const __m256 rayY8 = _mm256_set1_ps(rayY);
+	for(; u + 8 <= xRes; u += 8)
+	{
+		__m256 d = _mm256_loadu_ps(depthRow + u);
+		__m256 valid = _mm256_cmp_ps(d, minDepth8, _CMP_GT_OQ);
+		_mm256_storeu_ps(x + u, _mm256_blendv_ps(nan8, _mm256_mul_ps(_mm256_loadu_ps(rayX + u), d), valid));
+		_mm256_storeu_ps(y + u, _mm256_blendv_ps(nan8, _mm256_mul_ps(rayY8, d), valid));
+		_mm256_storeu_ps(z + u, _mm256_blendv_ps(nan8, d, valid));
+	}
+	_mm256_zeroupper();
+	return u;
+}
+#endif
+
+void CpuVertexMapBuilder::buildMirroredRows(const rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int begin, int end, float maxDepth)
+{
+	const int xRes = mXRes;
+	const float* rayX = getRayX();
+#ifdef RGBD_USE_AVX2
+	const bool useAVX2 = rgbd::framework::cpuHasAVX2();
+#endif
+
+	for(int v = begin; v < end; v++)
+	{
+		const uint16_t* src = &depthBuffer[v*xRes].depth;
+		float* x = vmapSOA.x[0] + v*xRes;
+		float* y = vmapSOA.y[0] + v*xRes;
+		float* z = vmapSOA.z[0] + v*xRes;
+		const float rayY = mRayY[v];
+
+		int u = 0;
+#ifdef RGBD_USE_AVX2
+		if(useAVX2)
+			u = buildMirroredRowAVX2(src, rayX, rayY, maxDepth, xRes, x, y, z);
+#endif
+#ifdef RGBD_USE_SSE2
+		const __m128 scale = _mm_set1_ps(0.001f);
+		const __m128 minDepth4 = _mm_set1_ps(0.001f);
+		const __m128 maxDepth4 = _mm_set1_ps(maxDepth);
+		const __m128 nan4 = _mm_set1_ps(VMAP_NAN_F);
+		const __m128 rayY4 = _mm_set1_ps(rayY);
+		const __m128i zero = _mm_setzero_si128();
+		for(; u + 8 <= xRes; u += 8)
+		{
+			//Pixels u..u+7 come from xRes-1-u back to xRes-8-u
+			__m128i raw = reverseDepths(_mm_loadu_si128((const __m128i*) (src + xRes - 8 - u)));
+			__m128 d[2];
+			d[0] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(raw, zero)), scale);
+			d[1] = _mm_mul_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(raw, zero)), scale);
+			for(int half = 0; half < 2; half++)
+			{
+				int i = u + half*4;
+				__m128 valid = _mm_and_ps(_mm_cmpgt_ps(d[half], minDepth4), _mm_cmplt_ps(d[half], maxDepth4));
+				__m128 invalidNaN = _mm_andnot_ps(valid, nan4);
+				_mm_storeu_ps(x + i, _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(_mm_loadu_ps(rayX + i), d[half])), invalidNaN));
+				_mm_storeu_ps(y + i, _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(rayY4, d[half])), invalidNaN));
+				_mm_storeu_ps(z + i, _mm_or_ps(_mm_and_ps(valid, d[half]), invalidNaN));
+			}
+		}
+#endif
+		for(; u < xRes; u++)
+		{
+			float d = src[xRes - 1 - u] * 0.001f;
+			//Exclude zero or negative depths.
+			bool valid = d > 0.001f && d < maxDepth;
+			x[u] = valid ? rayX[u] * d : VMAP_NAN_F;
+			y[u] = valid ? rayY * d : VMAP_NAN_F;
+			z[u] = valid ? d : VMAP_NAN_F;
+		}
+	}
+}
+
+void CpuVertexMapBuilder::buildRowFromDepth(const float* depthRow, Float3SOAPyramid vmapSOA, int v)
+{
+	const int xRes = mXRes;
+	const float* rayX = getRayX();
+	float* x = vmapSOA.x[0] + v*xRes;
+	float* y = vmapSOA.y[0] + v*xRes;
+	float* z = vmapSOA.z[0] + v*xRes;
+	const float rayY = mRayY[v];
+
+	int u = 0;
+#ifdef RGBD_USE_AVX2
+	if(rgbd::framework::cpuHasAVX2())
+		u = buildRowFromDepthAVX2(depthRow, rayX, rayY, xRes, x, y, z);
+#endif
+#ifdef RGBD_USE_SSE2
+	const __m128 minDepth4 = _mm_set1_ps(0.001f);
+	const __m128 nan4 = _mm_set1_ps(VMAP_NAN_F);
+	const __m128 rayY4 = _mm_set1_ps(rayY);
+	for(; u + 4 <= xRes; u += 4)
+	{
+		__m128 d = _mm_loadu_ps(depthRow + u);
+		__m128 valid = _mm_cmpgt_ps(d, minDepth4);
+		__m128 invalidNaN = _mm_andnot_ps(valid, nan4);
+		_mm_storeu_ps(x + u, _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(_mm_loadu_ps(rayX + u), d)), invalidNaN));
+		_mm_storeu_ps(y + u, _mm_or_ps(_mm_and_ps(valid, _mm_mul_ps(rayY4, d)), invalidNaN));
+		_mm_storeu_ps(z + u, _mm_or_ps(_mm_and_ps(valid, d), invalidNaN));
+	}
+#endif
+	for(; u < xRes; u++)
+	{
+		float d = depthRow[u];
+		//Exclude zero or negative depths.
+		bool valid = d > 0.001f;
+		x[u] = valid ? rayX[u] * d : VMAP_NAN_F;
+		y[u] = valid ? rayY * d : VMAP_NAN_F;
+		z[u] = valid ? d : VMAP_NAN_F;
+	}
+}
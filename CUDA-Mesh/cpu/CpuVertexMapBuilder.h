@@ -0,0 +1,49 @@
+#pragma once
+#include "device_structs.h"
+#include "RGBDFrame.h"
+#include "Calibration.h"
+#include "SIMDUtils.h"
+#include <vector>
+
+using namespace std;
+
+/*
+*	Class CpuVertexMapBuilder
+*	Turns depth images into vertex maps on the host. The ray direction of every pixel only depends on its column and row,
+*	so (u-cx)/fx and (v-cy)/fy are kept in one table per axis and rebuilt only when the intrinsics or resolution change.
+*	Each row is then a single pass of loads, one multiply per axis and stores, 8 pixels at a time with AVX2 or SSE2.
+*	z matches the kernels exactly. x and y are ray*d instead of (u-cx)*d/fx and differ from the kernels by at most 2 ulp.
+*/
+class CpuVertexMapBuilder
+{
+private:
+	//Make this class non construction-copyable
+	CpuVertexMapBuilder( const CpuVertexMapBuilder& other );
+	CpuVertexMapBuilder& operator=( const CpuVertexMapBuilder& );
+protected:
+	rgbd::framework::Intrinsics mIntr;
+	int mXRes;
+	int mYRes;
+
+	//(u-cx)/fx for each column, (v-cy)/fy for each row
+	vector<float> mRayX;
+	vector<float> mRayY;
+public:
+	CpuVertexMapBuilder(void);
+
+	//Rebuilds the ray tables if intrinsics or resolution differ from the last call. Not thread safe
+	void setCamera(rgbd::framework::Intrinsics intr, int xRes, int yRes);
+
+	inline const float* getRayX(){return mRayX.empty() ? NULL : &mRayX[0];}
+	inline const float* getRayY(){return mRayY.empty() ? NULL : &mRayY[0];}
+
+	//Builds rows [begin, end) of the level 0 vertex map like buildVMapNoFilterKernel. Depth rows are read mirrored in X.
+	//Depths of 1mm or less or at least maxDepth become NaN.
+	//Call setCamera first. Safe to call from several threads for disjoint rows
+	void buildMirroredRows(const rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int begin, int end, float maxDepth);
+
+	//Writes row v of the level 0 vertex map from a row of metric depths that is already filtered and not mirrored.
+	//Depths of 1mm or less (or NaN) become NaN, like the filter kernels' final step.
+	//Safe to call from several threads for different rows
+	void buildRowFromDepth(const float* depthRow, Float3SOAPyramid vmapSOA, int v);
+};
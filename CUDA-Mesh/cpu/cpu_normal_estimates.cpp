@@ -0,0 +1,228 @@
+#include "CpuMeshBackend.h"
+#include <algorithm>
+#include <cmath>
+
+#pragma region Simple Normals Calculation
+void CpuMeshBackend::simpleNormals(Float3SOAPyramid vmap, Float3SOAPyramid nmap, int /*numLevels*/, int xRes, int yRes)
+{
+	const float* x_vert = vmap.x[0];
+	const float* y_vert = vmap.y[0];
+	const float* z_vert = vmap.z[0];
+	float* x_norm = nmap.x[0];
+	float* y_norm = nmap.y[0];
+	float* z_norm = nmap.z[0];
+
+	mPool.parallelFor(yRes, mPool.grainFor(yRes), [&](int begin, int end){
+		for(int v = begin; v < end; v++)
+		{
+			int row = v*xRes;
+			if(v == 0 || v == yRes - 1)
+			{
+				fill(x_norm + row, x_norm + row + xRes, CPU_NAN_F);
+				fill(y_norm + row, y_norm + row + xRes, CPU_NAN_F);
+				fill(z_norm + row, z_norm + row + xRes, CPU_NAN_F);
+				continue;
+			}
+
+			x_norm[row] = y_norm[row] = z_norm[row] = CPU_NAN_F;
+			x_norm[row + xRes - 1] = y_norm[row + xRes - 1] = z_norm[row + xRes - 1] = CPU_NAN_F;
+			for(int u = 1; u < xRes - 1; u++)
+			{
+				int i = row + u;
+
+				//Diff to right
+				float dx1 = x_vert[i+1] - x_vert[i-1];
+				float dy1 = y_vert[i+1] - y_vert[i-1];
+				float dz1 = z_vert[i+1] - z_vert[i-1];
+
+				//Diff to bottom
+				float dx2 = x_vert[i+xRes] - x_vert[i-xRes];
+				float dy2 = y_vert[i+xRes] - y_vert[i-xRes];
+				float dz2 = z_vert[i+xRes] - z_vert[i-xRes];
+
+				//d1 cross d2
+				float nx = dy1*dz2-dz1*dy2;
+				float ny = dz1*dx2-dx1*dz2;
+				float nz = dx1*dy2-dy1*dx2;
+
+				//if n dot p > 0, flip towards viewpoint
+				float s = (nx*x_vert[i] + ny*y_vert[i] + nz*z_vert[i] > 0.0f) ? -1.0f : 1.0f;
+				s /= sqrtf(nx*nx + ny*ny + nz*nz);
+
+				x_norm[i] = nx*s;
+				y_norm[i] = ny*s;
+				z_norm[i] = nz*s;
+			}
+		}
+	});
+}
+#pragma endregion
+
+#pragma region Gradients
+void CpuMeshBackend::horizontalGradient(float* image_in, float* gradient_out, int width, int height)
+{
+	mPool.parallelFor(height, mPool.grainFor(height), [&](int begin, int end){
+		for(int v = begin; v < end; v++)
+		{
+			const float* image = image_in + v*width;
+			float* grad = gradient_out + v*width;
+			grad[0] = 0.0f;
+			for(int u = 1; u < width - 1; u++)
+				grad[u] = image[u+1] - image[u-1];
+			grad[width-1] = 0.0f;
+		}
+	});
+}
+
+void CpuMeshBackend::verticalGradient(float* image_in, float* gradient_out, int width, int height)
+{
+	mPool.parallelFor(height, mPool.grainFor(height), [&](int begin, int end){
+		for(int v = begin; v < end; v++)
+		{
+			float* grad = gradient_out + v*width;
+			if(v == 0 || v == height - 1)
+			{
+				fill(grad, grad + width, 0.0f);
+				continue;
+			}
+
+			const float* up = image_in + (v-1)*width;
+			const float* down = image_in + (v+1)*width;
+			for(int u = 0; u < width; u++)
+				grad[u] = down[u] - up[u];
+		}
+	});
+}
+#pragma endregion
+
+#pragma region Seperable Kernel
+void CpuMeshBackend::setSeperableKernelGaussian(float sigma)
+{
+	for(int i = -CPU_SEPERABLE_KERNEL_RADIUS; i <= CPU_SEPERABLE_KERNEL_RADIUS; ++i)
+	{
+		mSeperableKernel[i+CPU_SEPERABLE_KERNEL_RADIUS] = expf(-i*i/(2*sigma));
+	}
+}
+
+//Row pass. Same weighting as seperableKernelRows, which counts every tap once and valid taps a second time.
+//Samples outside the image are 0 and count as valid. A NaN center gives NaN
+static void seperableRows(const float* in, float* out, int xRes, int begin, int end, const float* kernel)
+{
+	const int R = CPU_SEPERABLE_KERNEL_RADIUS;
+	vector<float> padded(xRes + 2*R, 0.0f);
+	float* row = &padded[R];
+	for(int v = begin; v < end; v++)
+	{
+		copy(in + v*xRes, in + (v+1)*xRes, row);
+		float* dest = out + v*xRes;
+		for(int u = 0; u < xRes; u++)
+		{
+			float sum = 0.0f;
+			float weightAccum = 0.0f;
+			for(int j = -R; j <= R; j++)
+			{
+				float x = row[u+j];
+				float w = kernel[R - j];
+				bool valid = !(x != x);
+				weightAccum += valid ? 2.0f*w : w;
+				sum += valid ? w*x : 0.0f;
+			}
+			//Pixels with invalid vertex data don't filter results
+			dest[u] = (row[u] != row[u]) ? CPU_NAN_F : sum/weightAccum;
+		}
+	}
+}
+
+//Column pass. Only valid taps are counted, rows outside the image are 0
+static void seperableCols(const float* in, float* out, int xRes, int yRes, int begin, int end, const float* kernel)
+{
+	const int R = CPU_SEPERABLE_KERNEL_RADIUS;
+	vector<float> sumRow(xRes);
+	vector<float> weightRow(xRes);
+	float* sum = &sumRow[0];
+	float* weightAccum = &weightRow[0];
+	for(int v = begin; v < end; v++)
+	{
+		fill(sumRow.begin(), sumRow.end(), 0.0f);
+		fill(weightRow.begin(), weightRow.end(), 0.0f);
+
+		//Out of image taps are valid zeros
+		for(int j = -R; j <= R; j++)
+		{
+			if(v+j < 0 || v+j >= yRes)
+			{
+				float w = kernel[R - j];
+				for(int u = 0; u < xRes; u++)
+					weightAccum[u] += w;
+			}
+		}
+
+		for(int j = max(-R, -v); j <= min(R, yRes - 1 - v); j++)
+		{
+			const float* src = in + (v+j)*xRes;
+			float w = kernel[R - j];
+			for(int u = 0; u < xRes; u++)
+			{
+				float x = src[u];
+				bool valid = !(x != x);
+				weightAccum[u] += valid ? w : 0.0f;
+				sum[u] += valid ? w*x : 0.0f;
+			}
+		}
+
+		const float* center = in + v*xRes;
+		float* dest = out + v*xRes;
+		for(int u = 0; u < xRes; u++)
+			dest[u] = (center[u] != center[u]) ? CPU_NAN_F : sum[u]/weightAccum[u];
+	}
+}
+
+void CpuMeshBackend::seperableFilter(float* x, float* y, float* z, float* x_out, float* y_out, float* z_out, int xRes, int yRes)
+{
+	//The column kernels run in place on the outputs. Keeping the row results apart avoids reading half filtered data
+	float* rowPass[3] = {getScratch(0, xRes*yRes), getScratch(1, xRes*yRes), getScratch(2, xRes*yRes)};
+	float* in[3] = {x, y, z};
+	float* out[3] = {x_out, y_out, z_out};
+	const float* kernel = mSeperableKernel;
+
+	mPool.parallelFor(yRes, mPool.grainFor(yRes), [&](int begin, int end){
+		for(int c = 0; c < 3; c++)
+			seperableRows(in[c], rowPass[c], xRes, begin, end, kernel);
+	});
+	mPool.parallelFor(yRes, mPool.grainFor(yRes), [&](int begin, int end){
+		for(int c = 0; c < 3; c++)
+			seperableCols(rowPass[c], out[c], xRes, yRes, begin, end, kernel);
+	});
+}
+#pragma endregion
+
+#pragma region Filtered Average Gradient
+void CpuMeshBackend::computeAverageGradientNormals(Float3SOAPyramid horizontalGradient, Float3SOAPyramid vertGradient,
+												   Float3SOAPyramid vmap, Float3SOAPyramid nmap, int xRes, int yRes)
+{
+	mPool.parallelFor(yRes, mPool.grainFor(yRes), [&](int begin, int end){
+		for(int i = begin*xRes; i < end*xRes; i++)
+		{
+			float vx = vertGradient.x[0][i];
+			float vy = vertGradient.y[0][i];
+			float vz = vertGradient.z[0][i];
+			float hx = horizontalGradient.x[0][i];
+			float hy = horizontalGradient.y[0][i];
+			float hz = horizontalGradient.z[0][i];
+
+			//vert cross hor
+			float nx = vy*hz - vz*hy;
+			float ny = vz*hx - vx*hz;
+			float nz = vx*hy - vy*hx;
+
+			//if n dot p > 0, flip towards viewpoint
+			float s = (nx*vmap.x[0][i] + ny*vmap.y[0][i] + nz*vmap.z[0][i] > 0.0f) ? -1.0f : 1.0f;
+			s /= sqrtf(nx*nx + ny*ny + nz*nz);
+
+			nmap.x[0][i] = nx*s;
+			nmap.y[0][i] = ny*s;
+			nmap.z[0][i] = nz*s;
+		}
+	});
+}
+#pragma endregion
@@ -0,0 +1,724 @@
+#include "CpuMeshBackend.h"
+#include "Utils.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+#pragma region Helpers
+static int mod_pos(int a, int b)
+{
+	int ret = a % b;
+	if(ret < 0)
+		ret+=b;
+	return ret;
+}
+
+static glm::mat3 outerProduct(float x, float y, float z)
+{
+	return glm::mat3(x*x, x*y, x*z,
+		y*x, y*y, y*z,
+		z*x, z*y, z*z);
+}
+
+static glm::mat3 scatterMatrix(const PlaneStats& stats)
+{
+	return glm::mat3(glm::vec3(stats.Sxx, stats.Sxy, stats.Sxz),
+		glm::vec3(stats.Sxy, stats.Syy, stats.Syz),
+		glm::vec3(stats.Sxz, stats.Syz, stats.Szz));
+}
+
+//Same closed form eigen solver as the device version in plane_segmentation.cu
+static glm::vec3 normalFrom3x3Covar(glm::mat3 A, glm::vec3& eigs)
+{
+	glm::vec3 normal = glm::vec3(0.0f);
+
+	float p1 = A[0][1]*A[0][1] + A[0][2]*A[0][2] + A[1][2]*A[1][2];
+	if (fabsf(p1) < 0.00001f) { // A is diagonal
+		eigs = glm::vec3(A[0][0], A[1][1], A[2][2]);
+
+		// sorting: swap first pair if necessary, then second pair, then first pair again
+		for (int i=0; i<3; i++) {
+			int eig_i = i%2;
+			float tmp = eigs[eig_i];
+			eigs[eig_i] = glm::max(tmp, eigs[eig_i+1]);
+			eigs[eig_i+1] = glm::min(tmp, eigs[eig_i+1]);
+		}
+	} else {
+		float q = (A[0][0] + A[1][1] + A[2][2])/3.0f; // mean(trace(A))
+		float p2 = (A[0][0]-q)*(A[0][0]-q) + (A[1][1]-q)*(A[1][1]-q) + (A[2][2]-q)*(A[2][2]-q)+ 2*p1;
+		float p = sqrtf(p2/6);
+		glm::mat3 B = (1/p) * (A-q*glm::mat3(1.0f));
+		float r = glm::determinant(B)/2;
+		// theoretically -1 <= r <= 1, but clamp in case of numeric error
+		float phi;
+		if (r <= -1) {
+			phi = PI_F / 3;
+		} else if (r >= 1) {
+			phi = 0;
+		} else {
+			phi = glm::acos(r)/3;
+		}
+		eigs[0] = q + 2*p*glm::cos(phi);
+		eigs[2] = q + 2*p*glm::cos(phi + 2*PI_F/3);
+		eigs[1] = 3*q - eigs[0] - eigs[2];
+	}
+
+	//N = (A-eye(3)*eig1)*(A(:,1)-[1;0;0]*eig2);
+	glm::mat3 Aeig1 = A;
+	Aeig1[0][0] -= eigs[0];
+	Aeig1[1][1] -= eigs[0];
+	Aeig1[2][2] -= eigs[0];
+	normal = Aeig1*(A[0] - glm::vec3(eigs[1],0.0f,0.0f));
+
+	float length = glm::length(normal);
+	normal /= length;
+	return normal;
+}
+
+//Index of the maximum of values[0..n), n a power of two, picked the way the kernels' shared memory tree reduction
+//picks it: the first halving keeps the left element on ties, later steps only replace on strictly greater
+static int treeMaxIndex(const int* values, int n, vector<int>& s_max, vector<int>& s_maxI)
+{
+	int halfpoint = n >> 1;
+	if(halfpoint == 0)
+		return 0;
+	s_max.resize(halfpoint);
+	s_maxI.resize(halfpoint);
+	for(int index = 0; index < halfpoint; index++)
+	{
+		int thread2 = index + halfpoint;
+		bool leftSmaller = values[index] < values[thread2];
+		s_max[index] = leftSmaller ? values[thread2] : values[index];
+		s_maxI[index] = leftSmaller ? thread2 : index;
+	}
+	while(halfpoint > 0)
+	{
+		halfpoint >>= 1;
+		for(int index = 0; index < halfpoint; index++)
+		{
+			int thread2 = index + halfpoint;
+			if(s_max[thread2] > s_max[index])
+			{
+				s_max[index] = s_max[thread2];
+				s_maxI[index] = s_maxI[thread2];
+			}
+		}
+	}
+	return s_maxI[0];
+}
+
+//Port of the mergePlanes device routine. Merges t into s if they are close in angle and distance
+static bool mergePlanePair(PlaneStats& s, PlaneStats& t, float mergeAngleThreshCos, float mergeDistThresh)
+{
+	//Two valid planes. Check merging criteria
+	float angleDot = fabsf(glm::dot(s.norm, t.norm));
+	if(!(angleDot > mergeAngleThreshCos))
+		return false;
+
+	//Angle match. Check distance
+	glm::vec3 centroidDist = s.centroid - t.centroid;
+	float d1 = fabsf(glm::dot(s.norm, centroidDist));
+	float d2 = fabsf(glm::dot(t.norm, centroidDist));
+	if(!(glm::min(d1, d2) < mergeDistThresh))
+		return false;
+
+	//Combine counts
+	float count_m = s.count + t.count;
+	//Weighted centroid average
+	glm::vec3 mergedCentroid = 1.0f/count_m * (s.count*s.centroid + t.count*t.centroid);
+	//Merged S2 centroid component
+	glm::mat3 Sm2 = outerProduct(mergedCentroid.x, mergedCentroid.y, mergedCentroid.z);
+	//Compute merged S1_n
+	glm::mat3 Sm1_n = s.count/count_m * scatterMatrix(s) + t.count/count_m * scatterMatrix(t);
+
+	//Compute combined normalized scatter matrix and find normals
+	glm::vec3 eigs;
+	glm::vec3 norm = normalFrom3x3Covar(Sm1_n - Sm2, eigs);
+
+	//if n dot p > 0, flip towards viewpoint
+	if(glm::dot(norm, mergedCentroid) > 0.0f)
+		norm = -norm;
+
+	s.count = count_m;
+	s.centroid = mergedCentroid;
+	s.Sxx = Sm1_n[0][0];
+	s.Syy = Sm1_n[1][1];
+	s.Szz = Sm1_n[2][2];
+	s.Sxy = Sm1_n[0][1];
+	s.Syz = Sm1_n[1][2];
+	s.Sxz = Sm1_n[0][2];
+	s.norm = norm;
+	s.eigs = eigs;
+
+	t.count = 0.0f;
+	t.centroid = glm::vec3(0.0f);
+	t.Sxx = t.Syy = t.Szz = t.Sxy = t.Syz = t.Sxz = 0.0f;
+	t.norm = glm::vec3(0.0f);
+	t.eigs = glm::vec3(0.0f);
+	return true;
+}
+#pragma endregion
+
+#pragma region Histogram Two-D
+void CpuMeshBackend::clearHistogram(int* histogram, int xBins, int yBins)
+{
+	memset(histogram, 0, xBins*yBins*sizeof(int));
+}
+
+void CpuMeshBackend::computeNormalHistogram(float* normX, float* normY, float* normZ, int* finalSegmentsBuffer, int* histogram,
+											int xRes, int yRes, int xBins, int yBins, bool excludePreviousSegments)
+{
+	//One partial histogram per chunk, summed afterwards
+	int histLength = xBins*yBins;
+	int grain = mPool.grainFor(yRes);
+	int chunks = (yRes + grain - 1)/grain;
+	vector<int> partials(chunks*histLength, 0);
+
+	mPool.parallelFor(yRes, grain, [&](int begin, int end){
+		int* hist = &partials[(begin/grain)*histLength];
+		for(int i = begin*xRes; i < end*xRes; i++)
+		{
+			float x = normX[i];
+			float y = normY[i];
+			float z = normZ[i];
+			bool unsegmented = excludePreviousSegments?(finalSegmentsBuffer[i] == -1):true;
+
+			if(x == x && y == y && z == z && unsegmented)//Will be false if NaN
+			{
+				//Project down into the unit hemisphere
+				if(z < 0.0f)
+				{
+					x = -x;
+					y = -y;
+				}
+
+				int xI = deviceFloatToInt(acosf(x)*PI_INV_F*xBins);
+				int yI = deviceFloatToInt(acosf(y)*PI_INV_F*yBins);
+				int bin = yI*xBins + xI;
+				if(bin >= 0 && bin < histLength)
+					hist[bin]++;
+			}
+		}
+	});
+
+	for(int c = 0; c < chunks; c++)
+		for(int b = 0; b < histLength; b++)
+			histogram[b] += partials[c*histLength + b];
+}
+#pragma endregion
+
+#pragma region Histogram Peak Detection Two-D
+void CpuMeshBackend::normalHistogramPrimaryPeakDetection(int* histogram, int xBins, int yBins, Float3SOA peaks, int maxPeaks,
+														 int exclusionRadius, int minPeakHeight, float previousPeaksClearRadius)
+{
+	int histLength = xBins*yBins;
+	vector<int> hist(histogram, histogram + histLength);
+
+	//Clear around the peaks of the previous round
+	for(int index = 0; index < histLength; index++)
+	{
+		int bx = index % xBins;
+		int by = index / xBins;
+		for(int p = 0; p < maxPeaks; ++p)
+		{
+			int px = deviceFloatToInt(peaks.x[p]);
+			int py = deviceFloatToInt(peaks.y[p]);
+			int dx = min(mod_pos(px - bx, xBins), mod_pos(bx - px, xBins));//shortest path to peak (wraps around)
+			int dy = min(mod_pos(py - by, yBins), mod_pos(by - py, yBins));
+			if(dx*dx+dy*dy <= previousPeaksClearRadius*previousPeaksClearRadius)
+				hist[index] = 0;
+		}
+	}
+
+	//3x3 weighted mean position around each bin
+	vector<float> totalCount(histLength), xPos(histLength), yPos(histLength);
+	for(int index = 0; index < histLength; index++)
+	{
+		int bx = index % xBins;
+		int by = index / xBins;
+		float count = 0.0f;
+		float sx = 0.0f;
+		float sy = 0.0f;
+		for(int x = -1; x <= 1; ++x)
+		{
+			int tx = bx + x;
+			for(int y = -1; y <= 1; ++y)
+			{
+				int ty = by + y;
+				int binCount = hist[mod_pos(tx, xBins) + mod_pos(ty, yBins)*xBins];//wrap histogram index
+				count += binCount;
+				sx += binCount*tx;
+				sy += binCount*ty;
+			}
+		}
+		if(count > 0)
+		{
+			sx /= count;
+			sy /= count;
+		}
+		totalCount[index] = count;
+		xPos[index] = sx;
+		yPos[index] = sy;
+	}
+
+	//=========Peak detection Loop===========
+	vector<int> s_max, s_maxI;
+	for(int peakNum = 0; peakNum < maxPeaks; ++peakNum)
+	{
+		int maxI = treeMaxIndex(&hist[0], histLength, s_max, s_maxI);
+		if(hist[maxI] < minPeakHeight)
+		{
+			//Fill remaining slots with NAN
+			for(int p = peakNum; p < maxPeaks; p++)
+			{
+				peaks.x[p] = CPU_NAN_F;
+				peaks.y[p] = CPU_NAN_F;
+				peaks.z[p] = 0;
+			}
+			break;
+		}
+
+		peaks.x[peakNum] = xPos[maxI];
+		peaks.y[peakNum] = yPos[maxI];
+		peaks.z[peakNum] = totalCount[maxI];
+		histogram[maxI] = -(peakNum+1);
+
+		//Exclude around the new peak. Row index uses yBins like the kernel
+		int px = maxI % xBins;
+		int py = maxI / yBins;
+		for(int index = 0; index < histLength; index++)
+		{
+			int bx = index % xBins;
+			int by = index / xBins;
+			int dx = min(mod_pos(px - bx, xBins), mod_pos(bx - px, xBins));
+			int dy = min(mod_pos(py - by, yBins), mod_pos(by - py, yBins));
+			if(dx*dx+dy*dy < exclusionRadius*exclusionRadius)
+				hist[index] = 0;
+		}
+	}
+}
+#pragma endregion
+
+#pragma region Segmentation Two-D
+void CpuMeshBackend::segmentNormals2D(Float3SOA rawNormals, Float3SOA rawPositions,
+									  int* normalSegments, float* projectedDistance, int imageWidth, int imageHeight,
+									  int* /*histogram*/, int xBins, int yBins, Float3SOA peaks, int maxPeaks, float maxAngleRange)
+{
+	vector<glm::vec3> peakNormals(maxPeaks, glm::vec3(0.0f));
+	for(int p = 0; p < maxPeaks; p++)
+	{
+		float xi = peaks.x[p];
+		float yi = peaks.y[p];
+		if(xi == xi && yi == yi)
+		{
+			float x = cosf(xi*PI_F/xBins);
+			float y = cosf(yi*PI_F/yBins);
+			peakNormals[p] = glm::vec3(x, y, sqrtf(1-x*x-y*y));
+		}
+	}
+
+	mPool.parallelFor(imageHeight, mPool.grainFor(imageHeight), [&](int begin, int end){
+		for(int index = begin*imageWidth; index < end*imageWidth; index++)
+		{
+			glm::vec3 normal = glm::vec3(rawNormals.x[index], rawNormals.y[index], rawNormals.z[index]);
+			int bestPeak = -1;
+			if(normal.x == normal.x && normal.y == normal.y && normal.z == normal.z)
+			{
+				for(int peakNum = 0; peakNum < maxPeaks; ++peakNum)
+				{
+					float angle = acosf(fabsf(glm::dot(normal, peakNormals[peakNum])));
+					if(angle < maxAngleRange)
+					{
+						bestPeak = peakNum;
+						break;
+					}
+				}
+			}
+
+			float projectedD = CPU_NAN_F;
+			if(bestPeak >= 0)
+			{
+				glm::vec3 pos = glm::vec3(rawPositions.x[index], rawPositions.y[index], rawPositions.z[index]);
+				projectedD = fabsf(glm::dot(peakNormals[bestPeak], pos));
+			}
+
+			normalSegments[index] = bestPeak;
+			projectedDistance[index] = projectedD;
+		}
+	});
+}
+#pragma endregion
+
+#pragma region Distance Histograms
+void CpuMeshBackend::generateDistanceHistograms(int* normalSegments, float* planeProjectedDistanceMap, int xRes, int yRes,
+												int** distanceHistograms, int numMaxNormalSegments, int histcount, float histMinDist, float histMaxDist)
+{
+	int* histograms = distanceHistograms[0];
+	int totalLength = numMaxNormalSegments*histcount;
+	int grain = mPool.grainFor(yRes);
+	int chunks = (yRes + grain - 1)/grain;
+	vector<int> partials(chunks*totalLength, 0);
+
+	mPool.parallelFor(yRes, grain, [&](int begin, int end){
+		int* hist = &partials[(begin/grain)*totalLength];
+		for(int index = begin*xRes; index < end*xRes; index++)
+		{
+			int segment = normalSegments[index];
+			float dist = planeProjectedDistanceMap[index];
+			if(segment >= 0 && segment < numMaxNormalSegments && dist < histMaxDist && dist >= histMinDist)
+			{
+				int histI = deviceFloatToInt((dist - histMinDist)*histcount/(histMaxDist-histMinDist));
+				if(histI < histcount)
+					hist[segment*histcount + histI]++;
+			}
+		}
+	});
+
+	for(int c = 0; c < chunks; c++)
+		for(int b = 0; b < totalLength; b++)
+			histograms[b] += partials[c*totalLength + b];
+}
+
+void CpuMeshBackend::distanceHistogramPrimaryPeakDetection(int* histogram, int length, int numHistograms, float* distPeaks, int maxDistPeaks,
+														   int exclusionRadius, int minPeakHeight, float minHistDist, float maxHistDist)
+{
+	mPool.parallelFor(numHistograms, 1, [&](int begin, int end){
+		vector<int> s_max, s_maxI;
+		for(int b = begin; b < end; b++)
+		{
+			vector<int> hist(histogram + b*length, histogram + (b+1)*length);
+			float* peaks = distPeaks + b*maxDistPeaks;
+			for(int peakNum = 0; peakNum < maxDistPeaks; ++peakNum)
+			{
+				int maxI = treeMaxIndex(&hist[0], length, s_max, s_maxI);
+				if(hist[maxI] < minPeakHeight)
+				{
+					//Fill remaining slots with NaN
+					for(int p = peakNum; p < maxDistPeaks; p++)
+						peaks[p] = CPU_NAN_F;
+					break;
+				}
+
+				peaks[peakNum] = (maxI*(maxHistDist-minHistDist)/float(length)) + minHistDist;
+
+				for(int index = max(maxI - exclusionRadius, 0); index <= min(maxI + exclusionRadius, length - 1); index++)
+					hist[index] = 0;
+			}
+		}
+	});
+}
+#pragma endregion
+
+#pragma region Distance Segmentation
+void CpuMeshBackend::fineDistanceSegmentation(float* distPeaks, int numNormalPeaks, int maxDistPeaks,
+											  Float3SOA positions, PlaneStats* planeStats, int* normalSegments, float* planeProjectedDistanceMap,
+											  int xRes, int yRes, float maxDistTolerance, int iteration)
+{
+	//Per plane: count, centroid xyz, Sxx Syy Szz Sxy Syz Sxz. Accumulated per chunk in double, summed in chunk order
+	const int statCount = 10;
+	int numPlanes = numNormalPeaks*maxDistPeaks;
+	int planeOffset = iteration*numPlanes;
+	int grain = mPool.grainFor(yRes);
+	int chunks = (yRes + grain - 1)/grain;
+	vector<double> partials(chunks*numPlanes*statCount, 0.0);
+
+	mPool.parallelFor(yRes, grain, [&](int begin, int end){
+		double* stats = &partials[(begin/grain)*numPlanes*statCount];
+		for(int index = begin*xRes; index < end*xRes; index++)
+		{
+			int normalSeg = normalSegments[index];
+			if(normalSeg < 0)
+				continue;
+
+			float planeD = fabsf(planeProjectedDistanceMap[index]);
+			float px = positions.x[index];
+			float py = positions.y[index];
+			float pz = positions.z[index];
+
+			//Has a normal segment assignment
+			int bestPlaneIndex = -1;
+			for(int distPeak = 0; distPeak < maxDistPeaks; ++distPeak)
+			{
+				int planeIndex = normalSeg*maxDistPeaks + distPeak;
+				if(fabsf(distPeaks[planeIndex] - planeD) < maxDistTolerance)
+				{
+					bestPlaneIndex = planeIndex;
+					break;
+				}
+			}
+
+			if(bestPlaneIndex >= 0)
+			{
+				double* s = stats + bestPlaneIndex*statCount;
+				s[0] += 1.0;
+				s[1] += px;
+				s[2] += py;
+				s[3] += pz;
+				s[4] += px*px;
+				s[5] += py*py;
+				s[6] += pz*pz;
+				s[7] += px*py;
+				s[8] += py*pz;
+				s[9] += px*pz;
+			}
+
+			normalSegments[index] = bestPlaneIndex;
+		}
+	});
+
+	for(int plane = 0; plane < numPlanes; plane++)
+	{
+		double total[statCount] = {0};
+		for(int c = 0; c < chunks; c++)
+			for(int k = 0; k < statCount; k++)
+				total[k] += partials[(c*numPlanes + plane)*statCount + k];
+
+		PlaneStats& stats = planeStats[plane + planeOffset];
+		stats.count += (float) total[0];
+		stats.centroid.x += (float) total[1];
+		stats.centroid.y += (float) total[2];
+		stats.centroid.z += (float) total[3];
+		stats.Sxx += (float) total[4];
+		stats.Syy += (float) total[5];
+		stats.Szz += (float) total[6];
+		stats.Sxy += (float) total[7];
+		stats.Syz += (float) total[8];
+		stats.Sxz += (float) total[9];
+	}
+}
+
+void CpuMeshBackend::clearPlaneStats(PlaneStats* planeStats, int numNormalPeaks, int numDistPeaks, int maxRounds, int iteration)
+{
+	int numPlanes = numNormalPeaks*numDistPeaks;
+	int first = (iteration < 0) ? 0 : iteration;
+	int last = (iteration < 0) ? maxRounds : iteration + 1;
+	for(int index = first*numPlanes; index < last*numPlanes; index++)
+	{
+		PlaneStats& stats = planeStats[index];
+		stats.count = 0.0f;
+		stats.centroid = glm::vec3(0.0f);
+		stats.norm = glm::vec3(0.0f);
+		stats.tangent = glm::vec3(0.0f);
+		stats.Sxx = stats.Syy = stats.Szz = 0.0f;
+		stats.Sxy = stats.Syz = stats.Sxz = 0.0f;
+	}
+}
+
+void CpuMeshBackend::finalizePlanes(PlaneStats* planeStats, int numNormalPeaks, int numDistPeaks,
+									float mergeAngleThresh, float mergeDistThresh, int iteration)
+{
+	int numPlanes = numNormalPeaks*numDistPeaks;
+	PlaneStats* planes = planeStats + iteration*numPlanes;
+
+	for(int index = 0; index < numPlanes; index++)
+	{
+		PlaneStats& stats = planes[index];
+		int count = deviceFloatToInt(stats.count);
+		stats.count = (float) count;
+
+		//Normalize centroid and scatter matrix
+		stats.centroid /= (float) count;
+		stats.Sxx /= count;
+		stats.Syy /= count;
+		stats.Szz /= count;
+		stats.Sxy /= count;
+		stats.Syz /= count;
+		stats.Sxz /= count;
+
+		glm::vec3 eigs;
+		glm::vec3 norm = normalFrom3x3Covar(scatterMatrix(stats) - outerProduct(stats.centroid.x, stats.centroid.y, stats.centroid.z), eigs);
+
+		//if n dot p > 0, flip towards viewpoint
+		if(glm::dot(norm, stats.centroid) > 0.0f)
+			norm = -norm;
+
+		stats.norm = norm;
+		stats.eigs = eigs;
+	}
+
+	//Individual planes calculated, merge within each normal peak
+	float mergeAngleThreshCos = cos(mergeAngleThresh);
+	for(int normalPeak = 0; normalPeak < numNormalPeaks; ++normalPeak)
+	{
+		PlaneStats* row = planes + normalPeak*numDistPeaks;
+		for(int si = 0; si < numDistPeaks; ++si)
+		{
+			if(row[si].count > 0)
+			{
+				for(int ti = si + 1; ti < numDistPeaks; ++ti)
+				{
+					if(row[ti].count > 0)
+						mergePlanePair(row[si], row[ti], mergeAngleThreshCos, mergeDistThresh);
+				}
+			}
+		}
+	}
+}
+
+void CpuMeshBackend::mergePlanes(PlaneStats* planeStats, int numPlanes, float mergeAngleThresh, float mergeDistThresh)
+{
+	float mergeAngleThreshCos = cos(mergeAngleThresh);
+	for(int si = 0; si < numPlanes; ++si)
+	{
+		if(planeStats[si].count > 0)
+		{
+			for(int ti = si + 1; ti < numPlanes; ++ti)
+			{
+				if(planeStats[ti].count > 0)
+					mergePlanePair(planeStats[si], planeStats[ti], mergeAngleThreshCos, mergeDistThresh);
+			}
+		}
+	}
+}
+
+void CpuMeshBackend::fitFinalPlanes(PlaneStats* planeStats, int numPlanes,
+									Float3SOA norms, Float3SOA positions, int* finalSegmentsBuffer, float* distToPlaneBuffer, int xRes, int yRes,
+									float fitAngleThresh, float fitDistThresh, int iteration)
+{
+	int planeOffset = iteration*numPlanes;
+	vector<glm::vec3> planeNormals(numPlanes);
+	vector<float> planeDists(numPlanes);
+	for(int plane = 0; plane < numPlanes; plane++)
+	{
+		const PlaneStats& stats = planeStats[plane + planeOffset];
+		float validityMultiplier = (deviceFloatToInt(stats.count) > 0) ? 1.0f : CPU_NAN_F;
+		planeNormals[plane] = validityMultiplier*stats.norm;
+		//n dot c = planar offset
+		planeDists[plane] = validityMultiplier*fabsf(glm::dot(stats.centroid, planeNormals[plane]));
+	}
+
+	float fitAngleThreshCos = cos(fitAngleThresh);
+	mPool.parallelFor(yRes, mPool.grainFor(yRes), [&](int begin, int end){
+		for(int index = begin*xRes; index < end*xRes; index++)
+		{
+			float minDist = 1000000.0f;
+			int bestPlane = -1;
+			if(iteration > 0)
+			{
+				//If not first iteration, start from the previous values
+				bestPlane = finalSegmentsBuffer[index];
+				minDist = distToPlaneBuffer[index];
+			}
+
+			glm::vec3 n = glm::vec3(norms.x[index], norms.y[index], norms.z[index]);
+			glm::vec3 p = glm::vec3(positions.x[index], positions.y[index], positions.z[index]);
+			for(int plane = 0; plane < numPlanes; ++plane)
+			{
+				if(planeDists[plane] == planeDists[plane])//Skip non-valid planes
+				{
+					float dotprod = fabsf(glm::dot(n, planeNormals[plane]));
+					if(dotprod > fitAngleThreshCos)
+					{
+						float dist = fabsf(fabsf(glm::dot(p, planeNormals[plane])) - planeDists[plane]);
+						if(dist < fitDistThresh && dist < minDist)
+						{
+							minDist = dist;
+							bestPlane = plane + iteration*numPlanes;
+						}
+					}
+				}
+			}
+
+			finalSegmentsBuffer[index] = bestPlane;
+			distToPlaneBuffer[index] = minDist;
+		}
+	});
+}
+#pragma endregion
+
+void CpuMeshBackend::realignPeaks(PlaneStats* planeStats, Float3SOA normalPeaks, int numNormPeaks, int numDistPeaks,
+								  int xBins, int yBins, int iteration)
+{
+	//Align to the first plane of each normal peak
+	for(int peak = 0; peak < numNormPeaks; peak++)
+	{
+		const PlaneStats& stats = planeStats[peak*numDistPeaks + iteration*numNormPeaks*numDistPeaks];
+		float xI = CPU_NAN_F;
+		float yI = CPU_NAN_F;
+		float count = 0;
+		if(stats.count > 0)
+		{
+			float x = stats.norm.x;
+			float y = stats.norm.y;
+			count = stats.count;
+
+			if(stats.norm.z < 0.0f)
+			{
+				x = -x;
+				y = -y;
+			}
+			xI = acosf(x)*PI_INV_F*xBins;
+			yI = acosf(y)*PI_INV_F*yBins;
+		}
+
+		normalPeaks.x[peak] = xI;
+		normalPeaks.y[peak] = yI;
+		normalPeaks.z[peak] = count;
+	}
+}
+
+#pragma region Plane Compaction
+void CpuMeshBackend::generatePlaneCompressionMap(PlaneStats* planeStats, int numPlanes, int* planeIdMap, int* planeInvIdMap, int* planeCountOut)
+{
+	//Exclusive scan of valid planes
+	int scan = 0;
+	for(int i = 0; i < numPlanes; i++)
+	{
+		if(planeStats[i].count > 0)
+		{
+			planeIdMap[scan] = i;
+			planeInvIdMap[i] = scan;
+			scan++;
+		}else{
+			planeInvIdMap[i] = -1;
+		}
+	}
+	planeCountOut[0] = scan;
+}
+
+void CpuMeshBackend::compactPlaneStats(PlaneStats* planeStats, int numPlanes, int* planeIdMap, int* planeCount)
+{
+	//Gather everything before writing, sources can be overwritten
+	vector<PlaneStats> compacted(numPlanes);
+	for(int index = 0; index < numPlanes; index++)
+	{
+		if(index < planeCount[0])
+		{
+			compacted[index] = planeStats[planeIdMap[index]];
+		}else{
+			compacted[index] = PlaneStats();
+		}
+	}
+	copy(compacted.begin(), compacted.end(), planeStats);
+}
+
+void CpuMeshBackend::computePlaneTangents(PlaneStats* planeStats, int numPlanes, int* planeCount)
+{
+	int count = planeCount[0];
+	for(int index = 0; index < numPlanes; index++)
+	{
+		PlaneStats& stats = planeStats[index];
+		glm::vec3 tangent = glm::vec3(CPU_NAN_F);
+		if(index < count)
+		{
+			//T = (A-eye(3)*eig2)*(A(:,1)-[1;0;0]*eig3);
+			glm::mat3 A = scatterMatrix(stats) - outerProduct(stats.centroid.x, stats.centroid.y, stats.centroid.z);
+			glm::mat3 Aeig2 = A;
+			Aeig2[0][0] -= stats.eigs.y;
+			Aeig2[1][1] -= stats.eigs.y;
+			Aeig2[2][2] -= stats.eigs.y;
+			tangent = Aeig2*(A[0] - glm::vec3(stats.eigs.z,0.0f,0.0f));
+			tangent /= glm::length(tangent);
+
+			//Prefer whichever in plane axis is closer to vertical
+			glm::vec3 bitangent = glm::normalize(glm::cross(stats.norm, tangent));
+			if(fabsf(bitangent.y) > fabsf(tangent.y))
+				tangent = bitangent;
+
+			if(tangent.y < 0)
+				tangent = -tangent;
+		}
+		stats.tangent = tangent;
+	}
+}
+#pragma endregion
@@ -0,0 +1,108 @@
+#include "CpuMeshBackend.h"
+#include <algorithm>
+#include <cmath>
+
+#pragma region VMap No Filter
+void CpuMeshBackend::rgbAOSToSOA(rgbd::framework::ColorPixel* colorPixels, Float3SOAPyramid rgbSOA, int xRes, int yRes)
+{
+	mPool.parallelFor(yRes, mPool.grainFor(yRes), [&](int begin, int end){
+		for(int v = begin; v < end; v++)
+		{
+			const rgbd::framework::ColorPixel* src = colorPixels + v*xRes;
+			//Written mirrored, to match the flipped depth image
+			float* r = rgbSOA.x[0] + v*xRes + xRes - 1;
+			float* g = rgbSOA.y[0] + v*xRes + xRes - 1;
+			float* b = rgbSOA.z[0] + v*xRes + xRes - 1;
+			for(int u = 0; u < xRes; u++)
+			{
+				r[-u] = src[u].r / 255.0f;
+				g[-u] = src[u].g / 255.0f;
+				b[-u] = src[u].b / 255.0f;
+			}
+		}
+	});
+}
+
+void CpuMeshBackend::flipDepthImageXAxis(rgbd::framework::DPixel* depthBuffer, int xRes, int yRes)
+{
+	mPool.parallelFor(yRes, mPool.grainFor(yRes), [&](int begin, int end){
+		for(int v = begin; v < end; v++)
+		{
+			rgbd::framework::DPixel* row = depthBuffer + v*xRes;
+			for(int u = 0; u < xRes/2; u++)
+				swap(row[u].depth, row[xRes - 1 - u].depth);
+		}
+	});
+}
+
+void CpuMeshBackend::buildVMapNoFilter(rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+									   rgbd::framework::Intrinsics intr, float maxDepth)
+{
+	mVMapBuilder.setCamera(intr, xRes, yRes);
+	mPool.parallelFor(yRes, mPool.grainFor(yRes), [&](int begin, int end){
+		mVMapBuilder.buildMirroredRows(depthBuffer, vmapSOA, begin, end, maxDepth);
+	});
+}
+#pragma endregion
+
+void CpuMeshBackend::setGaussianSpatialKernel(float sigma)
+{
+	for(int i = -GAUSSIAN_SPATIAL_FILTER_RADIUS; i <= GAUSSIAN_SPATIAL_FILTER_RADIUS; ++i)
+	{
+		mGaussianSpatialKernel[i+GAUSSIAN_SPATIAL_FILTER_RADIUS] = expf(-i*i/(2*sigma));
+	}
+	mGaussianFilter.setKernel(mGaussianSpatialKernel);
+	mBilateralFilter.setKernel(mGaussianSpatialKernel, sigma);
+}
+
+#pragma region VMap Seperable Filters
+void CpuMeshBackend::buildVMapGaussianFilter(rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+											 rgbd::framework::Intrinsics intr, float maxDepth)
+{
+	mVMapBuilder.setCamera(intr, xRes, yRes);
+	int stripHeight = mGaussianFilter.getStripHeight(xRes);
+	int numStrips = (yRes + stripHeight - 1)/stripHeight;
+	mPool.parallelFor(numStrips, 1, [&](int begin, int end){
+		vector<float> scratch;
+		for(int strip = begin; strip < end; strip++)
+		{
+			mGaussianFilter.filterStrip(depthBuffer, vmapSOA, xRes, yRes, strip*stripHeight, min((strip+1)*stripHeight, yRes),
+				maxDepth, mVMapBuilder, scratch);
+		}
+	});
+}
+
+void CpuMeshBackend::buildVMapBilateralFilter(rgbd::framework::DPixel* depthBuffer, Float3SOAPyramid vmapSOA, int xRes, int yRes,
+											  rgbd::framework::Intrinsics intr, float maxDepth, float sigma_t)
+{
+	mVMapBuilder.setCamera(intr, xRes, yRes);
+	mBilateralFilter.filter(depthBuffer, vmapSOA, xRes, yRes, maxDepth, sigma_t, mVMapBuilder, mPool);
+}
+#pragma endregion
+
+#pragma region VMap Subsampling
+void CpuMeshBackend::subsamplePyramid(Float3SOAPyramid mapSOA, int xRes, int yRes, int numLevels)
+{
+	for(int i = 0; i < numLevels - 1; ++i)
+	{
+		int xRes_src = xRes >> i;
+		int xRes_dest = xRes >> (i+1);
+		int yRes_dest = yRes >> (i+1);
+		float* src[3] = {mapSOA.x[i], mapSOA.y[i], mapSOA.z[i]};
+		float* dest[3] = {mapSOA.x[i+1], mapSOA.y[i+1], mapSOA.z[i+1]};
+
+		mPool.parallelFor(yRes_dest, mPool.grainFor(yRes_dest), [&](int begin, int end){
+			for(int c = 0; c < 3; c++)
+			{
+				for(int v = begin; v < end; v++)
+				{
+					const float* s = src[c] + (v<<1)*xRes_src;
+					float* d = dest[c] + v*xRes_dest;
+					for(int u = 0; u < xRes_dest; u++)
+						d[u] = s[u<<1];
+				}
+			}
+		});
+	}
+}
+#pragma endregion
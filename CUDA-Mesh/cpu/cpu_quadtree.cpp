@@ -0,0 +1,524 @@
+#include "CpuMeshBackend.h"
+#include "quadtree.h"
+#include <algorithm>
+#include <cmath>
+
+#define QUADTREE_TILE_SIZE	16
+
+static int roundupnextpow2(int x)
+{
+	if (x < 0)
+		return 0;
+	--x;
+	x |= x >> 1;
+	x |= x >> 2;
+	x |= x >> 4;
+	x |= x >> 8;
+	x |= x >> 16;
+	return x+1;
+}
+
+#pragma region AABBs
+void CpuMeshBackend::computeAABBs(PlaneStats* planeStats, int* planeInvIdMap, glm::vec4* aabbsBlockResults,
+								  int* planeCount, int /*maxPlanes*/, Float3SOA positions, float* segmentProjectedSx, float* segmentProjectedSy,
+								  int* finalSegmentsBuffer, int xRes, int yRes)
+{
+	int numPlanes = planeCount[0];
+	vector<glm::vec3> tangents(numPlanes), bitangents(numPlanes), centroids(numPlanes);
+	for(int plane = 0; plane < numPlanes; plane++)
+	{
+		tangents[plane] = planeStats[plane].tangent;
+		centroids[plane] = planeStats[plane].centroid;
+		//bitangent = norm cross tangent
+		bitangents[plane] = glm::normalize(glm::cross(planeStats[plane].norm, tangents[plane]));
+	}
+
+	//Same blocks as the kernel, so the per block results line up
+	int blocksX = (xRes + AABB_COMPUTE_BLOCKWIDTH - 1)/AABB_COMPUTE_BLOCKWIDTH;
+	int blocksY = (yRes + AABB_COMPUTE_BLOCKHEIGHT - 1)/AABB_COMPUTE_BLOCKHEIGHT;
+	int numBlocks = blocksX*blocksY;
+
+	mPool.parallelFor(blocksY, mPool.grainFor(blocksY), [&](int begin, int end){
+		vector<glm::vec4> blockAABB(numPlanes);
+		vector<int> blockPixels(numPlanes);
+		for(int by = begin; by < end; by++)
+		{
+			int y0 = by*AABB_COMPUTE_BLOCKHEIGHT;
+			int y1 = min(y0 + AABB_COMPUTE_BLOCKHEIGHT, yRes);
+
+			//Remap segments and project onto the plane axes
+			for(int y = y0; y < y1; y++)
+			{
+				for(int x = 0; x < xRes; x++)
+				{
+					int i = x + y*xRes;
+					int segment = finalSegmentsBuffer[i];
+					float sx = 0;
+					float sy = 0;
+					if(segment >= 0)
+					{
+						segment = planeInvIdMap[segment];
+						finalSegmentsBuffer[i] = segment;
+						if(segment >= 0 && segment < numPlanes)
+						{
+							glm::vec3 dp = glm::vec3(positions.x[i], positions.y[i], positions.z[i]) - centroids[segment];
+							sx = glm::dot(dp, bitangents[segment]);
+							sy = glm::dot(dp, tangents[segment]);
+						}
+					}
+					segmentProjectedSx[i] = sx;
+					segmentProjectedSy[i] = sy;
+				}
+			}
+
+			//Min and max of each plane in each block. Other pixels of a block take part as 0 like in the kernel
+			for(int bx = 0; bx < blocksX; bx++)
+			{
+				int x0 = bx*AABB_COMPUTE_BLOCKWIDTH;
+				int x1 = min(x0 + AABB_COMPUTE_BLOCKWIDTH, xRes);
+				fill(blockPixels.begin(), blockPixels.end(), 0);
+				for(int y = y0; y < y1; y++)
+				{
+					for(int x = x0; x < x1; x++)
+					{
+						int i = x + y*xRes;
+						int segment = finalSegmentsBuffer[i];
+						if(segment < 0 || segment >= numPlanes)
+							continue;
+						float sx = segmentProjectedSx[i];
+						float sy = segmentProjectedSy[i];
+						glm::vec4& aabb = blockAABB[segment];
+						if(blockPixels[segment]++ == 0)
+						{
+							aabb = glm::vec4(sx, sx, sy, sy);
+						}else{
+							aabb = glm::vec4(MIN(aabb.x, sx), MAX(aabb.y, sx), MIN(aabb.z, sy), MAX(aabb.w, sy));
+						}
+					}
+				}
+
+				int blockSize = (x1-x0)*(y1-y0);
+				int blockIndex = bx + by*blocksX;
+				for(int plane = 0; plane < numPlanes; plane++)
+				{
+					glm::vec4 aabb = glm::vec4(0.0f);
+					if(blockPixels[plane] > 0)
+					{
+						aabb = blockAABB[plane];
+						if(blockPixels[plane] < blockSize)
+							aabb = glm::vec4(MIN(aabb.x, 0.0f), MAX(aabb.y, 0.0f), MIN(aabb.z, 0.0f), MAX(aabb.w, 0.0f));
+					}
+					aabbsBlockResults[blockIndex + plane*numBlocks] = aabb;
+				}
+			}
+		}
+	});
+
+	//Combine blocks. The kernel reduces a power of two that pads with zeros when there are fewer blocks
+	int pow2Blocks = roundupnextpow2(numBlocks) >> 1;
+	bool padded = 2*pow2Blocks > numBlocks;
+	for(int plane = 0; plane < numPlanes; plane++)
+	{
+		glm::vec4 aabb = aabbsBlockResults[plane*numBlocks];
+		for(int b = 1; b < numBlocks; b++)
+		{
+			glm::vec4 block = aabbsBlockResults[b + plane*numBlocks];
+			aabb = glm::vec4(MIN(aabb.x, block.x), MAX(aabb.y, block.y), MIN(aabb.z, block.z), MAX(aabb.w, block.w));
+		}
+		if(padded)
+			aabb = glm::vec4(MIN(aabb.x, 0.0f), MAX(aabb.y, 0.0f), MIN(aabb.z, 0.0f), MAX(aabb.w, 0.0f));
+		planeStats[plane].projParams.aabbMeters = aabb;
+	}
+}
+#pragma endregion
+
+#pragma region Texture Projection
+void CpuMeshBackend::calculateProjectionData(rgbd::framework::Intrinsics intr, PlaneStats* planeStats,
+											 int* planeCount, int maxTextureSize, int maxPlanes, int /*xRes*/, int /*yRes*/)
+{
+	for(int plane = 0; plane < maxPlanes; plane++)
+	{
+		glm::mat3 C(1.0f);
+		int destWidth  = 0;
+		int destHeight = 0;
+		int maxRatio = 0;
+		glm::vec4 aabb = planeStats[plane].projParams.aabbMeters;
+		if(plane < planeCount[0])
+		{
+			glm::vec3 tangent = planeStats[plane].tangent;
+			glm::vec3 normal = planeStats[plane].norm;
+			glm::vec3 bitangent = glm::normalize(glm::cross(normal, tangent));
+			glm::vec3 centroid = planeStats[plane].centroid;
+
+			//Camera space corners, clockwise from viewpoint
+			glm::vec3 sp1 = (aabb.x*bitangent)+(aabb.z*tangent)+centroid;//UL, Sxmin,Symin
+			glm::vec3 sp2 = (aabb.y*bitangent)+(aabb.z*tangent)+centroid;//UR, Sxmax,Symin
+			glm::vec3 sp3 = (aabb.y*bitangent)+(aabb.w*tangent)+centroid;//LR, Sxmax,Symax
+			glm::vec3 sp4 = (aabb.x*bitangent)+(aabb.w*tangent)+centroid;//LL, Sxmin,Symax
+
+			//Screen space projections
+			float su1 = sp1.x*intr.fx/sp1.z + intr.cx;
+			float sv1 = sp1.y*intr.fy/sp1.z + intr.cy;
+			float su2 = sp2.x*intr.fx/sp2.z + intr.cx;
+			float sv2 = sp2.y*intr.fy/sp2.z + intr.cy;
+			float su3 = sp3.x*intr.fx/sp3.z + intr.cx;
+			float sv3 = sp3.y*intr.fy/sp3.z + intr.cy;
+			float su4 = sp4.x*intr.fx/sp4.z + intr.cx;
+			float sv4 = sp4.y*intr.fy/sp4.z + intr.cy;
+
+			float sourceWidthMeters = aabb.y-aabb.x;
+			float sourceHeightMeters = aabb.w-aabb.z;
+
+			//Minimum resolution for complete data preservation
+			float d12 = sqrtf((su1-su2)*(su1-su2)+(sv1-sv2)*(sv1-sv2));
+			float d23 = sqrtf((su2-su3)*(su2-su3)+(sv2-sv3)*(sv2-sv3));
+			float d34 = sqrtf((su3-su4)*(su3-su4)+(sv3-sv4)*(sv3-sv4));
+			float d41 = sqrtf((su4-su1)*(su4-su1)+(sv4-sv1)*(sv4-sv1));
+			float maxXRatio = MAX(d12,d34)/sourceWidthMeters;
+			float maxYRatio = MAX(d23,d41)/sourceHeightMeters;
+
+			maxRatio = deviceFloatToInt(ceilf(MAX(maxXRatio,maxYRatio)));
+			maxRatio = roundupnextpow2(maxRatio);
+
+			destWidth  = deviceFloatToInt(maxRatio * sourceWidthMeters);
+			destHeight = deviceFloatToInt(maxRatio * sourceHeightMeters);
+
+			//Make sure it fits. If not, then scale down
+			if(destWidth > maxTextureSize || destHeight > maxTextureSize)
+			{
+				int scale = deviceFloatToInt(glm::max(ceilf(destWidth/float(maxTextureSize)),ceilf(destHeight/float(maxTextureSize))));
+				scale = roundupnextpow2(scale);
+				destWidth/=scale;
+				destHeight/=scale;
+			}
+
+			//A matrix (source points to basis vectors)
+			glm::mat3 A = glm::mat3(su1,sv1,1,su2,sv2,1,su3,sv3,1);
+			glm::vec3 b = glm::vec3(su4,sv4, 1);
+			glm::vec3 x = glm::inverse(A)*b;
+			for(int i = 0; i < 3; ++i)
+				A[i] *= x[i];
+
+			//B matrix (dest points to basis vectors)
+			glm::mat3 B = glm::mat3(0,0,1,
+				destWidth,0,1,
+				destWidth,destHeight,1);
+			b = glm::vec3(0,destHeight, 1);
+			x = glm::inverse(B)*b;
+			for(int i = 0; i < 3; ++i)
+				B[i] *= x[i];
+
+			C = A*glm::inverse(B);
+		}
+
+		planeStats[plane].projParams.projectionMatrix = C;
+		planeStats[plane].projParams.aabbMeters = aabb;
+		planeStats[plane].projParams.destWidth = destWidth;
+		planeStats[plane].projParams.destHeight = destHeight;
+		planeStats[plane].projParams.textureResolution = maxRatio;
+	}
+}
+
+void CpuMeshBackend::projectTexture(int segmentId, PlaneStats* /*host_planeStats*/, PlaneStats* dev_planeStats,
+									Float4SOA destTexture, int destTextureSize, RGBMapSOA rgbMap, int* finalSegmentsBuffer, float* finalDistanceToPlaneBuffer,
+									int imageXRes, int imageYRes)
+{
+	const ProjectionParameters& params = dev_planeStats->projParams;
+	int width = min(destTextureSize, params.destWidth);
+	int height = min(destTextureSize, params.destHeight);
+	glm::mat3 Tds = params.projectionMatrix;
+
+	mPool.parallelFor(height, mPool.grainFor(height), [&](int begin, int end){
+		for(int destY = begin; destY < end; destY++)
+		{
+			for(int destX = 0; destX < width; destX++)
+			{
+				float r = CPU_NAN_F;
+				float g = CPU_NAN_F;
+				float b = CPU_NAN_F;
+				float dist = CPU_NAN_F;
+
+				glm::vec3 sourceCoords = Tds*glm::vec3(destX, destY, 1.0f);
+				//Dehomogenization
+				sourceCoords.x /= sourceCoords.z;
+				sourceCoords.y /= sourceCoords.z;
+
+				if(sourceCoords.x >= 0 && sourceCoords.x < imageXRes
+					&& sourceCoords.y >= 0 && sourceCoords.y < imageYRes)
+				{
+					int linIndex = int(sourceCoords.x) + int(sourceCoords.y)*imageXRes;
+					if(segmentId == finalSegmentsBuffer[linIndex]){
+						r = rgbMap.r[linIndex];
+						g = rgbMap.g[linIndex];
+						b = rgbMap.b[linIndex];
+						dist = finalDistanceToPlaneBuffer[linIndex];
+					}
+				}
+
+				int destIndex = destX + destY*destTextureSize;
+				destTexture.x[destIndex] = r;
+				destTexture.y[destIndex] = g;
+				destTexture.z[destIndex] = b;
+				destTexture.w[destIndex] = dist;
+			}
+		}
+	});
+}
+#pragma endregion
+
+#pragma region Quadtree Decimation
+//Merges one tile of quadtree points. tile is (QUADTREE_TILE_SIZE+1)^2 with the right column and bottom row taken from
+//the neighbouring tiles. Points start at 0 (valid) or -1 (invalid); each level doubles the degree of corners whose four
+//children all have degree step*scale and removes the other three
+static void decimateTile(int* tile, int scale)
+{
+	const int T = QUADTREE_TILE_SIZE;
+	const int S = QUADTREE_TILE_SIZE+1;
+
+	//Step == 0 is special case. Decide for all points first, then apply
+	bool merge[QUADTREE_TILE_SIZE*QUADTREE_TILE_SIZE];
+	for(int y = 0; y < T; y++)
+		for(int x = 0; x < T; x++)
+			merge[x + y*T] = tile[x+y*S] == 0 && tile[(x+1)+y*S] == 0 && tile[x+(y+1)*S] == 0 && tile[(x+1)+(y+1)*S] == 0;
+	for(int y = 0; y < T; y++)
+		for(int x = 0; x < T; x++)
+			if(merge[x + y*T])
+				tile[x+y*S] = 1;
+
+	for(int step = 1; step < T; step <<= 1)
+	{
+		int degree = step*scale;
+		for(int y = 0; y < T; y += step*2)
+		{
+			for(int x = 0; x < T; x += step*2)
+			{
+				//Corner points only
+				if(tile[x+y*S] == degree && tile[(x+step)+y*S] == degree
+					&& tile[x+(y+step)*S] == degree && tile[(x+step)+(y+step)*S] == degree)
+				{
+					//Upgrade degree of this point and clear definitely removed points
+					tile[x+y*S] *= 2;
+					tile[(x+step)+y*S] = -1;
+					tile[x+(y+step)*S] = -1;
+					tile[(x+step)+(y+step)*S] = -1;
+				}
+			}
+		}
+	}
+}
+
+void CpuMeshBackend::quadtreeDecimation(int actualWidth, int actualHeight, Float4SOA planarTexture, int* quadTreeAssemblyBuffer,
+										int textureBufferSize)
+{
+	const int T = QUADTREE_TILE_SIZE;
+	const int S = QUADTREE_TILE_SIZE+1;
+
+	//Pass one, 16x16 pixel tiles
+	int tilesX = (actualWidth + T - 1)/T;
+	int tilesY = (actualHeight + T - 1)/T;
+	mPool.parallelFor(tilesY, mPool.grainFor(tilesY), [&](int begin, int end){
+		int tile[(QUADTREE_TILE_SIZE+1)*(QUADTREE_TILE_SIZE+1)];
+		for(int ty = begin; ty < end; ty++)
+		{
+			for(int tx = 0; tx < tilesX; tx++)
+			{
+				//Load tile and apron. Valid pixels in range are 0, everything else -1
+				for(int y = 0; y < S; y++)
+				{
+					for(int x = 0; x < S; x++)
+					{
+						int gx = tx*T + x;
+						int gy = ty*T + y;
+						int val = -1;
+						if(gx < actualWidth && gy < actualHeight)
+						{
+							float pixelContents = planarTexture.x[gx+gy*textureBufferSize];
+							if(pixelContents == pixelContents)
+								val = 0;
+						}
+						tile[x+y*S] = val;
+					}
+				}
+
+				decimateTile(tile, 1);
+
+				//Writeback core
+				for(int y = 0; y < T && ty*T + y < textureBufferSize; y++)
+					for(int x = 0; x < T && tx*T + x < textureBufferSize; x++)
+						quadTreeAssemblyBuffer[(tx*T + x) + (ty*T + y)*textureBufferSize] = tile[x+y*S];
+			}
+		}
+	});
+
+	//Pass two, every 16th point in 256x256 pixel tiles. Reads only points the first pass wrote, in tiles it doesn't write
+	int pointScale = T;
+	int blocksX = (actualWidth + T*T - 1)/(T*T);
+	int blocksY = (actualHeight + T*T - 1)/(T*T);
+	vector<int> tiles(blocksX*blocksY*S*S);
+	for(int by = 0; by < blocksY; by++)
+	{
+		for(int bx = 0; bx < blocksX; bx++)
+		{
+			int* tile = &tiles[(bx + by*blocksX)*S*S];
+			for(int y = 0; y < S; y++)
+			{
+				for(int x = 0; x < S; x++)
+				{
+					int gx = pointScale*(bx*T + x);
+					int gy = pointScale*(by*T + y);
+					tile[x+y*S] = (gx < actualWidth && gy < actualHeight) ? quadTreeAssemblyBuffer[gx+gy*textureBufferSize] : -1;
+				}
+			}
+			decimateTile(tile, pointScale);
+		}
+	}
+	for(int by = 0; by < blocksY; by++)
+	{
+		for(int bx = 0; bx < blocksX; bx++)
+		{
+			const int* tile = &tiles[(bx + by*blocksX)*S*S];
+			for(int y = 0; y < T; y++)
+			{
+				for(int x = 0; x < T; x++)
+				{
+					int gx = pointScale*(bx*T + x);
+					int gy = pointScale*(by*T + y);
+					if(gx < textureBufferSize && gy < textureBufferSize)
+						quadTreeAssemblyBuffer[gx+gy*textureBufferSize] = tile[x+y*S];
+				}
+			}
+		}
+	}
+
+	//Fill in holes. Make sure each corner of a quad is flagged as 0 or higher
+	for(int gy = 0; gy < actualHeight; gy++)
+	{
+		for(int gx = 0; gx < actualWidth; gx++)
+		{
+			int degree = quadTreeAssemblyBuffer[gx + gy*textureBufferSize];
+			if(degree > 0)
+			{
+				int* corner = &quadTreeAssemblyBuffer[(gx+degree) + gy*textureBufferSize];
+				if(*corner < 0) *corner = 0;
+				corner = &quadTreeAssemblyBuffer[gx + (gy+degree)*textureBufferSize];
+				if(*corner < 0) *corner = 0;
+				corner = &quadTreeAssemblyBuffer[(gx+degree) + (gy+degree)*textureBufferSize];
+				if(*corner < 0) *corner = 0;
+			}
+		}
+	}
+}
+#pragma endregion
+
+#pragma region Quadtree Mesh Generation
+void CpuMeshBackend::quadtreeMeshGeneration(glm::vec4 aabbMeters, int actualWidth, int actualHeight, int* quadTreeAssemblyBuffer,
+											int* quadTreeScanResults, int textureBufferSize, int* blockResults, int /*blockResultsBufferSize*/,
+											int* indexBuffer, float4* vertexBuffer, int* compactCount, int* host_compactCount, int /*outputBufferSize*/,
+											int finalTextureWidth, int finalTextureHeight, Float4SOA planarTexture, float4* finalTexture)
+{
+	//Exclusive scan of used vertices in each row
+	mPool.parallelFor(actualHeight, mPool.grainFor(actualHeight), [&](int begin, int end){
+		for(int y = begin; y < end; y++)
+		{
+			const int* input = quadTreeAssemblyBuffer + y*textureBufferSize;
+			int* output = quadTreeScanResults + y*textureBufferSize;
+			int sum = 0;
+			for(int x = 0; x < actualWidth; x++)
+			{
+				output[x] = sum;
+				sum += (input[x] >= 0) ? 1 : 0;
+			}
+			blockResults[y] = sum;
+		}
+	});
+
+	//Scan row totals
+	int total = 0;
+	for(int y = 0; y < actualHeight; y++)
+	{
+		int rowCount = blockResults[y];
+		blockResults[y] = total;
+		total += rowCount;
+	}
+	compactCount[0] = total;
+	host_compactCount[0] = total;
+
+	//Reintegrate
+	mPool.parallelFor(actualHeight, mPool.grainFor(actualHeight), [&](int begin, int end){
+		for(int y = begin; y < end; y++)
+		{
+			int* output = quadTreeScanResults + y*textureBufferSize;
+			for(int x = 0; x < actualWidth; x++)
+				output[x] += blockResults[y];
+		}
+	});
+
+	//Scatter vertices and generate quads
+	mPool.parallelFor(actualHeight, mPool.grainFor(actualHeight), [&](int begin, int end){
+		for(int pixelY = begin; pixelY < end; pixelY++)
+		{
+			for(int pixelX = 0; pixelX < actualWidth; pixelX++)
+			{
+				int degree = quadTreeAssemblyBuffer[pixelX + pixelY*textureBufferSize];
+				if(degree < 0)
+					continue;
+
+				int vertNum = quadTreeScanResults[pixelX + pixelY*textureBufferSize];
+
+				float4 vertex;
+				vertex.x = (pixelX*(aabbMeters.y-aabbMeters.x))/float(actualWidth) + aabbMeters.x;
+				vertex.y = (pixelY*(aabbMeters.w-aabbMeters.z))/float(actualHeight) + aabbMeters.z;
+				vertex.z = float(pixelX)/float(finalTextureWidth);
+				vertex.w = float(pixelY)/float(finalTextureHeight);
+				vertexBuffer[vertNum] = vertex;
+
+				// Quad configuration:
+				// 0-1
+				// |/|
+				// 2-3
+				int vertNum0 = 0;
+				int vertNum1 = 0;
+				int vertNum2 = 0;
+				int vertNum3 = 0;
+				if(degree > 0)
+				{
+					vertNum0 = vertNum;
+					vertNum1 = quadTreeScanResults[(pixelX+degree) + (pixelY)*textureBufferSize];
+					vertNum2 = quadTreeScanResults[(pixelX) + (pixelY+degree)*textureBufferSize];
+					vertNum3 = quadTreeScanResults[(pixelX+degree) + (pixelY+degree)*textureBufferSize];
+				}
+
+				// Index order: 0-2-1, 1-2-3
+				int* indices = indexBuffer + vertNum*6;
+				indices[0] = vertNum0;
+				indices[1] = vertNum2;
+				indices[2] = vertNum1;
+				indices[3] = vertNum1;
+				indices[4] = vertNum2;
+				indices[5] = vertNum3;
+			}
+		}
+	});
+
+	//Reshape texture to aligned memory
+	mPool.parallelFor(finalTextureHeight, mPool.grainFor(finalTextureHeight), [&](int begin, int end){
+		for(int y = begin; y < end; y++)
+		{
+			for(int x = 0; x < finalTextureWidth; x++)
+			{
+				float4 textureValue;
+				textureValue.x = textureValue.y = textureValue.z = textureValue.w = CPU_NAN_F;
+				if(x < actualWidth && y < actualHeight)
+				{
+					int sourceIndex = x + y*textureBufferSize;
+					textureValue.x = planarTexture.x[sourceIndex];
+					textureValue.y = planarTexture.y[sourceIndex];
+					textureValue.z = planarTexture.z[sourceIndex];
+					textureValue.w = planarTexture.w[sourceIndex];
+				}
+				finalTexture[x + y*finalTextureWidth] = textureValue;
+			}
+		}
+	});
+}
+#pragma endregion
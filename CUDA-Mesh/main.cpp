@@ -4,6 +4,7 @@
 using namespace std;
 
 void pause();
+int runHeadless(RGBDDevice* device, MeshBackendType backendType, int maxFrames);
 
 
 
@@ -38,6 +39,28 @@ public:
 	}
 };
 
+//Mailbox that also wakes the headless loop when a frame arrives
+class HeadlessFrameMailbox : public LatestFrameMailbox
+{
+protected:
+	boost::mutex mGuard;
+	boost::condition_variable mFrameCond;
+public:
+	void onNewRGBDFrame(RGBDFramePtr frame) override
+	{
+		publish(frame);
+		boost::lock_guard<boost::mutex> lock(mGuard);
+		mFrameCond.notify_all();
+	}
+
+	//Waits until a frame is waiting or timeoutMs passes. Returns true if one is
+	bool waitForFrame(int timeoutMs)
+	{
+		boost::unique_lock<boost::mutex> lock(mGuard);
+		return mFrameCond.wait_for(lock, boost::chrono::milliseconds(timeoutMs), [this]{return hasNewFrame();});
+	}
+};
+
 
 const int testArraySizeX = 640;
 const int testArraySizeY = 2;
@@ -52,11 +75,29 @@ int main(int argc, char** argv)
 
 	RGBDDevice* devicePtr;
 
+	//Flags: -headless runs the pipeline without the viewer, -cpu forces the CPU backend in headless mode,
+	//-frames N stops headless mode after N frames. The first other argument is a log directory to play back
+	bool headless = false;
+	MeshBackendType backendType = MESH_BACKEND_AUTO;
+	int maxFrames = 0;
+	char* logDirectory = NULL;
+	for(int i = 1; i < argc; ++i)
+	{
+		if(strcmp(argv[i], "-headless") == 0)
+			headless = true;
+		else if(strcmp(argv[i], "-cpu") == 0)
+			backendType = MESH_BACKEND_CPU;
+		else if(strcmp(argv[i], "-frames") == 0 && i + 1 < argc)
+			maxFrames = atoi(argv[++i]);
+		else if(logDirectory == NULL)
+			logDirectory = argv[i];
+	}
+
 	//Load source argument
-	if(argc > 1)
+	if(logDirectory != NULL)
 	{
 		devicePtr = new LogDevice();
-		((LogDevice*)devicePtr)->setSourceDirectory(argv[1]);
+		((LogDevice*)devicePtr)->setSourceDirectory(logDirectory);
 		((LogDevice*)devicePtr)->setLoopStreams(true);
 
 	}else{
@@ -101,6 +142,13 @@ int main(int argc, char** argv)
 	devicePtr->setImageRegistrationMode(REGISTRATION_DEPTH_TO_COLOR);
 	devicePtr->setSyncColorAndDepth(false);
 
+	if(headless)
+	{
+		int result = runHeadless(devicePtr, backendType, maxFrames);
+		devicePtr->shutdown();
+		return result;
+	}
+
 	MeshViewer viewer(devicePtr, screenwidth, screenheight);
 
 	DeviceStatus rc = viewer.init(argc, argv);
@@ -119,6 +167,80 @@ int main(int argc, char** argv)
 }
 
 
+//Runs the mesh pipeline on every frame it can keep up with, with the viewer's default settings, and prints timings.
+//Runs until maxFrames frames are processed (forever if maxFrames <= 0) or the device stops streaming depth
+int runHeadless(RGBDDevice* device, MeshBackendType backendType, int maxFrames)
+{
+	shared_ptr<MeshComputeBackend> backend = createMeshComputeBackend(backendType);
+	if(backend == NULL)
+	{
+		printf("Could not create compute backend\n");
+		return 5;
+	}
+	printf("Running headless on the %s backend\n", (backend->getType() == MESH_BACKEND_CPU) ? "CPU" : "CUDA");
+
+	int xRes = device->getDepthResolutionX();
+	int yRes = device->getDepthResolutionY();
+	MeshTracker tracker(xRes, yRes, device->getColorIntrinsics(), backend);
+	tracker.setGaussianSpatialSigma(2.0f);
+
+	//Frames that arrive while the pipeline is busy are dropped
+	HeadlessFrameMailbox mailbox;
+	device->addNewRGBDFrameListener(&mailbox, DISPATCH_LATEST);
+
+	timestamp lastTime = 0;
+	bool firstFrame = true;
+	int processed = 0;
+	while(maxFrames <= 0 || processed < maxFrames)
+	{
+		if(!device->hasDepthStream())
+		{
+			printf("Depth stream ended\n");
+			break;
+		}
+
+		//The timeout only bounds how long a stopped stream goes unnoticed
+		if(!mailbox.waitForFrame(100))
+			continue;
+
+		//The mailbox fills in the last array of a stream an unsynced device left out, so a frame without both is from before
+		//the first of each stream. A color update carries the depth image already processed, so run once per new depth image
+		RGBDFramePtr frame = mailbox.consume();
+		if(frame == NULL || !frame->hasColor() || !frame->hasDepth() || (!firstFrame && frame->getDepthTimestamp() == lastTime))
+			continue;
+
+		timestamp time = frame->getDepthTimestamp();
+		if(time < lastTime)
+		{
+			cout << "Reseting tracking, because timestamp" << endl;
+			tracker.resetTracker();
+		}
+		lastTime = time;
+		firstFrame = false;
+
+		boost::timer::cpu_timer t;
+
+		tracker.pushRGBDFrameToDevice(frame->getColorArray(), frame->getDepthArray(), time);
+		tracker.deleteQuadTreeMeshes();
+
+		tracker.buildRGBSOA();
+		tracker.buildVMapBilateralFilter(5.0f, 0.005f);
+		tracker.buildNMapAverageGradient();
+		tracker.subsamplePyramids();
+		tracker.GPUSimpleSegmentation();
+		tracker.ReprojectPlaneTextures();
+		backend->synchronize();
+
+		int millisec = t.elapsed().wall / 1000000;
+		printf("Frame %llu: %d ms, %d meshes\n", (unsigned long long) time, millisec, (int) tracker.getQuadTreeMeshes()->size());
+		processed++;
+	}
+
+	//Removing the listener waits for its dispatch thread, so the mailbox is never called after it goes out of scope
+	device->removeNewRGBDFrameListener(&mailbox);
+	return 0;
+}
+
 void pause()
 {
 	cout << "Press enter to continue..." << endl;
@@ -3,6 +3,8 @@
 #include <OpenNI.h>
 #include "MeshViewer.h"
 #include <iostream>
+#include <cstring>
+#include <cstdlib>
 #include "ONIKinectDevice.h"
 #include "LogDevice.h"
 #include "FileUtils.h"
@@ -0,0 +1,72 @@
+#pragma once
+#include "FileUtils.h"
+#include <boost/chrono.hpp>
+
+using namespace std;
+
+//Frames between re-measurements of a method that is not being picked
+#define ADAPTIVE_COMPRESSION_PROBE_INTERVAL		150
+//Weight of the newest sample in the running averages
+#define ADAPTIVE_COMPRESSION_SMOOTHING			0.1
+
+namespace rgbd
+{
+	namespace framework
+	{
+		//Streams the policy chooses methods for
+		enum ADAPTIVE_STREAM {ADAPTIVE_STREAM_COLOR = 0, ADAPTIVE_STREAM_DEPTH = 1};
+
+		/*
+		*	Class AdaptiveCompressionPolicy
+		*	Picks the compression method of each stream frame by frame from measured encode cost, output size and write speed.
+		*	Each stream chooses from NO_COMPRESSION, LZ4_COMPRESSION and its lossless image codec.
+		*	The pair with the smallest output wins as long as the compression workers and the disk keep up with the sensor.
+		*	How much of that capacity may be used shrinks as the recording queue fills, so a backlog pushes toward cheaper methods.
+		*	Not thread safe. FrameLogger calls it with its queue locked.
+		*/
+		class AdaptiveCompressionPolicy
+		{
+		protected:
+			//Running averages for one method of one stream
+			struct MethodStats
+			{
+				COMPRESSION_METHOD method;
+				bool hasSample;
+				int lastSampleFrame;
+				double encodeSeconds;
+				double bytes;
+			};
+
+			static const int METHOD_COUNT = 3;
+			MethodStats mStats[2][METHOD_COUNT];
+
+			//Average time between frames from the device
+			double mFramePeriod;
+			bool mHasLastArrival;
+			boost::chrono::steady_clock::time_point mLastArrival;
+
+			//Average bytes per second the log is written at. 0 until measured
+			double mWriteRate;
+
+			MethodStats* getStats(ADAPTIVE_STREAM stream, COMPRESSION_METHOD method);
+		public:
+			AdaptiveCompressionPolicy(void);
+
+			//Forgets all measurements
+			void reset();
+
+			//Call for every frame the device delivers
+			void onFrameArrival();
+
+			//Cost of compressing one frame of a stream. Uncompressed streams report 0 seconds and their raw size
+			void addEncodeSample(ADAPTIVE_STREAM stream, COMPRESSION_METHOD method, int frameId, double encodeSeconds, uint32_t bytes);
+
+			//Time taken to write one frame of bytes to the log
+			void addWriteSample(double writeSeconds, uint32_t bytes);
+
+			//Chooses the methods for a frame. queueFill is the fraction of the recording queue in use,
+			//workerThreads the number of compression workers.
+			void selectMethods(int frameId, double queueFill, int workerThreads, COMPRESSION_METHOD& colorMethod, COMPRESSION_METHOD& depthMethod);
+		};
+	}
+}
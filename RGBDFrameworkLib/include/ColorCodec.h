@@ -0,0 +1,49 @@
+#pragma once
+//Lossless codec for RGB888 color images.
+//
+//Interleaved RGB barely compresses with LZ4 because neighboring bytes belong to different channels.
+//This codec decorrelates the channels with a reversible YCoCg-R transform, splits the result into Y, Co and Cg planes
+//and replaces each byte with its difference from the previous pixel in the plane.
+//Sensor noise leaves the deltas small but rarely repeating, which LZ4 can't exploit (about 5% on our logs),
+//so each plane is Huffman coded with its own table instead.
+//
+//The transform is computed in 8 bit modular arithmetic. Every lifting step is undone exactly by the inverse,
+//so the image round trips bit for bit without the extra chroma bit of textbook YCoCg-R.
+//
+//Stream layout:
+//	ColorCodecHeader
+//	For each of the Y, Co and Cg delta planes:
+//		256 4 bit Huffman code lengths, two per byte
+//		uint32 size of the coded plane in bytes
+//		Huffman coded plane, MSB first
+
+#include <stdint.h>
+#include <vector>
+#include "RGBDFrame.h"
+#include "SIMDUtils.h"
+
+using namespace std;
+
+#define COLOR_CODEC_VERSION		1
+
+namespace rgbd
+{
+	namespace framework
+	{
+#pragma pack(push, 1)
+		struct ColorCodecHeader
+		{
+			uint8_t version;
+			uint32_t pixelCount;
+		};
+#pragma pack(pop)
+
+		//Encodes pixelCount pixels into dest. dest is resized to hold the output.
+		//Returns the number of bytes written to dest, or -1 if encoding failed.
+		int encodeColorImage(const ColorPixel* src, int pixelCount, vector<char>& dest);
+
+		//Decodes srcSize bytes created by encodeColorImage into dest, which holds destPixels pixels.
+		//Returns false if the stream is corrupt or the image is not exactly destPixels pixels.
+		bool decodeColorImage(const char* src, int srcSize, ColorPixel* dest, int destPixels);
+	}
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include "RGBDFrameFactory.h"
+#include <list>
+#include <map>
+#include <boost/thread.hpp>
+
+using namespace std;
+
+namespace rgbd
+{
+	namespace framework
+	{
+		struct DecodedFrameCacheStats
+		{
+			uint64_t hits;
+			uint64_t misses;
+			uint64_t evictions;
+			int entries;
+			size_t bytes;
+		};
+
+		/*
+		*	Class DecodedFrameCache
+		*	Keeps decoded log frames in memory so looped playback doesn't read and decode them again.
+		*	Entries are keyed by log position and evicted least recently used first once the memory budget is exceeded.
+		*	Cached pixels live in arrays from the factory's pool, so evicted memory is reused by later frames.
+		*	Frames are copied in and out. Listeners can modify the frames they receive without corrupting the cache.
+		*	For a looping log the budget should cover the whole log. A smaller LRU cache evicts each frame just before it is needed again.
+		*	Thread safe.
+		*/
+		class DecodedFrameCache
+		{
+		private:
+			//Make this class non construction-copyable
+			DecodedFrameCache( const DecodedFrameCache& other );
+			DecodedFrameCache& operator=( const DecodedFrameCache& );
+		protected:
+			struct Entry
+			{
+				int xRes, yRes;
+				DPixelArray depth;
+				ColorPixelArray color;
+				timestamp depthTime, colorTime;
+				bool hasDepth, hasColor;
+				size_t bytes;
+				//Position in mRecentKeys
+				list<int>::iterator recentPos;
+			};
+
+			RGBDFrameFactory* mFrameFactory;
+
+			boost::mutex mGuard;
+			map<int, Entry> mEntries;
+			//Most recently used first
+			list<int> mRecentKeys;
+			size_t mMemoryBudget;
+			DecodedFrameCacheStats mStats;
+
+			//Caller must hold mGuard
+			void evictToBudget(size_t budget);
+		public:
+			//Pixel arrays are taken from factory, which must outlive the cache
+			DecodedFrameCache(RGBDFrameFactory* factory);
+			~DecodedFrameCache(void);
+
+			//Max bytes of cached pixels. 0 (default) disables the cache and frees every entry
+			void setMemoryBudget(size_t bytes);
+			size_t getMemoryBudget();
+
+			//Returns a new frame holding a copy of the cached frame at key, or NULL if it isn't cached.
+			//An entry only matches if it holds every stream asked for
+			RGBDFramePtr getFrame(int key, bool needDepth, bool needColor);
+
+			//Copies frame into the cache under key, replacing any older entry. Does nothing if the frame is larger than the budget
+			void insert(int key, RGBDFramePtr frame);
+
+			void clear();
+
+			DecodedFrameCacheStats getStats();
+		};
+	}
+}
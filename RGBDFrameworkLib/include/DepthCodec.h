@@ -0,0 +1,60 @@
+#pragma once
+//Lossless predictive codec for 16 bit depth images.
+//
+//Each row is predicted from its neighbors with whichever predictor fits it best (left, up or median edge detector).
+//Prediction errors are zig-zag mapped so small errors of either sign become small unsigned values.
+//Kinect depth is quantized, so most residuals are zero. The residuals are coded JPEG style as (zero run, bit length) symbols
+//followed by the low bits of the value, and the symbols are Huffman coded with a table built per frame.
+//
+//Stream layout:
+//	DepthCodecHeader
+//	yRes bytes, the DEPTH_PREDICTOR of each row
+//	DEPTH_CODEC_SYMBOLS 4 bit Huffman code lengths, two per byte
+//	Huffman coded rows, MSB first. Rows above the first row are treated as zero.
+
+#include <stdint.h>
+#include <vector>
+#include "RGBDFrame.h"
+#include "SIMDUtils.h"
+
+using namespace std;
+
+#define DEPTH_CODEC_VERSION			1
+//Longest zero run a single symbol can carry
+#define DEPTH_CODEC_MAX_RUN			15
+//Symbols are run*17 + bit length of the residual. Bit length 0 is a control symbol: run 0 ends the row, run 15 skips 16 zeros
+#define DEPTH_CODEC_SYMBOLS			((DEPTH_CODEC_MAX_RUN + 1)*17)
+
+namespace rgbd
+{
+	namespace framework
+	{
+		//Per row predictors. a = left, b = up, c = up left
+		//DEPTH_PREDICT_MED is the LOCO-I median edge detector: min(a,b) or max(a,b) at edges, a+b-c otherwise
+		enum DEPTH_PREDICTOR {DEPTH_PREDICT_LEFT = 0, DEPTH_PREDICT_UP = 1, DEPTH_PREDICT_MED = 2};
+
+#pragma pack(push, 1)
+		struct DepthCodecHeader
+		{
+			uint8_t version;
+			uint32_t xRes;
+			uint32_t yRes;
+		};
+#pragma pack(pop)
+
+		//Encodes an xRes by yRes depth image into dest. dest is resized to hold the output.
+		//Returns the number of bytes written to dest, or -1 if the resolution is invalid.
+		int encodeDepthImage(const DPixel* src, int xRes, int yRes, vector<char>& dest);
+
+		//Decodes srcSize bytes created by encodeDepthImage into dest, which holds destPixels pixels.
+		//Returns false if the stream is corrupt or the image is not exactly destPixels pixels.
+		bool decodeDepthImage(const char* src, int srcSize, DPixel* dest, int destPixels);
+
+		//Temporal delta of count pixels against a reference image, delta = src - reference modulo 2^16.
+		//Static pixels become zero, which the codecs above store almost for free.
+		void computeDepthDelta(const DPixel* src, const DPixel* reference, DPixel* delta, int count);
+
+		//Undoes computeDepthDelta in place. image holds the delta on input and the original pixels on output.
+		void applyDepthDelta(DPixel* image, const DPixel* reference, int count);
+	}
+}
@@ -0,0 +1,105 @@
+#pragma once
+#include <vector>
+#include <boost/thread.hpp>
+#include <boost/chrono.hpp>
+#include <boost/shared_ptr.hpp>
+
+using namespace std;
+
+namespace rgbd
+{
+	namespace framework
+	{
+		//What one call to DeviceGroupSource::runGroupTask did
+		enum GROUP_TASK {GROUP_TASK_NONE = 0, GROUP_TASK_DECODE = 1, GROUP_TASK_DISPATCH = 2};
+
+		/*
+		*	Class DeviceGroupSource
+		*	Work a DeviceGroup can run on its workers. LogDevice implements it.
+		*	runGroupTask does at most one small unit of work (e.g. decode or deliver one frame) and returns what it did.
+		*	If it did nothing it sets nextWake to when it will next have timed work, or leaves it at time_point::max().
+		*	Work that becomes available for any other reason must be announced with DeviceGroup::wake.
+		*	It may be called from several workers at once.
+		*/
+		class DeviceGroupSource
+		{
+		public:
+			virtual ~DeviceGroupSource(){}
+
+			virtual GROUP_TASK runGroupTask(boost::chrono::steady_clock::time_point& nextWake) = 0;
+		};
+
+		struct DeviceGroupSourceStats
+		{
+			uint64_t decodedFrames;
+			uint64_t dispatchedFrames;
+			//Worker time spent on tasks of this source
+			double busySeconds;
+			//Dispatched frames per second since the source was added or the stats were reset
+			double dispatchRate;
+		};
+
+		/*
+		*	Class DeviceGroup
+		*	Runs any number of sources on a fixed pool of worker threads instead of threads per device.
+		*	Workers take turns across sources one task at a time, so a source with a slow decoder can't starve the others.
+		*	Idle workers sleep until a source announces work or the earliest time a source asked to be woken.
+		*	Sources must be removed before the group is destroyed.
+		*/
+		class DeviceGroup
+		{
+		private:
+			//Make this class non construction-copyable
+			DeviceGroup( const DeviceGroup& other );
+			DeviceGroup& operator=( const DeviceGroup& );
+		protected:
+			struct SourceEntry
+			{
+				DeviceGroupSource* source;
+				//Workers currently inside runGroupTask for this source
+				int activeTasks;
+				bool removed;
+				DeviceGroupSourceStats stats;
+				boost::chrono::steady_clock::time_point statsStart;
+			};
+			typedef boost::shared_ptr<SourceEntry> SourceEntryPtr;
+
+			boost::mutex mGuard;
+			//Signaled by wake and when sources are added
+			boost::condition_variable mWorkCond;
+			//Signaled when a source has no tasks running
+			boost::condition_variable mIdleCond;
+			vector<SourceEntryPtr> mSources;
+			//Source the next pass starts at. Advances every pass so sources take turns going first
+			size_t mNextSource;
+			//Incremented by wake. A worker that sees it change during a pass scans again instead of sleeping
+			uint64_t mWakeCount;
+			bool mIsStopping;
+			vector<boost::shared_ptr<boost::thread> > mWorkers;
+
+			void run();
+			//Caller must hold mGuard
+			SourceEntryPtr findSource(DeviceGroupSource* source);
+		public:
+			//0 workers uses one per hardware thread
+			DeviceGroup(int workerCount = 0);
+			~DeviceGroup(void);
+
+			void addSource(DeviceGroupSource* source);
+			//Waits for tasks of the source that are running to finish
+			void removeSource(DeviceGroupSource* source);
+			//Waits until no worker is running a task of the source
+			void waitForIdle(DeviceGroupSource* source);
+
+			//Tells the workers a source has new work
+			void wake();
+
+			int getWorkerCount();
+			int getSourceCount();
+
+			//Returns false if source isn't in the group
+			bool getSourceStats(DeviceGroupSource* source, DeviceGroupSourceStats& stats);
+			void resetStats();
+		};
+	}
+}
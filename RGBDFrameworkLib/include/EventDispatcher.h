@@ -0,0 +1,418 @@
+#pragma once
+#include "SPSCRing.h"
+#include <vector>
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+#include <boost/enable_shared_from_this.hpp>
+
+using namespace std;
+
+//Events a listener can have queued before its policy applies
+#define DISPATCH_DEFAULT_QUEUE_SIZE		8
+
+namespace rgbd
+{
+	namespace framework
+	{
+		//What a dispatcher does when events arrive faster than its listener handles them
+		//DISPATCH_ALL: Deliver every event in order. The device thread waits while the queue is full
+		//DISPATCH_LATEST: Only deliver the newest event. A new event replaces one still waiting, which counts as dropped. queueSize is unused
+		//DISPATCH_BOUNDED: Deliver in order, but drop new events while the queue is full
+		enum DISPATCH_POLICY {DISPATCH_ALL = 0, DISPATCH_LATEST = 1, DISPATCH_BOUNDED = 2};
+
+		struct DispatchStats
+		{
+			//Events waiting for the listener
+			int queueDepth;
+			//Deepest the queue has been
+			int maxQueueDepth;
+			uint64_t delivered;
+			uint64_t dropped;
+		};
+
+		/*
+		*	Class EventDispatcher
+		*	Delivers events to one listener on a long lived thread, fed by an SPSCRing.
+		*	Events reach the listener in the order they were posted.
+		*	post may be called from several threads. They are serialized so the ring keeps a single producer.
+		*	DISPATCH_LATEST uses a single slot the producer overwrites instead of the ring, so the listener always gets the newest event.
+		*	Create with create(). The dispatch thread holds a reference, so the dispatcher survives until it exits.
+		*/
+		template<typename Event>
+		class EventDispatcher : public boost::enable_shared_from_this<EventDispatcher<Event> >
+		{
+		private:
+			//Make this class non construction-copyable
+			EventDispatcher( const EventDispatcher& other );
+			EventDispatcher& operator=( const EventDispatcher& );
+		public:
+			typedef boost::function<void (Event&)> Handler;
+			typedef boost::function<void ()> SpaceHandler;
+			typedef boost::shared_ptr<EventDispatcher<Event> > Ptr;
+		protected:
+			SPSCRing<Event> mRing;
+			DISPATCH_POLICY mPolicy;
+			Handler mHandler;
+			boost::thread mThread;
+
+			//Serializes producers
+			boost::mutex mPostGuard;
+
+			//Sleeping on an empty or full ring. The flags let the other side skip the lock when nobody waits
+			boost::mutex mWaitGuard;
+			boost::condition_variable mEventCond;
+			boost::condition_variable mSpaceCond;
+			boost::atomic<bool> mConsumerWaiting;
+			boost::atomic<bool> mProducerWaiting;
+			//Set by hasSpace when the ring was full. The next event taken calls mSpaceHandler, guarded by mWaitGuard
+			boost::atomic<bool> mSpaceWanted;
+			SpaceHandler mSpaceHandler;
+			boost::atomic<bool> mIsStopping;
+			//Set by drain. No more events are taken, and the thread exits once the queue is empty
+			boost::atomic<bool> mIsDraining;
+
+			//DISPATCH_LATEST slot
+			boost::mutex mLatestGuard;
+			Event mLatest;
+			boost::atomic<bool> mHasLatest;
+
+			boost::atomic<uint64_t> mDelivered;
+			boost::atomic<uint64_t> mDropped;
+			boost::atomic<int> mMaxQueueDepth;
+
+			EventDispatcher(Handler handler, DISPATCH_POLICY policy, int queueSize)
+				: mRing((policy == DISPATCH_LATEST) ? 1 : queueSize), mPolicy(policy), mHandler(handler)
+			{
+				mConsumerWaiting = false;
+				mProducerWaiting = false;
+				mSpaceWanted = false;
+				mIsStopping = false;
+				mIsDraining = false;
+				mHasLatest = false;
+				mDelivered = 0;
+				mDropped = 0;
+				mMaxQueueDepth = 0;
+			}
+
+			void wake(boost::atomic<bool>& waiting, boost::condition_variable& cond)
+			{
+				if(waiting.load())
+				{
+					boost::mutex::scoped_lock lock(mWaitGuard);
+					cond.notify_all();
+				}
+			}
+
+			inline bool hasEvent()
+			{
+				return (mPolicy == DISPATCH_LATEST) ? mHasLatest.load() : !mRing.empty();
+			}
+
+			inline int getQueueDepth()
+			{
+				return (mPolicy == DISPATCH_LATEST) ? (mHasLatest ? 1 : 0) : mRing.size();
+			}
+
+			//Consumer only
+			bool takeEvent(Event& event)
+			{
+				if(mPolicy != DISPATCH_LATEST)
+					return mRing.pop(event);
+
+				boost::mutex::scoped_lock lock(mLatestGuard);
+				if(!mHasLatest)
+					return false;
+				event = mLatest;
+				mLatest = Event();
+				mHasLatest = false;
+				return true;
+			}
+
+			void run()
+			{
+				Event event;
+				while(!mIsStopping)
+				{
+					if(!takeEvent(event))
+					{
+						//drain sets the flag after the last post completes, so an empty queue now stays empty
+						if(mIsDraining && !hasEvent())
+							break;
+
+						boost::mutex::scoped_lock lock(mWaitGuard);
+						mConsumerWaiting = true;
+						while(!hasEvent() && !mIsStopping && !mIsDraining)
+							mEventCond.wait(lock);
+						mConsumerWaiting = false;
+						continue;
+					}
+					wake(mProducerWaiting, mSpaceCond);
+					if(mSpaceWanted.load())
+					{
+						SpaceHandler onSpace;
+						{
+							boost::mutex::scoped_lock lock(mWaitGuard);
+							mSpaceWanted = false;
+							onSpace.swap(mSpaceHandler);
+						}
+						if(onSpace)
+							onSpace();
+					}
+
+					if(mIsStopping)
+						break;
+					mHandler(event);
+					mDelivered++;
+					event = Event();
+				}
+			}
+
+		public:
+			static Ptr create(Handler handler, DISPATCH_POLICY policy = DISPATCH_ALL, int queueSize = DISPATCH_DEFAULT_QUEUE_SIZE)
+			{
+				Ptr dispatcher(new EventDispatcher<Event>(handler, policy, queueSize));
+				dispatcher->mThread = boost::thread(&EventDispatcher<Event>::run, dispatcher);
+				return dispatcher;
+			}
+
+			~EventDispatcher()
+			{
+				//Only reached once run has exited, or if create failed
+				if(mThread.joinable())
+					mThread.detach();
+			}
+
+			//Queues an event for the listener. Returns false if it was dropped or the dispatcher is stopped
+			bool post(const Event& event)
+			{
+				boost::mutex::scoped_lock postLock(mPostGuard);
+				if(mIsStopping || mIsDraining)
+				{
+					mDropped++;
+					return false;
+				}
+
+				if(mPolicy == DISPATCH_LATEST)
+				{
+					{
+						boost::mutex::scoped_lock lock(mLatestGuard);
+						if(mHasLatest)
+							mDropped++;
+						mLatest = event;
+						mHasLatest = true;
+					}
+					mMaxQueueDepth = 1;
+					wake(mConsumerWaiting, mEventCond);
+					return true;
+				}
+
+				while(!mRing.push(event))
+				{
+					if(mIsStopping || mPolicy != DISPATCH_ALL)
+					{
+						mDropped++;
+						return false;
+					}
+
+					boost::mutex::scoped_lock lock(mWaitGuard);
+					mProducerWaiting = true;
+					while(mRing.full() && !mIsStopping)
+						mSpaceCond.wait(lock);
+					mProducerWaiting = false;
+				}
+
+				int depth = mRing.size();
+				if(depth > mMaxQueueDepth)
+					mMaxQueueDepth = depth;
+				wake(mConsumerWaiting, mEventCond);
+				return true;
+			}
+
+			//True if post would not wait for the listener. Otherwise onSpace is called once from the dispatch thread
+			//when it takes the next event, so a producer that must not block can try again then instead of waiting in post.
+			//Call from the producing thread. Only the latest onSpace is kept
+			bool hasSpace(const SpaceHandler& onSpace)
+			{
+				if(mPolicy != DISPATCH_ALL || mIsStopping || mIsDraining || !mRing.full())
+					return true;
+
+				{
+					boost::mutex::scoped_lock lock(mWaitGuard);
+					mSpaceHandler = onSpace;
+					mSpaceWanted = true;
+				}
+				//The listener may have taken an event before it could see the request
+				return !mRing.full();
+			}
+
+			//Discards queued events and ends the dispatch thread.
+			//Waits for a callback in progress unless called from that callback. The listener is not called after this returns.
+			void stop()
+			{
+				mIsStopping = true;
+				{
+					boost::mutex::scoped_lock lock(mWaitGuard);
+					mEventCond.notify_all();
+					mSpaceCond.notify_all();
+				}
+
+				if(mThread.get_id() == boost::this_thread::get_id())
+					mThread.detach();
+				else if(mThread.joinable())
+					mThread.join();
+			}
+
+			//Stops taking new events, delivers the ones already queued and ends the dispatch thread.
+			//Waits for the queue to empty unless called from a callback, in which case the remaining events are delivered after it returns.
+			void drain()
+			{
+				{
+					//Once no post is in progress, nothing else reaches the queue
+					boost::mutex::scoped_lock postLock(mPostGuard);
+					mIsDraining = true;
+				}
+				{
+					boost::mutex::scoped_lock lock(mWaitGuard);
+					mEventCond.notify_all();
+				}
+
+				if(mThread.get_id() == boost::this_thread::get_id())
+					mThread.detach();
+				else if(mThread.joinable())
+					mThread.join();
+			}
+
+			DispatchStats getStats()
+			{
+				DispatchStats stats;
+				stats.queueDepth = getQueueDepth();
+				stats.maxQueueDepth = mMaxQueueDepth;
+				stats.delivered = mDelivered;
+				stats.dropped = mDropped;
+				return stats;
+			}
+		};
+
+		/*
+		*	Class ListenerList
+		*	Registered listeners of one kind, each with its own EventDispatcher.
+		*	The list is copied on change, so posting only locks long enough to grab the current copy
+		*	and a listener can add or remove listeners from its callback.
+		*/
+		template<typename Listener, typename Event>
+		class ListenerList
+		{
+		private:
+			//Make this class non construction-copyable
+			ListenerList( const ListenerList& other );
+			ListenerList& operator=( const ListenerList& );
+		public:
+			typedef typename EventDispatcher<Event>::Ptr DispatcherPtr;
+			typedef typename EventDispatcher<Event>::Handler Handler;
+			typedef typename EventDispatcher<Event>::SpaceHandler SpaceHandler;
+			typedef vector<pair<Listener*, DispatcherPtr> > Entries;
+		protected:
+			boost::mutex mGuard;
+			boost::shared_ptr<const Entries> mEntries;
+
+			boost::shared_ptr<const Entries> getEntries()
+			{
+				boost::mutex::scoped_lock lock(mGuard);
+				return mEntries;
+			}
+		public:
+			ListenerList(void) : mEntries(new Entries()) {}
+
+			~ListenerList(void)
+			{
+				clear();
+			}
+
+			void add(Listener* listener, Handler handler, DISPATCH_POLICY policy, int queueSize)
+			{
+				DispatcherPtr dispatcher = EventDispatcher<Event>::create(handler, policy, queueSize);
+
+				boost::mutex::scoped_lock lock(mGuard);
+				boost::shared_ptr<Entries> entries(new Entries(*mEntries));
+				entries->push_back(pair<Listener*, DispatcherPtr>(listener, dispatcher));
+				mEntries = entries;
+			}
+
+			//With drain, events already queued for the listener are delivered before it is dropped, otherwise they are discarded
+			void remove(Listener* listener, bool drain = false)
+			{
+				DispatcherPtr removed;
+				{
+					boost::mutex::scoped_lock lock(mGuard);
+					for(size_t i = 0; i < mEntries->size(); i++)
+					{
+						if((*mEntries)[i].first == listener)
+						{
+							boost::shared_ptr<Entries> entries(new Entries(*mEntries));
+							removed = (*entries)[i].second;
+							entries->erase(entries->begin() + i);
+							mEntries = entries;
+							break;
+						}
+					}
+				}
+
+				if(removed != NULL)
+				{
+					if(drain)
+						removed->drain();
+					else
+						removed->stop();
+				}
+			}
+
+			void clear()
+			{
+				boost::shared_ptr<const Entries> entries;
+				{
+					boost::mutex::scoped_lock lock(mGuard);
+					entries = mEntries;
+					mEntries = boost::shared_ptr<const Entries>(new Entries());
+				}
+
+				for(size_t i = 0; i < entries->size(); i++)
+					(*entries)[i].second->stop();
+			}
+
+			void post(const Event& event)
+			{
+				boost::shared_ptr<const Entries> entries = getEntries();
+				for(size_t i = 0; i < entries->size(); i++)
+					(*entries)[i].second->post(event);
+			}
+
+			//True if post would not wait for any listener. Otherwise onSpace is called when a full listener takes an event
+			//(see EventDispatcher::hasSpace). With a single posting thread, space only grows until its next post
+			bool hasSpace(const SpaceHandler& onSpace)
+			{
+				bool space = true;
+				boost::shared_ptr<const Entries> entries = getEntries();
+				for(size_t i = 0; i < entries->size(); i++)
+				{
+					if(!(*entries)[i].second->hasSpace(onSpace))
+						space = false;
+				}
+				return space;
+			}
+
+			bool getStats(Listener* listener, DispatchStats& stats)
+			{
+				boost::shared_ptr<const Entries> entries = getEntries();
+				for(size_t i = 0; i < entries->size(); i++)
+				{
+					if((*entries)[i].first == listener)
+					{
+						stats = (*entries)[i].second->getStats();
+						return true;
+					}
+				}
+				return false;
+			}
+		};
+	}
+}
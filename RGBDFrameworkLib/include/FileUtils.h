@@ -2,10 +2,12 @@
 
 
 #include <stdio.h>
+#include <string.h>
 #include <ostream>
 #include <fstream>
 #include <istream>
 #include <string>
+#include <vector>
 #include "RGBDFrame.h"
 #include <boost/filesystem.hpp>
 #include "lz4.h"
@@ -19,11 +21,27 @@ namespace rgbd
 	namespace framework
 	{
 		//Enumeration of supported binary compression methods
-		enum COMPRESSION_METHOD {NO_COMPRESSION = 0, LZ4_COMPRESSION = 1};
+		//DEPTH_PREDICTIVE_COMPRESSION is lossless and only valid for depth images (see DepthCodec.h)
+		//COLOR_YCOCG_COMPRESSION is lossless and only valid for color images (see ColorCodec.h)
+		enum COMPRESSION_METHOD {NO_COMPRESSION = 0, LZ4_COMPRESSION = 1, DEPTH_PREDICTIVE_COMPRESSION = 2, COLOR_YCOCG_COMPRESSION = 3};
 
 		string getCompressionMethodTag(COMPRESSION_METHOD method);
 		COMPRESSION_METHOD getCompressionMethodFromTag(string tag);
 
+		//Compresses srcSize bytes from src into dest with the specified method. dest is resized to hold the output.
+		//xRes is the image width. DEPTH_PREDICTIVE_COMPRESSION needs it to predict from the row above,
+		//without it (0) the buffer is coded as a single row.
+		//Returns the number of bytes written to dest, or -1 if compression failed.
+		int compressBuffer(const char* src, int srcSize, vector<char>& dest, COMPRESSION_METHOD compressMode, int xRes = 0);
+
+		//Compresses an xRes by yRes depth image. Image methods use the resolution, byte methods treat the image as a flat buffer.
+		//Returns the number of bytes written to dest, or -1 if compression failed.
+		int compressDepthImage(const DPixel* src, int xRes, int yRes, vector<char>& dest, COMPRESSION_METHOD compressMode);
+
+		//Decompresses srcSize bytes from src into the destSize byte array dest.
+		//Returns false, with dest zeroed, if the data could not be decoded into exactly destSize bytes.
+		bool decompressBuffer(const char* src, int srcSize, char* dest, int destSize, COMPRESSION_METHOD compressMode);
+
 		//Saves image files with appropriate file extensions and no compression
 		void saveRGBDFrameImagesToFiles(string filename, RGBDFramePtr frame);
 
@@ -73,9 +91,21 @@ namespace rgbd
 		//Returns true if the provided path is a directory
 		bool isDirectory(string dir);
 
+		//Reads a binary file into the memSize byte array outputArray, decompressing it with compressMode.
+		void loadCompressedBinaryFile(string filename, char* outputArray, int memSize, COMPRESSION_METHOD compressMode);
+
+		//Writes size bytes to a new binary file. Returns false if the file could not be written.
+		bool saveBinaryFile(string filename, const char* data, int size);
+
 		//Returns true if the provided file exists
 		bool fileExists(string filename);
 
+		//Returns the size of a file in bytes, or 0 if it does not exist
+		uint64_t getFileSize(string filename);
+
+		//Returns the last modification time of a file as a time_t, or 0 if it does not exist
+		int64_t getFileWriteTime(string filename);
+
 		//Loads an entire text file into a c++ string object.
 		//Warning: use at your own risk on huge files
 		string loadTextFile(string filename);
@@ -2,8 +2,11 @@
 #include "RGBDDevice.h"
 #include <string>
 #include <queue>
+#include <map>
 #include <boost/thread.hpp>
 #include "FileUtils.h"
+#include "LogContainer.h"
+#include "AdaptiveCompressionPolicy.h"
 #include <sstream>
 
 
@@ -13,6 +16,57 @@ namespace rgbd
 {
 	namespace framework
 	{
+		//What the logger does with a new frame when its queue is full.
+		//QUEUE_OVERFLOW_BLOCK waits for the logger to catch up, stalling the thread delivering the frame.
+		//QUEUE_OVERFLOW_DROP_OLDEST discards the oldest queued frame to make room. QUEUE_OVERFLOW_DROP_NEWEST discards the new frame.
+		enum QUEUE_OVERFLOW_POLICY {QUEUE_OVERFLOW_BLOCK = 0, QUEUE_OVERFLOW_DROP_OLDEST = 1, QUEUE_OVERFLOW_DROP_NEWEST = 2};
+
+		//Depth keyframe shared by the frames of one group
+		struct DepthKeyframe
+		{
+			int id;
+			RGBDFramePtr frame;
+			//Stored size of the keyframe payload. 0 until the keyframe has been compressed
+			uint32_t payloadSize;
+
+			DepthKeyframe(int id, RGBDFramePtr frame)
+			{
+				this->id = id;
+				this->frame = frame;
+				payloadSize = 0;
+			}
+		};
+		typedef boost::shared_ptr<DepthKeyframe> DepthKeyframePtr;
+
+		//A frame taken off the queue that has not been written yet
+		struct PendingFrame
+		{
+			EncodedFrame encoded;
+			//Group the depth stream belongs to. NULL if depth keyframes are off
+			DepthKeyframePtr depthKeyframe;
+			//Streams still being compressed
+			int remainingJobs;
+
+			PendingFrame()
+			{
+				remainingJobs = 0;
+			}
+		};
+		typedef boost::shared_ptr<PendingFrame> PendingFramePtr;
+
+		//Compression of one stream of a pending frame
+		struct CompressionJob
+		{
+			PendingFramePtr frame;
+			bool isDepth;
+
+			CompressionJob(PendingFramePtr frame, bool isDepth)
+			{
+				this->frame = frame;
+				this->isDepth = isDepth;
+			}
+		};
+
 		/*
 		*	Class FrameLogger
 		*	Tool for recording RGBDDevice streams. Can be used to asynchronously record any RGBDDevice's output frames
@@ -28,8 +82,10 @@ namespace rgbd
 			string mOutputDirectory;
 
 			//Buffer that allows log to record data without majorly affecting frame rate.
-			//Event handler pushes frames to the queue
+			//Event handler pushes frames to the queue. Holds at most mMaxQueueSize frames
 			queue<RGBDFramePtr> mFrameQueue;
+			size_t mMaxQueueSize;
+			QUEUE_OVERFLOW_POLICY mOverflowPolicy;
 
 			//Flag indicating if the log is recording
 			volatile bool mIsRecording;
@@ -37,11 +93,31 @@ namespace rgbd
 			//Device being recorded
 			RGBDDevice* mDevice;
 
-			//Thread for saving to file from buffer
+			//Thread for saving to file from buffer. Writes frames in id order as the compression workers finish them
 			boost::thread mLoggerThread;
 
+			//Compression workers. Started and joined by the logger thread
+			vector<boost::shared_ptr<boost::thread> > mCompressionThreads;
+			int mCompressionThreadCount;
+
+			//Frames claimed from mFrameQueue, keyed by frame id, and their outstanding work. Guarded by mQueueGuard
+			map<int, PendingFramePtr> mPendingFrames;
+			queue<CompressionJob> mCompressionJobs;
+			int mNextFrameId;//Id of the next frame claimed from the queue
+			int mNextWriteId;//Id of the next frame the logger thread writes
+
 			//Mutex that should be locked whenever queue is being accessed.
 			boost::mutex mQueueGuard;
+			//Signaled when a frame or compression job is queued, a pending frame is written or recording stops
+			boost::condition_variable mFrameQueuedCond;
+			//Signaled when a pending frame finishes compressing or recording stops
+			boost::condition_variable mFrameEncodedCond;
+			//Signaled when a frame leaves the queue or recording stops
+			boost::condition_variable mQueueSpaceCond;
+
+			//Recording statistics. Guarded by mQueueGuard and reset by startRecording
+			int mDroppedFrames;
+			size_t mQueueHighWaterMark;
 
 			//Compression algorithm to use when saving color images
 			COMPRESSION_METHOD mColorCompressionMethod;
@@ -49,8 +125,48 @@ namespace rgbd
 			//Compression algorithm to use when saving depth images
 			COMPRESSION_METHOD mDepthCompressionMethod;
 
+			//If true, methods are picked per frame by mCompressionPolicy instead. Policy is guarded by mQueueGuard
+			bool mAdaptiveCompression;
+			AdaptiveCompressionPolicy mCompressionPolicy;
+
+			//Format of the log being written
+			LOG_FORMAT mLogFormat;
+
+			//Depth frames per keyframe group. 1 stores every depth frame self contained
+			int mDepthKeyframeInterval;
+
+			//Group new frames are assigned to. Guarded by mQueueGuard
+			DepthKeyframePtr mDepthKeyframe;//NULL if the next depth frame starts a group
+			int mFramesSinceKeyframe;
+
+			//Output sinks. Only the one matching mLogFormat is open during recording
+			ofstream mXmlLog;
+			LogContainerWriter mContainerLog;
+
 			//This function will be run in mLoggerThread to save frames to output directory.
 			void record(string outputDirectory);
+
+			//Compression worker. Claims frames from the queue and compresses their streams
+			void compressFrames();
+
+			//Takes the next frame off the queue, assigns its id and depth group and queues its compression jobs.
+			//Caller must hold mQueueGuard
+			void claimFrame();
+
+			//Compress one stream of a pending frame with the current compression settings
+			void encodeColor(PendingFrame& pending);
+			void encodeDepth(PendingFrame& pending, vector<DPixel>& deltaBuffer);
+
+			//Encodes the frame's depth as a delta against its group keyframe.
+			//Returns false if the delta is no smaller than the keyframe and the frame should be stored self contained.
+			bool encodeDepthDelta(PendingFrame& pending, vector<DPixel>& deltaBuffer);
+
+			//Opens/closes the output log in the current format. openLog returns false if the log could not be created.
+			bool openLog(string outputDirectory, int xRes, int yRes);
+			void closeLog();
+
+			//Appends one encoded frame to the open log
+			void writeEncodedFrame(string outputDirectory, const EncodedFrame& encoded);
 		public:
 			FrameLogger(void);
 			~FrameLogger(void);
@@ -92,6 +208,48 @@ namespace rgbd
 			inline COMPRESSION_METHOD getColorCompressionMethod(){return mColorCompressionMethod;}
 			inline COMPRESSION_METHOD getDepthCompressionMethod(){return mDepthCompressionMethod;}
 
+			//If set to true, each stream switches between no compression, LZ4 and its lossless image codec frame by frame,
+			//using the smallest output the compression workers and the disk can sustain at the current frame rate
+			//(see AdaptiveCompressionPolicy). The fixed methods above are ignored while it is on.
+			//Logs store the method of every frame, so LogDevice plays back mixed logs as usual.
+			inline void setAdaptiveCompression(bool adaptive){ mAdaptiveCompression = adaptive;}
+			inline bool getAdaptiveCompression(){return mAdaptiveCompression;}
+
+			//Number of threads compressing frames while recording. Frames are still written in arrival order.
+			//Cannot be changed during recording. Returns false if recording in progress.
+			bool setCompressionThreadCount(int threads);
+			inline int getCompressionThreadCount(){return mCompressionThreadCount;}
+
+			//Max frames buffered between the device and the disk. Default is 60, about 90MB of VGA frames.
+			void setMaxQueueSize(size_t frames);
+			size_t getMaxQueueSize();
+
+			inline void setQueueOverflowPolicy(QUEUE_OVERFLOW_POLICY policy){ mOverflowPolicy = policy;}
+			inline QUEUE_OVERFLOW_POLICY getQueueOverflowPolicy(){return mOverflowPolicy;}
+
+			//Frames discarded by the overflow policy since recording started
+			int getDroppedFrameCount();
+
+			//Most frames queued at once since recording started
+			size_t getQueueHighWaterMark();
+
+			//Log format cannot be changed during recording. Returns false if recording in progress.
+			inline bool setLogFormat(LOG_FORMAT format)
+			{
+				if(mIsRecording)
+					return false;
+				mLogFormat = format;
+				return true;
+			}
+			inline LOG_FORMAT getLogFormat(){return mLogFormat;}
+
+			//Stores one self contained depth keyframe every interval frames. The frames in between are stored as the difference
+			//from that keyframe, compressed with the depth compression method (LZ4 if depth compression is off).
+			//Cuts file size several times over for static scenes. A group ends early if a delta outgrows its keyframe.
+			//1 (default) disables deltas. Takes effect on the next keyframe.
+			void setDepthKeyframeInterval(int interval);
+			inline int getDepthKeyframeInterval(){return mDepthKeyframeInterval;}
+
 		};
 
 	}
@@ -0,0 +1,107 @@
+#pragma once
+#include "RGBDFrame.h"
+#include <deque>
+#include <vector>
+#include <boost/thread.hpp>
+#include <boost/function.hpp>
+#include <boost/chrono.hpp>
+
+using namespace std;
+
+//Largest color to depth timestamp difference that still pairs. Half a frame at 30 fps
+#define FRAME_SYNC_DEFAULT_MAX_SKEW			16667
+//Longest a depth frame waits for its color frame before it is sent alone
+#define FRAME_SYNC_DEFAULT_MAX_WAIT_MS		50
+//Unpaired color frames kept while depth is behind
+#define FRAME_SYNC_MAX_PENDING_COLOR		8
+
+namespace rgbd
+{
+	namespace framework
+	{
+		struct FrameSyncStats
+		{
+			uint64_t pairedFrames;
+			//Depth frames sent without color because no color frame was within the skew in time
+			uint64_t depthOnlyFrames;
+			//Color frames that never paired
+			uint64_t droppedColorFrames;
+			//Absolute color to depth skew of paired frames
+			timestamp maxSkew;
+			double meanSkew;
+		};
+
+		/*
+		*	Class FrameSynchronizer
+		*	Pairs independent color and depth streams by timestamp.
+		*	Each depth frame is paired with the nearest color frame within the max skew. The color array is shared into the depth frame, not copied.
+		*	A depth frame is sent as soon as its best color frame is certain, or alone once it has waited max wait.
+		*	Max wait bounds the latency pairing adds. Max skew bounds how far apart paired images were captured.
+		*	Frames are delivered in depth order from an internal thread.
+		*	Thread safe. Color and depth may be added from different threads.
+		*/
+		class FrameSynchronizer
+		{
+		private:
+			//Make this class non construction-copyable
+			FrameSynchronizer( const FrameSynchronizer& other );
+			FrameSynchronizer& operator=( const FrameSynchronizer& );
+		public:
+			typedef boost::function<void (RGBDFramePtr)> FrameHandler;
+		protected:
+			struct PendingDepth
+			{
+				RGBDFramePtr frame;
+				boost::chrono::steady_clock::time_point deadline;
+			};
+
+			FrameHandler mHandler;
+
+			boost::mutex mGuard;
+			boost::condition_variable mFrameCond;
+			boost::thread mThread;
+			bool mIsStopping;
+			//Set by flush. Sends all pending depth frames without waiting
+			bool mFlushRequested;
+
+			deque<PendingDepth> mPendingDepth;
+			deque<RGBDFramePtr> mPendingColor;
+
+			timestamp mMaxSkew;
+			int mMaxWaitMs;
+
+			FrameSyncStats mStats;
+			double mSkewSum;
+
+			void run();
+
+			//Caller must hold mGuard. Moves every depth frame that can be decided now to ready, paired where possible
+			void collectReady(boost::chrono::steady_clock::time_point now, vector<RGBDFramePtr>& ready);
+
+			void dropColor();
+		public:
+			//handler receives paired and depth only frames
+			FrameSynchronizer(FrameHandler handler);
+			~FrameSynchronizer(void);
+
+			void addDepthFrame(RGBDFramePtr frame);
+			void addColorFrame(RGBDFramePtr frame);
+
+			//Sends every pending depth frame with the best color frame available now
+			void flush();
+
+			//Discards pending frames, e.g. when a stream restarts
+			void reset();
+
+			//In timestamp units (microseconds for OpenNI devices)
+			void setMaxSkew(timestamp maxSkew);
+			timestamp getMaxSkew();
+
+			void setMaxWait(int milliseconds);
+			int getMaxWait();
+
+			FrameSyncStats getStats();
+			void resetStats();
+		};
+	}
+}
@@ -0,0 +1,139 @@
+#pragma once
+//Canonical Huffman coding shared by the image codecs.
+//Code lengths are limited to HUFFMAN_MAX_CODE_LENGTH so a symbol decodes with a single table lookup.
+
+#include <stdint.h>
+#include <vector>
+
+using namespace std;
+
+#define HUFFMAN_MAX_CODE_LENGTH		12
+
+namespace rgbd
+{
+	namespace framework
+	{
+		//Computes code lengths no longer than HUFFMAN_MAX_CODE_LENGTH for count symbols. Unused symbols get length 0.
+		void buildHuffmanLengths(const uint32_t* frequencies, int count, uint8_t* lengths);
+
+		//Assigns canonical codes from code lengths. Returns false if the lengths don't form a valid prefix code.
+		bool buildCanonicalCodes(const uint8_t* lengths, int count, uint16_t* codes);
+
+		//Appends count code lengths to dest packed two per byte. count must be even.
+		void writeHuffmanLengths(const uint8_t* lengths, int count, vector<char>& dest);
+
+		//Reads count packed code lengths. Returns false if a length is out of range.
+		bool readHuffmanLengths(const char* src, int count, uint8_t* lengths);
+
+		//Number of bytes writeHuffmanLengths uses for count symbols
+		inline int getHuffmanLengthsSize(int count) {return count/2;}
+
+		/*
+		*	Class HuffmanBitWriter
+		*	MSB first bit writer appending to a byte vector.
+		*/
+		class HuffmanBitWriter
+		{
+		protected:
+			vector<char>& mOut;
+			uint64_t mBits;
+			int mCount;
+		public:
+			HuffmanBitWriter(vector<char>& out) : mOut(out), mBits(0), mCount(0) {}
+
+			//Writes the low n bits of bits. n must be 24 or less.
+			inline void write(uint32_t bits, int n)
+			{
+				mBits = (mBits << n) | bits;
+				mCount += n;
+				while(mCount >= 8)
+				{
+					mCount -= 8;
+					mOut.push_back((char) (mBits >> mCount));
+				}
+			}
+
+			//Pads the last byte with zeros
+			inline void flush()
+			{
+				if(mCount > 0)
+					mOut.push_back((char) (mBits << (8 - mCount)));
+				mCount = 0;
+			}
+		};
+
+		/*
+		*	Class HuffmanBitReader
+		*	MSB first bit reader. Reading past the end returns zeros and is detected by isOverrun.
+		*/
+		class HuffmanBitReader
+		{
+		protected:
+			const uint8_t* mIn;
+			const uint8_t* mEnd;
+			uint64_t mBits;//Left aligned
+			int mCount;
+			int mPaddedBytes;
+		public:
+			HuffmanBitReader(const char* in, const char* end) : mIn((const uint8_t*) in), mEnd((const uint8_t*) end), mBits(0), mCount(0), mPaddedBytes(0) {}
+
+			//Tops up the bit buffer to at least 57 bits
+			inline void refill()
+			{
+				while(mCount <= 56)
+				{
+					uint64_t byte = 0;
+					if(mIn < mEnd)
+						byte = *mIn++;
+					else
+						mPaddedBytes++;
+					mBits |= byte << (56 - mCount);
+					mCount += 8;
+				}
+			}
+
+			inline uint32_t peek(int n) {return (uint32_t) (mBits >> (64 - n));}
+
+			inline void consume(int n)
+			{
+				mBits <<= n;
+				mCount -= n;
+			}
+
+			//Reads n bits. Call refill first so at least n bits are buffered.
+			inline uint32_t read(int n)
+			{
+				uint32_t bits = peek(n);
+				consume(n);
+				return bits;
+			}
+
+			//True if more bits were consumed than the stream holds
+			inline bool isOverrun() {return mPaddedBytes*8 > mCount;}
+		};
+
+		/*
+		*	Class HuffmanDecodeTable
+		*	Direct lookup on the next HUFFMAN_MAX_CODE_LENGTH bits of the stream.
+		*/
+		class HuffmanDecodeTable
+		{
+		protected:
+			//symbol << 4 | code length. 0 marks codes no symbol uses
+			vector<uint16_t> mTable;
+		public:
+			//Returns false if the lengths don't form a valid prefix code
+			bool build(const uint8_t* lengths, int count);
+
+			//Decodes one symbol. Returns -1 on an invalid code. Call reader.refill() first.
+			inline int decode(HuffmanBitReader& reader)
+			{
+				uint16_t entry = mTable[reader.peek(HUFFMAN_MAX_CODE_LENGTH)];
+				if(entry == 0)
+					return -1;
+				reader.consume(entry & 0x0F);
+				return entry >> 4;
+			}
+		};
+	}
+}
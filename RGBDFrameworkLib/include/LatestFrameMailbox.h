@@ -0,0 +1,97 @@
+#pragma once
+#include "RGBDDevice.h"
+#include "SPSCRing.h"
+#include <boost/atomic.hpp>
+
+//Array references the producer can hand to the consumer for release before it has to drop them itself
+#define LATEST_FRAME_MAILBOX_RETIRE_CAPACITY		16
+
+namespace rgbd
+{
+	namespace framework
+	{
+		/*
+		*	Class LatestFrameMailbox
+		*	Hands the newest frame from one producer thread to one consumer thread without locks (a triple buffer).
+		*	The producer owns one slot, the consumer owns another and the third is swapped between them with a single atomic exchange,
+		*	so publish and consume never block each other.
+		*	Register it with a device (DISPATCH_LATEST fits) or call publish from a listener, then consume from the render or compute thread.
+		*	Each slot is a frame allocated up front. publish copies the frame's metadata into it and shares its arrays, so it never allocates.
+		*	Unsynced devices deliver color and depth in separate frames, and one could replace the other before the consumer looks.
+		*	So a stream missing from a frame is filled with the last array seen of that stream,
+		*	and every frame after the first of each stream has both.
+		*	Array references the producer drops are passed back to the consumer and released there, so the deleter of a pooled array,
+		*	which locks its pool, never runs in publish. publish is wait free as long as the consumer keeps calling consume.
+		*	If it stops, the retire ring fills after a few frames and publish releases the references itself.
+		*/
+		class LatestFrameMailbox : public RGBDDevice::NewRGBDFrameListener
+		{
+		private:
+			//Make this class non construction-copyable
+			LatestFrameMailbox( const LatestFrameMailbox& other );
+			LatestFrameMailbox& operator=( const LatestFrameMailbox& );
+		protected:
+			//Set in mMiddle when the middle slot holds a frame the consumer hasn't taken
+			static const int FRESH_FLAG = 4;
+			static const int SLOT_MASK = 3;
+
+			//References the producer dropped, waiting for the consumer to release them
+			struct RetiredArrays
+			{
+				ColorPixelArray color;
+				DPixelArray depth;
+				FrameSlab slab;
+			};
+
+			//Never replaced, only assigned into
+			RGBDFramePtr mSlots[3];
+			//Publish number of the frame in each slot
+			uint64_t mSequence[3];
+
+			//Owned by the producer
+			int mBack;
+			uint64_t mPublished;
+			//Newest array of each stream, filled into frames that lack it
+			ColorPixelArray mLastColorArray;
+			DPixelArray mLastDepthArray;
+			timestamp mLastColorTime, mLastDepthTime;
+
+			//Slot index plus FRESH_FLAG
+			boost::atomic<int> mMiddle;
+
+			//Pushed by the producer, drained by the consumer
+			SPSCRing<RetiredArrays> mRetired;
+
+			//Owned by the consumer
+			int mFront;
+			uint64_t mLastConsumed;
+			uint64_t mSkipped;
+
+			//Producer thread only. Passes the references to the consumer, or drops them here if the ring is full
+			void retire(const RetiredArrays& arrays);
+
+			//Consumer thread only
+			void releaseRetired();
+		public:
+			LatestFrameMailbox(void);
+
+			//Calls publish. Lets the mailbox be registered with a device directly
+			void onNewRGBDFrame(RGBDFramePtr frame) override;
+
+			//Producer thread only. Replaces any frame the consumer hasn't taken yet. frame itself is never modified. NULL frames are ignored
+			void publish(RGBDFramePtr frame);
+
+			//Consumer thread only. Returns the newest frame published since the last call, or NULL if there is none.
+			//The frame belongs to the mailbox and is valid until the next call that returns a frame. Copy its arrays to keep them.
+			//skipped is set to the number of frames published in between that the consumer never saw.
+			RGBDFramePtr consume(uint64_t& skipped);
+			RGBDFramePtr consume();
+
+			//True if consume would return a frame. Safe from any thread
+			inline bool hasNewFrame(){return (mMiddle.load() & FRESH_FLAG) != 0;}
+
+			//Consumer thread only. Frames skipped since construction
+			inline uint64_t getSkippedCount(){return mSkipped;}
+		};
+	}
+}
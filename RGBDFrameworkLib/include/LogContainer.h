@@ -0,0 +1,257 @@
+#pragma once
+//Single file, append-only log container.
+//
+//Layout on disk:
+//	LogContainerHeader
+//	Frame chunk 0: LogChunkHeader, color payload, depth payload
+//	Frame chunk 1: ...
+//	Index: LogIndexEntry for every chunk in write order
+//	LogIndexFooter
+//
+//Payloads start on LOG_CONTAINER_ALIGNMENT byte boundaries so uncompressed frames can be referenced in place.
+//If a recording is interrupted before the index is written, the reader rebuilds the index by walking the chunk headers.
+//
+//Version 2 depth payloads may be deltas against an earlier keyframe chunk (see LogChunkHeader::depthKeyframeDistance).
+//Version 1 logs always wrote zero there, so they read as all keyframes.
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include <fstream>
+#include <boost/shared_ptr.hpp>
+#include <boost/iostreams/device/mapped_file.hpp>
+#include "RGBDFrame.h"
+#include "FileUtils.h"
+
+using namespace std;
+
+#define LOG_CONTAINER_FILENAME		"log.rgbd"
+#define LOG_CONTAINER_VERSION		2
+#define LOG_CONTAINER_ALIGNMENT		16
+
+namespace rgbd
+{
+	namespace framework
+	{
+		//On disk log layouts.
+		//LOG_FORMAT_FILES is log.xml plus one .rgb and one .depth file per frame.
+		//LOG_FORMAT_CONTAINER stores every frame in a single indexed log.rgbd file.
+		enum LOG_FORMAT {LOG_FORMAT_FILES = 0, LOG_FORMAT_CONTAINER = 1};
+
+		const char LOG_CONTAINER_MAGIC[8] = {'R','G','B','D','L','O','G','\0'};
+		const uint32_t LOG_CHUNK_MAGIC = 0x454D5246;//"FRME"
+		const uint32_t LOG_INDEX_MAGIC = 0x58444E49;//"INDX"
+
+#pragma pack(push, 1)
+		struct LogContainerHeader
+		{
+			char magic[8];
+			uint32_t version;
+			int32_t xRes;
+			int32_t yRes;
+			uint32_t headerSize;
+		};
+
+		struct LogChunkHeader
+		{
+			uint32_t magic;
+			//Size of this header on disk. Payload begins at the next aligned offset after the header.
+			uint16_t headerSize;
+			uint8_t hasColor;
+			uint8_t hasDepth;
+			int32_t frameId;
+			timestamp colorTime;
+			timestamp depthTime;
+			uint8_t colorCompression;
+			uint8_t depthCompression;
+			//0 if the depth payload is self contained. Otherwise the payload is a delta (see computeDepthDelta) against
+			//the depth of the frame with id frameId - depthKeyframeDistance
+			uint16_t depthKeyframeDistance;
+			//Payload sizes in bytes, as stored (after compression)
+			uint32_t colorSize;
+			uint32_t depthSize;
+		};
+
+		struct LogIndexEntry
+		{
+			//Absolute file offset of the chunk header
+			uint64_t chunkOffset;
+			LogChunkHeader header;
+		};
+
+		struct LogIndexFooter
+		{
+			uint64_t indexOffset;
+			uint32_t frameCount;
+			uint32_t magic;
+		};
+#pragma pack(pop)
+
+		//Offset of the color payload relative to the start of the chunk
+		inline uint64_t getChunkColorOffset(const LogChunkHeader& header)
+		{
+			return (header.headerSize + LOG_CONTAINER_ALIGNMENT - 1) & ~((uint64_t) LOG_CONTAINER_ALIGNMENT - 1);
+		}
+
+		//Offset of the depth payload relative to the start of the chunk
+		inline uint64_t getChunkDepthOffset(const LogChunkHeader& header)
+		{
+			return (getChunkColorOffset(header) + header.colorSize + LOG_CONTAINER_ALIGNMENT - 1) & ~((uint64_t) LOG_CONTAINER_ALIGNMENT - 1);
+		}
+
+		//Total size of the chunk on disk including padding
+		inline uint64_t getChunkSize(const LogChunkHeader& header)
+		{
+			return (getChunkDepthOffset(header) + header.depthSize + LOG_CONTAINER_ALIGNMENT - 1) & ~((uint64_t) LOG_CONTAINER_ALIGNMENT - 1);
+		}
+
+		//A frame after compression, ready to be written to a log.
+		struct EncodedFrame
+		{
+			int id;
+			bool hasColor;
+			bool hasDepth;
+			timestamp colorTime;
+			timestamp depthTime;
+			COMPRESSION_METHOD colorCompression;
+			COMPRESSION_METHOD depthCompression;
+			//Id of the keyframe the depth payload is a delta against. 0 if the payload is self contained
+			int depthKeyframeId;
+			vector<char> colorData;
+			vector<char> depthData;
+
+			//Frame the payloads were encoded from. Streams stored without compression are written straight from its arrays.
+			RGBDFramePtr source;
+
+			EncodedFrame()
+			{
+				id = 0;
+				hasColor = false;
+				hasDepth = false;
+				colorTime = 0;
+				depthTime = 0;
+				colorCompression = NO_COMPRESSION;
+				depthCompression = NO_COMPRESSION;
+				depthKeyframeId = 0;
+			}
+
+			inline const char* getColorPayload() const
+			{
+				if(colorCompression == NO_COMPRESSION && source != NULL)
+					return (const char*) source->getColorArray().get();
+				return colorData.empty() ? NULL : &colorData[0];
+			}
+
+			inline uint32_t getColorPayloadSize() const
+			{
+				if(colorCompression == NO_COMPRESSION && source != NULL)
+					return source->getXRes()*source->getYRes()*sizeof(ColorPixel);
+				return (uint32_t) colorData.size();
+			}
+
+			inline const char* getDepthPayload() const
+			{
+				if(depthCompression == NO_COMPRESSION && source != NULL)
+					return (const char*) source->getDepthArray().get();
+				return depthData.empty() ? NULL : &depthData[0];
+			}
+
+			inline uint32_t getDepthPayloadSize() const
+			{
+				if(depthCompression == NO_COMPRESSION && source != NULL)
+					return source->getXRes()*source->getYRes()*sizeof(DPixel);
+				return (uint32_t) depthData.size();
+			}
+		};
+
+		/*
+		*	Class LogContainerWriter
+		*	Appends frame chunks to a single log file and writes the index footer on close.
+		*/
+		class LogContainerWriter
+		{
+		private:
+			LogContainerWriter( const LogContainerWriter& other ); // non construction-copyable
+			LogContainerWriter& operator=(const LogContainerWriter&);//Make not copiable
+
+		protected:
+			ofstream mFile;
+			uint64_t mOffset;
+			vector<LogIndexEntry> mIndex;
+
+			void writePadding(uint64_t alignedOffset);
+		public:
+			LogContainerWriter(void);
+			~LogContainerWriter(void);
+
+			//Creates the file and writes the container header. Returns false if the file could not be created.
+			bool open(string filename, int xRes, int yRes);
+
+			//Appends a frame chunk. Returns false if the write failed.
+			bool writeFrame(const EncodedFrame& frame);
+
+			//Writes the index footer and closes the file.
+			void close();
+
+			bool isOpen() {return mFile.is_open();}
+		};
+
+		/*
+		*	Class LogContainerReader
+		*	Loads the index of a log container and reads frame payloads with a single seek per frame.
+		*	Not thread safe. Use one reader per thread.
+		*/
+		class LogContainerReader
+		{
+		private:
+			LogContainerReader( const LogContainerReader& other ); // non construction-copyable
+			LogContainerReader& operator=(const LogContainerReader&);//Make not copiable
+
+		protected:
+			string mFilename;
+			ifstream mFile;
+			LogContainerHeader mHeader;
+			uint64_t mFileSize;
+
+			//Copy-on-write mapping of the whole log. Shared with every pixel array that views it.
+			boost::shared_ptr<boost::iostreams::mapped_file> mMapping;
+
+			//Reads the index footer. Returns false if the footer is missing or corrupt.
+			bool readIndexFooter(vector<LogIndexEntry>& index);
+
+			//Rebuilds the index by walking chunk headers from the start of the file.
+			void scanChunks(vector<LogIndexEntry>& index);
+		public:
+			LogContainerReader(void);
+			~LogContainerReader(void);
+
+			//Opens the file and validates the container header.
+			bool open(string filename);
+			void close();
+
+			//Loads the frame index from the footer, or rebuilds it if the log was not closed cleanly.
+			bool readIndex(vector<LogIndexEntry>& index);
+
+			//Reads a stored payload of size bytes at the given absolute file offset into buffer.
+			bool readPayload(uint64_t offset, uint32_t size, vector<char>& buffer);
+
+			//Reads a stored payload directly into dest. dest must hold at least size bytes.
+			bool readPayload(uint64_t offset, uint32_t size, char* dest);
+
+			//Memory maps the open log. The mapping is private, so writes to mapped pixels never reach the file.
+			//Returns false if the file could not be mapped.
+			bool mapFile();
+			bool isMapped() {return mMapping != NULL;}
+
+			//Returns a pointer to the payload inside the mapping, or NULL if not mapped or out of range.
+			//The pointer stays valid as long as the mapping owner (getMappingOwner) is referenced.
+			char* getMappedPayload(uint64_t offset, uint32_t size);
+			boost::shared_ptr<void> getMappingOwner() {return mMapping;}
+
+			inline int getXRes() {return mHeader.xRes;}
+			inline int getYRes() {return mHeader.yRes;}
+			bool isOpen() {return mFile.is_open();}
+		};
+
+	}
+}
@@ -1,21 +1,24 @@
 #pragma once
 #include "rgbddevice.h"
 #include "RGBDFrameFactory.h"
+#include "DecodedFrameCache.h"
+#include "DeviceGroup.h"
 #include <string>
 #include "FileUtils.h"
+#include "LogContainer.h"
 #include <ostream>
 #include <fstream>
 #include <sstream>
 #include <vector>
 #include <queue>
+#include <map>
 #include <boost/thread.hpp>
-#include "../rapidxml/rapidxml.hpp"
 #include <boost/date_time.hpp>
+#include <boost/chrono.hpp>
 #include <stdlib.h>
 #include <boost/lexical_cast.hpp>
 
 using namespace std;
-using namespace rapidxml;
 
 
 
@@ -26,14 +29,48 @@ namespace rgbd
 	
 
 
+		//How LogDevice paces playback.
+		//PLAYBACK_REAL_TIME delivers frames to listeners at their logged times, scaled by the playback speed.
+		//PLAYBACK_FREE_RUNNING delivers every frame to listeners as soon as it is decoded and the listeners can take it, without sleeping.
+		//PLAYBACK_PULL delivers nothing to listeners. The consumer takes frames one at a time with getNextFrame.
+		enum PLAYBACK_MODE {PLAYBACK_REAL_TIME = 0, PLAYBACK_FREE_RUNNING = 1, PLAYBACK_PULL = 2};
+
+		//Real time playback lateness. A frame's lateness is how long after its scheduled time it was handed to listeners
+		struct PlaybackTimingStats
+		{
+			uint64_t frames;
+			//Frames dispatched more than a millisecond late
+			uint64_t lateFrames;
+			//Microseconds
+			double meanLateness;
+			int64_t maxLateness;
+		};
+
 		struct FrameMetaData{
 			int id;
 			timestamp time;
 			COMPRESSION_METHOD compressionMode;
+			//Location of the stored payload. Only used by container logs
+			uint64_t offset;
+			uint32_t size;
+			//Id of the keyframe a depth delta payload was computed against. 0 if the payload is self contained
+			int keyframeId;
 			FrameMetaData(int id, timestamp time, COMPRESSION_METHOD compressionMode){
 				this->id = id;
 				this->time = time;
 				this->compressionMode = compressionMode;
+				offset = 0;
+				size = 0;
+				keyframeId = 0;
+			}
+
+			FrameMetaData(int id, timestamp time, COMPRESSION_METHOD compressionMode, uint64_t offset, uint32_t size){
+				this->id = id;
+				this->time = time;
+				this->compressionMode = compressionMode;
+				this->offset = offset;
+				this->size = size;
+				keyframeId = 0;
 			}
 
 			FrameMetaData()
@@ -41,9 +78,48 @@ namespace rgbd
 				id = 0;
 				time = 0;
 				compressionMode = NO_COMPRESSION;
+				offset = 0;
+				size = 0;
+				keyframeId = 0;
 			}
 		};
 
+		//Binary index written next to log.xml the first time it is parsed (log.xml.idx).
+		//Later loads map it instead of parsing the XML. It is rebuilt whenever log.xml changes size or modification time.
+		//Layout: LogSidecarHeader, then frameCount LogSidecarEntry in playback order.
+		#define LOG_SIDECAR_EXTENSION	".idx"
+		#define LOG_SIDECAR_VERSION		1
+		const uint32_t LOG_SIDECAR_MAGIC = 0x58444953;//"SIDX"
+
+#pragma pack(push, 1)
+		struct LogSidecarHeader
+		{
+			uint32_t magic;
+			uint32_t version;
+			//log.xml the index was built from
+			uint64_t sourceSize;
+			int64_t sourceWriteTime;
+			int32_t xRes;
+			int32_t yRes;
+			timestamp startTime;
+			uint32_t frameCount;
+		};
+
+		struct LogSidecarFrame
+		{
+			int32_t id;//0 if the stream has no frame in this entry
+			timestamp time;
+			uint8_t compressionMode;
+			int32_t keyframeId;
+		};
+
+		struct LogSidecarEntry
+		{
+			LogSidecarFrame depth;
+			LogSidecarFrame color;
+		};
+#pragma pack(pop)
+
 		struct SyncFrameMetaData{
 			FrameMetaData depthData;
 			FrameMetaData colorData;
@@ -65,49 +141,156 @@ namespace rgbd
 			}
 		};
 
+		//Per worker decode state. Container readers are not thread safe, so every decode worker reads through its own.
+		struct LogDecodeContext{
+			LogContainerReader reader;
+			vector<char> payloadBuffer;
+			//Last depth keyframe this worker decoded. Workers claim consecutive frames, so it usually serves a whole group
+			int keyframeId;
+			vector<DPixel> keyframeDepth;
+
+			LogDecodeContext()
+			{
+				keyframeId = 0;
+			}
+		};
+
 		class LogDevice :
-			public RGBDDevice
+			public RGBDDevice, public DeviceGroupSource
 		{
 		protected:
 			//Provides new frames 
 			RGBDFrameFactory mFrameFactory;
+			//Decoded frames keyed by index into mLogFrames. Disabled unless given a budget
+			DecodedFrameCache mFrameCache;
 			//Source directory for log files
 			string mDirectory;
 
 			//Resolution of logged data
 			int mXRes,mYRes;
 
+			//Layout of the log being played back
+			LOG_FORMAT mLogFormat;
+			//If true, log.xml logs are loaded through a binary sidecar index (see LogSidecarHeader)
+			bool mUseSidecarIndex;
+			//Reader for LOG_FORMAT_CONTAINER logs. Loads the index and owns the memory mapping. Decode workers open their own readers
+			string mContainerFile;
+			LogContainerReader mContainerReader;
+			boost::mutex mMappingGuard;
+			//If true, uncompressed container streams are played back as views into a memory mapping of the log. Only set by the user
+			bool mMemoryMappedPlayback;
+			//Set when the loaded log could not be mapped, so it is read instead. Reset by each load. Guarded by mMappingGuard
+			bool mMappingFailed;
+
 			//Stream frames for various 
 			vector<SyncFrameMetaData> mLogFrames;
 
 			//Stream management
 			bool mLoopStreams;
 			timestamp mStartTime;
-			boost::posix_time::ptime mPlaybackStartTime;
+			//Monotonic time at which playback time 0 was (or would have been) dispatched. Guarded by mBufferGuard
+			boost::chrono::steady_clock::time_point mPlaybackStartTime;
 			volatile bool mColorStreaming;
 			volatile bool mDepthStreaming;
 			volatile int mLogInd;
+			//Log time of the last dispatched frame, relative to mStartTime. Guarded by mBufferGuard
+			timestamp mLastDispatchTimeUS;
+
 
+			//Stream frame buffers. All guarded by mBufferGuard
+			size_t mBufferMemoryBudget;//Max bytes of decoded frames held ahead of the playhead, including frames being decoded
+			size_t mBufferedBytes;//Bytes in mStreamBuffer and mReorderBuffer
+			size_t mInFlightBytes;//Bytes claimed by workers that are still decoding
+			queue<BufferFrame> mStreamBuffer;//Decoded frames in playback order
+			map<int, BufferFrame> mReorderBuffer;//Decoded frames waiting for an earlier frame to finish, keyed by sequence number
+			int mNextDecodeSeq;//Sequence number of the next frame claimed by a worker
+			int mNextDeliverSeq;//Sequence number of the next frame to move to mStreamBuffer
+			int mBufferGeneration;//Incremented on seek/restart. Frames decoded for an older generation are dropped
+			boost::condition_variable mBufferCond;//Signaled whenever buffer state, position or streaming state changes
 
-			//Stream frame buffers.
-			int mBufferCapacity;//Max number of frames to buffer per stream
-			queue<BufferFrame> mStreamBuffer;
+			//Number of decode workers started with the streams
+			int mDecodeThreadCount;
 
 			//1.0 is normal, 0.5 is half speed, 2.0 is double speed, etc
 			double mPlaybackSpeed;
 
-			boost::thread mBufferThread;
+			//Guarded by mBufferGuard
+			PLAYBACK_MODE mPlaybackMode;
+			//Max frames delivered in free running mode and not yet acknowledged. 0 disables acknowledgement
+			int mAcknowledgeWindow;
+			int mUnacknowledgedFrames;
+
+			//Guarded by mBufferGuard
+			PlaybackTimingStats mTimingStats;
+			double mLatenessSum;
+
+			//If set, the group's workers decode and dispatch for this device instead of its own threads
+			DeviceGroup* mDeviceGroup;
+			//Set while a group worker is dispatching. Guarded by mBufferGuard
+			bool mGroupDispatching;
+			//Given to full frame listeners in group mode, so they wake the group once they take a frame
+			boost::function<void ()> mListenerSpaceHandler;
+			//Decode contexts lent to group workers. Guarded by mBufferGuard
+			vector<boost::shared_ptr<LogDecodeContext> > mIdleDecodeContexts;
+
+			vector<boost::shared_ptr<boost::thread> > mDecodeThreads;
 			boost::thread mEventThread;
 			boost::mutex mLogGuard;
 			boost::mutex mBufferGuard;
 			
 
-			void loadColorFrame(string sourceDir, FrameMetaData data, RGBDFramePtr frameOut, COMPRESSION_METHOD colorCompressMode);
-			void loadDepthFrame(string sourceDir, FrameMetaData data, RGBDFramePtr frameOut, COMPRESSION_METHOD depthCompressMode);
+			void loadColorFrame(LogDecodeContext& context, string sourceDir, FrameMetaData data, RGBDFramePtr frameOut, COMPRESSION_METHOD colorCompressMode);
+			void loadDepthFrame(LogDecodeContext& context, string sourceDir, FrameMetaData data, RGBDFramePtr frameOut, COMPRESSION_METHOD depthCompressMode);
+			//Reads and decompresses a stored depth payload into dest, which holds mXRes*mYRes pixels. Does not resolve deltas
+			void loadDepthPayload(LogDecodeContext& context, string sourceDir, FrameMetaData data, DPixel* dest);
+			//Makes context.keyframeDepth hold the depth of the given keyframe. Returns false if the keyframe is not in the log
+			bool loadKeyframe(LogDecodeContext& context, string sourceDir, int keyframeId);
 			void loadLog(string logFile);
+			//Streams log.xml one tag at a time. Returns false and reports the error if the log is invalid
+			bool parseLog(string logFile, vector<SyncFrameMetaData>& frames, timestamp& startTime);
+			//Loads the sidecar index of logFile. Returns false if it is missing or stale
+			bool loadSidecarIndex(string logFile, vector<SyncFrameMetaData>& frames, timestamp& startTime);
+			void saveSidecarIndex(string logFile, const vector<SyncFrameMetaData>& frames, timestamp startTime);
+			void loadContainer(string containerFile);
+			void loadPayload(LogDecodeContext& context, FrameMetaData data, char* outputArray, int memSize);
+			//Returns a pointer into the log mapping for an uncompressed full resolution payload, NULL if the payload must be decoded
+			char* getMappedPayload(FrameMetaData data, int memSize);
+			//Builds the playback frame for one synced log entry
+			RGBDFramePtr loadFrame(LogDecodeContext& context, SyncFrameMetaData frame);
+			//Claims the next log entry, decodes it outside the lock and publishes it in playback order.
+			//Caller must hold lock on mBufferGuard. Returns false if no entry can be claimed yet
+			bool decodeNextFrame(LogDecodeContext& context, boost::unique_lock<boost::mutex>& lock);
+			//Decode worker
 			void bufferFrames();
+			//Delivers the head frame if the playback mode allows it now. Caller must hold lock on mBufferGuard.
+			//Returns false otherwise and sets due to when the head frame is due, or time_point::max() to wait for a notification.
+			//In group mode the frame also stays buffered while a DISPATCH_ALL listener's queue is full, so a worker never blocks in post
+			bool dispatchNextFrame(boost::unique_lock<boost::mutex>& lock, boost::chrono::steady_clock::time_point& due);
 			void dispatchEvents();
-			void insertColorFrameToSyncedFrames(FrameMetaData colorData);
+			//Wakes playback threads or group workers after buffer state, position or streaming state changes
+			void notifyPlayback();
+			//Removes the next frame from mStreamBuffer and advances the playhead. Caller must hold mBufferGuard
+			RGBDFramePtr popBufferedFrame();
+			//Wall clock time a frame at playbackTimeUS is due at the current speed. Caller must hold mBufferGuard
+			boost::chrono::steady_clock::time_point getDueTime(timestamp playbackTimeUS);
+			//Moves the playback clock so the frame at playbackTimeUS is due now. Caller must hold mBufferGuard
+			void alignPlaybackClock(timestamp playbackTimeUS);
+			//True once every log entry has been handed out and playback won't loop. Caller must hold mBufferGuard
+			bool isPlaybackFinished();
+			//Starts decode workers and the dispatch thread
+			void startPlaybackThreads();
+			//Waits for playback threads to exit. Both streams must be stopped first
+			void joinPlaybackThreads();
+			//Empties all buffers and moves the decode position to logInd. Caller must hold mBufferGuard
+			void resetBuffer(int logInd);
+			//Budgeted size of one decoded frame
+			inline size_t getFrameBytes() {return mXRes*mYRes*(sizeof(ColorPixel) + sizeof(DPixel));}
+			//Moves the buffer thread to mLogFrames[logInd], drops buffered frames and aligns the playback clock to that frame
+			void seekToIndex(int logInd);
+			//Index of the first log entry with a depth id >= frameId, or mLogFrames.size() if none. Caller must hold mLogGuard
+			int findFrameIndex(int frameId);
+			//Index of the first log entry at or after the given time, or mLogFrames.size() if none. Caller must hold mLogGuard
+			int findTimestampIndex(timestamp time);
 		public:
 			LogDevice(void);
 			~LogDevice(void);
@@ -119,6 +302,23 @@ namespace rgbd
 
 			void restartPlayback();
 
+			//Jumps playback to the first frame at or after the given log timestamp (same units as the frame timestamps).
+			//Returns false if no frame in the log is that late. Playback position is unchanged in that case.
+			bool seekToTimestamp(timestamp time);
+
+			//Jumps playback to the first frame with an id greater than or equal to frameId.
+			//Returns false if the log has no such frame. Playback position is unchanged in that case.
+			bool seekToFrame(int frameId);
+
+			//Jumps playback to the depth keyframe of the first frame at or after the given log timestamp.
+			//Keyframes decode without a reference, so this is the cheapest place to resume playback.
+			//In logs without keyframe groups every frame is a keyframe and this is the same as seekToTimestamp.
+			//Returns false if no frame in the log is that late. Playback position is unchanged in that case.
+			bool seekToKeyframe(timestamp time);
+
+			//Number of synced frames in the loaded log
+			int getNumFrames();
+
 			void setSourceDirectory(string dir) { mDirectory = dir;}
 			string setSourceDirectory(){return mDirectory;}
 
@@ -152,10 +352,68 @@ namespace rgbd
 			bool getSyncColorAndDepth() override {return true;}
 			bool setSyncColorAndDepth(bool) override { return false;}
 
+			//If set to true, container logs are memory mapped and uncompressed streams are handed out as pixel arrays that point
+			//straight into the mapping instead of being copied into a freshly allocated frame.
+			//The mapping is copy-on-write, so listeners may modify frames without touching the log on disk.
+			//Each array keeps the mapping alive until it is released. Compressed streams and log.xml logs are decoded as usual.
+			//Takes effect on the next buffered frame.
+			inline void setMemoryMappedPlayback(bool mapped) {mMemoryMappedPlayback = mapped;}
+			inline bool getMemoryMappedPlayback(){return mMemoryMappedPlayback;}
+
+			//If set to true (default), connect() loads log.xml logs from a binary index next to the log and writes that index
+			//the first time a log is parsed. Logs in read-only directories are parsed every time.
+			inline void setUseSidecarIndex(bool use) {mUseSidecarIndex = use;}
+			inline bool getUseSidecarIndex(){return mUseSidecarIndex;}
+
+			//Plays back on the workers of group instead of threads of its own. NULL returns to own threads.
+			//Returns false while streaming. The device leaves the group when destroyed
+			bool setDeviceGroup(DeviceGroup* group);
+			inline DeviceGroup* getDeviceGroup(){return mDeviceGroup;}
+
+			//Decodes or dispatches one frame for a DeviceGroup worker
+			GROUP_TASK runGroupTask(boost::chrono::steady_clock::time_point& nextWake) override;
+
+			//Number of threads decoding frames ahead of the playhead. Frames are still delivered in log order.
+			//Takes effect the next time streams are started. Not used while in a DeviceGroup.
+			void setDecodeThreadCount(int threads);
+			inline int getDecodeThreadCount(){return mDecodeThreadCount;}
+
+			//Max bytes of decoded frames buffered ahead of the playhead. At least one frame is always buffered.
+			void setBufferMemoryBudget(size_t bytes);
+			inline size_t getBufferMemoryBudget(){return mBufferMemoryBudget;}
+
+			//Max bytes of decoded frames kept for later loops (see DecodedFrameCache). 0 (default) disables the cache.
+			//With a budget that covers the whole log, every loop after the first plays without reading or decoding anything.
+			//The cache is emptied whenever a log is loaded.
+			inline void setDecodedFrameCacheBudget(size_t bytes) {mFrameCache.setMemoryBudget(bytes);}
+			inline size_t getDecodedFrameCacheBudget(){return mFrameCache.getMemoryBudget();}
+			inline DecodedFrameCacheStats getDecodedFrameCacheStats(){return mFrameCache.getStats();}
+
 			//Getter/Setter for playback speed
 			//1.0 is normal, 0.5 is half speed, 2.0 is double speed, etc
 			void setPlaybackSpeed(double speed);
 			double getPlaybackSpeed(){return mPlaybackSpeed;}
+
+			//Lateness of frames dispatched in real time mode since the streams started or the stats were reset
+			PlaybackTimingStats getPlaybackTimingStats();
+			void resetPlaybackTimingStats();
+
+			//See PLAYBACK_MODE. Can be changed while streaming. Real time playback resumes from the last delivered frame
+			void setPlaybackMode(PLAYBACK_MODE mode);
+			PLAYBACK_MODE getPlaybackMode();
+
+			//In free running mode, stop delivering once this many frames are waiting for acknowledgeFrame.
+			//With a window of 1 each frame is sent only after the consumer is done with the previous one.
+			//0 (default) sends frames as fast as listeners accept them. Listeners registered with DISPATCH_ALL never miss one.
+			void setAcknowledgeWindow(int frames);
+			int getAcknowledgeWindow();
+			//Tells free running playback the consumer is done with the oldest delivered frame
+			void acknowledgeFrame();
+
+			//Pull mode only. Blocks until the next frame in log order is decoded and returns it.
+			//Returns NULL at the end of a non looping log, when the streams are stopped, after timeoutMs (negative waits forever),
+			//or if the device is not in pull mode.
+			RGBDFramePtr getNextFrame(int timeoutMs = -1);
 		};
 
 	}
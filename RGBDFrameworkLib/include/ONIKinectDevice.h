@@ -6,6 +6,7 @@
 #include <sstream>
 #include <boost/thread/mutex.hpp>
 #include "RGBDFrameFactory.h"
+#include "FrameSynchronizer.h"
 
 using namespace std;
 using namespace openni;
@@ -75,9 +76,8 @@ namespace rgbd
 			//Factory for frame
 			RGBDFrameFactory mFrameFactory;
 
-			//Lock for synchronized frames
-			boost::mutex frameGuard;
-			RGBDFramePtr mRGBDFrameSynced;
+			//Pairs color and depth when mSyncDepthAndColor is set
+			FrameSynchronizer mFrameSynchronizer;
 			bool mSyncDepthAndColor;
 		public:
 			ONIKinectDevice(void);
@@ -104,6 +104,9 @@ namespace rgbd
 			bool getSyncColorAndDepth() override {return mSyncDepthAndColor;}
 			bool setSyncColorAndDepth(bool sync) override { mSyncDepthAndColor = sync; return true;}
 
+			//Tune pairing skew and latency here
+			inline FrameSynchronizer& getFrameSynchronizer(){return mFrameSynchronizer;}
+
 			inline virtual Intrinsics getColorIntrinsics() 
 				{return Intrinsics(526.37013657, 526.37013657, 313.68782938, 259.01834898);}
 			inline virtual Intrinsics getDepthIntrinsics() 
@@ -1,6 +1,7 @@
 #pragma once
 #include "RGBDFrame.h"
 #include "Calibration.h"
+#include "EventDispatcher.h"
 #include <string>
 #include <vector>
 #include <algorithm>
@@ -61,11 +62,12 @@ namespace rgbd
 			};
 
 		protected:
-			//Collections of registered listeners 
-			std::vector<NewRGBDFrameListener*> mNewRGBDFrameListeners;
-			std::vector<DeviceConnectedListener*> mDeviceConnectedListeners;
-			std::vector<DeviceDisconnectedListener*> mDeviceDisconnectedListeners;
-			std::vector<DeviceMessageListener*> mDeviceMessageListeners;
+			//Collections of registered listeners. Each listener is called from its own dispatch thread
+			//Connect and disconnect events carry no data, the int is a placeholder
+			ListenerList<NewRGBDFrameListener, RGBDFramePtr> mNewRGBDFrameListeners;
+			ListenerList<DeviceConnectedListener, int> mDeviceConnectedListeners;
+			ListenerList<DeviceDisconnectedListener, int> mDeviceDisconnectedListeners;
+			ListenerList<DeviceMessageListener, std::string> mDeviceMessageListeners;
 
 		public:
 			//Destructor
@@ -113,17 +115,26 @@ namespace rgbd
 			virtual bool isColorStreamValid() = 0;
 
 			//Add event listeners
-			void addNewRGBDFrameListener(NewRGBDFrameListener* listener);
-			void addDeviceConnectedListener(DeviceConnectedListener* listener);
-			void addDeviceDisconnectedListener(DeviceDisconnectedListener* listener);
-			void addDeviceMessageListener(DeviceMessageListener* listener);
+			//Every registration gets a long lived thread that calls the listener in event order.
+			//policy decides what happens when the listener falls more than queueSize events behind (see DISPATCH_POLICY).
+			//Listeners that only display the newest frame should use DISPATCH_LATEST so a slow listener never stalls the device.
+			void addNewRGBDFrameListener(NewRGBDFrameListener* listener, DISPATCH_POLICY policy = DISPATCH_ALL, int queueSize = DISPATCH_DEFAULT_QUEUE_SIZE);
+			void addDeviceConnectedListener(DeviceConnectedListener* listener, DISPATCH_POLICY policy = DISPATCH_ALL, int queueSize = DISPATCH_DEFAULT_QUEUE_SIZE);
+			void addDeviceDisconnectedListener(DeviceDisconnectedListener* listener, DISPATCH_POLICY policy = DISPATCH_ALL, int queueSize = DISPATCH_DEFAULT_QUEUE_SIZE);
+			void addDeviceMessageListener(DeviceMessageListener* listener, DISPATCH_POLICY policy = DISPATCH_ALL, int queueSize = DISPATCH_DEFAULT_QUEUE_SIZE);
 
 			//Remove event listeners
-			void removeNewRGBDFrameListener(NewRGBDFrameListener* listener);
+			//Queued events are discarded. Once this returns the listener will not be called again,
+			//unless it is removed from its own callback, in which case that callback is the last one.
+			//With drainQueued, frames already queued for the listener are delivered before this returns instead.
+			void removeNewRGBDFrameListener(NewRGBDFrameListener* listener, bool drainQueued = false);
 			void removeDeviceConnectedListener(DeviceConnectedListener* listener);
 			void removeDeviceDisconnectedListener(DeviceDisconnectedListener* listener);
 			void removeDeviceMessageListener(DeviceMessageListener* listener);
 
+			//Queue depth and drop counters of a frame listener. Returns false if the listener is not registered
+			bool getNewRGBDFrameListenerStats(NewRGBDFrameListener* listener, DispatchStats& stats);
+
 			//Event handlers
 			void onNewRGBDFrame(RGBDFramePtr frame);
 			void onConnect();
@@ -5,6 +5,9 @@
 #include "boost/shared_ptr.hpp"
 #include "boost/shared_array.hpp"
 
+//Byte alignment of frame slabs and their rows
+#define RGBD_FRAME_ALIGNMENT		64
+
 
 namespace rgbd
 {
@@ -37,10 +40,37 @@ namespace rgbd
 		typedef boost::shared_array<DPixel> DPixelArray;
 		typedef boost::shared_array<ColorPixel> ColorPixelArray;
 
+		//Deleter for pixel arrays that point into memory owned by another object (e.g. a memory mapped log).
+		//Each array holds a reference to the owner, so the owner lives until the last array viewing it is released.
+		struct SharedOwnerDeleter
+		{
+			boost::shared_ptr<void> owner;
+
+			SharedOwnerDeleter(boost::shared_ptr<void> owner) : owner(owner) {}
+
+			void operator()(void*) const {}
+		};
+
+		//Allocates bytes aligned to RGBD_FRAME_ALIGNMENT. Returns NULL on failure. Release with alignedFree.
+		void* alignedAlloc(size_t bytes);
+		void alignedFree(void* data);
+
+		struct AlignedFreeDeleter
+		{
+			void operator()(void* data) const { alignedFree(data);}
+		};
+
+		//Owner of a slab holding both images of a frame
+		typedef boost::shared_ptr<uint8_t> FrameSlab;
+
 		class RGBDFrame
 		{
 		protected:
 			int mXRes, mYRes;
+			//Pixels from the start of one row to the next in both images. Equal to mXRes unless rows are padded
+			int mPitch;
+			//Slab the arrays were carved from, if any
+			FrameSlab mSlab;
 			timestamp mDepthTime, mColorTime;
 			bool mHasDepth, mHasColor;
 
@@ -66,6 +96,27 @@ namespace rgbd
 			//Other processes with DPixelArray or ColorPixelArray references may still use the data safely, but it will be deleted when the reference goes out of scope.
 			void setResolution(int width, int height, bool forceAlloc = false);
 
+			//Sets the resolution and points the frame at existing arrays without allocating or copying.
+			//Both arrays must hold at least width*height pixels.
+			//Use with SharedOwnerDeleter to wrap externally owned memory in a frame.
+			void setResolutionAndArrays(int width, int height, ColorPixelArray colorData, DPixelArray depthData);
+
+			//Like setResolution, but places depth and then color in a single RGBD_FRAME_ALIGNMENT aligned slab,
+			//so SIMD code can use aligned loads and the whole frame moves in one copy (see getSlab).
+			//With padRows, rows are padded to a multiple of RGBD_FRAME_ALIGNMENT pixels so every row of both images is aligned.
+			//Padded frames only work with code that indexes through getLinearIndex, getPitch or the row accessors.
+			//Most of the framework (file IO, codecs, logging) assumes tightly packed rows, so leave padRows off for frames passed to it.
+			void allocateSlab(int width, int height, bool padRows = false);
+
+			//Points the frame at a slab allocated elsewhere, laid out as described by the functions below.
+			//slab must hold at least getSlabSize(width, height, pitch) bytes.
+			void setResolutionAndSlab(int width, int height, int pitch, FrameSlab slab);
+
+			//Slab layout for a resolution
+			static int getSlabPitch(int width, bool padRows);
+			static size_t getSlabColorOffset(int height, int pitch);
+			static size_t getSlabSize(int height, int pitch);
+
 			//Writes 0 to all elements of depth image
 			void clearDepthImage(void);
 
@@ -214,7 +265,35 @@ namespace rgbd
 
 			inline int getLinearIndex(int x, int y)
 			{
-				return x+y*mXRes;
+				return x+y*mPitch;
+			}
+
+			inline int getPitch()
+			{
+				return mPitch;
+			}
+
+			inline DPixel* getDepthRow(int y)
+			{
+				return mDepthData.get() + y*mPitch;
+			}
+
+			inline ColorPixel* getColorRow(int y)
+			{
+				return mColorData.get() + y*mPitch;
+			}
+
+			//True while both arrays still point into the slab from allocateSlab or setResolutionAndSlab.
+			//The slab then holds the entire frame in getSlabSize(getYRes(), getPitch()) bytes
+			inline bool hasSlab()
+			{
+				return mSlab != NULL && (uint8_t*) mDepthData.get() == mSlab.get() &&
+					(uint8_t*) mColorData.get() == mSlab.get() + getSlabColorOffset(mYRes, mPitch);
+			}
+
+			inline FrameSlab getSlab()
+			{
+				return mSlab;
 			}
 
 		};
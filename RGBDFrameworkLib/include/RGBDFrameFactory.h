@@ -1,14 +1,150 @@
 #pragma once
 #include "RGBDFrame.h"
+#include <vector>
+#include <map>
+#include <boost/thread/mutex.hpp>
 
+using namespace std;
+
+//Idle frames and pixel arrays kept per resolution before extra ones are returned to the heap
+#define FRAME_POOL_DEFAULT_MAX_IDLE		16
 
 namespace rgbd
 {
 	namespace framework
 	{
+		//Snapshot of pool usage
+		struct FramePoolStats
+		{
+			//Pixel arrays and slabs served from the pool
+			uint64_t hits;
+			//Pixel arrays and slabs that had to be allocated
+			uint64_t misses;
+			//Frames and pixel arrays or slabs handed out and still referenced
+			int outstandingFrames;
+			int outstandingArrays;
+			//Pixel arrays and slabs waiting in the pool
+			int idleArrays;
+		};
+
+		/*
+		*	Class FramePool
+		*	Free lists shared by a factory and every frame and array it has handed out.
+		*	Pixel arrays are pooled separately from frame objects because devices move arrays between frames
+		*	(see ONIKinectDevice sync and RGBDFrame::overwriteColorData). An array returns when its own last reference dies.
+		*	Arrays are interchangeable between resolutions with the same pixel count, so lists are keyed by pixel count.
+		*	All memory is RGBD_FRAME_ALIGNMENT aligned.
+		*/
+		class FramePool
+		{
+		protected:
+			boost::mutex mGuard;
+			vector<RGBDFrame*> mIdleFrames;
+			map<int, vector<DPixel*> > mIdleDepth;
+			map<int, vector<ColorPixel*> > mIdleColor;
+			//Frame slabs, keyed by size in bytes
+			map<int, vector<uint8_t*> > mIdleSlabs;
+
+			int mMaxIdle;
+			//Once closed everything returned is freed
+			bool mIsClosed;
+			FramePoolStats mStats;
+
+			template<typename T>
+			T* takeArray(map<int, vector<T*> >& idle, int pixelCount);
+
+			template<typename T>
+			void returnArray(map<int, vector<T*> >& idle, T* data, int pixelCount);
+
+			template<typename T>
+			void freeArrays(map<int, vector<T*> >& idle);
+		public:
+			FramePool(void);
+			~FramePool(void);
+
+			RGBDFrame* takeFrame();
+			void returnFrame(RGBDFrame* frame);
+
+			DPixel* takeDepth(int pixelCount);
+			void returnDepth(DPixel* data, int pixelCount);
+
+			ColorPixel* takeColor(int pixelCount);
+			void returnColor(ColorPixel* data, int pixelCount);
+
+			uint8_t* takeSlab(int bytes);
+			void returnSlab(uint8_t* data, int bytes);
+
+			void setMaxIdle(int maxIdle);
+			int getMaxIdle();
+
+			FramePoolStats getStats();
+
+			//Frees all idle memory and stops pooling. Called when the factory is destroyed
+			void close();
+		};
+
+		typedef boost::shared_ptr<FramePool> FramePoolPtr;
+
+		//Deleters that hand frames and arrays back to their pool instead of freeing them.
+		//Each holds a reference to the pool, so the pool outlives its factory until the last frame is gone.
+		struct PooledFrameDeleter
+		{
+			FramePoolPtr pool;
+
+			PooledFrameDeleter(FramePoolPtr pool) : pool(pool) {}
 
+			void operator()(RGBDFrame* frame) const { pool->returnFrame(frame);}
+		};
+
+		struct PooledDepthDeleter
+		{
+			FramePoolPtr pool;
+			int pixelCount;
+
+			PooledDepthDeleter(FramePoolPtr pool, int pixelCount) : pool(pool), pixelCount(pixelCount) {}
+
+			void operator()(DPixel* data) const { pool->returnDepth(data, pixelCount);}
+		};
+
+		struct PooledColorDeleter
+		{
+			FramePoolPtr pool;
+			int pixelCount;
+
+			PooledColorDeleter(FramePoolPtr pool, int pixelCount) : pool(pool), pixelCount(pixelCount) {}
+
+			void operator()(ColorPixel* data) const { pool->returnColor(data, pixelCount);}
+		};
+
+		struct PooledSlabDeleter
+		{
+			FramePoolPtr pool;
+			int bytes;
+
+			PooledSlabDeleter(FramePoolPtr pool, int bytes) : pool(pool), bytes(bytes) {}
+
+			void operator()(uint8_t* data) const { pool->returnSlab(data, bytes);}
+		};
+
+		/*
+		*	Class RGBDFrameFactory
+		*	Hands out frames whose objects and pixel arrays are recycled once their last reference is released.
+		*	After warm up, capture and playback at a fixed resolution reuse the same memory instead of allocating
+		*	about 1.5 MB per VGA frame. Only the small shared pointer control blocks are still allocated.
+		*	Thread safe.
+		*/
 		class RGBDFrameFactory
 		{
+		private:
+			//Make this class non construction-copyable
+			RGBDFrameFactory( const RGBDFrameFactory& other );
+			RGBDFrameFactory& operator=( const RGBDFrameFactory& );
+		protected:
+			FramePoolPtr mPool;
+
+			//Frames with a resolution get one slab for both images instead of two arrays (see RGBDFrame::allocateSlab)
+			bool mUseSlabs;
+			bool mPadRows;
 		public:
 			RGBDFrameFactory(void);
 			~RGBDFrameFactory(void);
@@ -17,14 +153,30 @@ namespace rgbd
 			//Returns a frame with no memory allocated.
 			//The frame is guaranteed to be unused by other processes assuming other processes do not cast RGBDFramePtr to raw pointer
 			//Metadata will be reset by the factory
-			RGBDFramePtr getRGBDFrame(); 
+			RGBDFramePtr getRGBDFrame();
 
 			//Returns a frame with the specified resolution
 			//The frame is guaranteed to be unused by other processes assuming other processes do not cast RGBDFramePtr to raw pointer
 			//The memory is not garunteed to be clear. As an optimization, this has been left to the user code to specify
-			RGBDFramePtr getRGBDFrame(int width, int height); 
+			RGBDFramePtr getRGBDFrame(int width, int height);
+
+			//Returns pooled pixel arrays of pixelCount pixels. Contents are not cleared
+			DPixelArray getDepthArray(int pixelCount);
+			ColorPixelArray getColorArray(int pixelCount);
+
+			//Limits how many idle frames, and idle arrays of each size, the pool keeps. Extra ones are freed when released.
+			inline void setMaxIdleFrames(int maxIdle){ mPool->setMaxIdle(maxIdle);}
+			inline int getMaxIdleFrames(){return mPool->getMaxIdle();}
+
+			inline FramePoolStats getPoolStats(){return mPool->getStats();}
+
+			//If true (default), getRGBDFrame(width, height) carves both images from one aligned slab.
+			//padRows pads rows to an aligned pitch. Only enable it for consumers that honor RGBDFrame::getPitch.
+			inline void setSlabAllocation(bool useSlabs, bool padRows = false){ mUseSlabs = useSlabs; mPadRows = padRows;}
+			inline bool getSlabAllocation(){return mUseSlabs;}
+			inline bool getPadRows(){return mPadRows;}
 		};
 
 
 	}
-}
\ No newline at end of file
+}
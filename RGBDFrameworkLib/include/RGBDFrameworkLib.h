@@ -1,10 +1,21 @@
 #pragma once
 
+#include "AdaptiveCompressionPolicy.h"
+#include "ColorCodec.h"
+#include "DecodedFrameCache.h"
+#include "DepthCodec.h"
+#include "DeviceGroup.h"
+#include "EventDispatcher.h"
 #include "FileUtils.h"
 #include "FrameLogger.h"
+#include "FrameSynchronizer.h"
+#include "LatestFrameMailbox.h"
+#include "LogContainer.h"
 #include "LogDevice.h"
 #include "ONIKinectDevice.h"
 #include "RGBDFrame.h"
 #include "RGBDDevice.h"
 #include "RGBDFrameFactory.h"
+#include "SyntheticDevice.h"
 
+#include "SPSCRing.h"
@@ -0,0 +1,29 @@
+#pragma once
+//Compile time SIMD configuration shared by the codecs and image filters.
+
+//SSE2 is available on every x64 target. Define RGBD_NO_SIMD to force the scalar paths.
+#if !defined(RGBD_NO_SIMD) && (defined(_M_X64) || defined(__SSE2__) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define RGBD_USE_SSE2
+#endif
+
+//AVX2 kernels are compiled in wherever the compiler can emit them without targeting AVX2 for the whole file (VS2012 and up,
+//GCC and Clang), and only run when cpuHasAVX2() is true. Other builds fall back to SSE2. Define RGBD_NO_AVX2 to leave them out
+#if defined(RGBD_USE_SSE2) && !defined(RGBD_NO_AVX2) && (defined(__AVX2__) || defined(__GNUC__) || (defined(_MSC_VER) && _MSC_VER >= 1700))
+#define RGBD_USE_AVX2
+#endif
+
+//Marks functions holding AVX2 code. GCC and Clang only emit AVX2 instructions inside functions targeting it
+#if defined(RGBD_USE_AVX2) && defined(__GNUC__)
+#define RGBD_AVX2_TARGET __attribute__((target("avx2")))
+#else
+#define RGBD_AVX2_TARGET
+#endif
+
+namespace rgbd
+{
+	namespace framework
+	{
+		//True if the CPU and the OS support AVX2. Detected once, the first time it is called
+		bool cpuHasAVX2();
+	}
+}
@@ -0,0 +1,84 @@
+#pragma once
+#include <vector>
+#include <boost/atomic.hpp>
+
+using namespace std;
+
+//Bytes between the producer and consumer indices so they don't share a cache line
+#define SPSC_RING_PADDING		64
+
+namespace rgbd
+{
+	namespace framework
+	{
+		/*
+		*	Class SPSCRing
+		*	Fixed size lock free queue for exactly one producer thread and one consumer thread.
+		*	Capacity is rounded up to a power of two. T must be default constructible and assignable.
+		*	Popped slots are reset to T() so the ring doesn't keep references (e.g. frames) alive.
+		*/
+		template<typename T>
+		class SPSCRing
+		{
+		private:
+			//Make this class non construction-copyable
+			SPSCRing( const SPSCRing& other );
+			SPSCRing& operator=( const SPSCRing& );
+		protected:
+			vector<T> mSlots;
+			size_t mMask;
+
+			//Next slot to read. Written by the consumer only
+			boost::atomic<size_t> mHead;
+			char mPadding[SPSC_RING_PADDING];
+			//Next slot to write. Written by the producer only
+			boost::atomic<size_t> mTail;
+		public:
+			SPSCRing(int capacity)
+			{
+				size_t size = 1;
+				while(size < (size_t) max(capacity, 1))
+					size <<= 1;
+				mSlots.resize(size);
+				mMask = size - 1;
+				mHead = 0;
+				mTail = 0;
+			}
+
+			inline int getCapacity(){return (int) mSlots.size();}
+
+			//Approximate when called from a third thread
+			inline int size(){return (int) (mTail.load() - mHead.load());}
+
+			inline bool empty(){return mTail.load() == mHead.load();}
+
+			inline bool full(){return size() >= getCapacity();}
+
+			//Producer only. Returns false if the ring is full
+			bool push(const T& item)
+			{
+				size_t tail = mTail.load(boost::memory_order_relaxed);
+				if(tail - mHead.load() >= mSlots.size())
+					return false;
+
+				mSlots[tail & mMask] = item;
+				mTail.store(tail + 1);
+				return true;
+			}
+
+			//Consumer only. Returns false if the ring is empty
+			bool pop(T& item)
+			{
+				size_t head = mHead.load(boost::memory_order_relaxed);
+				if(head == mTail.load())
+					return false;
+
+				T& slot = mSlots[head & mMask];
+				item = slot;
+				slot = T();
+				mHead.store(head + 1);
+				return true;
+			}
+		};
+	}
+}
@@ -0,0 +1,205 @@
+#pragma once
+#include "RGBDDevice.h"
+#include "RGBDFrameFactory.h"
+#include <vector>
+#include <boost/thread.hpp>
+#include <boost/chrono.hpp>
+
+using namespace std;
+
+//Kinect depth camera the default intrinsics and noise model are taken from
+#define SYNTHETIC_KINECT_X_RES			640
+#define SYNTHETIC_KINECT_Y_RES			480
+#define SYNTHETIC_KINECT_BASELINE		0.075f
+//Depth error grows with the square of range (Khoshelham and Elberink 2012)
+#define SYNTHETIC_KINECT_NOISE_COEFF	1.425e-3f
+//The Kinect reports disparity in 1/8 pixel steps
+#define SYNTHETIC_KINECT_SUBPIXEL		8.0f
+
+namespace rgbd
+{
+	namespace framework
+	{
+		struct SyntheticVec3
+		{
+			float x, y, z;
+			SyntheticVec3() : x(0.0f), y(0.0f), z(0.0f) {}
+			SyntheticVec3(float _x, float _y, float _z) : x(_x), y(_y), z(_z) {}
+		};
+
+		//Infinite plane of points p with dot(normal, p) = distance, in world meters
+		struct SyntheticPlane
+		{
+			SyntheticVec3 normal;
+			float distance;
+			ColorPixel color;
+		};
+
+		//Axis aligned box in world meters. Each face reports as its own plane in the ground truth
+		struct SyntheticBox
+		{
+			SyntheticVec3 minCorner;
+			SyntheticVec3 maxCorner;
+			ColorPixel color;
+		};
+
+		//Camera pose at a point in the trajectory. The world frame is the camera frame at the identity pose:
+		//x right, y down, z forward, like Kinect camera coordinates. Yaw turns about y, then pitch about x.
+		struct SyntheticPose
+		{
+			double time;//seconds from the start of the trajectory
+			SyntheticVec3 position;
+			float yaw, pitch;//radians
+		};
+
+		struct SyntheticNoiseModel
+		{
+			//Scales the Kinect range dependent depth noise. 0 renders exact depth
+			float depthNoiseScale;
+			//Quantize depth to the Kinect's 1/8 pixel disparity steps
+			bool quantizeDisparity;
+			//Readings outside this range in meters are dropped to 0
+			float minRange, maxRange;
+			//Surfaces seen at a steeper angle (cosine of ray to normal below this) return no depth
+			float minIncidenceCos;
+			//Standard deviation of color noise in levels
+			float colorNoise;
+		};
+
+		//Ground truth for one planar surface in one frame, in camera coordinates and meters.
+		//Matches the norm, centroid and count fields of the mesh tracker's PlaneStats.
+		struct SyntheticPlaneStats
+		{
+			//Index of the plane, or of the box after all planes
+			int primitive;
+			//Box face (0..5 for -x,+x,-y,+y,-z,+z). 0 for planes
+			int face;
+			//Unit normal pointing toward the camera. Points p on the surface satisfy dot(normal, p) = -distance
+			SyntheticVec3 normal;
+			float distance;
+			//Mean of the noise free points of the visible pixels
+			SyntheticVec3 centroid;
+			int count;
+		};
+
+		/*
+		*	Class SyntheticDevice
+		*	Renders depth and color of a scene of planes and boxes analytically, seen from a camera moving along a trajectory.
+		*	Depth goes through a Kinect like noise and disparity quantization model.
+		*	Resolution and frame rate are free, and with real time playback off frames are generated as fast as listeners take them,
+		*	so the pipeline can be stressed without a sensor or a recorded log.
+		*	Frame n has timestamp n/frameRate seconds in microseconds and renders the same image every time.
+		*	A default room scene is loaded on construction.
+		*/
+		class SyntheticDevice : public RGBDDevice
+		{
+		private:
+			//Make this class non construction-copyable
+			SyntheticDevice( const SyntheticDevice& other );
+			SyntheticDevice& operator=( const SyntheticDevice& );
+		protected:
+			RGBDFrameFactory mFrameFactory;
+
+			int mXRes, mYRes;
+			double mFrameRate;
+			bool mRealTimePlayback;
+			//Stop after this many frames. 0 runs until the streams are destroyed
+			int mFrameLimit;
+			bool mLoopTrajectory;
+
+			//Scene, trajectory and noise are guarded by mSceneGuard
+			boost::mutex mSceneGuard;
+			vector<SyntheticPlane> mPlanes;
+			vector<SyntheticBox> mBoxes;
+			vector<SyntheticPose> mTrajectory;
+			SyntheticNoiseModel mNoise;
+
+			bool mIsConnected;
+			volatile bool mColorStreaming;
+			volatile bool mDepthStreaming;
+			volatile int mFramesGenerated;
+			boost::thread mStreamThread;
+
+			void generateFrames();
+			void startStreamThread();
+			void joinStreamThread();
+
+			//Caller must hold mSceneGuard
+			SyntheticPose getPose(double time);
+		public:
+			SyntheticDevice(void);
+			~SyntheticDevice(void);
+
+			DeviceStatus initialize(void) override;
+			DeviceStatus connect(void) override;
+			DeviceStatus disconnect(void) override;
+			DeviceStatus shutdown(void) override;
+
+			bool hasDepthStream() override {return mDepthStreaming;}
+			bool hasColorStream() override {return mColorStreaming;}
+
+			bool createColorStream() override;
+			bool createDepthStream() override;
+
+			bool destroyColorStream() override;
+			bool destroyDepthStream() override;
+
+			//Both images come from the same render
+			bool getSyncColorAndDepth() override {return true;}
+			bool setSyncColorAndDepth(bool sync) override {return sync;}
+
+			//Kinect intrinsics scaled to the configured resolution. Color is rendered registered to depth
+			Intrinsics getColorIntrinsics() override;
+			Intrinsics getDepthIntrinsics() override;
+
+			int getDepthResolutionX() override {return mXRes;}
+			int getDepthResolutionY() override {return mYRes;}
+			int getColorResolutionX() override {return mXRes;}
+			int getColorResolutionY() override {return mYRes;}
+			bool isDepthStreamValid() override {return mIsConnected;}
+			bool isColorStreamValid() override {return mIsConnected;}
+
+			//Returns false while streaming
+			bool setResolution(int xRes, int yRes);
+
+			//Frames per second of device time. Sets the timestamp spacing, and the delivery rate during real time playback
+			void setFrameRate(double fps);
+			inline double getFrameRate(){return mFrameRate;}
+
+			//If false, frames are rendered back to back. Listeners registered with DISPATCH_ALL then set the pace
+			inline void setRealTimePlayback(bool realTime){ mRealTimePlayback = realTime;}
+			inline bool getRealTimePlayback(){return mRealTimePlayback;}
+
+			//Streams stop on their own after this many frames, and hasColorStream and hasDepthStream return false. 0 (default) is unlimited
+			inline void setFrameLimit(int frames){ mFrameLimit = frames;}
+			inline int getFrameLimit(){return mFrameLimit;}
+
+			//Frames delivered since the streams were created
+			inline int getFramesGenerated(){return mFramesGenerated;}
+
+			//Scene setup. Safe while streaming, takes effect on the next frame
+			void clearScene();
+			void addPlane(const SyntheticPlane& plane);
+			void addBox(const SyntheticBox& box);
+			//Floor, two walls and a table sized box, with a slow pan
+			void loadDefaultScene();
+
+			//Poses are interpolated linearly and must be added in time order. Without poses the camera stays at the identity pose
+			void clearTrajectory();
+			void addTrajectoryPose(const SyntheticPose& pose);
+			//If true (default), the trajectory repeats after its last pose. Otherwise the camera stops there
+			inline void setLoopTrajectory(bool loop){ mLoopTrajectory = loop;}
+			inline bool getLoopTrajectory(){return mLoopTrajectory;}
+
+			void setNoiseModel(const SyntheticNoiseModel& noise);
+			SyntheticNoiseModel getNoiseModel();
+
+			//Renders frame frameIndex into frame, which must have the device resolution, and sets its timestamps.
+			//If groundTruth is given it receives one entry per visible surface.
+			void renderFrame(int frameIndex, RGBDFramePtr frame, vector<SyntheticPlaneStats>* groundTruth = NULL);
+
+			//Timestamp of frame frameIndex
+			timestamp getFrameTimestamp(int frameIndex);
+		};
+	}
+}
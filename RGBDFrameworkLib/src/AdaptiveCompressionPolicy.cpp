@@ -0,0 +1,159 @@
+#include "AdaptiveCompressionPolicy.h"
+#include <float.h>
+
+namespace rgbd
+{
+	namespace framework
+	{
+		//Candidates per stream, cheapest to encode first
+		static const COMPRESSION_METHOD COLOR_METHODS[] = {NO_COMPRESSION, LZ4_COMPRESSION, COLOR_YCOCG_COMPRESSION};
+		static const COMPRESSION_METHOD DEPTH_METHODS[] = {NO_COMPRESSION, LZ4_COMPRESSION, DEPTH_PREDICTIVE_COMPRESSION};
+
+		//Assumed until the device has delivered two frames
+		static const double DEFAULT_FRAME_PERIOD = 1.0/30.0;
+
+		//Share of worker and disk capacity the policy plans to use with an empty queue
+		static const double MAX_UTILIZATION = 0.9;
+
+		static inline double smooth(double average, double sample)
+		{
+			return average + ADAPTIVE_COMPRESSION_SMOOTHING*(sample - average);
+		}
+
+		AdaptiveCompressionPolicy::AdaptiveCompressionPolicy(void)
+		{
+			reset();
+		}
+
+		void AdaptiveCompressionPolicy::reset()
+		{
+			for(int i = 0; i < METHOD_COUNT; i++)
+			{
+				mStats[ADAPTIVE_STREAM_COLOR][i].method = COLOR_METHODS[i];
+				mStats[ADAPTIVE_STREAM_DEPTH][i].method = DEPTH_METHODS[i];
+				for(int stream = 0; stream < 2; stream++)
+				{
+					mStats[stream][i].hasSample = false;
+					mStats[stream][i].lastSampleFrame = 0;
+					mStats[stream][i].encodeSeconds = 0.0;
+					mStats[stream][i].bytes = 0.0;
+				}
+			}
+
+			mFramePeriod = DEFAULT_FRAME_PERIOD;
+			mHasLastArrival = false;
+			mWriteRate = 0.0;
+		}
+
+		AdaptiveCompressionPolicy::MethodStats* AdaptiveCompressionPolicy::getStats(ADAPTIVE_STREAM stream, COMPRESSION_METHOD method)
+		{
+			for(int i = 0; i < METHOD_COUNT; i++)
+				if(mStats[stream][i].method == method)
+					return &mStats[stream][i];
+			return NULL;
+		}
+
+		void AdaptiveCompressionPolicy::onFrameArrival()
+		{
+			boost::chrono::steady_clock::time_point now = boost::chrono::steady_clock::now();
+			if(mHasLastArrival)
+			{
+				double period = boost::chrono::duration<double>(now - mLastArrival).count();
+				mFramePeriod = smooth(mFramePeriod, period);
+			}
+			mLastArrival = now;
+			mHasLastArrival = true;
+		}
+
+		void AdaptiveCompressionPolicy::addEncodeSample(ADAPTIVE_STREAM stream, COMPRESSION_METHOD method, int frameId, double encodeSeconds, uint32_t bytes)
+		{
+			MethodStats* stats = getStats(stream, method);
+			if(stats == NULL)
+				return;
+
+			if(stats->hasSample)
+			{
+				stats->encodeSeconds = smooth(stats->encodeSeconds, encodeSeconds);
+				stats->bytes = smooth(stats->bytes, (double) bytes);
+			}else{
+				stats->encodeSeconds = encodeSeconds;
+				stats->bytes = (double) bytes;
+				stats->hasSample = true;
+			}
+			stats->lastSampleFrame = max(stats->lastSampleFrame, frameId);
+		}
+
+		void AdaptiveCompressionPolicy::addWriteSample(double writeSeconds, uint32_t bytes)
+		{
+			//Writes absorbed by the OS cache finish instantly and say nothing about the disk
+			if(writeSeconds <= 0.0 || bytes == 0)
+				return;
+
+			double rate = bytes/writeSeconds;
+			mWriteRate = (mWriteRate > 0.0) ? smooth(mWriteRate, rate) : rate;
+		}
+
+		void AdaptiveCompressionPolicy::selectMethods(int frameId, double queueFill, int workerThreads, COMPRESSION_METHOD& colorMethod, COMPRESSION_METHOD& depthMethod)
+		{
+			double cpuBudget = max(workerThreads, 1)*mFramePeriod;
+			double diskBudget = (mWriteRate > 0.0) ? mWriteRate*mFramePeriod : DBL_MAX;
+			double targetLoad = MAX_UTILIZATION*max(1.0 - queueFill, 0.0);
+
+			//Fewest bytes within the target load. If nothing fits, the least loaded pair
+			int bestColor = 0, bestDepth = 0;
+			double bestBytes = DBL_MAX;
+			double bestLoad = DBL_MAX;
+			bool foundFit = false;
+			for(int c = 0; c < METHOD_COUNT; c++)
+			{
+				const MethodStats& color = mStats[ADAPTIVE_STREAM_COLOR][c];
+				if(!color.hasSample)
+					continue;
+				for(int d = 0; d < METHOD_COUNT; d++)
+				{
+					const MethodStats& depth = mStats[ADAPTIVE_STREAM_DEPTH][d];
+					if(!depth.hasSample)
+						continue;
+
+					double bytes = color.bytes + depth.bytes;
+					double load = max((color.encodeSeconds + depth.encodeSeconds)/cpuBudget, bytes/diskBudget);
+					bool fits = load <= targetLoad;
+					if(fits && (!foundFit || bytes < bestBytes))
+					{
+						foundFit = true;
+						bestBytes = bytes;
+						bestColor = c;
+						bestDepth = d;
+					}else if(!foundFit && load < bestLoad){
+						bestLoad = load;
+						bestColor = c;
+						bestDepth = d;
+					}
+				}
+			}
+
+			//Measure methods that have not been tried lately, but only while there is slack
+			if(queueFill < 0.5)
+			{
+				for(int stream = 0; stream < 2; stream++)
+				{
+					int& best = (stream == ADAPTIVE_STREAM_COLOR) ? bestColor : bestDepth;
+					for(int i = 0; i < METHOD_COUNT; i++)
+					{
+						//Samples arrive after the frame is compressed. Count the probe as the sample so it isn't repeated meanwhile
+						MethodStats& stats = mStats[stream][i];
+						if((!stats.hasSample && stats.lastSampleFrame == 0) || frameId - stats.lastSampleFrame > ADAPTIVE_COMPRESSION_PROBE_INTERVAL)
+						{
+							stats.lastSampleFrame = frameId;
+							best = i;
+							break;
+						}
+					}
+				}
+			}
+
+			colorMethod = mStats[ADAPTIVE_STREAM_COLOR][bestColor].method;
+			depthMethod = mStats[ADAPTIVE_STREAM_DEPTH][bestDepth].method;
+		}
+	}
+}
@@ -0,0 +1,302 @@
+#include "ColorCodec.h"
+#include "HuffmanCoder.h"
+#include <string.h>
+
+#ifdef RGBD_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace rgbd
+{
+	namespace framework
+	{
+		//Arithmetic shift right of a byte interpreted as signed
+		static inline uint8_t halfSigned(uint8_t v)
+		{
+			return (uint8_t) (((int8_t) v) >> 1);
+		}
+
+		static inline void forwardYCoCg(uint8_t r, uint8_t g, uint8_t b, uint8_t& y, uint8_t& co, uint8_t& cg)
+		{
+			co = (uint8_t) (r - b);
+			uint8_t t = (uint8_t) (b + halfSigned(co));
+			cg = (uint8_t) (g - t);
+			y = (uint8_t) (t + halfSigned(cg));
+		}
+
+		static inline void inverseYCoCg(uint8_t y, uint8_t co, uint8_t cg, uint8_t& r, uint8_t& g, uint8_t& b)
+		{
+			uint8_t t = (uint8_t) (y - halfSigned(cg));
+			g = (uint8_t) (cg + t);
+			b = (uint8_t) (t - halfSigned(co));
+			r = (uint8_t) (b + co);
+		}
+
+#ifdef RGBD_USE_SSE2
+		//SSE2 has no 8 bit shifts. Shift 16 bit lanes, drop the bit shifted in from the neighbor and sign extend bit 6
+		static inline __m128i halfSigned(__m128i v)
+		{
+			const __m128i low7 = _mm_set1_epi8(0x7F);
+			const __m128i sign = _mm_set1_epi8(0x40);
+			__m128i shifted = _mm_and_si128(_mm_srli_epi16(v, 1), low7);
+			return _mm_sub_epi8(_mm_xor_si128(shifted, sign), sign);
+		}
+
+		static inline void forwardYCoCg(__m128i r, __m128i g, __m128i b, __m128i& y, __m128i& co, __m128i& cg)
+		{
+			co = _mm_sub_epi8(r, b);
+			__m128i t = _mm_add_epi8(b, halfSigned(co));
+			cg = _mm_sub_epi8(g, t);
+			y = _mm_add_epi8(t, halfSigned(cg));
+		}
+
+		static inline void inverseYCoCg(__m128i y, __m128i co, __m128i cg, __m128i& r, __m128i& g, __m128i& b)
+		{
+			__m128i t = _mm_sub_epi8(y, halfSigned(cg));
+			g = _mm_add_epi8(cg, t);
+			b = _mm_sub_epi8(t, halfSigned(co));
+			r = _mm_add_epi8(b, co);
+		}
+
+		//Inclusive prefix sum of 16 bytes plus the carry from the previous block
+		static inline __m128i prefixSum(__m128i v, __m128i carry)
+		{
+			v = _mm_add_epi8(v, _mm_slli_si128(v, 1));
+			v = _mm_add_epi8(v, _mm_slli_si128(v, 2));
+			v = _mm_add_epi8(v, _mm_slli_si128(v, 4));
+			v = _mm_add_epi8(v, _mm_slli_si128(v, 8));
+			return _mm_add_epi8(v, carry);
+		}
+
+		//Broadcasts byte 15 to all lanes
+		static inline __m128i broadcastLast(__m128i v)
+		{
+			v = _mm_srli_si128(v, 15);
+			v = _mm_unpacklo_epi8(v, v);
+			v = _mm_shufflelo_epi16(v, 0);
+			return _mm_unpacklo_epi64(v, v);
+		}
+#endif
+
+		//Writes the left delta of the Y, Co and Cg planes of src RGB planes
+		static void transformAndDelta(const uint8_t* r, const uint8_t* g, const uint8_t* b, int count, uint8_t* y, uint8_t* co, uint8_t* cg)
+		{
+			uint8_t prevY = 0, prevCo = 0, prevCg = 0;
+			int i = 0;
+			if(count > 0)
+			{
+				forwardYCoCg(r[0], g[0], b[0], prevY, prevCo, prevCg);
+				y[0] = prevY;
+				co[0] = prevCo;
+				cg[0] = prevCg;
+				i = 1;
+			}
+#ifdef RGBD_USE_SSE2
+			for(; i + 16 <= count; i += 16)
+			{
+				//Transform the block and the block shifted back one pixel, then subtract
+				__m128i curY, curCo, curCg, lastY, lastCo, lastCg;
+				forwardYCoCg(_mm_loadu_si128((const __m128i*) (r + i)), _mm_loadu_si128((const __m128i*) (g + i)),
+					_mm_loadu_si128((const __m128i*) (b + i)), curY, curCo, curCg);
+				forwardYCoCg(_mm_loadu_si128((const __m128i*) (r + i - 1)), _mm_loadu_si128((const __m128i*) (g + i - 1)),
+					_mm_loadu_si128((const __m128i*) (b + i - 1)), lastY, lastCo, lastCg);
+				_mm_storeu_si128((__m128i*) (y + i), _mm_sub_epi8(curY, lastY));
+				_mm_storeu_si128((__m128i*) (co + i), _mm_sub_epi8(curCo, lastCo));
+				_mm_storeu_si128((__m128i*) (cg + i), _mm_sub_epi8(curCg, lastCg));
+			}
+			if(i > 1)
+				forwardYCoCg(r[i-1], g[i-1], b[i-1], prevY, prevCo, prevCg);
+#endif
+			for(; i < count; i++)
+			{
+				uint8_t curY, curCo, curCg;
+				forwardYCoCg(r[i], g[i], b[i], curY, curCo, curCg);
+				y[i] = (uint8_t) (curY - prevY);
+				co[i] = (uint8_t) (curCo - prevCo);
+				cg[i] = (uint8_t) (curCg - prevCg);
+				prevY = curY;
+				prevCo = curCo;
+				prevCg = curCg;
+			}
+		}
+
+		//Undoes the left delta of a plane in place
+		static void integratePlane(uint8_t* plane, int count)
+		{
+			uint8_t last = 0;
+			int i = 0;
+#ifdef RGBD_USE_SSE2
+			__m128i carry = _mm_setzero_si128();
+			for(; i + 16 <= count; i += 16)
+			{
+				__m128i v = prefixSum(_mm_loadu_si128((const __m128i*) (plane + i)), carry);
+				_mm_storeu_si128((__m128i*) (plane + i), v);
+				carry = broadcastLast(v);
+			}
+			if(i > 0)
+				last = plane[i-1];
+#endif
+			for(; i < count; i++)
+			{
+				last = (uint8_t) (last + plane[i]);
+				plane[i] = last;
+			}
+		}
+
+		//Converts Y, Co and Cg planes back to RGB planes in place
+		static void inverseTransformPlanes(uint8_t* y, uint8_t* co, uint8_t* cg, int count)
+		{
+			int i = 0;
+#ifdef RGBD_USE_SSE2
+			for(; i + 16 <= count; i += 16)
+			{
+				__m128i r, g, b;
+				inverseYCoCg(_mm_loadu_si128((const __m128i*) (y + i)), _mm_loadu_si128((const __m128i*) (co + i)),
+					_mm_loadu_si128((const __m128i*) (cg + i)), r, g, b);
+				_mm_storeu_si128((__m128i*) (y + i), r);
+				_mm_storeu_si128((__m128i*) (co + i), g);
+				_mm_storeu_si128((__m128i*) (cg + i), b);
+			}
+#endif
+			for(; i < count; i++)
+			{
+				uint8_t r, g, b;
+				inverseYCoCg(y[i], co[i], cg[i], r, g, b);
+				y[i] = r;
+				co[i] = g;
+				cg[i] = b;
+			}
+		}
+
+		//Appends a Huffman coded plane to dest
+		static void encodePlane(const uint8_t* plane, int count, vector<char>& dest)
+		{
+			uint32_t frequencies[256] = {0};
+			for(int i = 0; i < count; i++)
+				frequencies[plane[i]]++;
+
+			uint8_t lengths[256];
+			uint16_t codes[256];
+			buildHuffmanLengths(frequencies, 256, lengths);
+			buildCanonicalCodes(lengths, 256, codes);
+			writeHuffmanLengths(lengths, 256, dest);
+
+			//Size is filled in once the plane is written
+			size_t sizeOffset = dest.size();
+			dest.resize(dest.size() + sizeof(uint32_t));
+
+			HuffmanBitWriter writer(dest);
+			for(int i = 0; i < count; i++)
+				writer.write(codes[plane[i]], lengths[plane[i]]);
+			writer.flush();
+
+			uint32_t planeSize = (uint32_t) (dest.size() - sizeOffset - sizeof(uint32_t));
+			memcpy(&dest[sizeOffset], &planeSize, sizeof(planeSize));
+		}
+
+		//Decodes a plane written by encodePlane. Returns the number of bytes read, or -1 if the plane is corrupt.
+		static int decodePlane(const char* src, int srcSize, uint8_t* plane, int count)
+		{
+			int headerSize = getHuffmanLengthsSize(256) + sizeof(uint32_t);
+			if(srcSize < headerSize)
+				return -1;
+
+			uint8_t lengths[256];
+			HuffmanDecodeTable table;
+			if(!readHuffmanLengths(src, 256, lengths) || !table.build(lengths, 256))
+				return -1;
+
+			uint32_t planeSize;
+			memcpy(&planeSize, src + getHuffmanLengthsSize(256), sizeof(planeSize));
+			if(planeSize > (uint32_t) (srcSize - headerSize))
+				return -1;
+
+			HuffmanBitReader reader(src + headerSize, src + headerSize + planeSize);
+			for(int i = 0; i < count; i++)
+			{
+				reader.refill();
+				int symbol = table.decode(reader);
+				if(symbol < 0)
+					return -1;
+				plane[i] = (uint8_t) symbol;
+			}
+			if(reader.isOverrun())
+				return -1;
+
+			return headerSize + planeSize;
+		}
+
+		int encodeColorImage(const ColorPixel* src, int pixelCount, vector<char>& dest)
+		{
+			if(pixelCount <= 0)
+				return -1;
+
+			//Split channels into planes
+			vector<uint8_t> rgbPlanes(3*pixelCount);
+			uint8_t* r = &rgbPlanes[0];
+			uint8_t* g = r + pixelCount;
+			uint8_t* b = g + pixelCount;
+			for(int i = 0; i < pixelCount; i++)
+			{
+				r[i] = src[i].r;
+				g[i] = src[i].g;
+				b[i] = src[i].b;
+			}
+
+			vector<uint8_t> deltaPlanes(3*pixelCount);
+			uint8_t* y = &deltaPlanes[0];
+			transformAndDelta(r, g, b, pixelCount, y, y + pixelCount, y + 2*pixelCount);
+
+			ColorCodecHeader header;
+			header.version = COLOR_CODEC_VERSION;
+			header.pixelCount = pixelCount;
+
+			dest.reserve(sizeof(header) + 3*pixelCount);
+			dest.resize(sizeof(header));
+			memcpy(&dest[0], &header, sizeof(header));
+			for(int p = 0; p < 3; p++)
+				encodePlane(y + p*pixelCount, pixelCount, dest);
+
+			return (int) dest.size();
+		}
+
+		bool decodeColorImage(const char* src, int srcSize, ColorPixel* dest, int destPixels)
+		{
+			if(srcSize < (int) sizeof(ColorCodecHeader))
+				return false;
+
+			ColorCodecHeader header;
+			memcpy(&header, src, sizeof(header));
+			if(header.version != COLOR_CODEC_VERSION || header.pixelCount == 0 || header.pixelCount != (uint32_t) destPixels)
+				return false;
+
+			int pixelCount = header.pixelCount;
+			vector<uint8_t> planes(3*pixelCount);
+			int offset = sizeof(header);
+			for(int p = 0; p < 3; p++)
+			{
+				int planeBytes = decodePlane(src + offset, srcSize - offset, &planes[p*pixelCount], pixelCount);
+				if(planeBytes < 0)
+					return false;
+				offset += planeBytes;
+			}
+
+			uint8_t* y = &planes[0];
+			uint8_t* co = y + pixelCount;
+			uint8_t* cg = co + pixelCount;
+			integratePlane(y, pixelCount);
+			integratePlane(co, pixelCount);
+			integratePlane(cg, pixelCount);
+			inverseTransformPlanes(y, co, cg, pixelCount);
+
+			//Planes now hold R, G and B
+			for(int i = 0; i < pixelCount; i++)
+			{
+				dest[i].r = y[i];
+				dest[i].g = co[i];
+				dest[i].b = cg[i];
+			}
+			return true;
+		}
+	}
+}
@@ -0,0 +1,156 @@
+#include "DecodedFrameCache.h"
+
+namespace rgbd
+{
+	namespace framework
+	{
+		DecodedFrameCache::DecodedFrameCache(RGBDFrameFactory* factory)
+		{
+			mFrameFactory = factory;
+			mMemoryBudget = 0;
+			mStats.hits = 0;
+			mStats.misses = 0;
+			mStats.evictions = 0;
+			mStats.entries = 0;
+			mStats.bytes = 0;
+		}
+
+		DecodedFrameCache::~DecodedFrameCache(void)
+		{
+			clear();
+		}
+
+		void DecodedFrameCache::evictToBudget(size_t budget)
+		{
+			while(mStats.bytes > budget && !mRecentKeys.empty())
+			{
+				map<int, Entry>::iterator it = mEntries.find(mRecentKeys.back());
+				mStats.bytes -= it->second.bytes;
+				mEntries.erase(it);
+				mRecentKeys.pop_back();
+				mStats.evictions++;
+			}
+			mStats.entries = (int) mEntries.size();
+		}
+
+		void DecodedFrameCache::setMemoryBudget(size_t bytes)
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			mMemoryBudget = bytes;
+			evictToBudget(bytes);
+		}
+
+		size_t DecodedFrameCache::getMemoryBudget()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			return mMemoryBudget;
+		}
+
+		RGBDFramePtr DecodedFrameCache::getFrame(int key, bool needDepth, bool needColor)
+		{
+			boost::unique_lock<boost::mutex> lock(mGuard);
+			if(mMemoryBudget == 0)
+				return RGBDFramePtr();
+
+			map<int, Entry>::iterator it = mEntries.find(key);
+			if(it == mEntries.end() || (needDepth && !it->second.hasDepth) || (needColor && !it->second.hasColor))
+			{
+				mStats.misses++;
+				return RGBDFramePtr();
+			}
+
+			//The copy holds the arrays, so eviction can't free them while they are read outside the lock
+			Entry entry = it->second;
+			mRecentKeys.splice(mRecentKeys.begin(), mRecentKeys, entry.recentPos);
+			mStats.hits++;
+			lock.unlock();
+
+			//Cached arrays are packed, the frame may have a row pitch
+			RGBDFramePtr frame = mFrameFactory->getRGBDFrame(entry.xRes, entry.yRes);
+			for(int y = 0; y < entry.yRes; y++)
+			{
+				if(needDepth)
+					memcpy(frame->getDepthRow(y), entry.depth.get() + y*entry.xRes, entry.xRes*sizeof(DPixel));
+				if(needColor)
+					memcpy(frame->getColorRow(y), entry.color.get() + y*entry.xRes, entry.xRes*sizeof(ColorPixel));
+			}
+
+			frame->setDepthTimestamp(entry.depthTime);
+			frame->setColorTimestamp(entry.colorTime);
+			frame->setHasDepth(needDepth);
+			frame->setHasColor(needColor);
+			return frame;
+		}
+
+		void DecodedFrameCache::insert(int key, RGBDFramePtr frame)
+		{
+			int xRes = frame->getXRes();
+			int yRes = frame->getYRes();
+			bool hasDepth = frame->hasDepth();
+			bool hasColor = frame->hasColor();
+			size_t bytes = xRes*yRes*((hasDepth ? sizeof(DPixel) : 0) + (hasColor ? sizeof(ColorPixel) : 0));
+
+			{
+				boost::mutex::scoped_lock lock(mGuard);
+				if(bytes == 0 || bytes > mMemoryBudget)
+					return;
+			}
+
+			//Copy outside the lock so decode workers don't serialize on it
+			Entry entry;
+			entry.xRes = xRes;
+			entry.yRes = yRes;
+			entry.hasDepth = hasDepth;
+			entry.hasColor = hasColor;
+			entry.depthTime = frame->getDepthTimestamp();
+			entry.colorTime = frame->getColorTimestamp();
+			entry.bytes = bytes;
+			if(hasDepth)
+				entry.depth = mFrameFactory->getDepthArray(xRes*yRes);
+			if(hasColor)
+				entry.color = mFrameFactory->getColorArray(xRes*yRes);
+			for(int y = 0; y < yRes; y++)
+			{
+				if(hasDepth)
+					memcpy(entry.depth.get() + y*xRes, frame->getDepthRow(y), xRes*sizeof(DPixel));
+				if(hasColor)
+					memcpy(entry.color.get() + y*xRes, frame->getColorRow(y), xRes*sizeof(ColorPixel));
+			}
+
+			boost::mutex::scoped_lock lock(mGuard);
+			if(bytes > mMemoryBudget)
+				return;
+
+			map<int, Entry>::iterator it = mEntries.find(key);
+			if(it != mEntries.end())
+			{
+				mStats.bytes -= it->second.bytes;
+				mRecentKeys.erase(it->second.recentPos);
+				mEntries.erase(it);
+			}
+
+			//Make room first so the new entry isn't the one evicted
+			evictToBudget(mMemoryBudget >= bytes ? mMemoryBudget - bytes : 0);
+			mRecentKeys.push_front(key);
+			entry.recentPos = mRecentKeys.begin();
+			mEntries.insert(pair<int, Entry>(key, entry));
+			mStats.bytes += bytes;
+			mStats.entries = (int) mEntries.size();
+		}
+
+		void DecodedFrameCache::clear()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			mEntries.clear();
+			mRecentKeys.clear();
+			mStats.bytes = 0;
+			mStats.entries = 0;
+		}
+
+		DecodedFrameCacheStats DecodedFrameCache::getStats()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			return mStats;
+		}
+	}
+}
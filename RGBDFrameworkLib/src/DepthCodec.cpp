@@ -0,0 +1,474 @@
+#include "DepthCodec.h"
+#include "HuffmanCoder.h"
+#include <string.h>
+#include <limits.h>
+
+#ifdef RGBD_USE_SSE2
+#include <emmintrin.h>
+#endif
+
+namespace rgbd
+{
+	namespace framework
+	{
+		static inline uint16_t zigzagEncode(uint16_t residual)
+		{
+			//Shift the unsigned value; shifting a negative int left is undefined
+			int16_t r = (int16_t) residual;
+			return (uint16_t) ((uint16_t) (residual << 1) ^ (uint16_t) (r >> 15));
+		}
+
+		static inline uint16_t zigzagDecode(uint16_t z)
+		{
+			return (uint16_t) ((z >> 1) ^ (uint16_t) (0 - (z & 1)));
+		}
+
+		static inline uint16_t predictMED(uint16_t a, uint16_t b, uint16_t c)
+		{
+			uint16_t maxAB = (a > b) ? a : b;
+			uint16_t minAB = (a > b) ? b : a;
+			if(c >= maxAB)
+				return minAB;
+			if(c <= minAB)
+				return maxAB;
+			return (uint16_t) (a + b - c);
+		}
+
+		static inline int getBitLength(uint16_t v)
+		{
+			int n = 0;
+			if(v >= 256) {n += 8; v >>= 8;}
+			if(v >= 16) {n += 4; v >>= 4;}
+			if(v >= 4) {n += 2; v >>= 2;}
+			if(v >= 2) {n += 1; v >>= 1;}
+			return n + v;
+		}
+
+#ifdef RGBD_USE_SSE2
+		static inline __m128i zigzagEncode(__m128i r)
+		{
+			return _mm_xor_si128(_mm_slli_epi16(r, 1), _mm_srai_epi16(r, 15));
+		}
+
+		static inline __m128i zigzagDecode(__m128i z)
+		{
+			__m128i sign = _mm_sub_epi16(_mm_setzero_si128(), _mm_and_si128(z, _mm_set1_epi16(1)));
+			return _mm_xor_si128(_mm_srli_epi16(z, 1), sign);
+		}
+
+		//Unsigned 16 bit MED predictor. SSE2 only has signed 16 bit min/max, so compare with the sign bit flipped.
+		static inline __m128i predictMED(__m128i a, __m128i b, __m128i c)
+		{
+			const __m128i flip = _mm_set1_epi16((short) 0x8000);
+			const __m128i ones = _mm_set1_epi16(-1);
+			__m128i as = _mm_xor_si128(a, flip);
+			__m128i bs = _mm_xor_si128(b, flip);
+			__m128i cs = _mm_xor_si128(c, flip);
+			__m128i maxAB = _mm_max_epi16(as, bs);
+			__m128i minAB = _mm_min_epi16(as, bs);
+			__m128i cGEMax = _mm_xor_si128(_mm_cmpgt_epi16(maxAB, cs), ones);
+			__m128i cLEMin = _mm_xor_si128(_mm_cmpgt_epi16(cs, minAB), ones);
+			__m128i grad = _mm_sub_epi16(_mm_add_epi16(a, b), c);
+
+			__m128i pred = _mm_or_si128(_mm_and_si128(cLEMin, _mm_xor_si128(maxAB, flip)), _mm_andnot_si128(cLEMin, grad));
+			return _mm_or_si128(_mm_and_si128(cGEMax, _mm_xor_si128(minAB, flip)), _mm_andnot_si128(cGEMax, pred));
+		}
+#endif
+
+		//Writes the zig-zag residuals of one row for the given predictor.
+		static void computeResiduals(const uint16_t* cur, const uint16_t* prev, int width, int predictor, uint16_t* residuals)
+		{
+			//First column has no left neighbor. Every predictor uses the pixel above.
+			residuals[0] = zigzagEncode((uint16_t) (cur[0] - prev[0]));
+
+			int x = 1;
+#ifdef RGBD_USE_SSE2
+			for(; x + 8 <= width; x += 8)
+			{
+				__m128i c = _mm_loadu_si128((const __m128i*) (cur + x));
+				__m128i pred;
+				switch(predictor)
+				{
+				case DEPTH_PREDICT_LEFT:
+					pred = _mm_loadu_si128((const __m128i*) (cur + x - 1));
+					break;
+				case DEPTH_PREDICT_UP:
+					pred = _mm_loadu_si128((const __m128i*) (prev + x));
+					break;
+				case DEPTH_PREDICT_MED:
+				default:
+					pred = predictMED(_mm_loadu_si128((const __m128i*) (cur + x - 1)),
+						_mm_loadu_si128((const __m128i*) (prev + x)),
+						_mm_loadu_si128((const __m128i*) (prev + x - 1)));
+					break;
+				}
+				_mm_storeu_si128((__m128i*) (residuals + x), zigzagEncode(_mm_sub_epi16(c, pred)));
+			}
+#endif
+			for(; x < width; x++)
+			{
+				uint16_t pred;
+				switch(predictor)
+				{
+				case DEPTH_PREDICT_LEFT:
+					pred = cur[x-1];
+					break;
+				case DEPTH_PREDICT_UP:
+					pred = prev[x];
+					break;
+				case DEPTH_PREDICT_MED:
+				default:
+					pred = predictMED(cur[x-1], prev[x], prev[x-1]);
+					break;
+				}
+				residuals[x] = zigzagEncode((uint16_t) (cur[x] - pred));
+			}
+		}
+
+		//Inverse of computeResiduals. residuals holds zig-zag values.
+		static void reconstructRow(const uint16_t* residuals, const uint16_t* prev, int width, int predictor, uint16_t* cur)
+		{
+			int x = 0;
+			switch(predictor)
+			{
+			case DEPTH_PREDICT_UP:
+				//Column 0 uses the same rule, so the whole row is independent
+#ifdef RGBD_USE_SSE2
+				for(; x + 8 <= width; x += 8)
+				{
+					__m128i r = zigzagDecode(_mm_loadu_si128((const __m128i*) (residuals + x)));
+					_mm_storeu_si128((__m128i*) (cur + x), _mm_add_epi16(_mm_loadu_si128((const __m128i*) (prev + x)), r));
+				}
+#endif
+				for(; x < width; x++)
+					cur[x] = (uint16_t) (prev[x] + zigzagDecode(residuals[x]));
+				break;
+			case DEPTH_PREDICT_LEFT:
+				{
+					//Running sum of residuals, seeded with the pixel above column 0
+					uint16_t last = prev[0];
+#ifdef RGBD_USE_SSE2
+					__m128i carry = _mm_set1_epi16((short) last);
+					for(; x + 8 <= width; x += 8)
+					{
+						//In register prefix sum over 8 lanes
+						__m128i r = zigzagDecode(_mm_loadu_si128((const __m128i*) (residuals + x)));
+						r = _mm_add_epi16(r, _mm_slli_si128(r, 2));
+						r = _mm_add_epi16(r, _mm_slli_si128(r, 4));
+						r = _mm_add_epi16(r, _mm_slli_si128(r, 8));
+						r = _mm_add_epi16(r, carry);
+						_mm_storeu_si128((__m128i*) (cur + x), r);
+
+						//Broadcast lane 7
+						carry = _mm_shufflehi_epi16(r, 0xFF);
+						carry = _mm_unpackhi_epi64(carry, carry);
+					}
+					if(x > 0)
+						last = cur[x-1];
+#endif
+					for(; x < width; x++)
+					{
+						last = (uint16_t) (last + zigzagDecode(residuals[x]));
+						cur[x] = last;
+					}
+				}
+				break;
+			case DEPTH_PREDICT_MED:
+			default:
+				//Each pixel depends on the one to its left. Scalar only
+				cur[0] = (uint16_t) (prev[0] + zigzagDecode(residuals[0]));
+				for(x = 1; x < width; x++)
+					cur[x] = (uint16_t) (predictMED(cur[x-1], prev[x], prev[x-1]) + zigzagDecode(residuals[x]));
+				break;
+			}
+		}
+
+		//Returns the index of the first nonzero residual at or after x, or width if the rest of the row is zero
+		static inline int findNonZero(const uint16_t* residuals, int x, int width)
+		{
+#ifdef RGBD_USE_SSE2
+			const __m128i zero = _mm_setzero_si128();
+			for(; x + 8 <= width; x += 8)
+			{
+				int zeroMask = _mm_movemask_epi8(_mm_cmpeq_epi16(_mm_loadu_si128((const __m128i*) (residuals + x)), zero));
+				if(zeroMask != 0xFFFF)
+				{
+					//Two mask bits per lane
+					int nonZero = ~zeroMask & 0xFFFF;
+					while((nonZero & 1) == 0)
+					{
+						nonZero >>= 2;
+						x++;
+					}
+					return x;
+				}
+			}
+#endif
+			for(; x < width; x++)
+				if(residuals[x] != 0)
+					return x;
+			return width;
+		}
+
+		//Rough size of a row in bits, used to pick the row predictor. Each nonzero residual costs its bit length plus 3 bits of symbol
+		static int estimateRowCost(const uint16_t* residuals, int width)
+		{
+			int cost = 0;
+			int x = 0;
+#ifdef RGBD_USE_SSE2
+			//Bit length is the number of powers of two the value reaches. Unsigned compares via flipped sign bits.
+			const __m128i flip = _mm_set1_epi16((short) 0x8000);
+			__m128i thresholds[13];
+			for(int k = 0; k < 13; k++)
+				thresholds[k] = _mm_set1_epi16((short) (((1 << k) - 1) ^ 0x8000));
+
+			const __m128i ones = _mm_set1_epi16(1);
+			__m128i acc = _mm_setzero_si128();
+			for(; x + 8 <= width; x += 8)
+			{
+				__m128i v = _mm_xor_si128(_mm_loadu_si128((const __m128i*) (residuals + x)), flip);
+				__m128i nonZero = _mm_cmpgt_epi16(v, thresholds[0]);
+				//Compare masks are -1, so subtracting counts. At most 16 per lane here
+				__m128i pixelCost = _mm_sub_epi16(_mm_setzero_si128(), _mm_add_epi16(nonZero, _mm_add_epi16(nonZero, nonZero)));
+				for(int k = 0; k < 13; k++)
+					pixelCost = _mm_sub_epi16(pixelCost, _mm_cmpgt_epi16(v, thresholds[k]));
+				//Sum pairs into 32 bit lanes so wide rows can't overflow
+				acc = _mm_add_epi32(acc, _mm_madd_epi16(pixelCost, ones));
+			}
+			acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 8));
+			acc = _mm_add_epi32(acc, _mm_srli_si128(acc, 4));
+			cost = _mm_cvtsi128_si32(acc);
+#endif
+			for(; x < width; x++)
+			{
+				if(residuals[x] != 0)
+					cost += 3 + getBitLength(residuals[x]);
+			}
+			return cost;
+		}
+
+		static inline int getSymbol(int run, int bitLength)
+		{
+			return run*17 + bitLength;
+		}
+
+		//Appends the (zero run, bit length) symbols of a row and counts symbol frequencies
+		static void appendRowSymbols(const uint16_t* residuals, int width, vector<uint16_t>& symbols, vector<uint16_t>& values, uint32_t* frequencies)
+		{
+			int run = 0;
+			int x = 0;
+			while(x < width)
+			{
+				int next = findNonZero(residuals, x, width);
+				run += next - x;
+				x = next;
+				if(x == width)
+					break;
+
+				while(run > DEPTH_CODEC_MAX_RUN)
+				{
+					//Skip 16 zeros
+					int symbol = getSymbol(DEPTH_CODEC_MAX_RUN, 0);
+					symbols.push_back(symbol);
+					values.push_back(0);
+					frequencies[symbol]++;
+					run -= DEPTH_CODEC_MAX_RUN + 1;
+				}
+
+				int symbol = getSymbol(run, getBitLength(residuals[x]));
+				symbols.push_back(symbol);
+				values.push_back(residuals[x]);
+				frequencies[symbol]++;
+				run = 0;
+				x++;
+			}
+
+			if(run > 0)
+			{
+				//End of row
+				symbols.push_back(getSymbol(0, 0));
+				values.push_back(0);
+				frequencies[getSymbol(0, 0)]++;
+			}
+		}
+
+		int encodeDepthImage(const DPixel* src, int xRes, int yRes, vector<char>& dest)
+		{
+			if(xRes <= 0 || yRes <= 0)
+				return -1;
+
+			vector<uint8_t> predictors(yRes);
+			vector<uint16_t> symbols;
+			vector<uint16_t> values;
+			symbols.reserve(xRes*yRes/4);
+			values.reserve(xRes*yRes/4);
+			uint32_t frequencies[DEPTH_CODEC_SYMBOLS] = {0};
+
+			//One residual row per predictor
+			vector<uint16_t> residuals(3*xRes);
+			vector<uint16_t> zeroRow(xRes, 0);
+			const uint16_t* prev = &zeroRow[0];
+
+			for(int y = 0; y < yRes; y++)
+			{
+				const uint16_t* cur = (const uint16_t*) (src + y*xRes);
+
+				//Pick the cheapest predictor for this row
+				int bestPredictor = 0;
+				int bestCost = INT_MAX;
+				for(int p = DEPTH_PREDICT_LEFT; p <= DEPTH_PREDICT_MED; p++)
+				{
+					computeResiduals(cur, prev, xRes, p, &residuals[p*xRes]);
+					int cost = estimateRowCost(&residuals[p*xRes], xRes);
+					if(cost < bestCost)
+					{
+						bestCost = cost;
+						bestPredictor = p;
+					}
+				}
+
+				predictors[y] = (uint8_t) bestPredictor;
+				appendRowSymbols(&residuals[bestPredictor*xRes], xRes, symbols, values, frequencies);
+				prev = cur;
+			}
+
+			uint8_t lengths[DEPTH_CODEC_SYMBOLS];
+			uint16_t codes[DEPTH_CODEC_SYMBOLS];
+			buildHuffmanLengths(frequencies, DEPTH_CODEC_SYMBOLS, lengths);
+			buildCanonicalCodes(lengths, DEPTH_CODEC_SYMBOLS, codes);
+
+			dest.clear();
+			dest.reserve(sizeof(DepthCodecHeader) + yRes + getHuffmanLengthsSize(DEPTH_CODEC_SYMBOLS) + symbols.size()*2);
+
+			DepthCodecHeader header;
+			header.version = DEPTH_CODEC_VERSION;
+			header.xRes = xRes;
+			header.yRes = yRes;
+			dest.insert(dest.end(), (const char*) &header, (const char*) &header + sizeof(header));
+			dest.insert(dest.end(), (const char*) &predictors[0], (const char*) &predictors[0] + yRes);
+			writeHuffmanLengths(lengths, DEPTH_CODEC_SYMBOLS, dest);
+
+			HuffmanBitWriter writer(dest);
+			for(size_t i = 0; i < symbols.size(); i++)
+			{
+				int symbol = symbols[i];
+				writer.write(codes[symbol], lengths[symbol]);
+
+				//Leading one of the value is implied by its bit length
+				int bitLength = symbol % 17;
+				if(bitLength > 1)
+					writer.write(values[i] & ((1 << (bitLength - 1)) - 1), bitLength - 1);
+			}
+			writer.flush();
+
+			return (int) dest.size();
+		}
+
+		bool decodeDepthImage(const char* src, int srcSize, DPixel* dest, int destPixels)
+		{
+			if(srcSize < (int) sizeof(DepthCodecHeader))
+				return false;
+
+			DepthCodecHeader header;
+			memcpy(&header, src, sizeof(header));
+			if(header.version != DEPTH_CODEC_VERSION || header.xRes == 0 || header.yRes == 0 ||
+				((uint64_t) header.xRes)*header.yRes != (uint64_t) destPixels)
+				return false;
+
+			int xRes = header.xRes;
+			int yRes = header.yRes;
+			if(srcSize < (int) (sizeof(DepthCodecHeader) + yRes + getHuffmanLengthsSize(DEPTH_CODEC_SYMBOLS)))
+				return false;
+
+			const uint8_t* predictors = (const uint8_t*) src + sizeof(DepthCodecHeader);
+			const uint8_t* packedLengths = predictors + yRes;
+
+			uint8_t lengths[DEPTH_CODEC_SYMBOLS];
+			HuffmanDecodeTable table;
+			if(!readHuffmanLengths((const char*) packedLengths, DEPTH_CODEC_SYMBOLS, lengths) || !table.build(lengths, DEPTH_CODEC_SYMBOLS))
+				return false;
+
+			HuffmanBitReader reader((const char*) packedLengths + getHuffmanLengthsSize(DEPTH_CODEC_SYMBOLS), src + srcSize);
+			vector<uint16_t> residuals(xRes);
+			vector<uint16_t> zeroRow(xRes, 0);
+			const uint16_t* prev = &zeroRow[0];
+
+			for(int y = 0; y < yRes; y++)
+			{
+				if(predictors[y] > DEPTH_PREDICT_MED)
+					return false;
+
+				memset(&residuals[0], 0, xRes*sizeof(uint16_t));
+				int x = 0;
+				while(x < xRes)
+				{
+					reader.refill();
+					int symbol = table.decode(reader);
+					if(symbol < 0)
+						return false;
+
+					int run = symbol / 17;
+					int bitLength = symbol % 17;
+					if(bitLength == 0)
+					{
+						if(run == 0)
+							break;//End of row
+						if(run != DEPTH_CODEC_MAX_RUN)
+							return false;
+						x += DEPTH_CODEC_MAX_RUN + 1;
+						continue;
+					}
+
+					x += run;
+					if(x >= xRes)
+						return false;
+					uint16_t value = 1;
+					if(bitLength > 1)
+						value = (uint16_t) ((1 << (bitLength - 1)) | reader.read(bitLength - 1));
+					residuals[x++] = value;
+				}
+				if(x > xRes || reader.isOverrun())
+					return false;
+
+				uint16_t* cur = (uint16_t*) (dest + y*xRes);
+				reconstructRow(&residuals[0], prev, xRes, predictors[y], cur);
+				prev = cur;
+			}
+
+			return true;
+		}
+
+		void computeDepthDelta(const DPixel* src, const DPixel* reference, DPixel* delta, int count)
+		{
+			const uint16_t* cur = (const uint16_t*) src;
+			const uint16_t* ref = (const uint16_t*) reference;
+			uint16_t* out = (uint16_t*) delta;
+			int i = 0;
+#ifdef RGBD_USE_SSE2
+			for(; i + 8 <= count; i += 8)
+			{
+				__m128i v = _mm_sub_epi16(_mm_loadu_si128((const __m128i*) (cur + i)), _mm_loadu_si128((const __m128i*) (ref + i)));
+				_mm_storeu_si128((__m128i*) (out + i), v);
+			}
+#endif
+			for(; i < count; i++)
+				out[i] = (uint16_t) (cur[i] - ref[i]);
+		}
+
+		void applyDepthDelta(DPixel* image, const DPixel* reference, int count)
+		{
+			uint16_t* out = (uint16_t*) image;
+			const uint16_t* ref = (const uint16_t*) reference;
+			int i = 0;
+#ifdef RGBD_USE_SSE2
+			for(; i + 8 <= count; i += 8)
+			{
+				__m128i v = _mm_add_epi16(_mm_loadu_si128((const __m128i*) (out + i)), _mm_loadu_si128((const __m128i*) (ref + i)));
+				_mm_storeu_si128((__m128i*) (out + i), v);
+			}
+#endif
+			for(; i < count; i++)
+				out[i] = (uint16_t) (out[i] + ref[i]);
+		}
+	}
+}
@@ -0,0 +1,187 @@
+#include "DeviceGroup.h"
+#include <algorithm>
+
+namespace rgbd
+{
+	namespace framework
+	{
+		static void clearStats(DeviceGroupSourceStats& stats)
+		{
+			stats.decodedFrames = 0;
+			stats.dispatchedFrames = 0;
+			stats.busySeconds = 0.0;
+			stats.dispatchRate = 0.0;
+		}
+
+		DeviceGroup::DeviceGroup(int workerCount)
+		{
+			mNextSource = 0;
+			mWakeCount = 0;
+			mIsStopping = false;
+
+			if(workerCount <= 0)
+				workerCount = max((int) boost::thread::hardware_concurrency(), 1);
+			for(int i = 0; i < workerCount; i++)
+				mWorkers.push_back(boost::shared_ptr<boost::thread>(new boost::thread(&DeviceGroup::run, this)));
+		}
+
+		DeviceGroup::~DeviceGroup(void)
+		{
+			{
+				boost::mutex::scoped_lock lock(mGuard);
+				mIsStopping = true;
+				mWorkCond.notify_all();
+			}
+			for(size_t i = 0; i < mWorkers.size(); i++)
+				mWorkers[i]->join();
+		}
+
+		DeviceGroup::SourceEntryPtr DeviceGroup::findSource(DeviceGroupSource* source)
+		{
+			for(size_t i = 0; i < mSources.size(); i++)
+				if(mSources[i]->source == source)
+					return mSources[i];
+			return SourceEntryPtr();
+		}
+
+		void DeviceGroup::addSource(DeviceGroupSource* source)
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			if(findSource(source) != NULL)
+				return;
+
+			SourceEntryPtr entry(new SourceEntry());
+			entry->source = source;
+			entry->activeTasks = 0;
+			entry->removed = false;
+			clearStats(entry->stats);
+			entry->statsStart = boost::chrono::steady_clock::now();
+			mSources.push_back(entry);
+
+			mWakeCount++;
+			mWorkCond.notify_all();
+		}
+
+		void DeviceGroup::removeSource(DeviceGroupSource* source)
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			SourceEntryPtr entry = findSource(source);
+			if(entry == NULL)
+				return;
+
+			//Workers skip removed entries from passes that started earlier
+			entry->removed = true;
+			mSources.erase(find(mSources.begin(), mSources.end(), entry));
+			while(entry->activeTasks > 0)
+				mIdleCond.wait(lock);
+		}
+
+		void DeviceGroup::waitForIdle(DeviceGroupSource* source)
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			SourceEntryPtr entry = findSource(source);
+			while(entry != NULL && entry->activeTasks > 0)
+				mIdleCond.wait(lock);
+		}
+
+		void DeviceGroup::wake()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			mWakeCount++;
+			mWorkCond.notify_all();
+		}
+
+		void DeviceGroup::run()
+		{
+			boost::unique_lock<boost::mutex> lock(mGuard);
+			while(!mIsStopping)
+			{
+				uint64_t wakeCount = mWakeCount;
+				boost::chrono::steady_clock::time_point nextWake = boost::chrono::steady_clock::time_point::max();
+				bool didWork = false;
+
+				//Sources can be added and removed while a task runs, so the pass works on a snapshot
+				vector<SourceEntryPtr> sources = mSources;
+				size_t first = sources.empty() ? 0 : mNextSource % sources.size();
+				mNextSource++;
+
+				for(size_t i = 0; i < sources.size() && !didWork && !mIsStopping; i++)
+				{
+					SourceEntryPtr entry = sources[(first + i) % sources.size()];
+					if(entry->removed)
+						continue;
+
+					entry->activeTasks++;
+					lock.unlock();
+
+					boost::chrono::steady_clock::time_point sourceWake = boost::chrono::steady_clock::time_point::max();
+					boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+					GROUP_TASK task = entry->source->runGroupTask(sourceWake);
+					boost::chrono::steady_clock::time_point end = boost::chrono::steady_clock::now();
+
+					lock.lock();
+					entry->activeTasks--;
+					if(entry->activeTasks == 0)
+						mIdleCond.notify_all();
+
+					if(task == GROUP_TASK_NONE)
+					{
+						nextWake = min(nextWake, sourceWake);
+						continue;
+					}
+
+					//One task per pass. The next pass starts at the next source, so every source gets a turn
+					didWork = true;
+					entry->stats.busySeconds += boost::chrono::duration<double>(end - start).count();
+					if(task == GROUP_TASK_DECODE)
+						entry->stats.decodedFrames++;
+					else
+						entry->stats.dispatchedFrames++;
+				}
+
+				if(didWork || wakeCount != mWakeCount || mIsStopping)
+					continue;
+
+				if(nextWake == boost::chrono::steady_clock::time_point::max())
+					mWorkCond.wait(lock);
+				else
+					mWorkCond.wait_until(lock, nextWake);
+			}
+		}
+
+		int DeviceGroup::getWorkerCount()
+		{
+			return (int) mWorkers.size();
+		}
+
+		int DeviceGroup::getSourceCount()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			return (int) mSources.size();
+		}
+
+		bool DeviceGroup::getSourceStats(DeviceGroupSource* source, DeviceGroupSourceStats& stats)
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			SourceEntryPtr entry = findSource(source);
+			if(entry == NULL)
+				return false;
+
+			stats = entry->stats;
+			double seconds = boost::chrono::duration<double>(boost::chrono::steady_clock::now() - entry->statsStart).count();
+			stats.dispatchRate = (seconds > 0.0) ? stats.dispatchedFrames/seconds : 0.0;
+			return true;
+		}
+
+		void DeviceGroup::resetStats()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			boost::chrono::steady_clock::time_point now = boost::chrono::steady_clock::now();
+			for(size_t i = 0; i < mSources.size(); i++)
+			{
+				clearStats(mSources[i]->stats);
+				mSources[i]->statsStart = now;
+			}
+		}
+	}
+}
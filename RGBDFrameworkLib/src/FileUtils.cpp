@@ -1,4 +1,6 @@
 #include "FileUtils.h"
+#include "DepthCodec.h"
+#include "ColorCodec.h"
 
 namespace rgbd
 {
@@ -11,6 +13,10 @@ namespace rgbd
 			{
 			case LZ4_COMPRESSION:
 				return string("lz4");
+			case DEPTH_PREDICTIVE_COMPRESSION:
+				return string("dpc");
+			case COLOR_YCOCG_COMPRESSION:
+				return string("ycocg");
 			case NO_COMPRESSION:
 			default:
 				return string("");
@@ -21,37 +27,106 @@ namespace rgbd
 		{
 			if(tag.compare("lz4") == 0)
 				return LZ4_COMPRESSION;
+			if(tag.compare("dpc") == 0)
+				return DEPTH_PREDICTIVE_COMPRESSION;
+			if(tag.compare("ycocg") == 0)
+				return COLOR_YCOCG_COMPRESSION;
 
 			return NO_COMPRESSION;
 		}
 
-		//Returns compression ratio for reference, or -1 if write failed
-		float saveToCompressedBinaryFile(string filename, char* uncompressed, int uncompressedSize, COMPRESSION_METHOD compressMode)
+		int compressBuffer(const char* src, int srcSize, vector<char>& dest, COMPRESSION_METHOD compressMode, int xRes)
 		{
-			char* compressed;
 			int compressedSize;
+			int pixels;
+			bool hasRows;
+			switch(compressMode)
+			{
+			case LZ4_COMPRESSION:
+				//Worst case output is slightly larger than the input
+				dest.resize(LZ4_compressBound(srcSize));
+				compressedSize = LZ4_compress(src, &dest[0], srcSize);
+				if(compressedSize <= 0)
+					return -1;
+				dest.resize(compressedSize);
+				return compressedSize;
+			case DEPTH_PREDICTIVE_COMPRESSION:
+				if(srcSize % sizeof(DPixel) != 0)
+					return -1;
+				//Without a width that divides the buffer it is coded as a single row
+				pixels = srcSize/sizeof(DPixel);
+				hasRows = xRes > 0 && pixels % xRes == 0;
+				return encodeDepthImage((const DPixel*) src, hasRows ? xRes : pixels, hasRows ? pixels/xRes : 1, dest);
+			case COLOR_YCOCG_COMPRESSION:
+				if(srcSize % sizeof(ColorPixel) != 0)
+					return -1;
+				return encodeColorImage((const ColorPixel*) src, srcSize/sizeof(ColorPixel), dest);
+			case NO_COMPRESSION:
+			default:
+				dest.assign(src, src + srcSize);
+				return srcSize;
+			}
+		}
+
+		bool decompressBuffer(const char* src, int srcSize, char* dest, int destSize, COMPRESSION_METHOD compressMode)
+		{
+			bool decoded;
+			switch(compressMode)
+			{
+			case LZ4_COMPRESSION:
+				//A short decode would leave the tail of dest as it was
+				decoded = LZ4_decompress_safe(src, dest, srcSize, destSize) == destSize;
+				break;
+			case DEPTH_PREDICTIVE_COMPRESSION:
+				decoded = decodeDepthImage(src, srcSize, (DPixel*) dest, destSize/sizeof(DPixel));
+				break;
+			case COLOR_YCOCG_COMPRESSION:
+				decoded = decodeColorImage(src, srcSize, (ColorPixel*) dest, destSize/sizeof(ColorPixel));
+				break;
+			case NO_COMPRESSION:
+			default:
+				memcpy(dest, src, min(srcSize, destSize));
+				return true;
+			}
+
+			//Frame arrays are recycled, so a frame that fails to decode must not show the pixels of an older one
+			if(!decoded)
+				memset(dest, 0, destSize);
+			return decoded;
+		}
+
+		int compressDepthImage(const DPixel* src, int xRes, int yRes, vector<char>& dest, COMPRESSION_METHOD compressMode)
+		{
+			switch(compressMode)
+			{
+			case DEPTH_PREDICTIVE_COMPRESSION:
+				return encodeDepthImage(src, xRes, yRes, dest);
+			default:
+				return compressBuffer((const char*) src, xRes*yRes*sizeof(DPixel), dest, compressMode, xRes);
+			}
+		}
+
+		//Returns compression ratio for reference, or -1 if write failed
+		float saveToCompressedBinaryFile(string filename, char* uncompressed, int uncompressedSize, COMPRESSION_METHOD compressMode, int xRes = 0)
+		{
 			float ratio = -1.0f;
 			//Try to open file
 			ofstream file (filename, ios::out|ios::binary);
 			if (file.is_open())
 			{
-				switch(compressMode)
+				if(compressMode == NO_COMPRESSION)
 				{
-				case LZ4_COMPRESSION:
-					//Allocate memory for compressed data
-					compressed = new char[uncompressedSize];
-					compressedSize = LZ4_compress_limitedOutput(uncompressed, compressed, uncompressedSize, uncompressedSize);
-					ratio = float(compressedSize)/float(uncompressedSize);
-					file.write(compressed, compressedSize);
-					delete compressed;
-
-					break;
-				case NO_COMPRESSION:
-				default:
-					//Save raw data
+					//Save raw data without an intermediate copy
 					file.write(uncompressed, uncompressedSize);
 					ratio = 1.0;
-					break;
+				}else{
+					vector<char> compressed;
+					int compressedSize = compressBuffer(uncompressed, uncompressedSize, compressed, compressMode, xRes);
+					if(compressedSize > 0)
+					{
+						ratio = float(compressedSize)/float(uncompressedSize);
+						file.write(&compressed[0], compressedSize);
+					}
 				}
 
 				file.close();
@@ -63,7 +138,6 @@ namespace rgbd
 
 		void loadCompressedBinaryFile(string filename, char* outputArray, int memSize, COMPRESSION_METHOD compressMode)
 		{
-			char* compressed;
 			ifstream file (filename, ios::in|ios::binary);
 			if (file.is_open())
 			{
@@ -73,20 +147,15 @@ namespace rgbd
 				int length = (int) file.tellg();
 				file.seekg (0, file.beg);
 
-				switch(compressMode)
+				if(compressMode == NO_COMPRESSION)
 				{
-				case LZ4_COMPRESSION:
-					//Allocate memory for compressed data
-					compressed = new char[length];
-					file.read(compressed, length);
-					LZ4_decompress_safe(compressed, outputArray, length, memSize);
-					delete compressed;
-					break;
-				case NO_COMPRESSION:
-				default:
 					//read raw data
 					file.read(outputArray, min(memSize, length));
-					break;
+				}else if(length > 0){
+					//Allocate memory for compressed data
+					vector<char> compressed(length);
+					file.read(&compressed[0], length);
+					decompressBuffer(&compressed[0], length, outputArray, memSize, compressMode);
 				}
 				file.close();
 			}
@@ -113,7 +182,7 @@ namespace rgbd
 				//write depth file
 				char* depthData = (char*)frame->getDepthArray().get();
 				int memSize = frame->getXRes()*frame->getYRes()*sizeof(DPixel);
-				saveToCompressedBinaryFile(filename + ".depth", depthData, memSize, depthCompression);
+				saveToCompressedBinaryFile(filename + ".depth", depthData, memSize, depthCompression, frame->getXRes());
 			}
 		}
 
@@ -182,6 +251,20 @@ namespace rgbd
 		}
 
 
+		bool saveBinaryFile(string filename, const char* data, int size)
+		{
+			ofstream file (filename, ios::out|ios::binary);
+			if (file.is_open())
+			{
+				if(size > 0)
+					file.write(data, size);
+				file.close();
+				return true;
+			}
+			return false;
+		}
+
+
 		bool fileExists(string filename)
 		{
 			boost::filesystem::path file(filename.c_str());
@@ -189,6 +272,22 @@ namespace rgbd
 		}
 
 
+		uint64_t getFileSize(string filename)
+		{
+			boost::system::error_code error;
+			uint64_t size = boost::filesystem::file_size(boost::filesystem::path(filename.c_str()), error);
+			return error ? 0 : size;
+		}
+
+
+		int64_t getFileWriteTime(string filename)
+		{
+			boost::system::error_code error;
+			time_t time = boost::filesystem::last_write_time(boost::filesystem::path(filename.c_str()), error);
+			return error ? 0 : (int64_t) time;
+		}
+
+
 		string loadTextFile(string filename)
 		{
 			ifstream logfile (filename);
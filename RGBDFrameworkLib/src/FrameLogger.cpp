@@ -1,4 +1,5 @@
 #include "FrameLogger.h"
+#include "DepthCodec.h"
 
 
 
@@ -11,6 +12,19 @@ namespace rgbd
 		{
 			mColorCompressionMethod = NO_COMPRESSION;
 			mDepthCompressionMethod = NO_COMPRESSION;
+			mLogFormat = LOG_FORMAT_CONTAINER;
+			mAdaptiveCompression = false;
+			mDepthKeyframeInterval = 1;
+			mFramesSinceKeyframe = 0;
+			mIsRecording = false;
+			mDevice = NULL;
+			mMaxQueueSize = 60;
+			mOverflowPolicy = QUEUE_OVERFLOW_BLOCK;
+			mDroppedFrames = 0;
+			mQueueHighWaterMark = 0;
+			mCompressionThreadCount = max((int) boost::thread::hardware_concurrency() - 1, 1);
+			mNextFrameId = 1;
+			mNextWriteId = 1;
 		}
 
 
@@ -21,80 +35,330 @@ namespace rgbd
 
 		void FrameLogger::record(string outputDirectory)
 		{
-			//Open log file
-			ofstream logfile (outputDirectory+"\\log.xml");
+			//Open log
+			int xRes = mDevice->getColorResolutionX();
+			int yRes = mDevice->getColorResolutionY();
 
-			if(logfile.is_open())
+			if(openLog(outputDirectory, xRes, yRes))
 			{
-				//Loop while still recording or still has frames to save. Everything up to the point stopRecording is called WILL be saved
+				//Ids start at 1 and the first depth frame is always a keyframe
 				mQueueGuard.lock();
-				bool queueIsEmpty = mFrameQueue.empty();
+				mNextFrameId = 1;
+				mNextWriteId = 1;
+				mDepthKeyframe.reset();
 				mQueueGuard.unlock();
 
-				//Open log
-				int xRes = mDevice->getColorResolutionX();
-				int yRes = mDevice->getColorResolutionY();
+				for(int i = 0; i < mCompressionThreadCount; i++)
+					mCompressionThreads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(&FrameLogger::compressFrames, this)));
 
-				//Root node
-				logfile << "<device xresolution=\"" << xRes << "\" yresolution=\"" << yRes << "\">" << endl;
-
-				int frameCount = 0;
-				while(mIsRecording || !queueIsEmpty)
+				//Loop while still recording or still has frames to save. Everything up to the point stopRecording is called WILL be saved
+				boost::unique_lock<boost::mutex> lock(mQueueGuard);
+				while(true)
 				{
-					//
-					if(!queueIsEmpty)
+					map<int, PendingFramePtr>::iterator next = mPendingFrames.find(mNextWriteId);
+					if(next != mPendingFrames.end() && next->second->remainingJobs == 0)
 					{
-						frameCount++;
-						mQueueGuard.lock();
-						RGBDFramePtr localFrame = mFrameQueue.front();
-						mFrameQueue.pop();
-						mQueueGuard.unlock();
-
-						//Print id
-						logfile << "<frame id=\"" << frameCount << "\"";
-						if(localFrame->hasColor()){
-							timestamp time = localFrame->getColorTimestamp();
-							logfile << " colorTimestamp=\"" << time << "\"";
-						}
-
-						if(localFrame->hasDepth()){
-							timestamp time = localFrame->getDepthTimestamp();
-							logfile << " depthTimestamp=\"" << time << "\"";
-						}
-
-						//TODO: Add more compression methods here
-						if(mColorCompressionMethod != NO_COMPRESSION)
-						{
-							logfile << " colorCompression=\"" << getCompressionMethodTag(mColorCompressionMethod) << "\"";
-
-						}
-
-						if(mDepthCompressionMethod != NO_COMPRESSION)
-						{
-							logfile << " depthCompression=\"" << getCompressionMethodTag(mDepthCompressionMethod) << "\"";
-						}
-
-						//Close tag
-						logfile << "/>" << endl;
-
-						//Save frames
-						ostringstream s;
-						s << outputDirectory << "\\" << frameCount;
-						saveRGBDFrameImagesToFiles(s.str(), localFrame, mColorCompressionMethod, mDepthCompressionMethod);
+						//Write frames in id order no matter which worker finished first
+						PendingFramePtr pending = next->second;
+						mPendingFrames.erase(next);
+						mNextWriteId++;
+						//Workers may be waiting for room to claim more frames
+						mFrameQueuedCond.notify_all();
+						lock.unlock();
+
+						boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+						writeEncodedFrame(outputDirectory, pending->encoded);
+						double writeSeconds = boost::chrono::duration<double>(boost::chrono::steady_clock::now() - start).count();
+
+						lock.lock();
+						const EncodedFrame& encoded = pending->encoded;
+						mCompressionPolicy.addWriteSample(writeSeconds, (encoded.hasColor ? encoded.getColorPayloadSize() : 0) +
+							(encoded.hasDepth ? encoded.getDepthPayloadSize() : 0));
+						continue;
 					}
 
-					mQueueGuard.lock();
-					queueIsEmpty = mFrameQueue.empty();
-					mQueueGuard.unlock();
+					if(!mIsRecording && mFrameQueue.empty() && mPendingFrames.empty())
+						break;
+
+					//Sleep until the next frame is ready
+					mFrameEncodedCond.wait(lock);
 				}
+				lock.unlock();
+
+				//Workers exit once the queue is drained
+				for(vector<boost::shared_ptr<boost::thread> >::iterator it = mCompressionThreads.begin(); it != mCompressionThreads.end(); ++it)
+					(*it)->join();
+				mCompressionThreads.clear();
+
+				closeLog();
+			}
+
+			//Release producers waiting for room
+			mQueueGuard.lock();
+			mIsRecording = false;
+			mQueueSpaceCond.notify_all();
+			mQueueGuard.unlock();
+		}
+
+		void FrameLogger::compressFrames()
+		{
+			vector<DPixel> deltaBuffer;
+
+			//Enough frames in flight to keep every worker busy without holding many frames in memory
+			size_t maxPendingFrames = 2*mCompressionThreadCount;
 
+			boost::unique_lock<boost::mutex> lock(mQueueGuard);
+			while(true)
+			{
+				//Frames with nothing to compress queue no jobs, so keep claiming until there is work or no room to claim.
+				//The logger thread signals mFrameQueuedCond when writing a frame frees room
+				while(mCompressionJobs.empty() && !mFrameQueue.empty() && mPendingFrames.size() < maxPendingFrames)
+					claimFrame();
+
+				if(!mCompressionJobs.empty())
+				{
+					CompressionJob job = mCompressionJobs.front();
+					mCompressionJobs.pop();
+					lock.unlock();
+
+					boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+					if(job.isDepth)
+						encodeDepth(*job.frame, deltaBuffer);
+					else
+						encodeColor(*job.frame);
+					double encodeSeconds = boost::chrono::duration<double>(boost::chrono::steady_clock::now() - start).count();
+
+					lock.lock();
+					const EncodedFrame& encoded = job.frame->encoded;
+					if(job.isDepth)
+						mCompressionPolicy.addEncodeSample(ADAPTIVE_STREAM_DEPTH, encoded.depthCompression, encoded.id, encodeSeconds, encoded.getDepthPayloadSize());
+					else
+						mCompressionPolicy.addEncodeSample(ADAPTIVE_STREAM_COLOR, encoded.colorCompression, encoded.id, encodeSeconds, encoded.getColorPayloadSize());
+
+					job.frame->remainingJobs--;
+					if(job.frame->remainingJobs == 0)
+						mFrameEncodedCond.notify_all();
+					continue;
+				}
+
+				if(!mIsRecording && mFrameQueue.empty())
+					break;
+
+				mFrameQueuedCond.wait(lock);
+			}
+		}
+
+		void FrameLogger::claimFrame()
+		{
+			double queueFill = mFrameQueue.size()/(double) mMaxQueueSize;
+			RGBDFramePtr frame = mFrameQueue.front();
+			mFrameQueue.pop();
+			mQueueSpaceCond.notify_one();
+
+			PendingFramePtr pending(new PendingFrame());
+			EncodedFrame& encoded = pending->encoded;
+			encoded.id = mNextFrameId++;
+			encoded.source = frame;
+			encoded.hasColor = frame->hasColor();
+			encoded.hasDepth = frame->hasDepth();
+			encoded.colorTime = frame->getColorTimestamp();
+			encoded.depthTime = frame->getDepthTimestamp();
+			encoded.colorCompression = mColorCompressionMethod;
+			encoded.depthCompression = mDepthCompressionMethod;
+			if(mAdaptiveCompression)
+				mCompressionPolicy.selectMethods(encoded.id, queueFill, mCompressionThreadCount, encoded.colorCompression, encoded.depthCompression);
+
+			//Groups are planned in arrival order so logs match a single threaded recording
+			if(encoded.hasDepth && mDepthKeyframeInterval > 1)
+			{
+				//Chunk headers store the keyframe as a 16 bit distance
+				if(mDepthKeyframe == NULL || mFramesSinceKeyframe >= mDepthKeyframeInterval ||
+					encoded.id - mDepthKeyframe->id > 0xFFFF ||
+					mDepthKeyframe->frame->getXRes() != frame->getXRes() || mDepthKeyframe->frame->getYRes() != frame->getYRes())
+				{
+					mDepthKeyframe = DepthKeyframePtr(new DepthKeyframe(encoded.id, frame));
+					mFramesSinceKeyframe = 0;
+				}
+				pending->depthKeyframe = mDepthKeyframe;
+				mFramesSinceKeyframe++;
+			}
+
+			//Uncompressed streams are written straight from the frame (see EncodedFrame::getColorPayload)
+			mPendingFrames.insert(pair<int, PendingFramePtr>(encoded.id, pending));
+			if(encoded.hasColor && encoded.colorCompression != NO_COMPRESSION)
+			{
+				pending->remainingJobs++;
+				mCompressionJobs.push(CompressionJob(pending, false));
+			}else if(encoded.hasColor){
+				mCompressionPolicy.addEncodeSample(ADAPTIVE_STREAM_COLOR, NO_COMPRESSION, encoded.id, 0.0, encoded.getColorPayloadSize());
+			}
 
+			if(encoded.hasDepth && (encoded.depthCompression != NO_COMPRESSION || pending->depthKeyframe != NULL))
+			{
+				pending->remainingJobs++;
+				mCompressionJobs.push(CompressionJob(pending, true));
+			}else if(encoded.hasDepth){
+				mCompressionPolicy.addEncodeSample(ADAPTIVE_STREAM_DEPTH, NO_COMPRESSION, encoded.id, 0.0, encoded.getDepthPayloadSize());
+			}
+
+			if(pending->remainingJobs == 0)
+				mFrameEncodedCond.notify_all();
+			else
+				mFrameQueuedCond.notify_all();
+		}
+
+		void FrameLogger::encodeColor(PendingFrame& pending)
+		{
+			EncodedFrame& encoded = pending.encoded;
+			RGBDFramePtr frame = encoded.source;
+			int memSize = frame->getXRes()*frame->getYRes()*sizeof(ColorPixel);
+			if(compressBuffer((const char*) frame->getColorArray().get(), memSize, encoded.colorData, encoded.colorCompression) < 0)
+				encoded.colorCompression = NO_COMPRESSION;
+		}
+
+		void FrameLogger::encodeDepth(PendingFrame& pending, vector<DPixel>& deltaBuffer)
+		{
+			EncodedFrame& encoded = pending.encoded;
+			RGBDFramePtr frame = encoded.source;
+			bool isKeyframe = pending.depthKeyframe != NULL && pending.depthKeyframe->id == encoded.id;
+
+			if(pending.depthKeyframe != NULL && !isKeyframe && encodeDepthDelta(pending, deltaBuffer))
+				return;
+
+			if(encoded.depthCompression != NO_COMPRESSION)
+			{
+				if(compressDepthImage(frame->getDepthArray().get(), frame->getXRes(), frame->getYRes(), encoded.depthData, encoded.depthCompression) < 0)
+					encoded.depthCompression = NO_COMPRESSION;
+			}
+
+			if(isKeyframe)
+			{
+				//Deltas of this group compare themselves against this size
+				boost::lock_guard<boost::mutex> lock(mQueueGuard);
+				pending.depthKeyframe->payloadSize = encoded.getDepthPayloadSize();
+			}
+		}
+
+		bool FrameLogger::encodeDepthDelta(PendingFrame& pending, vector<DPixel>& deltaBuffer)
+		{
+			EncodedFrame& encoded = pending.encoded;
+			RGBDFramePtr frame = encoded.source;
+			DepthKeyframePtr keyframe = pending.depthKeyframe;
+			int pixels = frame->getXRes()*frame->getYRes();
+
+			deltaBuffer.resize(pixels);
+			computeDepthDelta(frame->getDepthArray().get(), keyframe->frame->getDepthArray().get(), &deltaBuffer[0], pixels);
+
+			//Deltas are only stored compressed
+			COMPRESSION_METHOD method = (encoded.depthCompression == NO_COMPRESSION) ? LZ4_COMPRESSION : encoded.depthCompression;
+			int size = compressDepthImage(&deltaBuffer[0], frame->getXRes(), frame->getYRes(), encoded.depthData, method);
+
+			//Scene changed too much for the keyframe to help. The keyframe may still be compressing, then only the raw size is known
+			boost::lock_guard<boost::mutex> lock(mQueueGuard);
+			uint32_t keyframeSize = (keyframe->payloadSize > 0) ? keyframe->payloadSize : pixels*sizeof(DPixel);
+			if(size < 0 || (uint32_t) size >= keyframeSize)
+			{
+				encoded.depthData.clear();
+				//Start a new group with the next frame
+				if(mDepthKeyframe == keyframe)
+					mDepthKeyframe.reset();
+				return false;
+			}
+
+			encoded.depthCompression = method;
+			encoded.depthKeyframeId = keyframe->id;
+			return true;
+		}
+
+		void FrameLogger::setDepthKeyframeInterval(int interval)
+		{
+			mDepthKeyframeInterval = min(max(interval, 1), 0xFFFF);
+		}
+
+		bool FrameLogger::setCompressionThreadCount(int threads)
+		{
+			if(mIsRecording)
+				return false;
+			mCompressionThreadCount = max(threads, 1);
+			return true;
+		}
 
+		bool FrameLogger::openLog(string outputDirectory, int xRes, int yRes)
+		{
+			switch(mLogFormat)
+			{
+			case LOG_FORMAT_FILES:
+				mXmlLog.open(outputDirectory+"\\log.xml");
+				if(!mXmlLog.is_open())
+					return false;
+
+				//Root node
+				mXmlLog << "<device xresolution=\"" << xRes << "\" yresolution=\"" << yRes << "\">" << endl;
+				return true;
+			case LOG_FORMAT_CONTAINER:
+			default:
+				return mContainerLog.open(outputDirectory+"\\"+LOG_CONTAINER_FILENAME, xRes, yRes);
+			}
+		}
+
+		void FrameLogger::closeLog()
+		{
+			if(mXmlLog.is_open())
+			{
 				//Close log file
-				logfile << "</device>" << endl;
-				logfile.close();
+				mXmlLog << "</device>" << endl;
+				mXmlLog.close();
 			}
-			mIsRecording = false;
+
+			if(mContainerLog.isOpen())
+				mContainerLog.close();
+		}
+
+		void FrameLogger::writeEncodedFrame(string outputDirectory, const EncodedFrame& encoded)
+		{
+			if(mContainerLog.isOpen())
+			{
+				mContainerLog.writeFrame(encoded);
+				return;
+			}
+
+			//Print id
+			mXmlLog << "<frame id=\"" << encoded.id << "\"";
+			if(encoded.hasColor){
+				mXmlLog << " colorTimestamp=\"" << encoded.colorTime << "\"";
+			}
+
+			if(encoded.hasDepth){
+				mXmlLog << " depthTimestamp=\"" << encoded.depthTime << "\"";
+			}
+
+			//TODO: Add more compression methods here
+			if(encoded.colorCompression != NO_COMPRESSION)
+			{
+				mXmlLog << " colorCompression=\"" << getCompressionMethodTag(encoded.colorCompression) << "\"";
+
+			}
+
+			if(encoded.depthCompression != NO_COMPRESSION)
+			{
+				mXmlLog << " depthCompression=\"" << getCompressionMethodTag(encoded.depthCompression) << "\"";
+			}
+
+			if(encoded.depthKeyframeId > 0)
+			{
+				mXmlLog << " depthKeyframe=\"" << encoded.depthKeyframeId << "\"";
+			}
+
+			//Close tag
+			mXmlLog << "/>" << endl;
+
+			//Save frames
+			ostringstream s;
+			s << outputDirectory << "\\" << encoded.id;
+			if(encoded.hasColor)
+				saveBinaryFile(s.str() + ".rgb", encoded.getColorPayload(), encoded.getColorPayloadSize());
+			if(encoded.hasDepth)
+				saveBinaryFile(s.str() + ".depth", encoded.getDepthPayload(), encoded.getDepthPayloadSize());
 		}
 
 		//Create the output directory. Returns false if directory could not be created or is not empty
@@ -116,6 +380,9 @@ namespace rgbd
 
 			mQueueGuard.lock();
 			mFrameQueue = queue<RGBDFramePtr>();//Clear queue
+			mDroppedFrames = 0;
+			mQueueHighWaterMark = 0;
+			mCompressionPolicy.reset();
 			mQueueGuard.unlock();
 
 			//Register listener
@@ -132,8 +399,17 @@ namespace rgbd
 		void FrameLogger::stopRecording()
 		{
 			if(mIsRecording){
-				mDevice->removeNewRGBDFrameListener(this);
+				//Frames the device delivered before this call are still queued for us, so hand them to the logger before it stops
+				mDevice->removeNewRGBDFrameListener(this, true);
+
+				//Wake the logger thread so it can drain the queue and exit
+				mQueueGuard.lock();
 				mIsRecording = false;
+				mFrameQueuedCond.notify_all();
+				mFrameEncodedCond.notify_all();
+				mQueueSpaceCond.notify_all();
+				mQueueGuard.unlock();
+
 				mLoggerThread.join();//Wait for thread to die (finish saving)
 				mDevice = NULL;
 			}
@@ -141,12 +417,74 @@ namespace rgbd
 
 		void FrameLogger::onNewRGBDFrame(RGBDFramePtr frame)
 		{
-			if(mIsRecording)
+			boost::unique_lock<boost::mutex> lock(mQueueGuard);
+			if(!mIsRecording)
+				return;
+
+			mCompressionPolicy.onFrameArrival();
+			if(mFrameQueue.size() >= mMaxQueueSize)
 			{
-				mQueueGuard.lock();
-				mFrameQueue.push(frame);
-				mQueueGuard.unlock();
+				switch(mOverflowPolicy)
+				{
+				case QUEUE_OVERFLOW_DROP_NEWEST:
+					mDroppedFrames++;
+					return;
+				case QUEUE_OVERFLOW_DROP_OLDEST:
+					while(mFrameQueue.size() >= mMaxQueueSize)
+					{
+						mFrameQueue.pop();
+						mDroppedFrames++;
+					}
+					break;
+				case QUEUE_OVERFLOW_BLOCK:
+				default:
+					while(mIsRecording && mFrameQueue.size() >= mMaxQueueSize)
+						mQueueSpaceCond.wait(lock);
+					if(!mIsRecording)
+					{
+						//Logger may already have drained the queue and exited
+						mDroppedFrames++;
+						return;
+					}
+					break;
+				}
 			}
+
+			mFrameQueue.push(frame);
+			mQueueHighWaterMark = max(mQueueHighWaterMark, mFrameQueue.size());
+			mFrameQueuedCond.notify_one();
+		}
+
+		void FrameLogger::setMaxQueueSize(size_t frames)
+		{
+			mQueueGuard.lock();
+			mMaxQueueSize = max(frames, (size_t) 1);
+			mQueueSpaceCond.notify_all();
+			mQueueGuard.unlock();
+		}
+
+		size_t FrameLogger::getMaxQueueSize()
+		{
+			mQueueGuard.lock();
+			size_t maxSize = mMaxQueueSize;
+			mQueueGuard.unlock();
+			return maxSize;
+		}
+
+		int FrameLogger::getDroppedFrameCount()
+		{
+			mQueueGuard.lock();
+			int dropped = mDroppedFrames;
+			mQueueGuard.unlock();
+			return dropped;
+		}
+
+		size_t FrameLogger::getQueueHighWaterMark()
+		{
+			mQueueGuard.lock();
+			size_t highWaterMark = mQueueHighWaterMark;
+			mQueueGuard.unlock();
+			return highWaterMark;
 		}
 
 	}
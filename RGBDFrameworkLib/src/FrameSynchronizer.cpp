@@ -0,0 +1,197 @@
+#include "FrameSynchronizer.h"
+
+namespace rgbd
+{
+	namespace framework
+	{
+		static inline timestamp getSkew(timestamp a, timestamp b)
+		{
+			return (a > b) ? a - b : b - a;
+		}
+
+		FrameSynchronizer::FrameSynchronizer(FrameHandler handler)
+		{
+			mHandler = handler;
+			mIsStopping = false;
+			mFlushRequested = false;
+			mMaxSkew = FRAME_SYNC_DEFAULT_MAX_SKEW;
+			mMaxWaitMs = FRAME_SYNC_DEFAULT_MAX_WAIT_MS;
+			resetStats();
+
+			mThread = boost::thread(&FrameSynchronizer::run, this);
+		}
+
+		FrameSynchronizer::~FrameSynchronizer(void)
+		{
+			{
+				boost::mutex::scoped_lock lock(mGuard);
+				mIsStopping = true;
+				mFrameCond.notify_all();
+			}
+			mThread.join();
+		}
+
+		void FrameSynchronizer::addDepthFrame(RGBDFramePtr frame)
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			PendingDepth pending;
+			pending.frame = frame;
+			pending.deadline = boost::chrono::steady_clock::now() + boost::chrono::milliseconds(mMaxWaitMs);
+			mPendingDepth.push_back(pending);
+			mFrameCond.notify_all();
+		}
+
+		void FrameSynchronizer::addColorFrame(RGBDFramePtr frame)
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			mPendingColor.push_back(frame);
+			if(mPendingColor.size() > FRAME_SYNC_MAX_PENDING_COLOR)
+				dropColor();
+			mFrameCond.notify_all();
+		}
+
+		void FrameSynchronizer::dropColor()
+		{
+			mPendingColor.pop_front();
+			mStats.droppedColorFrames++;
+		}
+
+		void FrameSynchronizer::collectReady(boost::chrono::steady_clock::time_point now, vector<RGBDFramePtr>& ready)
+		{
+			while(!mPendingDepth.empty())
+			{
+				PendingDepth& depth = mPendingDepth.front();
+				timestamp depthTime = depth.frame->getDepthTimestamp();
+
+				//Colors too old for this depth frame are too old for every later one
+				while(!mPendingColor.empty() && mPendingColor.front()->getColorTimestamp() + mMaxSkew < depthTime)
+					dropColor();
+
+				//Colors arrive in time order, so the best match is the last one before depthTime or the first one after.
+				//Once a color at or after depthTime has arrived, nothing better can come
+				size_t best = mPendingColor.size();
+				bool decided = false;
+				for(size_t i = 0; i < mPendingColor.size(); i++)
+				{
+					timestamp colorTime = mPendingColor[i]->getColorTimestamp();
+					if(getSkew(colorTime, depthTime) <= mMaxSkew &&
+						(best == mPendingColor.size() || getSkew(colorTime, depthTime) < getSkew(mPendingColor[best]->getColorTimestamp(), depthTime)))
+						best = i;
+					if(colorTime >= depthTime)
+					{
+						decided = true;
+						break;
+					}
+				}
+
+				if(!decided && !mFlushRequested && now < depth.deadline)
+					break;
+
+				RGBDFramePtr frame = depth.frame;
+				if(best < mPendingColor.size())
+				{
+					//Earlier colors lost to this one and can't pair with later depth frames without crossing
+					for(size_t i = 0; i < best; i++)
+						dropColor();
+
+					RGBDFramePtr color = mPendingColor.front();
+					mPendingColor.pop_front();
+					frame->overwriteColorData(color);
+
+					timestamp skew = getSkew(color->getColorTimestamp(), depthTime);
+					mStats.pairedFrames++;
+					mStats.maxSkew = max(mStats.maxSkew, skew);
+					mSkewSum += (double) skew;
+					mStats.meanSkew = mSkewSum/mStats.pairedFrames;
+				}else{
+					mStats.depthOnlyFrames++;
+				}
+
+				ready.push_back(frame);
+				mPendingDepth.pop_front();
+			}
+			mFlushRequested = false;
+		}
+
+		void FrameSynchronizer::run()
+		{
+			vector<RGBDFramePtr> ready;
+			boost::mutex::scoped_lock lock(mGuard);
+			while(!mIsStopping)
+			{
+				collectReady(boost::chrono::steady_clock::now(), ready);
+				if(!ready.empty())
+				{
+					//Deliver without the lock so the handler can't stall the device threads adding frames
+					lock.unlock();
+					for(size_t i = 0; i < ready.size(); i++)
+						mHandler(ready[i]);
+					ready.clear();
+					lock.lock();
+					continue;
+				}
+
+				if(mPendingDepth.empty())
+					mFrameCond.wait(lock);
+				else
+					mFrameCond.wait_until(lock, mPendingDepth.front().deadline);
+			}
+		}
+
+		void FrameSynchronizer::flush()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			mFlushRequested = true;
+			mFrameCond.notify_all();
+		}
+
+		void FrameSynchronizer::reset()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			mPendingDepth.clear();
+			mPendingColor.clear();
+		}
+
+		void FrameSynchronizer::setMaxSkew(timestamp maxSkew)
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			mMaxSkew = maxSkew;
+			mFrameCond.notify_all();
+		}
+
+		timestamp FrameSynchronizer::getMaxSkew()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			return mMaxSkew;
+		}
+
+		void FrameSynchronizer::setMaxWait(int milliseconds)
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			mMaxWaitMs = max(milliseconds, 0);
+		}
+
+		int FrameSynchronizer::getMaxWait()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			return mMaxWaitMs;
+		}
+
+		FrameSyncStats FrameSynchronizer::getStats()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			return mStats;
+		}
+
+		void FrameSynchronizer::resetStats()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			mStats.pairedFrames = 0;
+			mStats.depthOnlyFrames = 0;
+			mStats.droppedColorFrames = 0;
+			mStats.maxSkew = 0;
+			mStats.meanSkew = 0.0;
+			mSkewSum = 0.0;
+		}
+	}
+}
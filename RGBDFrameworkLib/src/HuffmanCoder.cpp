@@ -0,0 +1,126 @@
+#include "HuffmanCoder.h"
+#include <string.h>
+#include <queue>
+#include <functional>
+#include <algorithm>
+
+namespace rgbd
+{
+	namespace framework
+	{
+		void buildHuffmanLengths(const uint32_t* frequencies, int count, uint8_t* lengths)
+		{
+			vector<uint32_t> weights(frequencies, frequencies + count);
+			vector<int> parents(2*count);
+
+			for(;;)
+			{
+				memset(lengths, 0, count);
+
+				typedef pair<uint64_t, int> Node;
+				priority_queue<Node, vector<Node>, greater<Node> > queue;
+				for(int i = 0; i < count; i++)
+					if(weights[i] > 0)
+						queue.push(Node(weights[i], i));
+
+				if(queue.size() == 1)
+				{
+					//A single symbol still needs one bit
+					lengths[queue.top().second] = 1;
+					return;
+				}
+
+				int nextNode = count;
+				while(queue.size() > 1)
+				{
+					Node a = queue.top(); queue.pop();
+					Node b = queue.top(); queue.pop();
+					parents[a.second] = nextNode;
+					parents[b.second] = nextNode;
+					queue.push(Node(a.first + b.first, nextNode));
+					nextNode++;
+				}
+				int root = nextNode - 1;
+
+				int longest = 0;
+				for(int i = 0; i < count; i++)
+				{
+					if(weights[i] == 0)
+						continue;
+					int depth = 0;
+					for(int node = i; node != root; node = parents[node])
+						depth++;
+					lengths[i] = (uint8_t) depth;
+					longest = max(longest, depth);
+				}
+
+				if(longest <= HUFFMAN_MAX_CODE_LENGTH)
+					return;
+
+				//Flatten the distribution and try again
+				for(int i = 0; i < count; i++)
+					if(weights[i] > 0)
+						weights[i] = (weights[i] >> 1) | 1;
+			}
+		}
+
+		bool buildCanonicalCodes(const uint8_t* lengths, int count, uint16_t* codes)
+		{
+			int lengthCounts[HUFFMAN_MAX_CODE_LENGTH + 1] = {0};
+			for(int i = 0; i < count; i++)
+				lengthCounts[lengths[i]]++;
+			lengthCounts[0] = 0;
+
+			int nextCode[HUFFMAN_MAX_CODE_LENGTH + 1] = {0};
+			int code = 0;
+			for(int len = 1; len <= HUFFMAN_MAX_CODE_LENGTH; len++)
+			{
+				code = (code + lengthCounts[len - 1]) << 1;
+				nextCode[len] = code;
+				if(code + lengthCounts[len] > (1 << len))
+					return false;
+			}
+
+			for(int i = 0; i < count; i++)
+				codes[i] = (lengths[i] > 0) ? (uint16_t) nextCode[lengths[i]]++ : 0;
+			return true;
+		}
+
+		void writeHuffmanLengths(const uint8_t* lengths, int count, vector<char>& dest)
+		{
+			for(int i = 0; i + 1 < count; i += 2)
+				dest.push_back((char) ((lengths[i] << 4) | lengths[i + 1]));
+		}
+
+		bool readHuffmanLengths(const char* src, int count, uint8_t* lengths)
+		{
+			for(int i = 0; i + 1 < count; i += 2)
+			{
+				lengths[i] = ((uint8_t) src[i/2]) >> 4;
+				lengths[i + 1] = ((uint8_t) src[i/2]) & 0x0F;
+				if(lengths[i] > HUFFMAN_MAX_CODE_LENGTH || lengths[i + 1] > HUFFMAN_MAX_CODE_LENGTH)
+					return false;
+			}
+			return true;
+		}
+
+		bool HuffmanDecodeTable::build(const uint8_t* lengths, int count)
+		{
+			vector<uint16_t> codes(count);
+			if(!buildCanonicalCodes(lengths, count, &codes[0]))
+				return false;
+
+			mTable.assign(1 << HUFFMAN_MAX_CODE_LENGTH, 0);
+			for(int i = 0; i < count; i++)
+			{
+				if(lengths[i] == 0)
+					continue;
+				//Every table index starting with this code maps to the symbol
+				int shift = HUFFMAN_MAX_CODE_LENGTH - lengths[i];
+				for(int j = codes[i] << shift; j < ((codes[i] + 1) << shift); j++)
+					mTable[j] = (uint16_t) ((i << 4) | lengths[i]);
+			}
+			return true;
+		}
+	}
+}
@@ -0,0 +1,126 @@
+#include "LatestFrameMailbox.h"
+
+namespace rgbd
+{
+	namespace framework
+	{
+		LatestFrameMailbox::LatestFrameMailbox(void)
+			: mRetired(LATEST_FRAME_MAILBOX_RETIRE_CAPACITY)
+		{
+			for(int i = 0; i < 3; i++)
+			{
+				mSlots[i] = RGBDFramePtr(new RGBDFrame());
+				mSequence[i] = 0;
+			}
+			mFront = 0;
+			mMiddle = 1;
+			mBack = 2;
+			mPublished = 0;
+			mLastColorTime = 0;
+			mLastDepthTime = 0;
+			mLastConsumed = 0;
+			mSkipped = 0;
+		}
+
+		void LatestFrameMailbox::onNewRGBDFrame(RGBDFramePtr frame)
+		{
+			publish(frame);
+		}
+
+		void LatestFrameMailbox::publish(RGBDFramePtr frame)
+		{
+			if(frame == NULL)
+				return;
+
+			RGBDFrame* slot = mSlots[mBack].get();
+
+			//The consumer empties slots it is done with, so anything left here is a frame it skipped.
+			//Hold its references so overwriting the slot can't drop the last one
+			RetiredArrays skipped;
+			skipped.color = slot->getColorArray();
+			skipped.depth = slot->getDepthArray();
+			skipped.slab = slot->getSlab();
+
+			//Copies the metadata and shares the arrays
+			*slot = *frame;
+			if(!frame->hasColor() && mLastColorArray != NULL)
+			{
+				slot->setColorArray(mLastColorArray);
+				slot->setColorTimestamp(mLastColorTime);
+				slot->setHasColor(true);
+			}
+			if(!frame->hasDepth() && mLastDepthArray != NULL)
+			{
+				slot->setDepthArray(mLastDepthArray);
+				slot->setDepthTimestamp(mLastDepthTime);
+				slot->setHasDepth(true);
+			}
+
+			RetiredArrays replaced;
+			if(frame->hasColor())
+			{
+				replaced.color.swap(mLastColorArray);
+				mLastColorArray = frame->getColorArray();
+				mLastColorTime = frame->getColorTimestamp();
+			}
+			if(frame->hasDepth())
+			{
+				replaced.depth.swap(mLastDepthArray);
+				mLastDepthArray = frame->getDepthArray();
+				mLastDepthTime = frame->getDepthTimestamp();
+			}
+
+			retire(skipped);
+			retire(replaced);
+
+			mSequence[mBack] = ++mPublished;
+
+			//The exchange publishes the slot contents and hands back the slot to fill next time.
+			//If that slot was still fresh the consumer never saw it, which consume detects from the sequence numbers
+			int previous = mMiddle.exchange(mBack | FRESH_FLAG, boost::memory_order_acq_rel);
+			mBack = previous & SLOT_MASK;
+		}
+
+		void LatestFrameMailbox::retire(const RetiredArrays& arrays)
+		{
+			if(arrays.color == NULL && arrays.depth == NULL && arrays.slab == NULL)
+				return;
+
+			//When full the caller's copy is the last one the mailbox holds, and it is released in publish
+			mRetired.push(arrays);
+		}
+
+		void LatestFrameMailbox::releaseRetired()
+		{
+			//Each pop overwrites, and so releases, the previous entry
+			RetiredArrays arrays;
+			while(mRetired.pop(arrays));
+		}
+
+		RGBDFramePtr LatestFrameMailbox::consume(uint64_t& skipped)
+		{
+			releaseRetired();
+
+			skipped = 0;
+			if((mMiddle.load(boost::memory_order_acquire) & FRESH_FLAG) == 0)
+				return RGBDFramePtr();
+
+			//The frame returned last time is no longer valid. Empty it so its arrays are released on this thread
+			*mSlots[mFront] = RGBDFrame();
+
+			int previous = mMiddle.exchange(mFront, boost::memory_order_acq_rel);
+			mFront = previous & SLOT_MASK;
+
+			skipped = mSequence[mFront] - mLastConsumed - 1;
+			mLastConsumed = mSequence[mFront];
+			mSkipped += skipped;
+			return mSlots[mFront];
+		}
+
+		RGBDFramePtr LatestFrameMailbox::consume()
+		{
+			uint64_t skipped;
+			return consume(skipped);
+		}
+	}
+}
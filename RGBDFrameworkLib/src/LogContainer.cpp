@@ -0,0 +1,296 @@
+#include "LogContainer.h"
+
+
+
+namespace rgbd
+{
+	namespace framework
+	{
+		LogContainerWriter::LogContainerWriter(void)
+		{
+			mOffset = 0;
+		}
+
+
+		LogContainerWriter::~LogContainerWriter(void)
+		{
+			if(mFile.is_open())
+				close();
+		}
+
+		bool LogContainerWriter::open(string filename, int xRes, int yRes)
+		{
+			mFile.open(filename, ios::out|ios::binary|ios::trunc);
+			if(!mFile.is_open())
+				return false;
+
+			mIndex.clear();
+
+			LogContainerHeader header;
+			memcpy(header.magic, LOG_CONTAINER_MAGIC, sizeof(header.magic));
+			header.version = LOG_CONTAINER_VERSION;
+			header.xRes = xRes;
+			header.yRes = yRes;
+			header.headerSize = sizeof(LogContainerHeader);
+
+			mFile.write((const char*) &header, sizeof(header));
+			mOffset = sizeof(header);
+			writePadding((mOffset + LOG_CONTAINER_ALIGNMENT - 1) & ~((uint64_t) LOG_CONTAINER_ALIGNMENT - 1));
+
+			return mFile.good();
+		}
+
+		void LogContainerWriter::writePadding(uint64_t alignedOffset)
+		{
+			static const char zeros[LOG_CONTAINER_ALIGNMENT] = {0};
+			if(alignedOffset > mOffset)
+			{
+				mFile.write(zeros, (streamsize) (alignedOffset - mOffset));
+				mOffset = alignedOffset;
+			}
+		}
+
+		bool LogContainerWriter::writeFrame(const EncodedFrame& frame)
+		{
+			if(!mFile.is_open())
+				return false;
+
+			LogIndexEntry entry;
+			entry.chunkOffset = mOffset;
+
+			LogChunkHeader& header = entry.header;
+			header.magic = LOG_CHUNK_MAGIC;
+			header.headerSize = sizeof(LogChunkHeader);
+			header.hasColor = frame.hasColor;
+			header.hasDepth = frame.hasDepth;
+			header.frameId = frame.id;
+			header.colorTime = frame.colorTime;
+			header.depthTime = frame.depthTime;
+			header.colorCompression = (uint8_t) frame.colorCompression;
+			header.depthCompression = (uint8_t) frame.depthCompression;
+			header.depthKeyframeDistance = (frame.depthKeyframeId > 0) ? (uint16_t) (frame.id - frame.depthKeyframeId) : 0;
+			header.colorSize = frame.hasColor ? frame.getColorPayloadSize() : 0;
+			header.depthSize = frame.hasDepth ? frame.getDepthPayloadSize() : 0;
+
+			mFile.write((const char*) &header, sizeof(header));
+			mOffset += sizeof(header);
+
+			writePadding(entry.chunkOffset + getChunkColorOffset(header));
+			if(header.colorSize > 0)
+			{
+				mFile.write(frame.getColorPayload(), header.colorSize);
+				mOffset += header.colorSize;
+			}
+
+			writePadding(entry.chunkOffset + getChunkDepthOffset(header));
+			if(header.depthSize > 0)
+			{
+				mFile.write(frame.getDepthPayload(), header.depthSize);
+				mOffset += header.depthSize;
+			}
+
+			writePadding(entry.chunkOffset + getChunkSize(header));
+
+			if(!mFile.good())
+				return false;
+
+			mIndex.push_back(entry);
+			return true;
+		}
+
+		void LogContainerWriter::close()
+		{
+			if(!mFile.is_open())
+				return;
+
+			LogIndexFooter footer;
+			footer.indexOffset = mOffset;
+			footer.frameCount = (uint32_t) mIndex.size();
+			footer.magic = LOG_INDEX_MAGIC;
+
+			if(!mIndex.empty())
+				mFile.write((const char*) &mIndex[0], mIndex.size()*sizeof(LogIndexEntry));
+			mFile.write((const char*) &footer, sizeof(footer));
+
+			mFile.close();
+			mIndex.clear();
+			mOffset = 0;
+		}
+
+
+		LogContainerReader::LogContainerReader(void)
+		{
+			memset(&mHeader, 0, sizeof(mHeader));
+			mFileSize = 0;
+		}
+
+
+		LogContainerReader::~LogContainerReader(void)
+		{
+			close();
+		}
+
+		bool LogContainerReader::open(string filename)
+		{
+			close();
+			mFilename = filename;
+			mFile.open(filename, ios::in|ios::binary);
+			if(!mFile.is_open())
+				return false;
+
+			mFile.seekg(0, mFile.end);
+			mFileSize = (uint64_t) mFile.tellg();
+			mFile.seekg(0, mFile.beg);
+
+			if(mFileSize < sizeof(LogContainerHeader))
+			{
+				close();
+				return false;
+			}
+
+			mFile.read((char*) &mHeader, sizeof(mHeader));
+			if(memcmp(mHeader.magic, LOG_CONTAINER_MAGIC, sizeof(mHeader.magic)) != 0 ||
+				mHeader.version > LOG_CONTAINER_VERSION)
+			{
+				close();
+				return false;
+			}
+
+			return true;
+		}
+
+		void LogContainerReader::close()
+		{
+			if(mFile.is_open())
+				mFile.close();
+			mFile.clear();
+			mFileSize = 0;
+			//Views handed out earlier keep their own reference to the mapping
+			mMapping.reset();
+		}
+
+		bool LogContainerReader::mapFile()
+		{
+			if(!mFile.is_open())
+				return false;
+			if(mMapping != NULL)
+				return true;
+
+			try
+			{
+				boost::iostreams::mapped_file_params params(mFilename);
+				params.flags = boost::iostreams::mapped_file::priv;
+				mMapping = boost::shared_ptr<boost::iostreams::mapped_file>(new boost::iostreams::mapped_file(params));
+			}catch(std::exception&)
+			{
+				mMapping.reset();
+				return false;
+			}
+
+			if(!mMapping->is_open() || (uint64_t) mMapping->size() < mFileSize)
+			{
+				mMapping.reset();
+				return false;
+			}
+			return true;
+		}
+
+		char* LogContainerReader::getMappedPayload(uint64_t offset, uint32_t size)
+		{
+			if(mMapping == NULL || offset + size > mFileSize)
+				return NULL;
+			return mMapping->data() + offset;
+		}
+
+		bool LogContainerReader::readIndex(vector<LogIndexEntry>& index)
+		{
+			index.clear();
+			if(!mFile.is_open())
+				return false;
+
+			if(!readIndexFooter(index))
+			{
+				//Recording was interrupted. Recover what we can.
+				index.clear();
+				scanChunks(index);
+			}
+
+			return true;
+		}
+
+		bool LogContainerReader::readIndexFooter(vector<LogIndexEntry>& index)
+		{
+			if(mFileSize < sizeof(LogContainerHeader) + sizeof(LogIndexFooter))
+				return false;
+
+			LogIndexFooter footer;
+			mFile.clear();
+			mFile.seekg(mFileSize - sizeof(LogIndexFooter), mFile.beg);
+			mFile.read((char*) &footer, sizeof(footer));
+			if(!mFile.good() || footer.magic != LOG_INDEX_MAGIC)
+				return false;
+
+			uint64_t indexBytes = ((uint64_t) footer.frameCount)*sizeof(LogIndexEntry);
+			if(footer.indexOffset + indexBytes + sizeof(LogIndexFooter) != mFileSize)
+				return false;
+
+			index.resize(footer.frameCount);
+			if(footer.frameCount > 0)
+			{
+				mFile.seekg(footer.indexOffset, mFile.beg);
+				mFile.read((char*) &index[0], indexBytes);
+			}
+
+			return mFile.good();
+		}
+
+		void LogContainerReader::scanChunks(vector<LogIndexEntry>& index)
+		{
+			uint64_t offset = (mHeader.headerSize + LOG_CONTAINER_ALIGNMENT - 1) & ~((uint64_t) LOG_CONTAINER_ALIGNMENT - 1);
+
+			while(offset + sizeof(LogChunkHeader) <= mFileSize)
+			{
+				LogIndexEntry entry;
+				entry.chunkOffset = offset;
+
+				mFile.clear();
+				mFile.seekg(offset, mFile.beg);
+				mFile.read((char*) &entry.header, sizeof(LogChunkHeader));
+				if(!mFile.good() || entry.header.magic != LOG_CHUNK_MAGIC || entry.header.headerSize < sizeof(LogChunkHeader))
+					break;
+
+				//Skip truncated chunks
+				uint64_t chunkSize = getChunkSize(entry.header);
+				if(offset + getChunkDepthOffset(entry.header) + entry.header.depthSize > mFileSize)
+					break;
+
+				index.push_back(entry);
+				offset += chunkSize;
+			}
+		}
+
+		bool LogContainerReader::readPayload(uint64_t offset, uint32_t size, vector<char>& buffer)
+		{
+			if(!mFile.is_open() || offset + size > mFileSize)
+				return false;
+
+			buffer.resize(size);
+			if(size == 0)
+				return true;
+
+			return readPayload(offset, size, &buffer[0]);
+		}
+
+		bool LogContainerReader::readPayload(uint64_t offset, uint32_t size, char* dest)
+		{
+			if(!mFile.is_open() || offset + size > mFileSize)
+				return false;
+
+			mFile.clear();
+			mFile.seekg(offset, mFile.beg);
+			mFile.read(dest, size);
+			return mFile.good();
+		}
+
+	}
+}
@@ -1,4 +1,7 @@
 #include "LogDevice.h"
+#include "DepthCodec.h"
+#include <algorithm>
+#include <boost/bind.hpp>
 
 
 
@@ -6,12 +9,16 @@ namespace rgbd
 {
 	namespace framework
 	{
-		LogDevice::LogDevice(void)
+		LogDevice::LogDevice(void) : mFrameCache(&mFrameFactory)
 		{
 			mDirectory = "";
 
 			mXRes = 0;
 			mYRes = 0;
+			mLogFormat = LOG_FORMAT_FILES;
+			mMemoryMappedPlayback = false;
+			mMappingFailed = false;
+			mUseSidecarIndex = true;
 
 			//Stream management
 			mLoopStreams = false;
@@ -19,16 +26,40 @@ namespace rgbd
 			mColorStreaming = false;
 			mDepthStreaming = false;
 			mLogInd = 0;
+			mLastDispatchTimeUS = 0;
 
 			mPlaybackSpeed = 1.0;
-
-			mBufferCapacity = 150;
+			mPlaybackMode = PLAYBACK_REAL_TIME;
+			mAcknowledgeWindow = 0;
+			mUnacknowledgedFrames = 0;
+			mPlaybackStartTime = boost::chrono::steady_clock::now();
+			mDeviceGroup = NULL;
+			mGroupDispatching = false;
+			mListenerSpaceHandler = boost::bind(&LogDevice::notifyPlayback, this);
+			resetPlaybackTimingStats();
+
+			//Roughly 150 VGA frames
+			mBufferMemoryBudget = 256*1024*1024;
+			mBufferedBytes = 0;
+			mInFlightBytes = 0;
+			mNextDecodeSeq = 0;
+			mNextDeliverSeq = 0;
+			mBufferGeneration = 0;
+
+			mDecodeThreadCount = max((int) boost::thread::hardware_concurrency() - 1, 1);
 
 		}
 
 
 		LogDevice::~LogDevice(void)
 		{
+			mColorStreaming = false;
+			mDepthStreaming = false;
+			joinPlaybackThreads();
+			if(mDeviceGroup != NULL)
+				mDeviceGroup->removeSource(this);
+			//Frame listeners may still call mListenerSpaceHandler until their dispatchers stop
+			mNewRGBDFrameListeners.clear();
 		}
 
 
@@ -39,142 +70,391 @@ namespace rgbd
 			return DEVICESTATUS_OK;	
 		}
 
-		void LogDevice::insertColorFrameToSyncedFrames(FrameMetaData colorData)
+		static inline timestamp getTimeDistance(timestamp a, timestamp b)
 		{
-			//Assumes depth data is sorted.
-			std::vector<SyncFrameMetaData>::iterator it = mLogFrames.begin();
+			return (a > b) ? a - b : b - a;
+		}
 
-			timestamp deltaT = colorData.time - it->depthData.time;//Current gradient
+		static bool isEarlierFrame(const FrameMetaData& a, const FrameMetaData& b)
+		{
+			return a.time < b.time;
+		}
+
+		static bool isEarlierSyncFrame(const SyncFrameMetaData& a, const SyncFrameMetaData& b)
+		{
+			return a.depthData.time < b.depthData.time;
+		}
+
+		//Pairs every color frame with the depth frame closest in time. frames must be sorted by depth time.
+		//If several color frames are closest to the same depth frame, the closest of them wins.
+		static void mergeColorFrames(vector<SyncFrameMetaData>& frames, vector<FrameMetaData>& colorFrames)
+		{
+			if(frames.empty())
+				return;
 
-			//If not last element and next element is closer, move up
-			while(it != mLogFrames.end() - 1 && (deltaT > colorData.time - (it+1)->depthData.time))
+			if(!is_sorted(colorFrames.begin(), colorFrames.end(), isEarlierFrame))
+				stable_sort(colorFrames.begin(), colorFrames.end(), isEarlierFrame);
+
+			//Both streams are in time order, so the closest depth frame only ever moves forward
+			size_t depthInd = 0;
+			for(vector<FrameMetaData>::iterator it = colorFrames.begin(); it != colorFrames.end(); ++it)
 			{
-				++it;
-				deltaT = colorData.time - it->depthData.time;//Current gradient
+				while(depthInd + 1 < frames.size() &&
+					getTimeDistance(it->time, frames[depthInd + 1].depthData.time) <= getTimeDistance(it->time, frames[depthInd].depthData.time))
+					depthInd++;
+
+				SyncFrameMetaData& sync = frames[depthInd];
+				if(sync.colorData.id == 0 ||
+					getTimeDistance(it->time, sync.depthData.time) < getTimeDistance(sync.colorData.time, sync.depthData.time))
+					sync.colorData = *it;
 			}
+		}
 
-			//At correct insertion point. (minimum difference)
-			it->colorData = colorData;
+		//Splits the text between '<' and '>' into a tag name and name="value" attributes
+		static void parseXmlTag(const string& text, string& name, vector<pair<string, string> >& attributes)
+		{
+			attributes.clear();
+			size_t pos = text.find_first_not_of(" \t\r\n");
+			size_t end = text.find_first_of(" \t\r\n/", pos);
+			if(pos == string::npos)
+			{
+				name.clear();
+				return;
+			}
+			name.assign(text, pos, (end == string::npos ? text.size() : end) - pos);
 
+			pos = end;
+			while(pos != string::npos)
+			{
+				size_t nameStart = text.find_first_not_of(" \t\r\n/", pos);
+				size_t equals = text.find('=', nameStart);
+				if(nameStart == string::npos || equals == string::npos)
+					return;
+				size_t valueStart = text.find_first_of("\"'", equals);
+				if(valueStart == string::npos)
+					return;
+				size_t valueEnd = text.find(text[valueStart], valueStart + 1);
+				if(valueEnd == string::npos)
+					return;
+
+				size_t nameEnd = text.find_last_not_of(" \t\r\n", equals - 1) + 1;
+				attributes.push_back(pair<string, string>(text.substr(nameStart, nameEnd - nameStart),
+					text.substr(valueStart + 1, valueEnd - valueStart - 1)));
+				pos = valueEnd + 1;
+			}
 		}
 
-		void LogDevice::loadLog(string logFile)
+		static timestamp parseTimestamp(const string& value)
 		{
-			string logStr = loadTextFile(logFile);
+			timestamp time = 0;
+			for(string::const_iterator it = value.begin(); it != value.end() && *it >= '0' && *it <= '9'; ++it)
+				time = time*10 + (*it - '0');
+			return time;
+		}
 
-			//Need to copy string to parse it
-			char *cstr = new char[logStr.length() + 1]();
-			logStr.copy(cstr, logStr.length());
-			xml_document<> doc;    // character type defaults to char
-			doc.parse<0>(cstr);    // 0 means default parse flags
+		bool LogDevice::parseLog(string logFile, vector<SyncFrameMetaData>& frames, timestamp& startTime)
+		{
+			ifstream file(logFile);
+			if(!file.is_open())
+			{
+				onMessage("Invalid Log File\n");
+				return false;
+			}
 
 			vector<FrameMetaData> colorFrames;
+			timestamp depthStartTime = 0;
+			timestamp colorStartTime = 0;
+			bool foundDevice = false;
+
+			string text, name;
+			vector<pair<string, string> > attributes;
+			while(getline(file, text, '>'))
+			{
+				size_t tagStart = text.find('<');
+				if(tagStart == string::npos)
+					continue;
+				parseXmlTag(text.substr(tagStart + 1), name, attributes);
 
-			//Parse tree
-			xml_node<char>* root = doc.first_node("device");
-			if(root != 0)
-			{
-				//Load device
-				xml_attribute<char>* xres = root->first_attribute("xresolution");
-				xml_attribute<char>* yres = root->first_attribute("yresolution");
-				if(xres != 0 && yres != 0){
-					mXRes = atoi(xres->value());
-					mYRes = atoi(yres->value());
-
-					//Clear array
-					mLogGuard.lock();
-					mLogFrames.clear();
-					mLogGuard.unlock();
-
-					xml_node<char>* frame = root->first_node("frame");
-					if(frame != 0){
-						timestamp depthStartTime = 0;
-						timestamp colorStartTime = 0;
-						while(frame != 0){
-							xml_attribute<char>* id = frame->first_attribute("id");
-							xml_attribute<char>* colorTimestamp = frame->first_attribute("colorTimestamp");
-							xml_attribute<char>* depthTimestamp = frame->first_attribute("depthTimestamp");
-							xml_attribute<char>* colorCompression = frame->first_attribute("colorCompression");
-							xml_attribute<char>* depthCompression = frame->first_attribute("depthCompression");
-
-							if(id != 0){
-								int frameId = atoi(id->value());
-								if(colorTimestamp != 0)
-								{
-
-									timestamp time = boost::lexical_cast<timestamp>(colorTimestamp->value());
-									if(colorStartTime == 0)
-										colorStartTime = time;
-									COMPRESSION_METHOD compressionMethod = NO_COMPRESSION;
-									if(colorCompression != 0)
-									{
-										char* compressionAlgId = colorCompression->value();
-										compressionMethod = getCompressionMethodFromTag(string(compressionAlgId));
-									}
-
-									colorFrames.push_back(FrameMetaData(frameId, time, compressionMethod));
-								}
-
-								if(depthTimestamp != 0)
-								{
-									timestamp time = boost::lexical_cast<timestamp>(depthTimestamp->value());
-									if(depthStartTime == 0)
-										depthStartTime = time;
-
-									COMPRESSION_METHOD compressionMethod = NO_COMPRESSION;
-									if(depthCompression != 0)
-									{
-										char* compressionAlgId = depthCompression->value();
-										compressionMethod = getCompressionMethodFromTag(string(compressionAlgId));
-									}
-
-									//Build master list from depth frames
-									mLogGuard.lock();
-									SyncFrameMetaData syncFrame;
-									syncFrame.depthData = FrameMetaData(frameId, time, compressionMethod);
-									mLogFrames.push_back(syncFrame);
-									mLogGuard.unlock();
-								}
-
-							}
-							frame = frame->next_sibling("frame");
-						}
-
-						mStartTime = min(depthStartTime, colorStartTime);
-
-						//Merge color and depth streams by timestamp
-
-						for(std::vector<FrameMetaData>::iterator it = colorFrames.begin(); it != colorFrames.end(); ++it)
-						{
-							mLogGuard.lock();
-							insertColorFrameToSyncedFrames(*it);
-							mLogGuard.unlock();
-						}
-
-
-					}else{
-						onMessage("Empty Log File\n");
+				if(name == "device")
+				{
+					int xRes = 0, yRes = 0;
+					for(size_t i = 0; i < attributes.size(); i++)
+					{
+						if(attributes[i].first == "xresolution")
+							xRes = atoi(attributes[i].second.c_str());
+						else if(attributes[i].first == "yresolution")
+							yRes = atoi(attributes[i].second.c_str());
+					}
+					if(xRes == 0 || yRes == 0)
+					{
+						onMessage("Missing Resolution Attributes\n");
+						return false;
+					}
+					mXRes = xRes;
+					mYRes = yRes;
+					foundDevice = true;
+				}else if(name == "frame" && foundDevice){
+					int frameId = 0;
+					bool hasColor = false, hasDepth = false;
+					FrameMetaData colorData, depthData;
+					for(size_t i = 0; i < attributes.size(); i++)
+					{
+						const string& attribute = attributes[i].first;
+						const string& value = attributes[i].second;
+						if(attribute == "id")
+							frameId = atoi(value.c_str());
+						else if(attribute == "colorTimestamp"){
+							colorData.time = parseTimestamp(value);
+							hasColor = true;
+						}else if(attribute == "depthTimestamp"){
+							depthData.time = parseTimestamp(value);
+							hasDepth = true;
+						}else if(attribute == "colorCompression")
+							colorData.compressionMode = getCompressionMethodFromTag(value);
+						else if(attribute == "depthCompression")
+							depthData.compressionMode = getCompressionMethodFromTag(value);
+						else if(attribute == "depthKeyframe")
+							depthData.keyframeId = atoi(value.c_str());
+					}
+
+					if(frameId == 0)
+						continue;
+
+					if(hasColor)
+					{
+						if(colorStartTime == 0)
+							colorStartTime = colorData.time;
+						colorData.id = frameId;
+						colorFrames.push_back(colorData);
+					}
+
+					if(hasDepth)
+					{
+						if(depthStartTime == 0)
+							depthStartTime = depthData.time;
+
+						//Build master list from depth frames
+						SyncFrameMetaData syncFrame;
+						syncFrame.depthData = depthData;
+						syncFrame.depthData.id = frameId;
+						frames.push_back(syncFrame);
 					}
-				}else{
-					onMessage("Missing Resolution Attributes\n");
 				}
-			}else{
+			}
+
+			if(!foundDevice)
+			{
+				onMessage("Invalid Log File\n");
+				return false;
+			}
+
+			if(frames.empty())
+			{
+				onMessage("Empty Log File\n");
+				return true;
+			}
+
+			startTime = (colorStartTime == 0) ? depthStartTime : min(depthStartTime, colorStartTime);
+
+			//Merge color and depth streams by timestamp
+			if(!is_sorted(frames.begin(), frames.end(), isEarlierSyncFrame))
+				stable_sort(frames.begin(), frames.end(), isEarlierSyncFrame);
+			mergeColorFrames(frames, colorFrames);
+			return true;
+		}
+
+		static void toSidecarFrame(const FrameMetaData& data, LogSidecarFrame& out)
+		{
+			out.id = data.id;
+			out.time = data.time;
+			out.compressionMode = (uint8_t) data.compressionMode;
+			out.keyframeId = data.keyframeId;
+		}
+
+		static FrameMetaData fromSidecarFrame(const LogSidecarFrame& data)
+		{
+			FrameMetaData out(data.id, data.time, (COMPRESSION_METHOD) data.compressionMode);
+			out.keyframeId = data.keyframeId;
+			return out;
+		}
+
+		bool LogDevice::loadSidecarIndex(string logFile, vector<SyncFrameMetaData>& frames, timestamp& startTime)
+		{
+			string sidecarFile = logFile + LOG_SIDECAR_EXTENSION;
+			if(!fileExists(sidecarFile))
+				return false;
+
+			boost::iostreams::mapped_file_source mapping;
+			try
+			{
+				mapping.open(sidecarFile);
+			}catch(std::exception&)
+			{
+				return false;
+			}
+			if(!mapping.is_open() || mapping.size() < sizeof(LogSidecarHeader))
+				return false;
+
+			LogSidecarHeader header;
+			memcpy(&header, mapping.data(), sizeof(header));
+			if(header.magic != LOG_SIDECAR_MAGIC || header.version != LOG_SIDECAR_VERSION ||
+				header.sourceSize != getFileSize(logFile) || header.sourceWriteTime != getFileWriteTime(logFile) ||
+				mapping.size() != sizeof(LogSidecarHeader) + ((uint64_t) header.frameCount)*sizeof(LogSidecarEntry))
+				return false;
+
+			const LogSidecarEntry* entries = (const LogSidecarEntry*) (mapping.data() + sizeof(LogSidecarHeader));
+			frames.resize(header.frameCount);
+			for(uint32_t i = 0; i < header.frameCount; i++)
+			{
+				frames[i].depthData = fromSidecarFrame(entries[i].depth);
+				frames[i].colorData = fromSidecarFrame(entries[i].color);
+			}
+
+			mXRes = header.xRes;
+			mYRes = header.yRes;
+			startTime = header.startTime;
+			return true;
+		}
+
+		void LogDevice::saveSidecarIndex(string logFile, const vector<SyncFrameMetaData>& frames, timestamp startTime)
+		{
+			LogSidecarHeader header;
+			header.magic = LOG_SIDECAR_MAGIC;
+			header.version = LOG_SIDECAR_VERSION;
+			header.sourceSize = getFileSize(logFile);
+			header.sourceWriteTime = getFileWriteTime(logFile);
+			header.xRes = mXRes;
+			header.yRes = mYRes;
+			header.startTime = startTime;
+			header.frameCount = (uint32_t) frames.size();
+
+			vector<char> data(sizeof(LogSidecarHeader) + frames.size()*sizeof(LogSidecarEntry));
+			memcpy(&data[0], &header, sizeof(header));
+			LogSidecarEntry* entries = (LogSidecarEntry*) (&data[0] + sizeof(LogSidecarHeader));
+			for(size_t i = 0; i < frames.size(); i++)
+			{
+				toSidecarFrame(frames[i].depthData, entries[i].depth);
+				toSidecarFrame(frames[i].colorData, entries[i].color);
+			}
+
+			//The index is only a cache. If it can't be written the log is parsed again next time
+			saveBinaryFile(logFile + LOG_SIDECAR_EXTENSION, &data[0], (int) data.size());
+		}
+
+		void LogDevice::loadLog(string logFile)
+		{
+			vector<SyncFrameMetaData> logFrames;
+			timestamp startTime = 0;
+
+			if(!mUseSidecarIndex || !loadSidecarIndex(logFile, logFrames, startTime))
+			{
+				if(!parseLog(logFile, logFrames, startTime))
+					logFrames.clear();
+				else if(mUseSidecarIndex && !logFrames.empty())
+					saveSidecarIndex(logFile, logFrames, startTime);
+			}
+
+			mStartTime = startTime;
+			mLogGuard.lock();
+			mLogFrames.swap(logFrames);
+			mLogGuard.unlock();
+			mFrameCache.clear();
+		}
+
+		void LogDevice::loadContainer(string containerFile)
+		{
+			mContainerFile = containerFile;
+
+			//Clear array
+			mLogGuard.lock();
+			mLogFrames.clear();
+			mLogGuard.unlock();
+
+			//A new log gets a new chance to be mapped
+			mMappingGuard.lock();
+			mMappingFailed = false;
+			bool opened = mContainerReader.open(containerFile);
+			mMappingGuard.unlock();
+			if(!opened)
+			{
 				onMessage("Invalid Log File\n");
+				return;
+			}
+
+			mXRes = mContainerReader.getXRes();
+			mYRes = mContainerReader.getYRes();
+
+			vector<LogIndexEntry> index;
+			mContainerReader.readIndex(index);
+
+			if(index.empty())
+			{
+				onMessage("Empty Log File\n");
+				return;
 			}
 
-			//Free memory
-			delete [] cstr;
+			vector<SyncFrameMetaData> logFrames;
+			vector<FrameMetaData> colorFrames;
+			timestamp depthStartTime = 0;
+			timestamp colorStartTime = 0;
+			for(vector<LogIndexEntry>::iterator it = index.begin(); it != index.end(); ++it)
+			{
+				const LogChunkHeader& header = it->header;
+				if(header.hasColor)
+				{
+					if(colorStartTime == 0)
+						colorStartTime = header.colorTime;
+					colorFrames.push_back(FrameMetaData(header.frameId, header.colorTime, (COMPRESSION_METHOD) header.colorCompression,
+						it->chunkOffset + getChunkColorOffset(header), header.colorSize));
+				}
+
+				if(header.hasDepth)
+				{
+					if(depthStartTime == 0)
+						depthStartTime = header.depthTime;
+
+					//Build master list from depth frames
+					SyncFrameMetaData syncFrame;
+					syncFrame.depthData = FrameMetaData(header.frameId, header.depthTime, (COMPRESSION_METHOD) header.depthCompression,
+						it->chunkOffset + getChunkDepthOffset(header), header.depthSize);
+					if(header.depthKeyframeDistance > 0)
+						syncFrame.depthData.keyframeId = header.frameId - header.depthKeyframeDistance;
+					logFrames.push_back(syncFrame);
+				}
+			}
+
+			mStartTime = (colorStartTime == 0) ? depthStartTime : min(depthStartTime, colorStartTime);
+
+			//Merge color and depth streams by timestamp
+			if(!is_sorted(logFrames.begin(), logFrames.end(), isEarlierSyncFrame))
+				stable_sort(logFrames.begin(), logFrames.end(), isEarlierSyncFrame);
+			mergeColorFrames(logFrames, colorFrames);
+
+			mLogGuard.lock();
+			mLogFrames.swap(logFrames);
+			mLogGuard.unlock();
+			mFrameCache.clear();
 		}
 
 		DeviceStatus LogDevice::connect(void)
 		{
+			std::ostringstream containerPath; 
+			containerPath << mDirectory << "\\" << LOG_CONTAINER_FILENAME;
 
 			std::ostringstream logfilePath; 
 			logfilePath << mDirectory << "\\log.xml";
-			if(fileExists(logfilePath.str()))
+			if(fileExists(containerPath.str()))
 			{
+				//Single file log
+				mLogFormat = LOG_FORMAT_CONTAINER;
+				loadContainer(containerPath.str());
 
+				onConnect();
+				return DEVICESTATUS_OK;
+			}else if(fileExists(logfilePath.str()))
+			{
 				//Load log.
+				mLogFormat = LOG_FORMAT_FILES;
 				loadLog(logfilePath.str());
 
 				onConnect();
@@ -211,101 +491,357 @@ namespace rgbd
 		}
 
 
+		bool LogDevice::decodeNextFrame(LogDecodeContext& context, boost::unique_lock<boost::mutex>& lock)
+		{
+			//Loop buffer if turned on 
+			if(mLoopStreams && (int) mLogFrames.size() <= mLogInd) 
+			{
+				mLogInd = 0;
+			}
+
+			//Wait for pending frames and room in the budget. Always allow one frame so tiny budgets still play
+			size_t frameBytes = getFrameBytes();
+			size_t usedBytes = mBufferedBytes + mInFlightBytes;
+			if(mLogInd >= (int) mLogFrames.size() || (usedBytes > 0 && usedBytes + frameBytes > mBufferMemoryBudget))
+				return false;
+
+			//Claim the frame
+			int logInd = mLogInd;
+			SyncFrameMetaData frame = mLogFrames[logInd];
+			mLogInd++;
+			int seq = mNextDecodeSeq++;
+			int generation = mBufferGeneration;
+			mInFlightBytes += frameBytes;
+
+			//Decode without holding the lock
+			lock.unlock();
+			RGBDFramePtr localFrame = mFrameCache.getFrame(logInd, mDepthStreaming && frame.depthData.id > 0, mColorStreaming && frame.colorData.id > 0);
+			if(localFrame == NULL)
+			{
+				localFrame = loadFrame(context, frame);
+				mFrameCache.insert(logInd, localFrame);
+			}
+			lock.lock();
+
+			mInFlightBytes -= frameBytes;
+			if(generation == mBufferGeneration)
+			{
+				mReorderBuffer.insert(pair<int, BufferFrame>(seq, BufferFrame(max(frame.depthData.time, frame.colorData.time), localFrame)));
+				mBufferedBytes += frameBytes;
+
+				//Release every frame that is now in order
+				while(!mReorderBuffer.empty() && mReorderBuffer.begin()->first == mNextDeliverSeq)
+				{
+					mStreamBuffer.push(mReorderBuffer.begin()->second);
+					mReorderBuffer.erase(mReorderBuffer.begin());
+					mNextDeliverSeq++;
+				}
+			}
+			notifyPlayback();
+			return true;
+		}
+
 		void LogDevice::bufferFrames()
 		{
-			RGBDFramePtr localFrame = NULL;
-			mLogInd = 0;
+			LogDecodeContext context;
+			if(mLogFormat == LOG_FORMAT_CONTAINER)
+				context.reader.open(mContainerFile);
 
+			boost::unique_lock<boost::mutex> lock(mBufferGuard);
 			while(mColorStreaming || mDepthStreaming){
-				if(mStreamBuffer.size() < mBufferCapacity)
-				{
-					//More room in buffer to fill
-					//Check if stream has pending frames
-					if(mLogInd < mLogFrames.size())
-					{
+				if(!decodeNextFrame(context, lock))
+					mBufferCond.wait(lock);
+			}
 
-						//Buffer the frame
-						mBufferGuard.lock();
-						SyncFrameMetaData frame = mLogFrames[mLogInd];
+		}
 
-						localFrame = mFrameFactory.getRGBDFrame(mXRes, mYRes);
-						if(mColorStreaming && frame.colorData.id > 0)
-							loadColorFrame(mDirectory, frame.colorData, localFrame, frame.colorData.compressionMode);
-						if(mDepthStreaming && frame.depthData.id > 0)
-							loadDepthFrame(mDirectory, frame.depthData, localFrame, frame.depthData.compressionMode);
+		RGBDFramePtr LogDevice::popBufferedFrame()
+		{
+			BufferFrame bufFrame = mStreamBuffer.front();
+			mStreamBuffer.pop();
+			mBufferedBytes -= getFrameBytes();
+			mLastDispatchTimeUS = (bufFrame.time > mStartTime) ? bufFrame.time - mStartTime : 0;
+			notifyPlayback();
+			return bufFrame.frame;
+		}
 
-						mStreamBuffer.push(BufferFrame(max(frame.depthData.time, frame.colorData.time), localFrame));
-						localFrame = NULL;//Pass to buffer
-						mBufferGuard.unlock();
+		bool LogDevice::isPlaybackFinished()
+		{
+			return !mLoopStreams && mLogInd >= (int) mLogFrames.size() && mInFlightBytes == 0 && mReorderBuffer.empty() && mStreamBuffer.empty();
+		}
 
-						mLogInd++;
-					}
+		bool LogDevice::dispatchNextFrame(boost::unique_lock<boost::mutex>& lock, boost::chrono::steady_clock::time_point& due)
+		{
+			due = boost::chrono::steady_clock::time_point::max();
 
-					//Loop buffer if turned on 
-					if(mLoopStreams && mLogFrames.size() <= mLogInd) 
-					{
-						mLogInd = 0;
-					}
-				}
-				boost::this_thread::sleep_for(boost::chrono::milliseconds(10));//10ms resolution should be fine
+			//Check for next time frame. Pull mode consumers take frames themselves
+			if(mStreamBuffer.size() == 0 || mPlaybackMode == PLAYBACK_PULL)
+				return false;
+
+			//Group workers are shared with other devices and must not wait in post. The listener wakes the group when it has room
+			if(mDeviceGroup != NULL && !mNewRGBDFrameListeners.hasSpace(mListenerSpaceHandler))
+				return false;
+
+			if(mPlaybackMode == PLAYBACK_FREE_RUNNING)
+			{
+				if(mAcknowledgeWindow > 0 && mUnacknowledgedFrames >= mAcknowledgeWindow)
+					return false;
+
+				//Counted before delivery so a listener acknowledging inline can't run ahead of the count
+				RGBDFramePtr frame = popBufferedFrame();
+				mUnacknowledgedFrames++;
+
+				//Without a group, DISPATCH_ALL listeners block here when their queues are full, which paces the decode workers
+				lock.unlock();
+				onNewRGBDFrame(frame);
+				lock.lock();
+				return true;
+			}
 
+			BufferFrame bufFrame = mStreamBuffer.front();
+			timestamp nextTimeUS = (bufFrame.time > mStartTime) ? bufFrame.time - mStartTime : 0;
+			if(nextTimeUS < mLastDispatchTimeUS){
+				//Looped back to the start of the log. Restart the clock
+				mPlaybackStartTime = boost::chrono::steady_clock::now();
+				mLastDispatchTimeUS = 0;
 			}
 
-		}
+			//Seeks, speed changes and stopping notify the waiting thread and the due time is recomputed
+			boost::chrono::steady_clock::time_point frameDue = getDueTime(nextTimeUS);
+			boost::chrono::steady_clock::time_point now = boost::chrono::steady_clock::now();
+			if(now < frameDue)
+			{
+				due = frameDue;
+				return false;
+			}
 
+			//Reached time to dispatch frame
+			int64_t lateness = boost::chrono::duration_cast<boost::chrono::microseconds>(now - frameDue).count();
+			mTimingStats.frames++;
+			if(lateness > 1000)
+				mTimingStats.lateFrames++;
+			mTimingStats.maxLateness = max(mTimingStats.maxLateness, lateness);
+			mLatenessSum += (double) lateness;
+			mTimingStats.meanLateness = mLatenessSum/mTimingStats.frames;
+
+			popBufferedFrame();
+
+			//Listeners may take a while. Don't hold up the decode workers
+			lock.unlock();
+			onNewRGBDFrame(bufFrame.frame);
+			lock.lock();
+			return true;
+		}
 
 		void LogDevice::dispatchEvents()
 		{
-			timestamp lastTimeUS = 0;//Time of previous frame. If 
+			boost::unique_lock<boost::mutex> lock(mBufferGuard);
 			while(mColorStreaming || mDepthStreaming)
 			{
-				//Tick thread time
-				boost::posix_time::ptime now  = boost::posix_time::microsec_clock::local_time();
-				boost::posix_time::time_duration duration = (now - mPlaybackStartTime);
-				timestamp currentPlaybackTimeUS = (timestamp) (duration.total_microseconds()*mPlaybackSpeed);//Time in microseconds. Normalized to playback time
+				//Sleep until a frame is published or the head frame is due
+				boost::chrono::steady_clock::time_point due;
+				if(dispatchNextFrame(lock, due))
+					continue;
+
+				if(due == boost::chrono::steady_clock::time_point::max())
+					mBufferCond.wait(lock);
+				else
+					mBufferCond.wait_until(lock, due);
+			}
+		}
 
-				//Check for next time frame
+		GROUP_TASK LogDevice::runGroupTask(boost::chrono::steady_clock::time_point& nextWake)
+		{
+			boost::unique_lock<boost::mutex> lock(mBufferGuard);
+			if(!mColorStreaming && !mDepthStreaming)
+				return GROUP_TASK_NONE;
 
-				mBufferGuard.lock();
-				if(mStreamBuffer.size() > 0){
-					BufferFrame bufFrame = mStreamBuffer.front();
-					timestamp nextTimeUS = bufFrame.time - mStartTime;
+			//Only one worker delivers at a time so frames stay in order
+			if(!mGroupDispatching)
+			{
+				mGroupDispatching = true;
+				bool dispatched = dispatchNextFrame(lock, nextWake);
+				mGroupDispatching = false;
+				if(dispatched)
+					return GROUP_TASK_DISPATCH;
+			}
 
-					if(nextTimeUS > 0)
-					{
-						if(nextTimeUS < lastTimeUS){
-							//Reset playback timer
-							mPlaybackStartTime  = boost::posix_time::microsec_clock::local_time();
-						}
-
-						if(nextTimeUS <= currentPlaybackTimeUS)
-						{
-							//Reached time to dispatch frame
-							mStreamBuffer.pop();
-							lastTimeUS = nextTimeUS;
-							onNewRGBDFrame(bufFrame.frame);
-						}
-					}
+			//Decode state is per worker in the thread model. Here it is kept by the device and lent to whichever worker decodes
+			boost::shared_ptr<LogDecodeContext> context;
+			if(mIdleDecodeContexts.empty())
+			{
+				context.reset(new LogDecodeContext());
+				if(mLogFormat == LOG_FORMAT_CONTAINER)
+					context->reader.open(mContainerFile);
+			}else{
+				context = mIdleDecodeContexts.back();
+				mIdleDecodeContexts.pop_back();
+			}
 
-				}
-				
+			bool decoded = decodeNextFrame(*context, lock);
+			mIdleDecodeContexts.push_back(context);
+			return decoded ? GROUP_TASK_DECODE : GROUP_TASK_NONE;
+		}
+
+		void LogDevice::notifyPlayback()
+		{
+			mBufferCond.notify_all();
+			if(mDeviceGroup != NULL)
+				mDeviceGroup->wake();
+		}
+
+		bool LogDevice::setDeviceGroup(DeviceGroup* group)
+		{
+			if(mColorStreaming || mDepthStreaming)
+				return false;
+
+			//Threads from the previous session see both streams stopped and exit
+			joinPlaybackThreads();
+			if(mDeviceGroup != NULL)
+				mDeviceGroup->removeSource(this);
+			mDeviceGroup = group;
+			if(mDeviceGroup != NULL)
+				mDeviceGroup->addSource(this);
+			return true;
+		}
+
+		boost::chrono::steady_clock::time_point LogDevice::getDueTime(timestamp playbackTimeUS)
+		{
+			return mPlaybackStartTime + boost::chrono::microseconds((int64_t) (playbackTimeUS/mPlaybackSpeed));
+		}
+
+		void LogDevice::alignPlaybackClock(timestamp playbackTimeUS)
+		{
+			mPlaybackStartTime = boost::chrono::steady_clock::now() - boost::chrono::microseconds((int64_t) (playbackTimeUS/mPlaybackSpeed));
+		}
+
+		PlaybackTimingStats LogDevice::getPlaybackTimingStats()
+		{
+			boost::mutex::scoped_lock lock(mBufferGuard);
+			return mTimingStats;
+		}
+
+		void LogDevice::resetPlaybackTimingStats()
+		{
+			boost::mutex::scoped_lock lock(mBufferGuard);
+			mTimingStats.frames = 0;
+			mTimingStats.lateFrames = 0;
+			mTimingStats.meanLateness = 0.0;
+			mTimingStats.maxLateness = 0;
+			mLatenessSum = 0.0;
+		}
+
+		RGBDFramePtr LogDevice::getNextFrame(int timeoutMs)
+		{
+			boost::chrono::steady_clock::time_point deadline = boost::chrono::steady_clock::now() + boost::chrono::milliseconds(max(timeoutMs, 0));
+
+			boost::unique_lock<boost::mutex> lock(mBufferGuard);
+			while((mColorStreaming || mDepthStreaming) && mPlaybackMode == PLAYBACK_PULL)
+			{
+				if(mStreamBuffer.size() > 0)
+					return popBufferedFrame();
+
+				if(isPlaybackFinished())
+					break;
+
+				if(timeoutMs < 0)
+					mBufferCond.wait(lock);
+				else if(mBufferCond.wait_until(lock, deadline) == boost::cv_status::timeout)
+					break;
+			}
+			return RGBDFramePtr();
+		}
+
+		void LogDevice::setPlaybackMode(PLAYBACK_MODE mode)
+		{
+			mBufferGuard.lock();
+			if(mode == PLAYBACK_REAL_TIME && mPlaybackMode != PLAYBACK_REAL_TIME)
+			{
+				//Pick up the clock from the last frame delivered
+				alignPlaybackClock(mLastDispatchTimeUS);
+			}
+			mPlaybackMode = mode;
+			mUnacknowledgedFrames = 0;
+			notifyPlayback();
+			mBufferGuard.unlock();
+		}
+
+		PLAYBACK_MODE LogDevice::getPlaybackMode()
+		{
+			boost::mutex::scoped_lock lock(mBufferGuard);
+			return mPlaybackMode;
+		}
+
+		void LogDevice::setAcknowledgeWindow(int frames)
+		{
+			mBufferGuard.lock();
+			mAcknowledgeWindow = max(frames, 0);
+			notifyPlayback();
+			mBufferGuard.unlock();
+		}
+
+		int LogDevice::getAcknowledgeWindow()
+		{
+			boost::mutex::scoped_lock lock(mBufferGuard);
+			return mAcknowledgeWindow;
+		}
+
+		void LogDevice::acknowledgeFrame()
+		{
+			mBufferGuard.lock();
+			if(mUnacknowledgedFrames > 0)
+				mUnacknowledgedFrames--;
+			notifyPlayback();
+			mBufferGuard.unlock();
+		}
+
+		void LogDevice::startPlaybackThreads()
+		{
+			resetPlaybackTimingStats();
+			if(mDeviceGroup != NULL)
+			{
+				//Group workers do the decoding and dispatching. Contexts from an earlier session may belong to another log
+				mBufferGuard.lock();
+				mIdleDecodeContexts.clear();
+				notifyPlayback();
 				mBufferGuard.unlock();
-				
-				boost::this_thread::sleep_for(boost::chrono::milliseconds(1));
+				return;
 			}
+
+			for(int i = 0; i < mDecodeThreadCount; i++)
+				mDecodeThreads.push_back(boost::shared_ptr<boost::thread>(new boost::thread(&LogDevice::bufferFrames, this)));
+			mEventThread = boost::thread(&LogDevice::dispatchEvents, this);
+		}
+
+		void LogDevice::joinPlaybackThreads()
+		{
+			//Threads exit once both streams are stopped
+			mBufferGuard.lock();
+			notifyPlayback();
+			mBufferGuard.unlock();
+
+			for(vector<boost::shared_ptr<boost::thread> >::iterator it = mDecodeThreads.begin(); it != mDecodeThreads.end(); ++it)
+				(*it)->join();
+			mDecodeThreads.clear();
+			if(mEventThread.joinable())
+				mEventThread.join();
+
+			if(mDeviceGroup != NULL)
+				mDeviceGroup->waitForIdle(this);
 		}
 
 		bool LogDevice::createColorStream() 
 		{
 			if(mLogFrames.size() > 0){
 
-				mColorStreaming = true;
-				if(!mDepthStreaming)
+				if(!mDepthStreaming && !mColorStreaming)
 				{
-					//Start threads
-					mBufferThread = boost::thread(&LogDevice::bufferFrames, this);
-					mEventThread = boost::thread(&LogDevice::dispatchEvents, this);
+					//Start threads. Threads from the previous session see both streams stopped and exit
+					joinPlaybackThreads();
+					mColorStreaming = true;
+					startPlaybackThreads();
 				}
+				mColorStreaming = true;
 
 				restartPlayback();
 			}
@@ -317,13 +853,14 @@ namespace rgbd
 
 			if(mLogFrames.size() > 0){
 
-				mDepthStreaming = true;
-				if(!mColorStreaming)
+				if(!mColorStreaming && !mDepthStreaming)
 				{
-					//Start threads
-					mBufferThread = boost::thread(&LogDevice::bufferFrames, this);
-					mEventThread = boost::thread(&LogDevice::dispatchEvents, this);
+					//Start threads. Threads from the previous session see both streams stopped and exit
+					joinPlaybackThreads();
+					mDepthStreaming = true;
+					startPlaybackThreads();
 				}
+				mDepthStreaming = true;
 
 				restartPlayback();
 			}
@@ -333,24 +870,164 @@ namespace rgbd
 		bool LogDevice::destroyColorStream()  
 		{
 			mColorStreaming = false;
+			//Wake up waiting threads so they can exit
+			mBufferGuard.lock();
+			notifyPlayback();
+			mBufferGuard.unlock();
 			return true;
 		}
 
 		bool LogDevice::destroyDepthStream()
 		{
 			mDepthStreaming = false;
+			//Wake up waiting threads so they can exit
+			mBufferGuard.lock();
+			notifyPlayback();
+			mBufferGuard.unlock();
 			return true;
 		}
 
+		void LogDevice::resetBuffer(int logInd)
+		{
+			mLogInd = logInd;
+			mLastDispatchTimeUS = 0;
+			mUnacknowledgedFrames = 0;
+			mStreamBuffer = queue<BufferFrame>();
+			mReorderBuffer.clear();
+			mBufferedBytes = 0;
+			mNextDecodeSeq = 0;
+			mNextDeliverSeq = 0;
+			//Frames still being decoded belong to the old position
+			mBufferGeneration++;
+			notifyPlayback();
+		}
 
 		void LogDevice::restartPlayback()
 		{
-			//Do not lock, will deadlock threads
 			mBufferGuard.lock();
-			mLogInd = 0;
-			mStreamBuffer = queue<BufferFrame>();
+			resetBuffer(0);
+			mPlaybackStartTime = boost::chrono::steady_clock::now();
 			mBufferGuard.unlock();//ALWAYS UNLOCK YOUR GORRAM MUTEX!
-			mPlaybackStartTime  = boost::posix_time::microsec_clock::local_time();
+		}
+
+		void LogDevice::setDecodeThreadCount(int threads)
+		{
+			mDecodeThreadCount = max(threads, 1);
+		}
+
+		void LogDevice::setBufferMemoryBudget(size_t bytes)
+		{
+			mBufferGuard.lock();
+			mBufferMemoryBudget = bytes;
+			notifyPlayback();
+			mBufferGuard.unlock();
+		}
+
+		int LogDevice::findTimestampIndex(timestamp time)
+		{
+			//Frames are stored in depth timestamp order
+			int low = 0;
+			int high = (int) mLogFrames.size();
+			while(low < high)
+			{
+				int mid = low + (high - low)/2;
+				if(mLogFrames[mid].depthData.time < time)
+					low = mid + 1;
+				else
+					high = mid;
+			}
+			return low;
+		}
+
+		int LogDevice::findFrameIndex(int frameId)
+		{
+			//Frame ids increase with depth timestamp
+			int low = 0;
+			int high = (int) mLogFrames.size();
+			while(low < high)
+			{
+				int mid = low + (high - low)/2;
+				if(mLogFrames[mid].depthData.id < frameId)
+					low = mid + 1;
+				else
+					high = mid;
+			}
+			return low;
+		}
+
+		bool LogDevice::seekToTimestamp(timestamp time)
+		{
+			mLogGuard.lock();
+			int logInd = findTimestampIndex(time);
+			if(logInd >= (int) mLogFrames.size())
+				logInd = -1;
+			mLogGuard.unlock();
+
+			if(logInd < 0)
+				return false;
+
+			seekToIndex(logInd);
+			return true;
+		}
+
+		bool LogDevice::seekToFrame(int frameId)
+		{
+			mLogGuard.lock();
+			int logInd = findFrameIndex(frameId);
+			if(logInd >= (int) mLogFrames.size())
+				logInd = -1;
+			mLogGuard.unlock();
+
+			if(logInd < 0)
+				return false;
+
+			seekToIndex(logInd);
+			return true;
+		}
+
+		bool LogDevice::seekToKeyframe(timestamp time)
+		{
+			mLogGuard.lock();
+			int logInd = findTimestampIndex(time);
+			if(logInd >= (int) mLogFrames.size())
+			{
+				logInd = -1;
+			}else if(mLogFrames[logInd].depthData.keyframeId > 0){
+				//Back up to the start of the group
+				int keyInd = findFrameIndex(mLogFrames[logInd].depthData.keyframeId);
+				if(keyInd < (int) mLogFrames.size() && mLogFrames[keyInd].depthData.id == mLogFrames[logInd].depthData.keyframeId)
+					logInd = keyInd;
+			}
+			mLogGuard.unlock();
+
+			if(logInd < 0)
+				return false;
+
+			seekToIndex(logInd);
+			return true;
+		}
+
+		void LogDevice::seekToIndex(int logInd)
+		{
+			mLogGuard.lock();
+			timestamp frameTime = mLogFrames[logInd].depthData.time;
+			mLogGuard.unlock();
+
+			timestamp playbackTimeUS = (frameTime > mStartTime) ? frameTime - mStartTime : 0;
+
+			mBufferGuard.lock();
+			resetBuffer(logInd);
+			//Start the playback clock as if we had been playing up to this frame
+			alignPlaybackClock(playbackTimeUS);
+			mBufferGuard.unlock();
+		}
+
+		int LogDevice::getNumFrames()
+		{
+			mLogGuard.lock();
+			int numFrames = mLogFrames.size();
+			mLogGuard.unlock();
+			return numFrames;
 		}
 
 		int LogDevice::getDepthResolutionX()
@@ -382,29 +1059,170 @@ namespace rgbd
 			return mColorStreaming;
 		}
 
-		void LogDevice::loadColorFrame(string sourceDir, FrameMetaData data, RGBDFramePtr frameOut, COMPRESSION_METHOD colorCompressMode)
+		void LogDevice::loadPayload(LogDecodeContext& context, FrameMetaData data, char* outputArray, int memSize)
+		{
+			if(data.compressionMode == NO_COMPRESSION)
+			{
+				//Read straight into the frame
+				context.reader.readPayload(data.offset, min(data.size, (uint32_t) memSize), outputArray);
+			}else if(context.reader.readPayload(data.offset, data.size, context.payloadBuffer) && data.size > 0){
+				decompressBuffer(&context.payloadBuffer[0], data.size, outputArray, memSize, data.compressionMode);
+			}
+		}
+
+		char* LogDevice::getMappedPayload(FrameMetaData data, int memSize)
+		{
+			if(!mMemoryMappedPlayback || mLogFormat != LOG_FORMAT_CONTAINER)
+				return NULL;
+			if(data.compressionMode != NO_COMPRESSION || data.size != (uint32_t) memSize || data.keyframeId > 0)
+				return NULL;
+
+			//Workers share one mapping. Map it the first time any of them needs it
+			boost::lock_guard<boost::mutex> lock(mMappingGuard);
+			if(mMappingFailed)
+				return NULL;
+			if(!mContainerReader.isMapped() && !mContainerReader.mapFile())
+			{
+				//Only this log falls back. The user's setting applies again to the next one
+				onMessage("Could not memory map log. Falling back to buffered reads\n");
+				mMappingFailed = true;
+				return NULL;
+			}
+			return mContainerReader.getMappedPayload(data.offset, data.size);
+		}
+
+		RGBDFramePtr LogDevice::loadFrame(LogDecodeContext& context, SyncFrameMetaData frame)
+		{
+			bool loadColor = mColorStreaming && frame.colorData.id > 0;
+			bool loadDepth = mDepthStreaming && frame.depthData.id > 0;
+
+			char* colorView = loadColor ? getMappedPayload(frame.colorData, mXRes*mYRes*sizeof(ColorPixel)) : NULL;
+			char* depthView = loadDepth ? getMappedPayload(frame.depthData, mXRes*mYRes*sizeof(DPixel)) : NULL;
+
+			if(colorView == NULL && depthView == NULL)
+			{
+				//Nothing to map, decode into a new frame
+				RGBDFramePtr localFrame = mFrameFactory.getRGBDFrame(mXRes, mYRes);
+				if(loadColor)
+					loadColorFrame(context, mDirectory, frame.colorData, localFrame, frame.colorData.compressionMode);
+				if(loadDepth)
+					loadDepthFrame(context, mDirectory, frame.depthData, localFrame, frame.depthData.compressionMode);
+				return localFrame;
+			}
+
+			//Point mapped streams at the log. Any stream that could not be mapped gets its own memory.
+			SharedOwnerDeleter deleter(mContainerReader.getMappingOwner());
+			ColorPixelArray colorArray = (colorView != NULL) ? ColorPixelArray((ColorPixel*) colorView, deleter) : mFrameFactory.getColorArray(mXRes*mYRes);
+			DPixelArray depthArray = (depthView != NULL) ? DPixelArray((DPixel*) depthView, deleter) : mFrameFactory.getDepthArray(mXRes*mYRes);
+
+			RGBDFramePtr localFrame = mFrameFactory.getRGBDFrame();
+			localFrame->setResolutionAndArrays(mXRes, mYRes, colorArray, depthArray);
+
+			if(colorView != NULL)
+			{
+				localFrame->setColorTimestamp(frame.colorData.time);
+				localFrame->setHasColor(true);
+			}else if(loadColor){
+				loadColorFrame(context, mDirectory, frame.colorData, localFrame, frame.colorData.compressionMode);
+			}
+
+			if(depthView != NULL)
+			{
+				localFrame->setDepthTimestamp(frame.depthData.time);
+				localFrame->setHasDepth(true);
+			}else if(loadDepth){
+				loadDepthFrame(context, mDirectory, frame.depthData, localFrame, frame.depthData.compressionMode);
+			}
+
+			return localFrame;
+		}
+
+		void LogDevice::loadColorFrame(LogDecodeContext& context, string sourceDir, FrameMetaData data, RGBDFramePtr frameOut, COMPRESSION_METHOD colorCompressMode)
 		{
-			std::ostringstream out; 
-			out << sourceDir << "\\" << data.id;
 			frameOut->setColorTimestamp(data.time);
-			loadColorImageFromFile(out.str(), frameOut, colorCompressMode);
+			if(mLogFormat == LOG_FORMAT_CONTAINER)
+			{
+				loadPayload(context, data, (char*) frameOut->getColorArray().get(), frameOut->getXRes()*frameOut->getYRes()*sizeof(ColorPixel));
+				frameOut->setHasColor(true);
+			}else{
+				std::ostringstream out; 
+				out << sourceDir << "\\" << data.id;
+				loadColorImageFromFile(out.str(), frameOut, colorCompressMode);
+			}
 		}
 
-		void LogDevice::loadDepthFrame(string sourceDir, FrameMetaData data, RGBDFramePtr frameOut, COMPRESSION_METHOD depthCompressMode)
+		void LogDevice::loadDepthFrame(LogDecodeContext& context, string sourceDir, FrameMetaData data, RGBDFramePtr frameOut, COMPRESSION_METHOD depthCompressMode)
 		{
-			std::ostringstream out; 
-			out << sourceDir << "\\" << data.id;
 			frameOut->setDepthTimestamp(data.time);
-			loadDepthImageFromFile(out.str(), frameOut, depthCompressMode);
+			if(data.keyframeId == 0)
+			{
+				if(mLogFormat == LOG_FORMAT_CONTAINER)
+				{
+					loadPayload(context, data, (char*) frameOut->getDepthArray().get(), frameOut->getXRes()*frameOut->getYRes()*sizeof(DPixel));
+					frameOut->setHasDepth(true);
+				}else{
+					std::ostringstream out; 
+					out << sourceDir << "\\" << data.id;
+					loadDepthImageFromFile(out.str(), frameOut, depthCompressMode);
+				}
+				return;
+			}
+
+			//Delta frame
+			DPixel* depth = frameOut->getDepthArray().get();
+			if(loadKeyframe(context, sourceDir, data.keyframeId))
+			{
+				loadDepthPayload(context, sourceDir, data, depth);
+				applyDepthDelta(depth, &context.keyframeDepth[0], mXRes*mYRes);
+			}else{
+				onMessage("Missing depth keyframe\n");
+				memset(depth, 0, mXRes*mYRes*sizeof(DPixel));
+			}
+			frameOut->setHasDepth(true);
+		}
+
+		void LogDevice::loadDepthPayload(LogDecodeContext& context, string sourceDir, FrameMetaData data, DPixel* dest)
+		{
+			int memSize = mXRes*mYRes*sizeof(DPixel);
+			if(mLogFormat == LOG_FORMAT_CONTAINER)
+			{
+				loadPayload(context, data, (char*) dest, memSize);
+			}else{
+				std::ostringstream out; 
+				out << sourceDir << "\\" << data.id << ".depth";
+				loadCompressedBinaryFile(out.str(), (char*) dest, memSize, data.compressionMode);
+			}
+		}
+
+		bool LogDevice::loadKeyframe(LogDecodeContext& context, string sourceDir, int keyframeId)
+		{
+			if(context.keyframeId == keyframeId)
+				return true;
+
+			mLogGuard.lock();
+			int keyInd = findFrameIndex(keyframeId);
+			bool found = keyInd < (int) mLogFrames.size() && mLogFrames[keyInd].depthData.id == keyframeId;
+			FrameMetaData keyframe = found ? mLogFrames[keyInd].depthData : FrameMetaData();
+			mLogGuard.unlock();
+
+			//Keyframes never depend on other frames
+			if(!found || keyframe.keyframeId != 0)
+				return false;
+
+			context.keyframeDepth.resize(mXRes*mYRes);
+			loadDepthPayload(context, sourceDir, keyframe, &context.keyframeDepth[0]);
+			context.keyframeId = keyframeId;
+			return true;
 		}
 
 		void LogDevice::setPlaybackSpeed(double speed) 
 		{
 			if(speed>0.0) {
+				boost::mutex::scoped_lock lock(mBufferGuard);
+
 				//Grab current time scaled by old playback
-				boost::posix_time::ptime now  = boost::posix_time::microsec_clock::local_time();
-				boost::posix_time::time_duration duration = (now - mPlaybackStartTime);
-				timestamp durationUS = (timestamp) (duration.total_microseconds()*mPlaybackSpeed);
+				boost::chrono::steady_clock::time_point now = boost::chrono::steady_clock::now();
+				double playbackTimeUS = boost::chrono::duration_cast<boost::chrono::microseconds>(now - mPlaybackStartTime).count()*mPlaybackSpeed;
 
 				//Change speed
 				mPlaybackSpeed = speed;
@@ -412,9 +1230,9 @@ namespace rgbd
 				if(mColorStreaming || mDepthStreaming)
 				{
 					//If playback ongoing, reset start time to simulate seamless speed change
-					double usOffset = (double) durationUS;
-					usOffset /= mPlaybackSpeed;
-					mPlaybackStartTime = now - boost::posix_time::microseconds((int64_t) usOffset);//Move playback to scaled time
+					mPlaybackStartTime = now - boost::chrono::microseconds((int64_t) (playbackTimeUS/mPlaybackSpeed));
+					//The frame being waited on is due at a different time now
+					notifyPlayback();
 				}
 			}
 		}
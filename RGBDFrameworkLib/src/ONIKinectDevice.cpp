@@ -1,4 +1,5 @@
 #include "ONIKinectDevice.h"
+#include <boost/bind.hpp>
 
 
 
@@ -7,6 +8,7 @@ namespace rgbd
 	namespace framework
 	{
 		ONIKinectDevice::ONIKinectDevice(void)
+			: mFrameSynchronizer(boost::bind(&RGBDDevice::onNewRGBDFrame, this, _1))
 		{
 		}
 
@@ -144,6 +146,8 @@ namespace rgbd
 		{
 			mColorStream.stop();
 			mColorStream.destroy();
+			//Send frames still waiting for the other stream
+			mFrameSynchronizer.flush();
 			return true;
 		}
 
@@ -151,6 +155,8 @@ namespace rgbd
 		{
 			mDepthStream.stop();
 			mDepthStream.destroy();
+			//Send frames still waiting for the other stream
+			mFrameSynchronizer.flush();
 			return true;
 		}
 
@@ -224,31 +230,16 @@ namespace rgbd
 					rgbdFrame->setDepthTimestamp(frame.getTimestamp());
 					rgbdFrame->setHasDepth(true);
 
-					//Check if send
-					if(!mSyncDepthAndColor)
+					//Check if send. Without a color stream there is nothing to pair with
+					if(!mSyncDepthAndColor || !mColorStream.isValid())
 					{
 						//Send it
 						onNewRGBDFrame(rgbdFrame);
-						rgbdFrame = NULL;
 					}else{
 						//Sync it
-						frameGuard.lock();
-						if(mRGBDFrameSynced == NULL)
-						{
-							//FIRST POST!!!
-							mRGBDFrameSynced = rgbdFrame;
-						}else{
-							//SECOND!!
-							//Send it
-							mRGBDFrameSynced->setDepthArray(rgbdFrame->getDepthArray());
-							mRGBDFrameSynced->setHasDepth(true);
-							mRGBDFrameSynced->setDepthTimestamp(frame.getTimestamp());
-							onNewRGBDFrame(mRGBDFrameSynced);
-							mRGBDFrameSynced = NULL;
-						}
-						//Unlock scoped
-						frameGuard.unlock();
+						mFrameSynchronizer.addDepthFrame(rgbdFrame);
 					}
+					rgbdFrame = NULL;
 
 				}else{
 					//Size error
@@ -297,31 +288,16 @@ namespace rgbd
 					}*/
 					rgbdFrame->setColorTimestamp(frame.getTimestamp());
 					rgbdFrame->setHasColor(true);
-					//Check if send
-					if(!mSyncDepthAndColor)
+					//Check if send. Without a depth stream there is nothing to pair with
+					if(!mSyncDepthAndColor || !mDepthStream.isValid())
 					{
 						//Send it
 						onNewRGBDFrame(rgbdFrame);
-						rgbdFrame = NULL;
 					}else{
 						//Sync it
-						frameGuard.lock();
-						if(mRGBDFrameSynced == NULL)
-						{
-							//FIRST POST!!!
-							mRGBDFrameSynced = rgbdFrame;
-						}else{
-							//SECOND!!
-							//Send it
-							mRGBDFrameSynced->setColorArray(rgbdFrame->getColorArray());
-							mRGBDFrameSynced->setHasColor(true);
-							mRGBDFrameSynced->setColorTimestamp(frame.getTimestamp());
-							onNewRGBDFrame(mRGBDFrameSynced);
-							mRGBDFrameSynced = NULL;
-						}
-						//Unlock scoped
-						frameGuard.unlock();
+						mFrameSynchronizer.addColorFrame(rgbdFrame);
 					}
+					rgbdFrame = NULL;
 
 				}else{
 					//Size error
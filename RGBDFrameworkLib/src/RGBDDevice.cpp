@@ -1,4 +1,5 @@
 #include "RGBDDevice.h"
+#include <boost/bind.hpp>
 
 
 namespace rgbd
@@ -6,96 +7,69 @@ namespace rgbd
 	namespace framework
 	{
 
-		void RGBDDevice::addNewRGBDFrameListener(NewRGBDFrameListener* listener)
+		void RGBDDevice::addNewRGBDFrameListener(NewRGBDFrameListener* listener, DISPATCH_POLICY policy, int queueSize)
 		{
-			mNewRGBDFrameListeners.push_back(listener);
+			mNewRGBDFrameListeners.add(listener, boost::bind(&NewRGBDFrameListener::onNewRGBDFrame, listener, _1), policy, queueSize);
 		}
 
-		void RGBDDevice::addDeviceConnectedListener(DeviceConnectedListener* listener)
+		void RGBDDevice::addDeviceConnectedListener(DeviceConnectedListener* listener, DISPATCH_POLICY policy, int queueSize)
 		{
-			mDeviceConnectedListeners.push_back(listener);
+			mDeviceConnectedListeners.add(listener, boost::bind(&DeviceConnectedListener::onDeviceConnected, listener), policy, queueSize);
 		}
 
-		void RGBDDevice::addDeviceDisconnectedListener(DeviceDisconnectedListener* listener)
+		void RGBDDevice::addDeviceDisconnectedListener(DeviceDisconnectedListener* listener, DISPATCH_POLICY policy, int queueSize)
 		{
-			mDeviceDisconnectedListeners.push_back(listener);
+			mDeviceDisconnectedListeners.add(listener, boost::bind(&DeviceDisconnectedListener::onDeviceDisconnected, listener), policy, queueSize);
 		}
 
-		void RGBDDevice::addDeviceMessageListener(DeviceMessageListener* listener)
+		void RGBDDevice::addDeviceMessageListener(DeviceMessageListener* listener, DISPATCH_POLICY policy, int queueSize)
 		{
-			mDeviceMessageListeners.push_back(listener);
+			mDeviceMessageListeners.add(listener, boost::bind(&DeviceMessageListener::onMessage, listener, _1), policy, queueSize);
 		}
 
-		void RGBDDevice::removeNewRGBDFrameListener(NewRGBDFrameListener* listener)
+		void RGBDDevice::removeNewRGBDFrameListener(NewRGBDFrameListener* listener, bool drainQueued)
 		{
-			std::vector<NewRGBDFrameListener*>::iterator position = std::find(mNewRGBDFrameListeners.begin(), mNewRGBDFrameListeners.end(), listener);
-
-			if (position != mNewRGBDFrameListeners.end()) // == vector.end() means the element was not found
-				mNewRGBDFrameListeners.erase(position);
-
+			mNewRGBDFrameListeners.remove(listener, drainQueued);
 		}
 
 		void RGBDDevice::removeDeviceConnectedListener(DeviceConnectedListener* listener)
 		{
-			std::vector<DeviceConnectedListener*>::iterator position = std::find(mDeviceConnectedListeners.begin(), mDeviceConnectedListeners.end(), listener);
-
-			if (position != mDeviceConnectedListeners.end()) // == vector.end() means the element was not found
-				mDeviceConnectedListeners.erase(position);
-
+			mDeviceConnectedListeners.remove(listener);
 		}
 
 		void RGBDDevice::removeDeviceDisconnectedListener(DeviceDisconnectedListener* listener)
 		{
-			std::vector<DeviceDisconnectedListener*>::iterator position = std::find(mDeviceDisconnectedListeners.begin(), mDeviceDisconnectedListeners.end(), listener);
-
-			if (position != mDeviceDisconnectedListeners.end()) // == vector.end() means the element was not found
-				mDeviceDisconnectedListeners.erase(position);
-
+			mDeviceDisconnectedListeners.remove(listener);
 		}
 
 		void RGBDDevice::removeDeviceMessageListener(DeviceMessageListener* listener)
 		{
-			std::vector<DeviceMessageListener*>::iterator position = std::find(mDeviceMessageListeners.begin(), mDeviceMessageListeners.end(), listener);
-
-			if (position != mDeviceMessageListeners.end()) // == vector.end() means the element was not found
-				mDeviceMessageListeners.erase(position);
+			mDeviceMessageListeners.remove(listener);
+		}
 
+		bool RGBDDevice::getNewRGBDFrameListenerStats(NewRGBDFrameListener* listener, DispatchStats& stats)
+		{
+			return mNewRGBDFrameListeners.getStats(listener, stats);
 		}
 
 		void RGBDDevice::onNewRGBDFrame(RGBDFramePtr frame)
 		{
-			for(std::vector<NewRGBDFrameListener*>::iterator it = mNewRGBDFrameListeners.begin(); it != mNewRGBDFrameListeners.end(); ++it) {
-				boost::thread eventDispatch = boost::thread(&NewRGBDFrameListener::onNewRGBDFrame, (*it), frame);
-				eventDispatch.detach();
-				//(*it)->onNewRGBDFrame(frame);
-			}
+			mNewRGBDFrameListeners.post(frame);
 		}
 
 		void RGBDDevice::onConnect()
 		{
-			for(std::vector<DeviceConnectedListener*>::iterator it = mDeviceConnectedListeners.begin(); it != mDeviceConnectedListeners.end(); ++it) {
-				boost::thread eventDispatch = boost::thread(&DeviceConnectedListener::onDeviceConnected, (*it));
-				eventDispatch.detach();
-				//(*it)->onDeviceConnected();
-			}
+			mDeviceConnectedListeners.post(0);
 		}
 
 		void RGBDDevice::onDisconnect()
 		{
-			for(std::vector<DeviceDisconnectedListener*>::iterator it = mDeviceDisconnectedListeners.begin(); it != mDeviceDisconnectedListeners.end(); ++it) {
-				boost::thread eventDispatch = boost::thread(&DeviceDisconnectedListener::onDeviceDisconnected, (*it));
-				eventDispatch.detach();
-				//(*it)->onDeviceDisconnected();
-			}
+			mDeviceDisconnectedListeners.post(0);
 		}
 
 		void RGBDDevice::onMessage(std::string msg)
 		{
-			for(std::vector<DeviceMessageListener*>::iterator it = mDeviceMessageListeners.begin(); it != mDeviceMessageListeners.end(); ++it) {
-				boost::thread eventDispatch = boost::thread(&DeviceMessageListener::onMessage, (*it), msg);
-				eventDispatch.detach();
-				//(*it)->onMessage(msg);
-			}
+			mDeviceMessageListeners.post(msg);
 		}
 
 	}
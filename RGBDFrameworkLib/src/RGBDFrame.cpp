@@ -1,11 +1,41 @@
 #include "RGBDFrame.h"
+#include <stdlib.h>
 
+#ifdef _WIN32
+#include <malloc.h>
+#endif
 
 
 namespace rgbd
 {
 	namespace framework
 	{
+		void* alignedAlloc(size_t bytes)
+		{
+#ifdef _WIN32
+			return _aligned_malloc(bytes, RGBD_FRAME_ALIGNMENT);
+#else
+			void* data = NULL;
+			if(posix_memalign(&data, RGBD_FRAME_ALIGNMENT, bytes) != 0)
+				return NULL;
+			return data;
+#endif
+		}
+
+		void alignedFree(void* data)
+		{
+#ifdef _WIN32
+			_aligned_free(data);
+#else
+			free(data);
+#endif
+		}
+
+		static inline size_t alignUp(size_t value, size_t alignment)
+		{
+			return (value + alignment - 1)/alignment*alignment;
+		}
+
 		RGBDFrame::RGBDFrame(void)
 		{
 			init();
@@ -30,6 +60,7 @@ namespace rgbd
 		{
 			mXRes = 0;
 			mYRes = 0;
+			mPitch = 0;
 			//NULL Pointers
 			mDepthData = DPixelArray();
 			mColorData = ColorPixelArray();
@@ -53,18 +84,21 @@ namespace rgbd
 		//forceAlloc is default false.
 		void RGBDFrame::setResolution(int width, int height, bool forceAlloc /*=false*/)
 		{
-			if(width != mXRes || height != mYRes || forceAlloc)
+			if(width != mXRes || height != mYRes || mPitch != width || forceAlloc)
 			{
+				mSlab.reset();
 				if(width > 0 && height > 0){
 					//Resolution changed, reallocate
 					mXRes = width;
 					mYRes = height;
+					mPitch = width;
 					mDepthData = DPixelArray(new DPixel[width*height]);
 					mColorData = ColorPixelArray(new ColorPixel[width*height]);
 				}else{
 					//width and height invalid. Clear
 					mXRes = 0;
 					mYRes = 0;
+					mPitch = 0;
 					//Null pointers
 					mDepthData = DPixelArray();
 					mColorData = ColorPixelArray();
@@ -72,6 +106,57 @@ namespace rgbd
 			}
 		}
 
+		void RGBDFrame::setResolutionAndArrays(int width, int height, ColorPixelArray colorData, DPixelArray depthData)
+		{
+			mXRes = width;
+			mYRes = height;
+			mPitch = width;
+			mSlab.reset();
+			mColorData = colorData;
+			mDepthData = depthData;
+		}
+
+		int RGBDFrame::getSlabPitch(int width, bool padRows)
+		{
+			//A multiple of the alignment in pixels keeps rows of both 2 and 3 byte pixels aligned
+			return padRows ? (int) alignUp(width, RGBD_FRAME_ALIGNMENT) : width;
+		}
+
+		size_t RGBDFrame::getSlabColorOffset(int height, int pitch)
+		{
+			return alignUp(pitch*height*sizeof(DPixel), RGBD_FRAME_ALIGNMENT);
+		}
+
+		size_t RGBDFrame::getSlabSize(int height, int pitch)
+		{
+			return alignUp(getSlabColorOffset(height, pitch) + pitch*height*sizeof(ColorPixel), RGBD_FRAME_ALIGNMENT);
+		}
+
+		void RGBDFrame::allocateSlab(int width, int height, bool padRows /*=false*/)
+		{
+			if(width <= 0 || height <= 0)
+			{
+				setResolution(0, 0);
+				return;
+			}
+
+			int pitch = getSlabPitch(width, padRows);
+			FrameSlab slab((uint8_t*) alignedAlloc(getSlabSize(height, pitch)), AlignedFreeDeleter());
+			setResolutionAndSlab(width, height, pitch, slab);
+		}
+
+		void RGBDFrame::setResolutionAndSlab(int width, int height, int pitch, FrameSlab slab)
+		{
+			//Arrays alias the slab and keep it alive, so they stay valid if handed to other frames
+			SharedOwnerDeleter deleter(slab);
+			mXRes = width;
+			mYRes = height;
+			mPitch = pitch;
+			mSlab = slab;
+			mDepthData = DPixelArray((DPixel*) slab.get(), deleter);
+			mColorData = ColorPixelArray((ColorPixel*) (slab.get() + getSlabColorOffset(height, pitch)), deleter);
+		}
+
 		void RGBDFrame::clearDepthImage(void)
 		{
 			DPixel clear = {0};
@@ -7,13 +7,178 @@ namespace rgbd
 	namespace framework
 	{
 
+		FramePool::FramePool(void)
+		{
+			mMaxIdle = FRAME_POOL_DEFAULT_MAX_IDLE;
+			mIsClosed = false;
+			mStats.hits = 0;
+			mStats.misses = 0;
+			mStats.outstandingFrames = 0;
+			mStats.outstandingArrays = 0;
+			mStats.idleArrays = 0;
+		}
+
+		FramePool::~FramePool(void)
+		{
+			close();
+		}
+
+		template<typename T>
+		T* FramePool::takeArray(map<int, vector<T*> >& idle, int pixelCount)
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			mStats.outstandingArrays++;
+			typename map<int, vector<T*> >::iterator list = idle.find(pixelCount);
+			if(list != idle.end() && !list->second.empty())
+			{
+				T* data = list->second.back();
+				list->second.pop_back();
+				mStats.idleArrays--;
+				mStats.hits++;
+				return data;
+			}
+
+			mStats.misses++;
+			lock.unlock();
+			//Pixels are plain data, raw aligned memory is enough
+			return (T*) alignedAlloc(pixelCount*sizeof(T));
+		}
+
+		template<typename T>
+		void FramePool::returnArray(map<int, vector<T*> >& idle, T* data, int pixelCount)
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			mStats.outstandingArrays--;
+			if(!mIsClosed)
+			{
+				vector<T*>& list = idle[pixelCount];
+				if((int) list.size() < mMaxIdle)
+				{
+					list.push_back(data);
+					mStats.idleArrays++;
+					return;
+				}
+			}
+			lock.unlock();
+			alignedFree(data);
+		}
+
+		template<typename T>
+		void FramePool::freeArrays(map<int, vector<T*> >& idle)
+		{
+			for(typename map<int, vector<T*> >::iterator list = idle.begin(); list != idle.end(); ++list)
+			{
+				for(size_t i = 0; i < list->second.size(); i++)
+					alignedFree(list->second[i]);
+			}
+			idle.clear();
+		}
+
+		RGBDFrame* FramePool::takeFrame()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			mStats.outstandingFrames++;
+			if(!mIdleFrames.empty())
+			{
+				RGBDFrame* frame = mIdleFrames.back();
+				mIdleFrames.pop_back();
+				return frame;
+			}
+			lock.unlock();
+			return new RGBDFrame();
+		}
+
+		void FramePool::returnFrame(RGBDFrame* frame)
+		{
+			//Release the arrays first. Their deleters take the pool lock themselves
+			frame->setResolutionAndArrays(0, 0, ColorPixelArray(), DPixelArray());
+			frame->resetMetaData();
+
+			boost::mutex::scoped_lock lock(mGuard);
+			mStats.outstandingFrames--;
+			if(!mIsClosed && (int) mIdleFrames.size() < mMaxIdle)
+			{
+				mIdleFrames.push_back(frame);
+				return;
+			}
+			lock.unlock();
+			delete frame;
+		}
+
+		DPixel* FramePool::takeDepth(int pixelCount)
+		{
+			return takeArray(mIdleDepth, pixelCount);
+		}
+
+		void FramePool::returnDepth(DPixel* data, int pixelCount)
+		{
+			returnArray(mIdleDepth, data, pixelCount);
+		}
+
+		ColorPixel* FramePool::takeColor(int pixelCount)
+		{
+			return takeArray(mIdleColor, pixelCount);
+		}
+
+		void FramePool::returnColor(ColorPixel* data, int pixelCount)
+		{
+			returnArray(mIdleColor, data, pixelCount);
+		}
+
+		uint8_t* FramePool::takeSlab(int bytes)
+		{
+			return takeArray(mIdleSlabs, bytes);
+		}
+
+		void FramePool::returnSlab(uint8_t* data, int bytes)
+		{
+			returnArray(mIdleSlabs, data, bytes);
+		}
+
+		void FramePool::setMaxIdle(int maxIdle)
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			mMaxIdle = max(maxIdle, 0);
+		}
+
+		int FramePool::getMaxIdle()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			return mMaxIdle;
+		}
+
+		FramePoolStats FramePool::getStats()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			return mStats;
+		}
+
+		void FramePool::close()
+		{
+			boost::mutex::scoped_lock lock(mGuard);
+			mIsClosed = true;
+			for(size_t i = 0; i < mIdleFrames.size(); i++)
+				delete mIdleFrames[i];
+			mIdleFrames.clear();
+			freeArrays(mIdleDepth);
+			freeArrays(mIdleColor);
+			freeArrays(mIdleSlabs);
+			mStats.idleArrays = 0;
+		}
+
+
 		RGBDFrameFactory::RGBDFrameFactory(void)
 		{
+			mPool = FramePoolPtr(new FramePool());
+			mUseSlabs = true;
+			mPadRows = false;
 		}
 
 
 		RGBDFrameFactory::~RGBDFrameFactory(void)
 		{
+			//Frames still in use keep the pool alive. Make them free their memory when released
+			mPool->close();
 		}
 
 
@@ -23,7 +188,7 @@ namespace rgbd
 		//Metadata will be reset by the factory
 		RGBDFramePtr RGBDFrameFactory::getRGBDFrame()
 		{
-			return getRGBDFrame(0,0);
+			return RGBDFramePtr(mPool->takeFrame(), PooledFrameDeleter(mPool));
 		}
 
 		//Returns a frame with the specified resolution
@@ -31,9 +196,30 @@ namespace rgbd
 		//The memory is not garunteed to be clear. As an optimization, this has been left to the user code to specify
 		RGBDFramePtr RGBDFrameFactory::getRGBDFrame(int width, int height)
 		{
-			//TODO: Impelement frame recycling for memory efficiency
-			return RGBDFramePtr(new RGBDFrame(width, height));
+			RGBDFramePtr frame = getRGBDFrame();
+			if(width <= 0 || height <= 0)
+				return frame;
+
+			if(mUseSlabs)
+			{
+				int pitch = RGBDFrame::getSlabPitch(width, mPadRows);
+				int bytes = (int) RGBDFrame::getSlabSize(height, pitch);
+				frame->setResolutionAndSlab(width, height, pitch, FrameSlab(mPool->takeSlab(bytes), PooledSlabDeleter(mPool, bytes)));
+			}else{
+				frame->setResolutionAndArrays(width, height, getColorArray(width*height), getDepthArray(width*height));
+			}
+			return frame;
+		}
+
+		DPixelArray RGBDFrameFactory::getDepthArray(int pixelCount)
+		{
+			return DPixelArray(mPool->takeDepth(pixelCount), PooledDepthDeleter(mPool, pixelCount));
+		}
+
+		ColorPixelArray RGBDFrameFactory::getColorArray(int pixelCount)
+		{
+			return ColorPixelArray(mPool->takeColor(pixelCount), PooledColorDeleter(mPool, pixelCount));
 		}
 
 	}
-}
\ No newline at end of file
+}
@@ -0,0 +1,59 @@
+#include "SIMDUtils.h"
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#include <immintrin.h>
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#endif
+
+namespace rgbd
+{
+	namespace framework
+	{
+		static bool detectAVX2()
+		{
+#if defined(_MSC_VER) && _MSC_VER >= 1700
+			int info[4];
+			__cpuid(info, 0);
+			if(info[0] < 7)
+				return false;
+
+			//The OS has to save the ymm registers (OSXSAVE, then XCR0 bits 1 and 2) on top of the CPU reporting AVX
+			__cpuid(info, 1);
+			if((info[2] & (1 << 27)) == 0 || (info[2] & (1 << 28)) == 0)
+				return false;
+			if((_xgetbv(0) & 6) != 6)
+				return false;
+
+			__cpuidex(info, 7, 0);
+			return (info[1] & (1 << 5)) != 0;
+#elif defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+			unsigned int eax, ebx, ecx, edx;
+			if(__get_cpuid_max(0, 0) < 7)
+				return false;
+
+			//The OS has to save the ymm registers (OSXSAVE, then XCR0 bits 1 and 2) on top of the CPU reporting AVX
+			__cpuid(1, eax, ebx, ecx, edx);
+			if((ecx & (1 << 27)) == 0 || (ecx & (1 << 28)) == 0)
+				return false;
+			unsigned int xcr0Low, xcr0High;
+			__asm__ ("xgetbv" : "=a" (xcr0Low), "=d" (xcr0High) : "c" (0));
+			if((xcr0Low & 6) != 6)
+				return false;
+
+			__cpuid_count(7, 0, eax, ebx, ecx, edx);
+			return (ebx & (1 << 5)) != 0;
+#else
+			return false;
+#endif
+		}
+
+		bool cpuHasAVX2()
+		{
+			//Every caller computes the same value, so a racing first call is harmless
+			static const bool hasAVX2 = detectAVX2();
+			return hasAVX2;
+		}
+	}
+}
@@ -0,0 +1,553 @@
+#include "SyntheticDevice.h"
+#include <math.h>
+
+namespace rgbd
+{
+	namespace framework
+	{
+		static inline SyntheticVec3 operator+(SyntheticVec3 a, SyntheticVec3 b) {return SyntheticVec3(a.x + b.x, a.y + b.y, a.z + b.z);}
+		static inline SyntheticVec3 operator-(SyntheticVec3 a, SyntheticVec3 b) {return SyntheticVec3(a.x - b.x, a.y - b.y, a.z - b.z);}
+		static inline SyntheticVec3 operator*(SyntheticVec3 a, float s) {return SyntheticVec3(a.x*s, a.y*s, a.z*s);}
+		static inline float dot(SyntheticVec3 a, SyntheticVec3 b) {return a.x*b.x + a.y*b.y + a.z*b.z;}
+		static inline float length(SyntheticVec3 a) {return sqrtf(dot(a, a));}
+
+		//Row major rotation from camera to world
+		struct Rotation
+		{
+			SyntheticVec3 rows[3];
+
+			inline SyntheticVec3 apply(SyntheticVec3 v) const {return SyntheticVec3(dot(rows[0], v), dot(rows[1], v), dot(rows[2], v));}
+			inline SyntheticVec3 applyInverse(SyntheticVec3 v) const {return rows[0]*v.x + rows[1]*v.y + rows[2]*v.z;}
+		};
+
+		static Rotation makeRotation(float yaw, float pitch)
+		{
+			//Ry(yaw)*Rx(pitch)
+			float cy = cosf(yaw), sy = sinf(yaw), cp = cosf(pitch), sp = sinf(pitch);
+			Rotation r;
+			r.rows[0] = SyntheticVec3(cy, sy*sp, sy*cp);
+			r.rows[1] = SyntheticVec3(0.0f, cp, -sp);
+			r.rows[2] = SyntheticVec3(-sy, cy*sp, cy*cp);
+			return r;
+		}
+
+		//Small fast generator for per pixel noise. Seeded per row so every frame renders the same way each time
+		struct NoiseSource
+		{
+			uint32_t state;
+
+			NoiseSource(int frameIndex, int row)
+			{
+				state = ((uint32_t) frameIndex*0x9E3779B1u) ^ ((uint32_t) row*0x85EBCA6Bu) ^ 0x6A09E667u;
+				if(state == 0)
+					state = 1;
+			}
+
+			inline float uniform()
+			{
+				state ^= state << 13;
+				state ^= state >> 17;
+				state ^= state << 5;
+				return (state >> 8)*(1.0f/16777216.0f);
+			}
+
+			//Unit variance, sum of four uniforms
+			inline float gaussian()
+			{
+				return (uniform() + uniform() + uniform() + uniform() - 2.0f)*1.7320508f;
+			}
+		};
+
+		//A planar surface in the frame being rendered, in world coordinates
+		struct Surface
+		{
+			SyntheticVec3 normal;
+			float distance;
+			ColorPixel color;
+			//distance - dot(normal, camera position). Hit distance along a ray d is offset/dot(normal, d)
+			float offset;
+			//dot(normal, d) at the start of the current row, and its change per pixel
+			float rowDenom, stepDenom;
+		};
+
+		static inline uint8_t clampColor(float value)
+		{
+			return (uint8_t) (value < 0.0f ? 0.0f : (value > 255.0f ? 255.0f : value + 0.5f));
+		}
+
+		static inline ColorPixel makeColor(uint8_t r, uint8_t g, uint8_t b)
+		{
+			ColorPixel color = {r, g, b};
+			return color;
+		}
+
+		SyntheticDevice::SyntheticDevice(void)
+		{
+			mXRes = SYNTHETIC_KINECT_X_RES;
+			mYRes = SYNTHETIC_KINECT_Y_RES;
+			mFrameRate = 30.0;
+			mRealTimePlayback = true;
+			mFrameLimit = 0;
+			mLoopTrajectory = true;
+
+			mNoise.depthNoiseScale = 1.0f;
+			mNoise.quantizeDisparity = true;
+			mNoise.minRange = 0.5f;
+			mNoise.maxRange = 4.5f;
+			mNoise.minIncidenceCos = 0.1f;
+			mNoise.colorNoise = 2.0f;
+
+			mIsConnected = false;
+			mColorStreaming = false;
+			mDepthStreaming = false;
+			mFramesGenerated = 0;
+
+			loadDefaultScene();
+		}
+
+		SyntheticDevice::~SyntheticDevice(void)
+		{
+			mColorStreaming = false;
+			mDepthStreaming = false;
+			joinStreamThread();
+		}
+
+		DeviceStatus SyntheticDevice::initialize(void)
+		{
+			return DEVICESTATUS_OK;
+		}
+
+		DeviceStatus SyntheticDevice::connect(void)
+		{
+			mIsConnected = true;
+			onConnect();
+			return DEVICESTATUS_OK;
+		}
+
+		DeviceStatus SyntheticDevice::disconnect(void)
+		{
+			//No frames arrive after disconnect returns
+			mColorStreaming = false;
+			mDepthStreaming = false;
+			joinStreamThread();
+			mIsConnected = false;
+			onDisconnect();
+			return DEVICESTATUS_OK;
+		}
+
+		DeviceStatus SyntheticDevice::shutdown(void)
+		{
+			return DEVICESTATUS_OK;
+		}
+
+		void SyntheticDevice::startStreamThread()
+		{
+			mFramesGenerated = 0;
+			mStreamThread = boost::thread(&SyntheticDevice::generateFrames, this);
+		}
+
+		void SyntheticDevice::joinStreamThread()
+		{
+			if(mStreamThread.joinable())
+				mStreamThread.join();
+		}
+
+		bool SyntheticDevice::createColorStream()
+		{
+			if(!mIsConnected)
+				return false;
+
+			if(!mColorStreaming && !mDepthStreaming)
+			{
+				//Threads from the previous session see both streams stopped and exit
+				joinStreamThread();
+				mColorStreaming = true;
+				startStreamThread();
+			}
+			mColorStreaming = true;
+			return true;
+		}
+
+		bool SyntheticDevice::createDepthStream()
+		{
+			if(!mIsConnected)
+				return false;
+
+			if(!mColorStreaming && !mDepthStreaming)
+			{
+				joinStreamThread();
+				mDepthStreaming = true;
+				startStreamThread();
+			}
+			mDepthStreaming = true;
+			return true;
+		}
+
+		bool SyntheticDevice::destroyColorStream()
+		{
+			mColorStreaming = false;
+			return true;
+		}
+
+		bool SyntheticDevice::destroyDepthStream()
+		{
+			mDepthStreaming = false;
+			return true;
+		}
+
+		Intrinsics SyntheticDevice::getColorIntrinsics()
+		{
+			return getDepthIntrinsics();
+		}
+
+		Intrinsics SyntheticDevice::getDepthIntrinsics()
+		{
+			float scaleX = mXRes/(float) SYNTHETIC_KINECT_X_RES;
+			float scaleY = mYRes/(float) SYNTHETIC_KINECT_Y_RES;
+			return Intrinsics(585.05108211f*scaleX, 585.05108211f*scaleY, 315.83800193f*scaleX, 242.94140713f*scaleY);
+		}
+
+		bool SyntheticDevice::setResolution(int xRes, int yRes)
+		{
+			if(mColorStreaming || mDepthStreaming || xRes <= 0 || yRes <= 0)
+				return false;
+
+			mXRes = xRes;
+			mYRes = yRes;
+			return true;
+		}
+
+		void SyntheticDevice::setFrameRate(double fps)
+		{
+			if(fps > 0.0)
+				mFrameRate = fps;
+		}
+
+		timestamp SyntheticDevice::getFrameTimestamp(int frameIndex)
+		{
+			return (timestamp) (frameIndex*1000000.0/mFrameRate);
+		}
+
+		void SyntheticDevice::clearScene()
+		{
+			boost::mutex::scoped_lock lock(mSceneGuard);
+			mPlanes.clear();
+			mBoxes.clear();
+		}
+
+		void SyntheticDevice::addPlane(const SyntheticPlane& plane)
+		{
+			boost::mutex::scoped_lock lock(mSceneGuard);
+			SyntheticPlane normalized = plane;
+			float len = length(plane.normal);
+			if(len <= 0.0f)
+				return;
+			normalized.normal = plane.normal*(1.0f/len);
+			normalized.distance = plane.distance/len;
+			mPlanes.push_back(normalized);
+		}
+
+		void SyntheticDevice::addBox(const SyntheticBox& box)
+		{
+			boost::mutex::scoped_lock lock(mSceneGuard);
+			mBoxes.push_back(box);
+		}
+
+		void SyntheticDevice::loadDefaultScene()
+		{
+			clearScene();
+			clearTrajectory();
+
+			//Floor 1.2m below the camera, back wall 4m ahead, side wall 2m to the left
+			SyntheticPlane floor = {SyntheticVec3(0.0f, 1.0f, 0.0f), 1.2f, makeColor(140, 120, 100)};
+			SyntheticPlane backWall = {SyntheticVec3(0.0f, 0.0f, 1.0f), 4.0f, makeColor(200, 200, 190)};
+			SyntheticPlane sideWall = {SyntheticVec3(1.0f, 0.0f, 0.0f), -2.0f, makeColor(120, 150, 180)};
+			addPlane(floor);
+			addPlane(backWall);
+			addPlane(sideWall);
+
+			//Table standing on the floor
+			SyntheticBox table = {SyntheticVec3(-0.5f, 0.45f, 1.8f), SyntheticVec3(0.5f, 1.2f, 2.6f), makeColor(160, 90, 50)};
+			addBox(table);
+
+			//Look down at the table and pan left and right over 10 seconds
+			SyntheticPose left = {0.0, SyntheticVec3(0.0f, 0.0f, 0.0f), -0.3f, -0.3f};
+			SyntheticPose right = {5.0, SyntheticVec3(0.3f, 0.0f, 0.2f), 0.3f, -0.3f};
+			SyntheticPose back = {10.0, SyntheticVec3(0.0f, 0.0f, 0.0f), -0.3f, -0.3f};
+			addTrajectoryPose(left);
+			addTrajectoryPose(right);
+			addTrajectoryPose(back);
+		}
+
+		void SyntheticDevice::clearTrajectory()
+		{
+			boost::mutex::scoped_lock lock(mSceneGuard);
+			mTrajectory.clear();
+		}
+
+		void SyntheticDevice::addTrajectoryPose(const SyntheticPose& pose)
+		{
+			boost::mutex::scoped_lock lock(mSceneGuard);
+			mTrajectory.push_back(pose);
+		}
+
+		void SyntheticDevice::setNoiseModel(const SyntheticNoiseModel& noise)
+		{
+			boost::mutex::scoped_lock lock(mSceneGuard);
+			mNoise = noise;
+		}
+
+		SyntheticNoiseModel SyntheticDevice::getNoiseModel()
+		{
+			boost::mutex::scoped_lock lock(mSceneGuard);
+			return mNoise;
+		}
+
+		SyntheticPose SyntheticDevice::getPose(double time)
+		{
+			if(mTrajectory.empty())
+			{
+				SyntheticPose identity = {time, SyntheticVec3(), 0.0f, 0.0f};
+				return identity;
+			}
+
+			const SyntheticPose& first = mTrajectory.front();
+			const SyntheticPose& last = mTrajectory.back();
+			if(mLoopTrajectory && last.time > first.time)
+				time = first.time + fmod(time - first.time, last.time - first.time);
+
+			if(time <= first.time)
+				return first;
+			if(time >= last.time)
+				return last;
+
+			size_t next = 1;
+			while(mTrajectory[next].time < time)
+				next++;
+			const SyntheticPose& a = mTrajectory[next - 1];
+			const SyntheticPose& b = mTrajectory[next];
+			float w = (b.time > a.time) ? (float) ((time - a.time)/(b.time - a.time)) : 1.0f;
+
+			SyntheticPose pose;
+			pose.time = time;
+			pose.position = a.position + (b.position - a.position)*w;
+			pose.yaw = a.yaw + (b.yaw - a.yaw)*w;
+			pose.pitch = a.pitch + (b.pitch - a.pitch)*w;
+			return pose;
+		}
+
+		void SyntheticDevice::renderFrame(int frameIndex, RGBDFramePtr frame, vector<SyntheticPlaneStats>* groundTruth)
+		{
+			int xRes = frame->getXRes();
+			int yRes = frame->getYRes();
+			float scaleX = xRes/(float) SYNTHETIC_KINECT_X_RES;
+			float scaleY = yRes/(float) SYNTHETIC_KINECT_Y_RES;
+			Intrinsics intr(585.05108211f*scaleX, 585.05108211f*scaleY, 315.83800193f*scaleX, 242.94140713f*scaleY);
+
+			boost::mutex::scoped_lock lock(mSceneGuard);
+			SyntheticPose pose = getPose(frameIndex/mFrameRate);
+			Rotation rotation = makeRotation(pose.yaw, pose.pitch);
+			SyntheticVec3 origin = pose.position;
+			SyntheticNoiseModel noise = mNoise;
+
+			//Flatten the scene into planar surfaces. Box faces are bounded by the box's extent on the other two axes
+			vector<Surface> surfaces;
+			surfaces.reserve(mPlanes.size() + 6*mBoxes.size());
+			for(size_t i = 0; i < mPlanes.size(); i++)
+			{
+				Surface surface = {mPlanes[i].normal, mPlanes[i].distance, mPlanes[i].color, 0.0f, 0.0f, 0.0f};
+				surfaces.push_back(surface);
+			}
+			for(size_t i = 0; i < mBoxes.size(); i++)
+			{
+				const SyntheticBox& box = mBoxes[i];
+				float minValues[3] = {box.minCorner.x, box.minCorner.y, box.minCorner.z};
+				float maxValues[3] = {box.maxCorner.x, box.maxCorner.y, box.maxCorner.z};
+				for(int axis = 0; axis < 3; axis++)
+				{
+					float n[3] = {0.0f, 0.0f, 0.0f};
+					n[axis] = -1.0f;
+					Surface low = {SyntheticVec3(n[0], n[1], n[2]), -minValues[axis], box.color, 0.0f, 0.0f, 0.0f};
+					n[axis] = 1.0f;
+					Surface high = {SyntheticVec3(n[0], n[1], n[2]), maxValues[axis], box.color, 0.0f, 0.0f, 0.0f};
+					surfaces.push_back(low);
+					surfaces.push_back(high);
+				}
+			}
+			int planeCount = (int) mPlanes.size();
+			int surfaceCount = (int) surfaces.size();
+
+			//Box faces turned away from the camera are hidden by the front faces, so only front faces are tested
+			vector<int> tested;
+			for(int s = 0; s < surfaceCount; s++)
+			{
+				surfaces[s].offset = surfaces[s].distance - dot(surfaces[s].normal, origin);
+				if(s < planeCount || surfaces[s].offset < 0.0f)
+					tested.push_back(s);
+			}
+
+			//Ground truth sums per surface
+			vector<int> counts(surfaceCount, 0);
+			vector<double> sums(3*surfaceCount, 0.0);
+
+			//Ray direction per pixel is linear in x, d = rowStart + x*step. Its camera z is 1, so hit distance is depth
+			float invFx = 1.0f/intr.fx;
+			SyntheticVec3 step = rotation.apply(SyntheticVec3(invFx, 0.0f, 0.0f));
+			for(int s = 0; s < surfaceCount; s++)
+				surfaces[s].stepDenom = dot(surfaces[s].normal, step);
+			float bf = SYNTHETIC_KINECT_BASELINE*intr.fx;
+			DPixel noDepth = {0};
+			ColorPixel background = {0, 0, 0};
+
+			for(int y = 0; y < yRes; y++)
+			{
+				DPixel* depthRow = frame->getDepthRow(y);
+				ColorPixel* colorRow = frame->getColorRow(y);
+				NoiseSource random(frameIndex, y);
+				float rayY = (y - intr.cy)/intr.fy;
+				SyntheticVec3 rowStart = rotation.apply(SyntheticVec3(-intr.cx*invFx, rayY, 1.0f));
+				for(int s = 0; s < surfaceCount; s++)
+					surfaces[s].rowDenom = dot(surfaces[s].normal, rowStart);
+
+				for(int x = 0; x < xRes; x++)
+				{
+					SyntheticVec3 ray = rowStart + step*(float) x;
+
+					//Nearest surface in front of the camera
+					float bestT = 1e30f;
+					int best = -1;
+					for(size_t i = 0; i < tested.size(); i++)
+					{
+						int s = tested[i];
+						//t = offset/denom, tested for 0 < t < bestT without dividing
+						float denom = surfaces[s].rowDenom + x*surfaces[s].stepDenom;
+						float offset = surfaces[s].offset;
+						if(denom < 0.0f)
+						{
+							denom = -denom;
+							offset = -offset;
+						}
+						if(denom < 1e-6f || offset <= 0.0f || offset >= bestT*denom)
+							continue;
+						float t = offset/denom;
+
+						if(s >= planeCount)
+						{
+							//Hits on a box face plane only count inside the face
+							const SyntheticBox& box = mBoxes[(s - planeCount)/6];
+							SyntheticVec3 hit = origin + ray*t;
+							const float eps = 1e-4f;
+							if(hit.x < box.minCorner.x - eps || hit.x > box.maxCorner.x + eps ||
+								hit.y < box.minCorner.y - eps || hit.y > box.maxCorner.y + eps ||
+								hit.z < box.minCorner.z - eps || hit.z > box.maxCorner.z + eps)
+								continue;
+						}
+						bestT = t;
+						best = s;
+					}
+
+					if(best < 0)
+					{
+						depthRow[x] = noDepth;
+						colorRow[x] = background;
+						continue;
+					}
+
+					const Surface& surface = surfaces[best];
+					float incidence = fabsf(dot(surface.normal, ray))/length(ray);
+
+					float shade = 0.3f + 0.7f*incidence;
+					colorRow[x].r = clampColor(surface.color.r*shade + random.gaussian()*noise.colorNoise);
+					colorRow[x].g = clampColor(surface.color.g*shade + random.gaussian()*noise.colorNoise);
+					colorRow[x].b = clampColor(surface.color.b*shade + random.gaussian()*noise.colorNoise);
+
+					counts[best]++;
+					sums[3*best] += (x - intr.cx)*invFx*bestT;
+					sums[3*best + 1] += rayY*bestT;
+					sums[3*best + 2] += bestT;
+
+					float z = bestT;
+					if(z < noise.minRange || z > noise.maxRange || incidence < noise.minIncidenceCos)
+					{
+						depthRow[x] = noDepth;
+						continue;
+					}
+
+					z += random.gaussian()*noise.depthNoiseScale*SYNTHETIC_KINECT_NOISE_COEFF*z*z;
+					if(noise.quantizeDisparity && z > 0.0f)
+					{
+						float disparity = floorf(bf/z*SYNTHETIC_KINECT_SUBPIXEL + 0.5f)/SYNTHETIC_KINECT_SUBPIXEL;
+						z = (disparity > 0.0f) ? bf/disparity : 0.0f;
+					}
+
+					float millimeters = z*1000.0f + 0.5f;
+					depthRow[x].depth = (uint16_t) (millimeters < 0.0f ? 0.0f : (millimeters > 65535.0f ? 65535.0f : millimeters));
+				}
+			}
+
+			if(groundTruth != NULL)
+			{
+				groundTruth->clear();
+				for(size_t s = 0; s < surfaces.size(); s++)
+				{
+					if(counts[s] == 0)
+						continue;
+
+					//Plane in camera coordinates: dot(R^T n, p) = distance - dot(n, origin)
+					SyntheticVec3 normal = rotation.applyInverse(surfaces[s].normal);
+					float offset = surfaces[s].offset;
+					if(offset > 0.0f)
+					{
+						normal = normal*-1.0f;
+						offset = -offset;
+					}
+
+					SyntheticPlaneStats stats;
+					stats.primitive = (s < (size_t) planeCount) ? (int) s : planeCount + ((int) s - planeCount)/6;
+					stats.face = (s < (size_t) planeCount) ? 0 : ((int) s - planeCount)%6;
+					stats.normal = normal;
+					stats.distance = -offset;
+					stats.count = counts[s];
+					stats.centroid = SyntheticVec3((float) (sums[3*s]/counts[s]), (float) (sums[3*s + 1]/counts[s]), (float) (sums[3*s + 2]/counts[s]));
+					groundTruth->push_back(stats);
+				}
+			}
+
+			timestamp time = getFrameTimestamp(frameIndex);
+			frame->setDepthTimestamp(time);
+			frame->setColorTimestamp(time);
+			frame->setHasDepth(true);
+			frame->setHasColor(true);
+		}
+
+		void SyntheticDevice::generateFrames()
+		{
+			boost::chrono::steady_clock::time_point start = boost::chrono::steady_clock::now();
+			int frameIndex = 0;
+			while(mColorStreaming || mDepthStreaming)
+			{
+				if(mFrameLimit > 0 && frameIndex >= mFrameLimit)
+					break;
+
+				if(mRealTimePlayback)
+				{
+					boost::chrono::duration<double> offset(frameIndex/mFrameRate);
+					boost::this_thread::sleep_until(start + boost::chrono::duration_cast<boost::chrono::nanoseconds>(offset));
+				}
+
+				RGBDFramePtr frame = mFrameFactory.getRGBDFrame(mXRes, mYRes);
+				renderFrame(frameIndex, frame);
+				frame->setHasDepth(mDepthStreaming);
+				frame->setHasColor(mColorStreaming);
+				onNewRGBDFrame(frame);
+
+				frameIndex++;
+				mFramesGenerated = frameIndex;
+			}
+
+			//Reaching the frame limit ends both streams. create* joins this thread before setting the flags again
+			mColorStreaming = false;
+			mDepthStreaming = false;
+		}
+	}
+}
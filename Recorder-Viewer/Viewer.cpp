@@ -128,7 +128,7 @@ openni::Status SampleViewer::init(int argc, char **argv)
 	m_pTexMap = new openni::RGB888Pixel[m_nTexMapX * m_nTexMapY];
 
 	//Register frame listener
-	mDevice->addNewRGBDFrameListener(this);
+	mDevice->addNewRGBDFrameListener(this, DISPATCH_LATEST);
 	return initOpenGL(argc, argv);
 
 }
@@ -140,6 +140,21 @@ openni::Status SampleViewer::run()	//Does not return
 }
 void SampleViewer::display()
 {
+	//The mailbox fills in streams an unsynced device left out, but frames from before the first of each stream still lack one
+	RGBDFramePtr latestFrame = mFrameMailbox.consume();
+	if(latestFrame != NULL)
+	{
+		if(latestFrame->hasColor())
+		{
+			mColorArray = latestFrame->getColorArray();
+		}
+
+		if(latestFrame->hasDepth())
+		{
+			mDepthArray = latestFrame->getDepthArray();
+		}
+	}
+
 	ColorPixelArray localColorArray = mColorArray;
 	DPixelArray localDepthArray = mDepthArray;
 
@@ -270,8 +285,9 @@ void SampleViewer::onKey(unsigned char key, int /*x*/, int /*y*/)
 		break;
 	case 'r':
 		//Start recording
-		logger.setDepthCompressionMethod(LZ4_COMPRESSION);
-		logger.setColorCompressionMethod(NO_COMPRESSION);
+		logger.setDepthCompressionMethod(DEPTH_PREDICTIVE_COMPRESSION);
+		logger.setColorCompressionMethod(COLOR_YCOCG_COMPRESSION);
+		logger.setDepthKeyframeInterval(30);
 		if(!logger.setOutputDirectory("logs/recording"))
 			cout<<"Could not set output directory"<<endl;
 
@@ -329,17 +345,6 @@ void SampleViewer::initOpenGLHooks()
 
 void SampleViewer::onNewRGBDFrame(RGBDFramePtr frame)
 {
-	latestFrame = frame;
-	if(latestFrame != NULL)
-	{
-		if(latestFrame->hasColor())
-		{
-			mColorArray = latestFrame->getColorArray();
-		}
-
-		if(latestFrame->hasDepth())
-		{
-			mDepthArray = latestFrame->getDepthArray();
-		}
-	}
+	//Runs on the dispatch thread. display() picks the frame up
+	mFrameMailbox.publish(frame);
 }
\ No newline at end of file
@@ -58,7 +58,7 @@ protected:
 
 	RGBDDevice*			mDevice;
 
-	RGBDFramePtr latestFrame;
+	LatestFrameMailbox mFrameMailbox;
 	ColorPixelArray mColorArray;
 	DPixelArray mDepthArray;
 private: